@@ -0,0 +1,181 @@
+/*
+* Drift benchmark of the simulation precision
+*
+* Simulates a cloth hanging by two corners with the integration kernels of the physics engine,
+* then reports the step time and, if a reference run is given, how far the particles drifted from it.
+* Built twice (clothDriftBenchmarkDouble / clothDriftBenchmarkFloat), usage:
+*	clothDriftBenchmarkDouble --output reference.txt
+*	clothDriftBenchmarkFloat --reference reference.txt
+* Options: --res N (cloth resolution, 30), --steps N (3000), --dt S (0.001)
+*/
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+#include "../src/physics/simd/clothKernels.hpp"
+#include "../src/physics/simd/simdDispatch.hpp"
+
+// Includes from STL
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+
+struct BenchmarkOptions
+{
+	int m_res = 30;
+	int m_steps = 3000;
+	double m_dt = 0.001;
+	std::string m_outputPath;
+	std::string m_referencePath;
+};
+
+
+static BenchmarkOptions parseOptions(const int argc, char** argv)
+{
+	BenchmarkOptions options;
+	for (int k = 1; k + 1 < argc; k += 2)
+	{
+		const std::string name = argv[k];
+		const std::string value = argv[k + 1];
+		if (name == "--res")
+		{
+			options.m_res = std::max(5, std::atoi(value.c_str()));
+		}
+		else if (name == "--steps")
+		{
+			options.m_steps = std::max(1, std::atoi(value.c_str()));
+		}
+		else if (name == "--dt")
+		{
+			options.m_dt = std::atof(value.c_str());
+		}
+		else if (name == "--output")
+		{
+			options.m_outputPath = value;
+		}
+		else if (name == "--reference")
+		{
+			options.m_referencePath = value;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << name << std::endl;
+		}
+	}
+	return options;
+}
+
+
+/*
+* Same setup as a Cloth of 1 x 1 with a mass of 1, in the XZ plane, hanging by the two corners of its first row
+*/
+static void initCloth(ClothParticleStore& store, ClothSpringStencil& stencil, const int res)
+{
+	const double spacing = 1.0 / static_cast<double>(res - 1);
+	const double particleMass = 1.0 / static_cast<double>(res * res);
+
+	store.resize(res, res);
+	for (int i = 0; i < res; ++i)
+	{
+		for (int j = 0; j < res; ++j)
+		{
+			const size_t index = store.getIndex(i, j);
+			store.m_position[index] = Vec3R(static_cast<double>(i) * spacing, 2.0, static_cast<double>(j) * spacing);
+			store.m_inverseMass[index] = static_cast<Real>(1.0 / particleMass);
+		}
+	}
+	store.setFixed(store.getIndex(0, 0), true);
+	store.setFixed(store.getIndex(0, res - 1), true);
+	store.copyCurrentToPrevious(0, store.size());
+
+	stencil.init(res, res, spacing, spacing, 1000.0, 0.0);
+}
+
+
+int main(int argc, char** argv)
+{
+	const BenchmarkOptions options = parseOptions(argc, argv);
+	const int rowsPerBatch = 5;
+
+	ClothParticleStore store;
+	ClothSpringStencil stencil;
+	initCloth(store, stencil, options.m_res);
+
+	ClothIntegrationParams params;
+	params.m_dt = static_cast<Real>(options.m_dt);
+	params.m_pStencil = &stencil;
+
+	std::cout << "Precision: " << (sizeof(Real) == sizeof(float) ? "float" : "double")
+		<< ", kernels: " << SimdDispatch::getIsaName(SimdDispatch::getActiveIsa())
+		<< ", cloth: " << options.m_res << "x" << options.m_res
+		<< ", steps: " << options.m_steps << std::endl;
+
+	// Same sequence as the orchestrator: integrate all the batches, then copy the state
+	const auto startTime = std::chrono::steady_clock::now();
+	for (int step = 0; step < options.m_steps; ++step)
+	{
+		for (int i = 0; i < options.m_res; i += rowsPerBatch)
+		{
+			ClothKernels::integrateRows(store, params, i, std::min(i + rowsPerBatch, options.m_res));
+		}
+		store.copyCurrentToPrevious(0, store.size());
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	const double particleSteps = static_cast<double>(store.size()) * static_cast<double>(options.m_steps);
+	std::cout << "Time: " << elapsed.count() << " s, "
+		<< (elapsed.count() * 1e9 / particleSteps) << " ns per particle step" << std::endl;
+
+	Vec3 centroid;
+	for (const Vec3R& position : store.m_position)
+	{
+		centroid += Vec3(position);
+	}
+	centroid /= static_cast<double>(store.size());
+	std::cout << std::setprecision(10) << "Centroid: " << centroid.x << " " << centroid.y << " " << centroid.z << std::endl;
+
+	if (!options.m_outputPath.empty())
+	{
+		std::ofstream file(options.m_outputPath);
+		file << std::setprecision(17) << store.size() << "\n";
+		for (const Vec3R& position : store.m_position)
+		{
+			file << static_cast<double>(position.x) << " " << static_cast<double>(position.y) << " " << static_cast<double>(position.z) << "\n";
+		}
+		std::cout << "Positions written to " << options.m_outputPath << std::endl;
+	}
+
+	if (!options.m_referencePath.empty())
+	{
+		std::ifstream file(options.m_referencePath);
+		size_t count = 0;
+		file >> count;
+		if (!file || count != store.size())
+		{
+			std::cerr << "Error: the reference does not match this cloth" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		double maxDrift = 0.0;
+		double sumSquaredDrift = 0.0;
+		for (size_t k = 0; k < count; ++k)
+		{
+			Vec3 reference;
+			file >> reference.x >> reference.y >> reference.z;
+			const double drift = (Vec3(store.m_position[k]) - reference).norm();
+			maxDrift = std::max(maxDrift, drift);
+			sumSquaredDrift += drift * drift;
+		}
+		std::cout << "Drift from the reference: max " << maxDrift << ", rms " << std::sqrt(sumSquaredDrift / static_cast<double>(count)) << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+/*
+* Collision grid benchmark
+*
+* Builds the SortedGridCollider from stacked sheets of particles (like a pile of cloths), then tests the distances
+* between the particles of each non-empty cell and of half of its adjacent cells, like ApplicationData::updateCollisions().
+* The pass is run twice: reading the positions from the cloths (row major storage, one array per cloth, resolved
+* from the handles of the particles) and reading the positions copied in the grid in the order of the cells.
+* Both find the same contacts. Reports the time per step of the build and of the passes, with the cache misses
+* per step when the hardware counters are available (Linux perf events).
+* Usage: gridCollisionBenchmark [--cloths N (8)] [--res N (96)] [--steps N (100)] [--dense 1 (box grid instead of unbounded)]
+*/
+
+// Includes from project
+#include "../src/physics/gridCollider.hpp"
+
+// Includes from STL
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+struct BenchmarkOptions
+{
+	int m_cloths = 8;
+	int m_res = 96;
+	int m_steps = 100;
+	bool m_isDense = false;
+};
+
+
+static BenchmarkOptions parseOptions(const int argc, char** argv)
+{
+	BenchmarkOptions options;
+	for (int k = 1; k + 1 < argc; k += 2)
+	{
+		const std::string name = argv[k];
+		const int value = std::max(1, std::atoi(argv[k + 1]));
+		if (name == "--cloths")
+		{
+			options.m_cloths = value;
+		}
+		else if (name == "--res")
+		{
+			options.m_res = value;
+		}
+		else if (name == "--steps")
+		{
+			options.m_steps = value;
+		}
+		else if (name == "--dense")
+		{
+			options.m_isDense = (std::atoi(argv[k + 1]) != 0);
+		}
+		else
+		{
+			std::cerr << "Unknown option " << name << std::endl;
+		}
+	}
+	return options;
+}
+
+
+/*
+* Counts the cache misses of the calling thread, when the system allows it
+*/
+class CacheMissCounter
+{
+private:
+	int m_fileDescriptor = -1;
+
+public:
+	CacheMissCounter()
+	{
+#ifdef __linux__
+		perf_event_attr attributes{};
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(perf_event_attr);
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		m_fileDescriptor = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if (m_fileDescriptor >= 0)
+		{
+			close(m_fileDescriptor);
+		}
+#endif
+	}
+
+	bool isAvailable() const { return m_fileDescriptor >= 0; }
+
+	void start()
+	{
+#ifdef __linux__
+		if (m_fileDescriptor >= 0)
+		{
+			ioctl(m_fileDescriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(m_fileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	uint64_t stop()
+	{
+		uint64_t count = 0;
+#ifdef __linux__
+		if (m_fileDescriptor >= 0)
+		{
+			ioctl(m_fileDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(m_fileDescriptor, &count, sizeof(count)) != sizeof(count))
+			{
+				count = 0;
+			}
+		}
+#endif
+		return count;
+	}
+};
+
+
+struct PassResult
+{
+	double m_time = 0.0;
+	uint64_t m_cacheMisses = 0;
+	size_t m_contacts = 0;
+};
+
+
+// The adjacent cells checked from a cell, as in ApplicationData::updateCollisions()
+static constexpr int s_halfAdjacentCells[13][3] = {
+	{ -1, -1, -1 }, { 0, -1, -1 }, { 1, -1, -1 },
+	{ -1,  0, -1 }, { 0,  0, -1 }, { 1,  0, -1 },
+	{ -1,  1, -1 }, { 0,  1, -1 }, { 1,  1, -1 },
+	{ -1, -1,  0 }, { 0, -1,  0 }, { 1, -1,  0 },
+	{ 1,  0,  0 }
+};
+
+
+/*
+* Count the pairs of particles closer than the contact distance
+*
+* @param grid The built grid
+* @param getPositions Gives the positions of the particles of a cell, from their handles
+* @param contactDistance Twice the radius of the particles
+* @return size_t The number of pairs in contact
+*/
+template <typename GetPositions>
+static size_t countContacts(const SortedGridCollider& grid, GetPositions&& getPositions, const Real contactDistance)
+{
+	const Real maxSquaredDistance = contactDistance * contactDistance;
+	size_t contactCount = 0;
+	for (size_t cellIndex = 0; cellIndex < grid.getNonEmptyCellCount(); ++cellIndex)
+	{
+		const size_t cell = grid.getNonEmptyCell(cellIndex);
+		int x;
+		int y;
+		int z;
+		grid.getCellCoordsFromIndex(cell, x, y, z);
+
+		size_t count = 0;
+		const uint32_t* pParticles = grid.getCellParticles(cell, count);
+		const Vec3R* pPositions = getPositions(cell, pParticles, count, 0);
+
+		for (int k = -1; k < 13; ++k)
+		{
+			size_t otherCount = count;
+			const Vec3R* pOtherPositions = pPositions;
+			if (k >= 0)
+			{
+				const size_t adjacentCell = grid.findCell(x + s_halfAdjacentCells[k][0], y + s_halfAdjacentCells[k][1], z + s_halfAdjacentCells[k][2]);
+				if (adjacentCell == SortedGridCollider::s_invalidCell)
+				{
+					continue;
+				}
+				const uint32_t* pOtherParticles = grid.getCellParticles(adjacentCell, otherCount);
+				if (otherCount == 0)
+				{
+					continue;
+				}
+				pOtherPositions = getPositions(adjacentCell, pOtherParticles, otherCount, 1);
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				for (size_t j = (k < 0) ? i + 1 : 0; j < otherCount; ++j)
+				{
+					const Vec3R delta = pPositions[i] - pOtherPositions[j];
+					contactCount += (delta.dot(delta) < maxSquaredDistance) ? 1 : 0;
+				}
+			}
+		}
+	}
+	return contactCount;
+}
+
+
+int main(int argc, char** argv)
+{
+	using Clock = std::chrono::steady_clock;
+	const BenchmarkOptions options = parseOptions(argc, argv);
+
+	// Sheets of particles 2 cm apart, stacked 3 cm apart: the cells are twice the contact distance of the application
+	const double spacing = 0.02;
+	const double radius = 0.012;
+	const double cellSize = 0.07;
+	const int res = options.m_res;
+	std::vector<std::vector<Vec3R>> cloths(static_cast<size_t>(options.m_cloths), std::vector<Vec3R>(static_cast<size_t>(res * res)));
+
+	const size_t gridWidth = static_cast<size_t>(10.0 / cellSize);
+	std::unique_ptr<SortedGridCollider> pGrid = options.m_isDense
+		? std::make_unique<SortedGridCollider>(cellSize, gridWidth, gridWidth)
+		: std::make_unique<SortedGridCollider>(cellSize);
+	SortedGridCollider& grid = *pGrid;
+	for (size_t c = 0; c < cloths.size(); ++c)
+	{
+		grid.registerCloth(c, res, res);
+	}
+
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<double> noise(-0.004, 0.004);
+
+	CacheMissCounter cacheMissCounter;
+	double buildTime = 0.0;
+	PassResult clothOrder;
+	PassResult cellOrder;
+	std::vector<Vec3R> gatheredPositions[2];
+
+	for (int step = 0; step < options.m_steps; ++step)
+	{
+		// Move the particles a little, like a step of the simulation
+		for (size_t c = 0; c < cloths.size(); ++c)
+		{
+			for (int i = 0; i < res; ++i)
+			{
+				for (int j = 0; j < res; ++j)
+				{
+					cloths[c][static_cast<size_t>(i * res + j)] = Vec3R(
+						1.0 + i * spacing + noise(generator), 1.0 + c * 0.03 + noise(generator), 1.0 + j * spacing + noise(generator));
+				}
+			}
+		}
+
+		Clock::time_point startTime = Clock::now();
+		for (size_t c = 0; c < cloths.size(); ++c)
+		{
+			for (int i = 0; i < res; ++i)
+			{
+				for (int j = 0; j < res; ++j)
+				{
+					grid.addParticleToCell(cloths[c][static_cast<size_t>(i * res + j)], std::make_tuple(c, i, j));
+				}
+			}
+		}
+		grid.countCells(0, grid.getCellChunkCount());
+		grid.scanCells();
+		grid.writeCellStarts(0, grid.getCellChunkCount());
+		grid.scatterParticles(0, grid.getParticleChunkCount());
+		buildTime += std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+
+		// Positions read from the cloths, through the handles
+		startTime = Clock::now();
+		cacheMissCounter.start();
+		clothOrder.m_contacts += countContacts(grid,
+			[&grid, &cloths, &gatheredPositions, res](const size_t, const uint32_t* pParticles, const size_t count, const int buffer) {
+				std::vector<Vec3R>& positions = gatheredPositions[buffer];
+				positions.resize(count);
+				for (size_t p = 0; p < count; ++p)
+				{
+					const GridParticle& particle = grid.getParticle(pParticles[p]);
+					positions[p] = cloths[particle.m_clothUid][static_cast<size_t>(particle.m_i * res + particle.m_j)];
+				}
+				return positions.data();
+			}, static_cast<Real>(2.0 * radius));
+		clothOrder.m_cacheMisses += cacheMissCounter.stop();
+		clothOrder.m_time += std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+
+		// Positions copied in the grid, in the order of the cells
+		startTime = Clock::now();
+		cacheMissCounter.start();
+		cellOrder.m_contacts += countContacts(grid,
+			[&grid](const size_t cell, const uint32_t*, const size_t, const int) {
+				return grid.getCellPositions(cell);
+			}, static_cast<Real>(2.0 * radius));
+		cellOrder.m_cacheMisses += cacheMissCounter.stop();
+		cellOrder.m_time += std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+
+		grid.clearGridParallelized(0, grid.getNonEmptyCellCount());
+		grid.swap();
+	}
+
+	const double steps = static_cast<double>(options.m_steps);
+	std::cout << options.m_cloths << " cloths of " << res << "x" << res << " particles, " << (options.m_isDense ? "dense" : "unbounded")
+		<< " grid, " << options.m_steps << " steps" << std::endl;
+	std::cout << std::fixed << std::setprecision(1) << "Build: " << buildTime / steps << " us per step" << std::endl;
+	std::cout << std::setw(14) << "positions" << std::setw(14) << "us/step" << std::setw(18) << "cache misses" << std::setw(14) << "contacts" << std::endl;
+	for (const auto& [name, pResult] : { std::make_pair("cloth order", &clothOrder), std::make_pair("cell order", &cellOrder) })
+	{
+		std::cout << std::setw(14) << name << std::setw(14) << pResult->m_time / steps;
+		if (cacheMissCounter.isAvailable())
+		{
+			std::cout << std::setw(18) << static_cast<double>(pResult->m_cacheMisses) / steps;
+		}
+		else
+		{
+			std::cout << std::setw(18) << "n/a";
+		}
+		std::cout << std::setw(14) << pResult->m_contacts / static_cast<size_t>(options.m_steps) << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
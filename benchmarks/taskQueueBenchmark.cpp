@@ -0,0 +1,374 @@
+/*
+* Task dispatch benchmark
+*
+* Compares the TaskQueue backends (work stealing and lock free bounded ring) with the previous mutex guarded queue
+* (reproduced below), on phases of many tiny tasks like the ones of the orchestrator: a batch of rows per task,
+* then a batch of grid cells. Each phase is waited for before the next one, like the barriers of a simulation step.
+* Reports the dispatch throughput, and the latency between the addition of a task and its start (p50, p99, p99.9, max).
+* Then measures the raw contention of the queues alone: every thread pushes and pops values as fast as it can,
+* on the MpmcRing and on a mutex guarded deque.
+* Without --threads, the benchmarks are run with 1, 2, 4, 8, 16, 32 and 64 threads.
+* Usage: taskQueueBenchmark [--threads N] [--phases N (200)] [--rowTasks N (2000)] [--cellTasks N (1500)] [--work N (200)]
+*                           [--operations N (200000, push and pop pairs per thread of the contention benchmark)]
+* --work is the number of loop iterations of each task (a few hundred nanoseconds)
+*/
+
+// Includes from project
+#include "../src/threading/taskQueue.hpp"
+
+// Includes from STL
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdlib>
+
+
+struct BenchmarkOptions
+{
+	std::vector<size_t> m_threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+	int m_phases = 200;
+	int m_rowTasks = 2000;
+	int m_cellTasks = 1500;
+	int m_work = 200;
+	int m_operations = 200000;
+};
+
+
+static BenchmarkOptions parseOptions(const int argc, char** argv)
+{
+	BenchmarkOptions options;
+	for (int k = 1; k + 1 < argc; k += 2)
+	{
+		const std::string name = argv[k];
+		const int value = std::max(1, std::atoi(argv[k + 1]));
+		if (name == "--threads")
+		{
+			options.m_threadCounts = { static_cast<size_t>(value) };
+		}
+		else if (name == "--phases")
+		{
+			options.m_phases = value;
+		}
+		else if (name == "--rowTasks")
+		{
+			options.m_rowTasks = value;
+		}
+		else if (name == "--cellTasks")
+		{
+			options.m_cellTasks = value;
+		}
+		else if (name == "--work")
+		{
+			options.m_work = value;
+		}
+		else if (name == "--operations")
+		{
+			options.m_operations = value;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << name << std::endl;
+		}
+	}
+	return options;
+}
+
+
+/*
+* The previous TaskQueue: one mutex around a deque, every addition wakes up all the workers
+*/
+class MutexTaskQueue
+{
+private:
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::atomic<int> m_taskCount = 0;
+	std::condition_variable m_cv;
+
+public:
+	void addTask(std::function<void()>&& taskCallback)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(taskCallback));
+		m_taskCount++;
+		m_cv.notify_all();
+	}
+
+	void getTask(std::function<void()>& taskCallback, const size_t)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return !m_tasks.empty(); });
+		taskCallback = std::move(m_tasks.front());
+		m_tasks.pop_front();
+	}
+
+	void markTaskAsDone() { m_taskCount--; }
+
+	void waitUntilEmpty()
+	{
+		while (m_taskCount > 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void setWorkerCount(const size_t) {}
+
+	void releaseAll(const size_t numberOfThreads)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.clear();
+		for (size_t i = 0; i < numberOfThreads; ++i)
+		{
+			m_tasks.push_back([]() {});
+		}
+		m_cv.notify_all();
+	}
+};
+
+
+struct BenchmarkResult
+{
+	double m_totalTime = 0.0;
+	size_t m_taskCount = 0;
+	std::vector<double> m_latencies;
+	std::vector<double> m_phaseTimes;
+};
+
+
+static double getPercentile(std::vector<double>& values, const double percentile)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	const size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * static_cast<double>(values.size())));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+
+/*
+* Run the phases with the same worker loop as the orchestrator
+*/
+template <typename Queue>
+static BenchmarkResult runBenchmark(Queue& queue, const BenchmarkOptions& options, const size_t threadCount)
+{
+	using Clock = std::chrono::steady_clock;
+
+	queue.setWorkerCount(threadCount);
+
+	std::atomic<bool> isRunning = true;
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		workers.emplace_back([&queue, &isRunning, i]() {
+			while (isRunning)
+			{
+				std::function<void()> task;
+				queue.getTask(task, i);
+				if (task)
+				{
+					task();
+					queue.markTaskAsDone();
+				}
+			}
+		});
+	}
+
+	const int maxTasks = std::max(options.m_rowTasks, options.m_cellTasks);
+	std::vector<double> phaseLatencies(static_cast<size_t>(maxTasks));
+	const int work = options.m_work;
+
+	BenchmarkResult result;
+	const Clock::time_point startTime = Clock::now();
+	for (int phase = 0; phase < 2 * options.m_phases; ++phase)
+	{
+		// Alternate the row batches and the cell batches phases
+		const int taskCount = (phase % 2 == 0) ? options.m_rowTasks : options.m_cellTasks;
+		const Clock::time_point phaseStart = Clock::now();
+
+		for (int k = 0; k < taskCount; ++k)
+		{
+			const Clock::time_point addTime = Clock::now();
+			double* pLatency = &phaseLatencies[static_cast<size_t>(k)];
+			queue.addTask([addTime, pLatency, work]() {
+				*pLatency = std::chrono::duration<double, std::micro>(Clock::now() - addTime).count();
+
+				// Tiny amount of work, like a small batch of rows or cells
+				volatile double sum = 0.0;
+				for (int w = 0; w < work; ++w)
+				{
+					sum = sum + static_cast<double>(w) * 0.5;
+				}
+			});
+		}
+		queue.waitUntilEmpty();
+
+		result.m_phaseTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - phaseStart).count());
+		result.m_latencies.insert(result.m_latencies.end(), phaseLatencies.begin(), phaseLatencies.begin() + taskCount);
+		result.m_taskCount += static_cast<size_t>(taskCount);
+	}
+	result.m_totalTime = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+	isRunning = false;
+	queue.releaseAll(threadCount);
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	return result;
+}
+
+
+/*
+* A deque guarded by a mutex, to compare the contention of the MpmcRing with
+*/
+class MutexDeque
+{
+private:
+	std::deque<int> m_values;
+	std::mutex m_mutex;
+
+public:
+	bool tryPush(int& value)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_values.push_back(value);
+		return true;
+	}
+
+	bool tryPop(int& value)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_values.empty())
+		{
+			return false;
+		}
+		value = m_values.front();
+		m_values.pop_front();
+		return true;
+	}
+};
+
+
+/*
+* Every thread pushes a value then pops one, as fast as it can
+*
+* @return double Millions of push and pop pairs per second, for all the threads
+*/
+template <typename Queue>
+static double runContentionBenchmark(Queue& queue, const size_t threadCount, const int operations)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::atomic<size_t> readyCount = 0;
+	std::atomic<bool> isStarted = false;
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([&queue, &readyCount, &isStarted, operations, i]() {
+			readyCount++;
+			while (!isStarted)
+			{
+				std::this_thread::yield();
+			}
+			for (int k = 0; k < operations; ++k)
+			{
+				int value = static_cast<int>(i) + k;
+				while (!queue.tryPush(value))
+				{
+					std::this_thread::yield();
+				}
+				while (!queue.tryPop(value))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	while (readyCount < threadCount)
+	{
+		std::this_thread::yield();
+	}
+	const Clock::time_point startTime = Clock::now();
+	isStarted = true;
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	const double time = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+	return static_cast<double>(threadCount) * static_cast<double>(operations) / time / 1e6;
+}
+
+
+static void printResult(const size_t threadCount, const std::string& name, BenchmarkResult& result)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(8) << threadCount
+		<< std::setw(14) << name
+		<< std::setw(14) << (static_cast<double>(result.m_taskCount) / result.m_totalTime / 1e3)
+		<< std::setw(10) << getPercentile(result.m_latencies, 0.5)
+		<< std::setw(10) << getPercentile(result.m_latencies, 0.99)
+		<< std::setw(10) << getPercentile(result.m_latencies, 0.999)
+		<< std::setw(12) << getPercentile(result.m_latencies, 1.0)
+		<< std::setw(12) << getPercentile(result.m_phaseTimes, 0.5)
+		<< std::setw(12) << getPercentile(result.m_phaseTimes, 0.99)
+		<< std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+	const BenchmarkOptions options = parseOptions(argc, argv);
+
+	std::cout << "Phases: " << options.m_phases
+		<< " x (" << options.m_rowTasks << " row tasks + " << options.m_cellTasks << " cell tasks)"
+		<< ", work: " << options.m_work << " iterations per task" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(14) << "queue" << std::setw(14) << "ktasks/s"
+		<< std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us" << std::setw(12) << "max us"
+		<< std::setw(12) << "phase p50" << std::setw(12) << "phase p99" << std::endl;
+
+	for (const size_t threadCount : options.m_threadCounts)
+	{
+		MutexTaskQueue mutexQueue;
+		BenchmarkResult mutexResult = runBenchmark(mutexQueue, options, threadCount);
+		printResult(threadCount, "mutex", mutexResult);
+
+		TaskQueue stealingQueue(TaskQueueBackend::WorkStealing);
+		BenchmarkResult stealingResult = runBenchmark(stealingQueue, options, threadCount);
+		printResult(threadCount, "work stealing", stealingResult);
+
+		TaskQueue ringQueue(TaskQueueBackend::BoundedRing);
+		BenchmarkResult ringResult = runBenchmark(ringQueue, options, threadCount);
+		printResult(threadCount, "ring", ringResult);
+	}
+
+	std::cout << std::endl << "Contention: " << options.m_operations << " push and pop pairs per thread" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(16) << "ring Mops/s" << std::setw(16) << "mutex Mops/s" << std::endl;
+	for (const size_t threadCount : options.m_threadCounts)
+	{
+		MpmcRing<int> ring(1024);
+		const double ringRate = runContentionBenchmark(ring, threadCount, options.m_operations);
+
+		MutexDeque mutexDeque;
+		const double mutexRate = runContentionBenchmark(mutexDeque, threadCount, options.m_operations);
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< std::setw(8) << threadCount << std::setw(16) << ringRate << std::setw(16) << mutexRate << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
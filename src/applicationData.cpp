@@ -11,6 +11,7 @@
 #include <vector>
 #include <tuple>
 #include <unordered_set>
+#include <algorithm>
 
 
 
@@ -117,6 +118,7 @@ bool ApplicationData::initSimulation()
 	size_t gridWith = static_cast<size_t>(10.0 / cellSize);
 	size_t gridHeight = static_cast<size_t>(10.0 / cellSize);
 	m_pGridCollider = std::make_shared<StaticGridCollider>(cellSize, gridWith, gridHeight, Vec3(0.0, 0.0, 0.0));
+	m_pSortedGridCollider = std::make_shared<SortedGridCollider>(cellSize);
 
 	// Create a bunch of cloths in a raw
 	double _x = 5.0;
@@ -166,6 +168,17 @@ bool ApplicationData::initSimulation()
 		m_pCloths.addCloth(pCloth6);
 	}
 
+	// The cloths lying on the colliders fall asleep, and stop costing CPU time
+	ClothSleepSettings sleepSettings;
+	sleepSettings.m_isEnabled = true;
+	for (auto& pCloth : m_pCloths.m_pCloths)
+	{
+		if (pCloth)
+		{
+			pCloth->setSleepSettings(sleepSettings);
+		}
+	}
+
 	// Start the physics simulation by starting the orchestrator (main simulation thread)
 	Orchestrator::getInstance().start(*this);
 }
@@ -220,15 +233,56 @@ size_t getUniquePairHash(size_t id1, size_t id2)
 }
 
 
+/*
+* Resolve the collision between two particles, if any
+* Two sleeping particles are at rest against each other and are skipped,
+* a sleeping particle hit by an awake one is woken up when the contacts are applied (see Cloth::applyContacts())
+*
+* @param cloth1 The first particle's cloth
+* @param i1 The first particle's i index
+* @param j1 The first particle's j index
+* @param cloth2 The second particle's cloth
+* @param i2 The second particle's i index
+* @param j2 The second particle's j index
+* @param contacts The contacts of the collision task
+* @return void
+*/
+static void resolveParticlesCollision(const Cloth& cloth1, const int i1, const int j1, const Cloth& cloth2, const int i2, const int j2, ContactBuffer& contacts)
+{
+	const size_t index1 = cloth1.m_store.getIndex(i1, j1);
+	const size_t index2 = cloth2.m_store.getIndex(i2, j2);
+
+	if (cloth1.m_store.isSleeping(index1) && cloth2.m_store.isSleeping(index2))
+	{
+		return;
+	}
+
+	Particle::detectCollision(cloth1.m_store, cloth1.m_uidIndex, index1, cloth2.m_store, cloth2.m_uidIndex, index2, contacts);
+}
+
+
+// The adjacent cells checked from a cell (dx, dy, dz), the other half checks this cell (see updateCollisions())
+static constexpr int s_halfAdjacentCells[13][3] = {
+	{ -1, -1, -1 }, { 0, -1, -1 }, { 1, -1, -1 },
+	{ -1,  0, -1 }, { 0,  0, -1 }, { 1,  0, -1 },
+	{ -1,  1, -1 }, { 0,  1, -1 }, { 1,  1, -1 },
+	{ -1, -1,  0 }, { 0, -1,  0 }, { 1, -1,  0 },
+	{ 1,  0,  0 }
+};
+
+
 /*
 * Update the collisions between the particles
 * This function detect between all pair of particles within the current cell and some of the adjacent cells
 * Then resolve the collisions for each pair of particles
 * 
-* @param CellsFromReadGrid The list of non-empty grid cells (can be the entire list or just a batch for parallelism)
+* @param CellsFromReadGrid The list of non-empty grid cells
+* @param indexFrom The first cell of the list to handle
+* @param indexTo The end of the cells to handle (excluded), the list can be split in batches for parallelism
+* @param contacts The contacts found, the particles are not modified (see Cloth::applyContacts())
 * @return void
 */
-void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCell>>& CellsFromReadGrid)
+void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCell>>& CellsFromReadGrid, const size_t indexFrom, const size_t indexTo, ContactBuffer& contacts)
 {
 	if (!m_pGridCollider) // Should not happend, but anyway...
 	{
@@ -236,9 +290,11 @@ void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCel
 	}
 
 	// Loop over all the non-empty (existing) grid cells.
-	// Actually not all but the one in the list CellsFromReadGrid, to allow parallelism.
-	for (auto& pCell : CellsFromReadGrid)
+	// Actually not all but the ones in [indexFrom, indexTo[, to allow parallelism.
+	const size_t indexEnd = std::min(indexTo, CellsFromReadGrid.size());
+	for (size_t cellIndex = indexFrom; cellIndex < indexEnd; ++cellIndex)
 	{
+		const std::shared_ptr<GridCell>& pCell = CellsFromReadGrid[cellIndex];
 		if (!pCell) // Should not happend, but anyway...
 		{
 			continue;
@@ -269,7 +325,7 @@ void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCel
 				// Resolve the collisions
 				if (pCloth1 && pCloth2)
 				{
-					Particle::detectCollision(pCloth1->m_particles[partI1][partJ1], pCloth2->m_particles[partI2][partJ2]);
+					resolveParticlesCollision(*pCloth1, partI1, partJ1, *pCloth2, partI2, partJ2, contacts);
 				}
 			}
 
@@ -331,7 +387,7 @@ void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCel
 								// Resolve the collisions
 								if (pCloth1 && pCloth2)
 								{
-									Particle::detectCollision(pCloth1->m_particles[partI1][partJ1], pCloth2->m_particles[partI2][partJ2]);
+									resolveParticlesCollision(*pCloth1, partI1, partJ1, *pCloth2, partI2, partJ2, contacts);
 								}
 							}
 						}
@@ -343,6 +399,102 @@ void ApplicationData::updateCollisions(const std::vector<std::shared_ptr<GridCel
 }
 
 
+/*
+* Update the collisions between the particles, from the grid built by a counting sort
+* Same pairs as the other updateCollisions(): the particles of a cell together, then with the particles of half
+* of the adjacent cells. The particles of a cell are a contiguous range of the grid.
+* The distances are first tested on the positions copied in the grid, in the order of the cells: the cloths are
+* only read for the pairs in contact.
+*
+* @param grid The sorted grid, built for the current step
+* @param indexFrom The first non-empty cell to handle
+* @param indexTo The end of the non-empty cells to handle (excluded), the cells can be split in batches for parallelism
+* @param contacts The contacts found, the particles are not modified (see Cloth::applyContacts())
+* @return void
+*/
+void ApplicationData::updateCollisions(const SortedGridCollider& grid, const size_t indexFrom, const size_t indexTo, ContactBuffer& contacts)
+{
+	const size_t indexEnd = std::min(indexTo, grid.getNonEmptyCellCount());
+	for (size_t cellIndex = indexFrom; cellIndex < indexEnd; ++cellIndex)
+	{
+		const size_t cell = grid.getNonEmptyCell(cellIndex);
+		int x;
+		int y;
+		int z;
+		grid.getCellCoordsFromIndex(cell, x, y, z);
+
+		size_t count = 0;
+		const uint32_t* pParticles = grid.getCellParticles(cell, count);
+		const Vec3R* pPositions = grid.getCellPositions(cell);
+
+		// Half of the adjacent cells, so two cells are checked once
+		size_t adjacentCellCount = 0;
+		const uint32_t* pAdjacentParticles[13];
+		const Vec3R* pAdjacentPositions[13];
+		size_t adjacentCounts[13];
+		for (const auto& [dx, dy, dz] : s_halfAdjacentCells)
+		{
+			const size_t adjacentCell = grid.findCell(x + dx, y + dy, z + dz);
+			if (adjacentCell != SortedGridCollider::s_invalidCell)
+			{
+				pAdjacentParticles[adjacentCellCount] = grid.getCellParticles(adjacentCell, adjacentCounts[adjacentCellCount]);
+				if (adjacentCounts[adjacentCellCount] > 0)
+				{
+					pAdjacentPositions[adjacentCellCount] = grid.getCellPositions(adjacentCell);
+					adjacentCellCount++;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			// The handles resolve to the particles and their cloths, no shared pointer is copied
+			const GridParticle& particle1 = grid.getParticle(pParticles[i]);
+			const Cloth* pCloth1 = grid.getCloth(particle1);
+			if (!pCloth1)
+			{
+				continue;
+			}
+			const Vec3R position1 = pPositions[i];
+
+			// Same test as Particle::detectCollision(), with a margin for the rounding: it decides for the pairs kept
+			const Real contactDistance = static_cast<Real>(2.0 * pCloth1->m_store.m_radius);
+			const Real maxSquaredDistance = contactDistance * contactDistance * static_cast<Real>(1.001);
+
+			// The next particles of the cell, then the particles of the adjacent cells
+			for (size_t k = 0; k <= adjacentCellCount; ++k)
+			{
+				const uint32_t* pOtherParticles = (k == 0) ? pParticles + i + 1 : pAdjacentParticles[k - 1];
+				const Vec3R* pOtherPositions = (k == 0) ? pPositions + i + 1 : pAdjacentPositions[k - 1];
+				const size_t otherCount = (k == 0) ? count - i - 1 : adjacentCounts[k - 1];
+				for (size_t j = 0; j < otherCount; ++j)
+				{
+					const Vec3R delta = position1 - pOtherPositions[j];
+					if (delta.dot(delta) >= maxSquaredDistance)
+					{
+						continue;
+					}
+
+					const GridParticle& particle2 = grid.getParticle(pOtherParticles[j]);
+
+					// Skip the current particle and the neightbors if we collide to ourself
+					if (Cloth::areParticlesNeighbors(particle1, particle2))
+					{
+						continue;
+					}
+
+					const Cloth* pCloth2 = grid.getCloth(particle2);
+					if (pCloth2)
+					{
+						resolveParticlesCollision(*pCloth1, particle1.m_i, particle1.m_j, *pCloth2, particle2.m_i, particle2.m_j, contacts);
+					}
+				}
+			}
+		}
+	}
+}
+
+
 /*
 * Stop the simulation and all the threads for a clean exit
 * 
@@ -40,6 +40,9 @@ public:
 	// The hash grid collision optimization system
 	std::shared_ptr<StaticGridCollider> m_pGridCollider;
 
+	// An unbounded grid built by a counting sort, without lock (see Orchestrator::setSortedGridCollider())
+	std::shared_ptr<SortedGridCollider> m_pSortedGridCollider;
+
 public:
 	ApplicationData();
 	~ApplicationData();
@@ -51,5 +54,6 @@ public:
 	void onApplicationExit();
 
 	// Simulation functions
-	void updateCollisions(const std::vector<std::shared_ptr<GridCell>>& CellsFromReadGrid);
+	void updateCollisions(const std::vector<std::shared_ptr<GridCell>>& CellsFromReadGrid, const size_t indexFrom, const size_t indexTo, ContactBuffer& contacts);
+	void updateCollisions(const SortedGridCollider& grid, const size_t indexFrom, const size_t indexTo, ContactBuffer& contacts);
 };
\ No newline at end of file
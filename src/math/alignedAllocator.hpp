@@ -0,0 +1,52 @@
+#pragma once
+
+// Includes from STL
+#include <cstddef>
+#include <new>
+#include <vector>
+
+
+/*
+* AlignedAllocator class
+*
+* STL compatible allocator that returns memory aligned on 'Alignment' bytes.
+* Used for the hot simulation arrays so that each array start on a cache line
+* (and on a SIMD register boundary).
+*/
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind
+	{
+		using other = AlignedAllocator<U, Alignment>;
+	};
+
+public:
+	AlignedAllocator() noexcept {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+	T* allocate(const std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T* p, const std::size_t n [[maybe_unused]]) noexcept
+	{
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+
+// Vector whose data is aligned on a cache line
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
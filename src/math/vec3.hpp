@@ -2,34 +2,46 @@
 
 // Includes from STD
 #include <array>
+#include <cmath>
+#include <type_traits>
 
 
 /*
-* Vec3 class
+* Vec3T class
 * 
-* This class is used to represent a 3D vector
+* This class is used to represent a 3D vector, in simple or double precision
+* Use the aliases: Vec3 (double), Vec3f (float) and Vec3R (precision of the simulation state, see Real)
 */
-class Vec3
+template <typename Scalar>
+class Vec3T
 {
 public:
-	double x = 0.0;
-	double y = 0.0;
-	double z = 0.0;
-
-	Vec3() {};
-	Vec3(const double x, const double y, const double z) : x(x), y(y), z(z) {}
-	Vec3(const float x, const float y, const float z) : 
-		x(static_cast<double>(x)), y(static_cast<double>(y)), z(static_cast<double>(z)) {}
-	Vec3(const std::array<double, 3>& arr) : x(arr[0]), y(arr[1]), z(arr[2]) {}
-	Vec3(const std::array<float, 3>& arr) : 
-		x(static_cast<double>(arr[0])), y(static_cast<double>(arr[1])), z(static_cast<double>(arr[2])) {}
-
-	Vec3 operator+(const Vec3& other) const
+	Scalar x = 0;
+	Scalar y = 0;
+	Scalar z = 0;
+
+	Vec3T() {};
+	// Coordinates of any arithmetic type (integer literals, mixed precisions), converted to Scalar
+	template <typename X, typename Y, typename Z>
+		requires std::is_arithmetic_v<X> && std::is_arithmetic_v<Y> && std::is_arithmetic_v<Z>
+	Vec3T(const X x, const Y y, const Z z) : 
+		x(static_cast<Scalar>(x)), y(static_cast<Scalar>(y)), z(static_cast<Scalar>(z)) {}
+	Vec3T(const std::array<double, 3>& arr) : 
+		x(static_cast<Scalar>(arr[0])), y(static_cast<Scalar>(arr[1])), z(static_cast<Scalar>(arr[2])) {}
+	Vec3T(const std::array<float, 3>& arr) : 
+		x(static_cast<Scalar>(arr[0])), y(static_cast<Scalar>(arr[1])), z(static_cast<Scalar>(arr[2])) {}
+
+	// Conversion from the other precision
+	template <typename OtherScalar>
+	explicit Vec3T(const Vec3T<OtherScalar>& other) : 
+		x(static_cast<Scalar>(other.x)), y(static_cast<Scalar>(other.y)), z(static_cast<Scalar>(other.z)) {}
+
+	Vec3T operator+(const Vec3T& other) const
 	{
-		return Vec3(x + other.x, y + other.y, z + other.z);
+		return Vec3T(x + other.x, y + other.y, z + other.z);
 	}
 
-	void operator+=(const Vec3& other)
+	void operator+=(const Vec3T& other)
 	{
 		x += other.x;
 		y += other.y;
@@ -38,12 +50,12 @@ public:
 		// No return to avoid copy
 	}
 
-	Vec3 operator-(const Vec3& other) const
+	Vec3T operator-(const Vec3T& other) const
 	{
-		return Vec3(x - other.x, y - other.y, z - other.z);
+		return Vec3T(x - other.x, y - other.y, z - other.z);
 	}
 
-	void operator-=(const Vec3& other)
+	void operator-=(const Vec3T& other)
 	{
 		x -= other.x;
 		y -= other.y;
@@ -52,12 +64,12 @@ public:
 		// No return to avoid copy
 	}
 
-	Vec3 operator*(const double scalar) const
+	Vec3T operator*(const Scalar scalar) const
 	{
-		return Vec3(x * scalar, y * scalar, z * scalar);
+		return Vec3T(x * scalar, y * scalar, z * scalar);
 	}
 
-	void operator*=(const double scalar)
+	void operator*=(const Scalar scalar)
 	{
 		x *= scalar;
 		y *= scalar;
@@ -66,12 +78,12 @@ public:
 		// No return to avoid copy
 	}
 
-	Vec3 operator/(const double scalar) const
+	Vec3T operator/(const Scalar scalar) const
 	{
-		return Vec3(x / scalar, y / scalar, z / scalar);
+		return Vec3T(x / scalar, y / scalar, z / scalar);
 	}
 
-	void operator/=(const double scalar)
+	void operator/=(const Scalar scalar)
 	{
 		x /= scalar;
 		y /= scalar;
@@ -80,40 +92,40 @@ public:
 		// No return to avoid copy
 	}
 
-	Vec3 cross(const Vec3& other) const
+	Vec3T cross(const Vec3T& other) const
 	{
-		return Vec3(
+		return Vec3T(
 			y * other.z - z * other.y,
 			z * other.x - x * other.z,
 			x * other.y - y * other.x
 		);
 	}
 
-	double dot(const Vec3& other) const
+	Scalar dot(const Vec3T& other) const
 	{
 		return x * other.x + y * other.y + z * other.z;
 	}
 
-	double norm() const
+	Scalar norm() const
 	{
-		return sqrt(x * x + y * y + z * z);
+		return std::sqrt(x * x + y * y + z * z);
 	}
 
-	Vec3 getNormalized() const
+	Vec3T getNormalized() const
 	{
-		double len = norm();
-		if (len == 0.0)
+		Scalar len = norm();
+		if (len == 0)
 		{
-			return Vec3(x, y, z);
+			return Vec3T(x, y, z);
 		}
 
-		return Vec3(x / len, y / len, z / len);
+		return Vec3T(x / len, y / len, z / len);
 	}
 
 	void normalize()
 	{
-		double len = norm();
-		if (len == 0.0)
+		Scalar len = norm();
+		if (len == 0)
 		{
 			return;
 		}
@@ -123,13 +135,30 @@ public:
 		z /= len;
 	}
 
-	Vec3 getReflected(const Vec3& normal) const
+	Vec3T getReflected(const Vec3T& normal) const
 	{
-		return *this - normal * 2.0 * dot(normal);
+		return *this - normal * (static_cast<Scalar>(2) * dot(normal));
 	}
 
 	std::array<float, 3> toArray() const
 	{
 		return { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
 	}
-};
\ No newline at end of file
+};
+
+
+using Vec3 = Vec3T<double>;
+using Vec3f = Vec3T<float>;
+
+
+/*
+* Precision of the simulation state (particles, springs)
+* double by default, float when built with CLOTH_USE_FLOAT (CMake option USE_FLOAT_PRECISION)
+*/
+#ifdef CLOTH_USE_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
+using Vec3R = Vec3T<Real>;
@@ -0,0 +1,99 @@
+// Includes from project
+#include "adaptiveTimeStep.hpp"
+
+// Includes from STL
+#include <algorithm>
+
+
+/*
+* Merge the bounds of another part of the cloth
+*
+* @param other The bounds to merge
+* @return void
+*/
+void ClothMotionBounds::merge(const ClothMotionBounds& other)
+{
+	m_maxSpeed = std::max(m_maxSpeed, other.m_maxSpeed);
+	m_maxStrain = std::max(m_maxStrain, other.m_maxStrain);
+	m_maxStrainRate = std::max(m_maxStrainRate, other.m_maxStrainRate);
+}
+
+
+/*
+* Start the selection of a new time step
+*
+* @return void
+*/
+void AdaptiveTimeStep::reset()
+{
+	m_stats = AdaptiveTimeStepStats();
+}
+
+
+/*
+* Restrict the time step with the motion of a cloth
+*
+* @param bounds Motion of the cloth during the last step
+* @param cflLength Distance a particle of the cloth can travel in one step
+* @return void
+*/
+void AdaptiveTimeStep::addCloth(const ClothMotionBounds& bounds, const double cflLength)
+{
+	const double maxSpeed = static_cast<double>(bounds.m_maxSpeed);
+	const double maxStrainRate = static_cast<double>(bounds.m_maxStrainRate);
+
+	if (maxSpeed > 0.0)
+	{
+		m_stats.m_cflTimeStep = std::min(m_stats.m_cflTimeStep, m_tolerance * cflLength / maxSpeed);
+	}
+	if (maxStrainRate > 0.0)
+	{
+		m_stats.m_strainTimeStep = std::min(m_stats.m_strainTimeStep, m_tolerance * m_strainLimit / maxStrainRate);
+	}
+
+	m_stats.m_maxSpeed = std::max(m_stats.m_maxSpeed, maxSpeed);
+	m_stats.m_maxStrain = std::max(m_stats.m_maxStrain, static_cast<double>(bounds.m_maxStrain));
+}
+
+
+/*
+* Select the time step from the cloths added since reset()
+*
+* @param stabilityLimit Largest time step the integrators of the cloths are stable with
+* @return double The time step
+*/
+double AdaptiveTimeStep::selectTimeStep(const double stabilityLimit)
+{
+	const double maxTimeStep = std::max(std::min(m_maxTimeStep, stabilityLimit), m_minTimeStep);
+
+	double timeStep = std::min({ maxTimeStep, m_stats.m_cflTimeStep, m_stats.m_strainTimeStep });
+
+	// Already over stretched, slow down until the springs recover
+	if (m_stats.m_maxStrain > m_strainLimit)
+	{
+		timeStep *= m_strainLimit / m_stats.m_maxStrain;
+	}
+
+	m_stats.m_timeStep = std::max(timeStep, m_minTimeStep);
+	return m_stats.m_timeStep;
+}
+
+
+/*
+* Cut a selected time step to the time left to simulate
+* A leftover shorter than a hundredth of m_minTimeStep is simulated by this step instead of the next one: a step of
+* a few rounding errors would cost a whole solver pass, and the XPBD compliance is divided by the square of the step.
+*
+* @param timeStep The selected time step
+* @param remainingTime The time left to simulate
+* @return double The time step to simulate, all the remaining time when the leftover would be too short
+*/
+double AdaptiveTimeStep::fitToRemainingTime(const double timeStep, const double remainingTime) const
+{
+	const double minLeftover = 0.01 * m_minTimeStep;
+	if (remainingTime - timeStep < minLeftover)
+	{
+		return remainingTime;
+	}
+	return timeStep;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+
+// Includes from STL
+#include <limits>
+
+
+/*
+* Largest motion of the particles of a cloth (or of a part of it) during the last step
+* The strain is measured on the links between direct neighbors: |length - restLength| / restLength
+*/
+struct ClothMotionBounds
+{
+	Real m_maxSpeed = 0;
+	Real m_maxStrain = 0;
+	Real m_maxStrainRate = 0; // Strain change per second
+
+	void merge(const ClothMotionBounds& other);
+};
+
+
+/*
+* Choice made by an AdaptiveTimeStep, and why
+*/
+struct AdaptiveTimeStepStats
+{
+	double m_timeStep = 0.0;
+	double m_cflTimeStep = std::numeric_limits<double>::infinity();
+	double m_strainTimeStep = std::numeric_limits<double>::infinity();
+	double m_maxSpeed = 0.0;
+	double m_maxStrain = 0.0;
+};
+
+
+/*
+* Class AdaptiveTimeStep
+*
+* Picks the time step of the next simulation step from the motion of the cloths during the last one:
+* - CFL condition: a particle must not move more than m_tolerance times its CFL length (the smallest of its
+*   collider radius and of the collision grid cell size), so no collision is skipped
+* - Strain condition: the strain of the links must not change by more than m_tolerance times m_strainLimit,
+*   and the step is reduced proportionally when the strain is already beyond m_strainLimit
+* The step is clamped between m_minTimeStep and m_maxTimeStep (and the stability limit of the integrators).
+*
+* Usage, for each step: reset(), addCloth() for each cloth, then selectTimeStep()
+* A fixed length of time is consumed by the selected steps cut by fitToRemainingTime().
+*/
+class AdaptiveTimeStep
+{
+public:
+	double m_tolerance = 0.5;
+	double m_strainLimit = 0.1;
+	double m_minTimeStep = 1e-4;
+	double m_maxTimeStep = 1.0 / 30.0;
+
+private:
+	AdaptiveTimeStepStats m_stats;
+
+public:
+	AdaptiveTimeStep() {};
+	~AdaptiveTimeStep() {};
+
+	void reset();
+	void addCloth(const ClothMotionBounds& bounds, const double cflLength);
+	double selectTimeStep(const double stabilityLimit);
+	double fitToRemainingTime(const double timeStep, const double remainingTime) const;
+
+	inline const AdaptiveTimeStepStats& getStats() const { return m_stats; };
+};
@@ -37,23 +37,40 @@ m_textureFolderPath(textureFolderPath)
 
 	Vec3 pos = position - Vec3(m_width / 2.0, 0.0, m_height / 2.0);
 
+	// Allocate the particles' simulation state
+	m_store.resize(m_resX, m_resY);
+	m_store.m_radius = colliderRadius;
+	// Same margin for the rounding as the test of the distances between the particles
+	m_bounds.init(m_resX, m_resY, static_cast<Real>(colliderRadius * 1.001));
+	m_rowMotionBounds.assign(m_resX, ClothMotionBounds());
+	m_rowAwakeCount.assign(m_resX, m_resY);
+	m_rowWakeRequests = std::vector<std::atomic<uint8_t>>(m_resX);
+	m_isRowAwake.assign(m_resX, 0);
+	// A batch holds at least one row, the batches are selected at each step without allocating
+	m_awakeBatches.reserve(std::max(m_resX, 1));
+	m_awakeBatches.assign(1, 1);
+	m_awakeBatchSize = std::max(m_resX, 1);
+
 	// Create particles
 	for (int i = 0; i < m_resX; ++i)
 	{
 		std::vector<Particle> rowBottom;
-		std::vector<Particle> rowTop;
+		rowBottom.reserve(m_resY);
 
 		for (int j = 0; j < m_resY; ++j)
 		{
-			// Create the particles
+			const size_t index = m_store.getIndex(i, j);
+
+			// Initialize the particle state
 			Vec3 posBottom = Vec3(pos.x + static_cast<double>(i) * distBetweenParticlesX, pos.y, pos.z + static_cast<double>(j) * distBetweenParticlesY);
-			Particle particleBottom = Particle(posBottom, particleMass);
+			m_store.m_position[index] = Vec3R(posBottom);
+			m_store.m_previousPosition[index] = Vec3R(posBottom);
+			m_store.m_inverseMass[index] = static_cast<Real>(1.0 / particleMass);
+
+			// Create the particles
+			Particle particleBottom = Particle(index);
 			particleBottom.m_indexI = i;
 			particleBottom.m_indexJ = j;
-			
-			// Create the AABB for the particle (only for the bottom side)
-			particleBottom.m_pAabb = std::make_shared<AABB>(colliderRadius);
-			particleBottom.m_pAabb->constructCubicAABB(posBottom);
 
 			// Add the particles to the lists
 			rowBottom.push_back(particleBottom);
@@ -63,10 +80,127 @@ m_textureFolderPath(textureFolderPath)
 	}
 
 	// Define the spring parameters
-	const double springStrengh = 1000.0;
-	const double springDamping = 0.0;
+	m_distBetweenParticlesX = distBetweenParticlesX;
+	m_distBetweenParticlesY = distBetweenParticlesY;
+	m_springStiffness = 1000.0;
+	m_springDamping = 0.0;
+
+	// The grid springs are not stored, only the stencil parameters
+	m_springStencil.init(m_resX, m_resY, m_distBetweenParticlesX, m_distBetweenParticlesY, m_springStiffness, m_springDamping);
+
+	// Initialize the mesh
+	initMesh();
+}
+
+
+/*
+* Select how the springs are represented
+* The explicit edge list is only built when needed, the stencil model does not store any spring
+*
+* @param springModel The spring model to use
+* @return void
+*/
+void Cloth::setSpringModel(const SpringModel springModel)
+{
+	m_springModel = springModel;
+
+	if (m_springModel == SpringModel::EdgeList)
+	{
+		buildSpringEdges();
+	}
+	else
+	{
+		// Release the memory of the edges
+		m_springEdges = SpringEdgeList();
+	}
+}
+
+
+/*
+* Change the stiffness and damping of the springs (before the distance falloff)
+* The springs of all the models are updated
+*
+* @param stiffness Stiffness of the springs linking direct neighbors
+* @param damping Damping of the springs
+* @return void
+*/
+void Cloth::setSpringParameters(const double stiffness, const double damping)
+{
+	m_springStiffness = stiffness;
+	m_springDamping = damping;
+
+	m_springStencil.init(m_resX, m_resY, m_distBetweenParticlesX, m_distBetweenParticlesY, m_springStiffness, m_springDamping);
+	setSpringModel(m_springModel);
+	setIntegrationMode(m_integrationMode);
+}
+
+
+/*
+* Select how the particles are stepped
+* The implicit mode always uses the stencil springs, whatever the spring model
+* The XPBD constraints use the stiffness of the stencil springs they replace (same falloff), as a compliance
+*
+* @param integrationMode The integration mode to use
+* @return void
+*/
+void Cloth::setIntegrationMode(const IntegrationMode integrationMode)
+{
+	m_integrationMode = integrationMode;
+
+	if (m_integrationMode == IntegrationMode::Xpbd)
+	{
+		m_xpbdSolver.init(m_resX, m_resY, m_distBetweenParticlesX, m_distBetweenParticlesY);
+
+		const double stretchStiffness = m_springStiffness / 2.0;
+		const double bendStiffness = m_springStiffness / 4.0;
+		m_xpbdSolver.setCompliances(1.0 / stretchStiffness, 1.0 / stretchStiffness, 1.0 / bendStiffness);
+	}
+	else
+	{
+		// Release the memory of the multipliers
+		m_xpbdSolver.release();
+	}
+
+	if (m_integrationMode == IntegrationMode::Implicit)
+	{
+		m_implicitSolver.init(m_resX, m_resY, &m_springStencil);
+	}
+	else
+	{
+		m_implicitSolver.release();
+	}
+}
+
+
+/*
+* Get the largest time step the integration mode of the cloth is stable with
+*
+* @return double The maximum time step
+*/
+double Cloth::getMaxTimeStep() const
+{
+	if (m_integrationMode == IntegrationMode::Xpbd)
+	{
+		return 1.0 / 30.0;
+	}
+	if (m_integrationMode == IntegrationMode::Implicit)
+	{
+		return 1.0 / 60.0;
+	}
+
+	return 0.005;
+}
+
+
+/*
+* Build the explicit list of springs, with the same 5x5 neighborhood than the stencil
+* 
+* @return void
+*/
+void Cloth::buildSpringEdges()
+{
+	m_springEdges.reset(m_resX, m_resY);
 
-	// Create the springs
 	for (int i = 0; i < m_resX; ++i)
 	{
 		for (int j = 0; j < m_resY; ++j)
@@ -83,28 +217,48 @@ m_textureFolderPath(textureFolderPath)
 						continue;
 					}
 
+					// Each spring is shared by two particles, only create it from the first one
+					if (m_store.getIndex(ii, jj) < m_store.getIndex(i, j))
+					{
+						continue;
+					}
+
 					const int dist = std::max(std::abs(ii - i), std::abs(jj - j)); // dist can not be 0
 					const double strenghDecreaseFactor = 2.0;
-					const double springStrenghLocal = springStrengh / (static_cast<double>(dist) * strenghDecreaseFactor);
+					const double springStrenghLocal = m_springStiffness / (static_cast<double>(dist) * strenghDecreaseFactor);
 
-					// Compute the distance between the particles, it is the same for top and bottom
-					const double distanceSameLayer = (m_particles[i][j].m_position - m_particles[ii][jj].m_position).norm();
+					// Rest length: distance between the particles on the flat grid
+					const double dx = static_cast<double>(ii - i) * m_distBetweenParticlesX;
+					const double dy = static_cast<double>(jj - j) * m_distBetweenParticlesY;
+					const double restLength = std::sqrt(dx * dx + dy * dy);
 
-					// Add the neighbor
-					m_particles[i][j].m_springs.push_back(Spring(&m_particles[ii][jj], distanceSameLayer, springStrenghLocal, springDamping));
+					// Add the spring
+					m_springEdges.addEdge(m_store.getIndex(i, j), m_store.getIndex(ii, jj), restLength, springStrenghLocal, m_springDamping);
 				}
 			}
-
-			// Debug
-			if (j == (m_resY - 1) || j == 0 || i == 0 || i == (m_resX - 1))
-			{
-				//m_particlesBottom[i][j].setFixed(true);
-			}
 		}
 	}
 
-	// Initialize the mesh
-	initMesh();
+	m_springEdges.finalize();
+}
+
+
+/*
+* Compute the forces of the springs starting in the rows [resxFrom, resxTo] and accumulate them
+* into the particles' external forces. Each spring is evaluated once.
+* Must be called for all the rows of the cloth before updateParticles(), with the same batches.
+*
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::computeSpringForces(const int resxFrom, const int resxTo)
+{
+	// The stencil springs are gathered directly in updateParticles()
+	if (m_springModel == SpringModel::EdgeList)
+	{
+		m_springEdges.accumulateForces(m_store, resxFrom, resxTo);
+	}
 }
 
 
@@ -126,26 +280,168 @@ void Cloth::updateParticles(
 	const std::vector<std::shared_ptr<Collider>>& colliders, 
 	std::shared_ptr<GridCollider> pGridCollider
 )
+{
+	wakeSleepingParticles(resxFrom, resxTo);
+
+	// Integrate the particles (springs, forces, velocity and position), vectorized when the CPU allows it
+	ClothIntegrationParams params;
+	params.m_dt = static_cast<Real>(dt);
+	if (m_springModel == SpringModel::EdgeList)
+	{
+		// Collect the spring forces scattered into our rows by the previous batch(es)
+		m_springEdges.gatherHaloForces(m_store, resxFrom, resxTo);
+	}
+	else
+	{
+		// The stencil springs are gathered by the integration kernel
+		params.m_pStencil = &m_springStencil;
+	}
+	ClothKernels::integrateRows(m_store, params, resxFrom, resxTo);
+
+	handleCollisions(resxFrom, resxTo, colliders, pGridCollider);
+}
+
+
+/*
+* Predict the positions of the particles from the external forces (XPBD step)
+* Only update the particles in the range [resxFrom, resxTo], this way we can parallelize the update
+*
+* @param dt Time step
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::predictPositions(const double dt, const int resxFrom, const int resxTo)
+{
+	wakeSleepingParticles(resxFrom, resxTo);
+	m_xpbdSolver.predict(m_store, dt, resxFrom, resxTo);
+}
+
+
+/*
+* Project the XPBD constraints starting in the rows [resxFrom, resxTo]
+* The constraints move the particles up to XpbdSolver::getReachRows() rows after resxTo: the batches must
+* be at least that large, and the batches processed at the same time must not be adjacent.
+*
+* @param dt Time step
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @param iteration Index of the solver iteration in the step
+* @return void
+*/
+void Cloth::solveConstraints(const double dt, const int resxFrom, const int resxTo, const int iteration)
+{
+	m_xpbdSolver.solve(m_store, dt, resxFrom, resxTo, iteration);
+}
+
+
+/*
+* Build the linear system of the implicit step for the rows [resxFrom, resxTo]
+* The system is then solved by the conjugate gradient of m_implicitSolver, driven by the orchestrator
+*
+* @param dt Time step
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::beginImplicitStep(const double dt, const int resxFrom, const int resxTo)
+{
+	wakeSleepingParticles(resxFrom, resxTo);
+	m_implicitSolver.beginStep(m_store, dt, resxFrom, resxTo);
+}
+
+
+/*
+* End the XPBD or implicit step: compute the velocities and positions from the solver and handle the collisions
+* Only update the particles in the range [resxFrom, resxTo], this way we can parallelize the update
+*
+* @param dt Time step
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @param colliders The list of colliders in the scene
+* @param pGridCollider The hash grid collider instance
+* @return void
+*/
+void Cloth::finalizeParticles(
+	const double dt,
+	const int resxFrom,
+	const int resxTo,
+	const std::vector<std::shared_ptr<Collider>>& colliders,
+	std::shared_ptr<GridCollider> pGridCollider
+)
+{
+	if (m_integrationMode == IntegrationMode::Implicit)
+	{
+		m_implicitSolver.endStep(m_store, dt, resxFrom, resxTo);
+	}
+	else
+	{
+		m_xpbdSolver.updateVelocities(m_store, dt, resxFrom, resxTo);
+	}
+
+	handleCollisions(resxFrom, resxTo, colliders, pGridCollider);
+}
+
+
+/*
+* Handle the collisions of the particles with the ground and the colliders, update the bounds of the rows and add
+* the particles to the grid collider
+* Only update the particles in the range [resxFrom, resxTo], this way we can parallelize the update
+*
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @param colliders The list of colliders in the scene
+* @param pGridCollider The hash grid collider instance, nullptr when the particles are added after the culling (see addActiveParticlesToGrid())
+* @return void
+*/
+void Cloth::handleCollisions(
+	const int resxFrom,
+	const int resxTo,
+	const std::vector<std::shared_ptr<Collider>>& colliders,
+	std::shared_ptr<GridCollider> pGridCollider
+)
 {
 	constexpr double EPSILON = 1e-7;
 
-	// Update the particles
+	const double radius = m_store.m_radius;
+	AABB aabb(radius);
+
 	for (int i = resxFrom; i < resxTo; ++i)
 	{
+		m_bounds.clearRow(i);
+
 		for (int j = 0; j < m_resY; ++j)
 		{
-			// Update the particles
-			m_particles[i][j].update(dt, colliders);
+			const size_t index = m_store.getIndex(i, j);
 
+			Vec3R& position = m_store.m_position[index];
+			Vec3R& velocity = m_store.m_velocity[index];
+
+			// A sleeping particle does not move, but the awake particles can still collide with it
+			if (m_store.isSleeping(index))
+			{
+				m_bounds.addParticle(i, j, position);
+				if (pGridCollider)
+				{
+					pGridCollider->addParticleToCell(position, std::make_tuple(m_uidIndex, i, j));
+				}
+				continue;
+			}
 
 			// Handle collision with the ground
-			if (m_particles[i][j].m_position.y < m_particles[i][j].m_pAabb->m_halfSize)
+			if (position.y < radius)
 			{
-				m_particles[i][j].m_position.y = m_particles[i][j].m_pAabb->m_halfSize;
+				position.y = static_cast<Real>(radius);
 
-				m_particles[i][j].bounceOnCollision(Vec3(0.0, 1.0, 0.0), 1.0 / m_particles[i][j].m_groundFriction);
+				Particle::bounceOnCollision(m_store, index, Vec3R(0.0, 1.0, 0.0), 1.0 / m_store.m_groundFriction);
 			}
 
+			// The colliders work in double precision
+			const Vec3 previousPosition(m_store.m_previousPosition[index]);
+
+			// AABB around the particle at the start of the step (the colliders test from the previous position)
+			aabb.constructCubicAABB(previousPosition);
+
 			// Handle collision with the colliders
 			for (const auto& pCollider : colliders)
 			{
@@ -161,57 +457,98 @@ void Cloth::updateParticles(
 					collPosition, 
 					collNormal, 
 					bounceVect, 
-					m_particles[i][j].m_previousPosition, 
-					m_particles[i][j].m_position, 
-					m_particles[i][j].m_pAabb->m_halfSize,
-					*m_particles[i][j].m_pAabb
+					previousPosition, 
+					Vec3(position), 
+					radius,
+					aabb
 				))
 				{
 					// Compute the new position
-					m_particles[i][j].m_position = collPosition + collNormal * (m_particles[i][j].m_pAabb->m_halfSize + EPSILON);
+					position = Vec3R(collPosition + collNormal * (radius + EPSILON));
 					// Compute the new velocity
-					m_particles[i][j].m_velocity = bounceVect * m_particles[i][j].m_velocity.norm();
-					if (m_particles[i][j].m_objectFriction > 0.0)
+					velocity = Vec3R(bounceVect * static_cast<double>(velocity.norm()));
+					if (m_store.m_objectFriction > 0.0)
 					{
-						m_particles[i][j].m_velocity *= 1.0 / m_particles[i][j].m_objectFriction;
+						velocity *= static_cast<Real>(1.0 / m_store.m_objectFriction);
 					}
 				}
 			}
 
-			// Update the AABB
-			m_particles[i][j].m_pAabb->constructCubicAABB(m_particles[i][j].m_position);
+			m_bounds.addParticle(i, j, position);
 
 			// Add the particle's new position to the grid collider
 			// Done here to minimize the "mutex race" between the threads if done all at once at the end
-			pGridCollider->addParticleToCell(
-				m_particles[i][j].m_position,
-				std::make_tuple(m_uidIndex, i, j)
-			);
+			if (pGridCollider)
+			{
+				pGridCollider->addParticleToCell(
+					position,
+					std::make_tuple(m_uidIndex, i, j)
+				);
+			}
 		}
 	}
 }
 
 
 /*
-* Update the grid collider with the new position of the particles
+* Update the bounds of the rows and the grid collider with the new position of the particles
 * Only update the particles in the range [indexFrom, indexTo], this way we can parallelize the update
 * 
-* @param pGridCollider The grid collider instance
+* @param pGridCollider The grid collider instance, nullptr when the particles are added after the culling (see addActiveParticlesToGrid())
 * @param indexFrom The starting index in the X direction
 * @param indexTo The ending index in the X direction
 * @return void
 */
 void Cloth::updateGridCollider(std::shared_ptr<GridCollider> pGridCollider, const int indexFrom, const int indexTo)
 {
-	if (pGridCollider)
+	for (int i = indexFrom; i < indexTo; ++i)
 	{
-		for (int i = indexFrom; i < indexTo; ++i)
+		m_bounds.clearRow(i);
+
+		for (int j = 0; j < m_resY; ++j)
 		{
-			for (int j = 0; j < m_resY; ++j)
+			const Vec3R& position = m_store.m_position[m_store.getIndex(i, j)];
+			m_bounds.addParticle(i, j, position);
+
+			// Add the particle's new position to the grid collider
+			if (pGridCollider)
+			{
+				pGridCollider->addParticleToCell(
+					position,
+					std::make_tuple(m_uidIndex, i, j)
+				);
+			}
+		}
+	}
+}
+
+
+/*
+* Add the particles of the active patches to the grid collider, the other ones cannot touch another particle
+* (see ClothSweepAndPrune)
+* Only add the particles in the range [indexFrom, indexTo], this way we can parallelize the update
+*
+* @param pGridCollider The grid collider instance
+* @param indexFrom The starting index in the X direction
+* @param indexTo The ending index in the X direction
+* @return void
+*/
+void Cloth::addActiveParticlesToGrid(std::shared_ptr<GridCollider> pGridCollider, const int indexFrom, const int indexTo)
+{
+	for (int i = indexFrom; i < indexTo; ++i)
+	{
+		for (int jFrom = 0; jFrom < m_resY; jFrom += ClothBounds::s_patchColumns)
+		{
+			if (!m_bounds.isPatchActive(m_bounds.getPatch(i, jFrom)))
+			{
+				continue;
+			}
+
+			const int jTo = std::min(jFrom + ClothBounds::s_patchColumns, m_resY);
+			for (int j = jFrom; j < jTo; ++j)
 			{
-				// Add the particle's new position to the grid collider
 				pGridCollider->addParticleToCell(
-					m_particles[i][j].m_position,
+					m_store.m_position[m_store.getIndex(i, j)],
 					std::make_tuple(m_uidIndex, i, j)
 				);
 			}
@@ -221,26 +558,351 @@ void Cloth::updateGridCollider(std::shared_ptr<GridCollider> pGridCollider, cons
 
 
 /*
-* Initialize previous position and velocity of the particles to their current position and velocity
+* Measure the speed of the particles and the strain of the links between direct neighbors
+* Only measure the particles in the range [resxFrom, resxTo], this way we can parallelize the measure.
+* Reads the positions and velocities of the next row, which must not be modified meanwhile.
+*
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::measureMotion(const int resxFrom, const int resxTo)
+{
+	const Real restLengthX = static_cast<Real>(m_distBetweenParticlesX);
+	const Real restLengthY = static_cast<Real>(m_distBetweenParticlesY);
+
+	auto measureLink = [this](ClothMotionBounds& bounds, const size_t index, const size_t neighborIndex, const Real restLength) {
+		Vec3R direction = m_store.m_position[neighborIndex] - m_store.m_position[index];
+		const Real length = direction.norm();
+		direction.normalize();
+
+		const Real strainRate = std::abs((m_store.m_velocity[neighborIndex] - m_store.m_velocity[index]).dot(direction)) / restLength;
+		bounds.m_maxStrain = std::max(bounds.m_maxStrain, std::abs(length - restLength) / restLength);
+		bounds.m_maxStrainRate = std::max(bounds.m_maxStrainRate, strainRate);
+	};
+
+	for (int i = resxFrom; i < resxTo; ++i)
+	{
+		ClothMotionBounds bounds;
+
+		for (int j = 0; j < m_resY; ++j)
+		{
+			const size_t index = m_store.getIndex(i, j);
+
+			bounds.m_maxSpeed = std::max(bounds.m_maxSpeed, m_store.m_velocity[index].norm());
+
+			if (i + 1 < m_resX)
+			{
+				measureLink(bounds, index, m_store.getIndex(i + 1, j), restLengthX);
+			}
+			if (j + 1 < m_resY)
+			{
+				measureLink(bounds, index, index + 1, restLengthY);
+			}
+		}
+
+		m_rowMotionBounds[i] = bounds;
+	}
+}
+
+
+/*
+* Get the motion of the whole cloth during the last step, measured by measureMotion()
+*
+* @return ClothMotionBounds The motion bounds of the cloth
+*/
+ClothMotionBounds Cloth::getMotionBounds() const
+{
+	ClothMotionBounds bounds;
+	for (const ClothMotionBounds& rowBounds : m_rowMotionBounds)
+	{
+		bounds.merge(rowBounds);
+	}
+	return bounds;
+}
+
+
+/*
+* Change the sleep settings of the cloth
+* Disabling the sleeping wakes up all the particles
+*
+* @param sleepSettings The new sleep settings
+* @return void
+*/
+void Cloth::setSleepSettings(const ClothSleepSettings& sleepSettings)
+{
+	m_sleepSettings = sleepSettings;
+
+	if (!m_sleepSettings.m_isEnabled)
+	{
+		for (size_t index = 0; index < m_store.size(); ++index)
+		{
+			m_store.setSleeping(index, false);
+			m_store.m_stillSteps[index] = 0;
+		}
+		m_rowAwakeCount.assign(m_resX, m_resY);
+	}
+}
+
+
+/*
+* Select the batches of rows to simulate in the next step: the ones with an awake particle,
+* or close enough to an awake particle (within the reach of the springs) to be woken up by it
+* The motion bounds of the skipped rows are cleared (see getMotionBounds()).
+* Must be called before the step, by a single thread
+*
+* @param batchSize Number of rows of the batches of the step
+* @return int Number of awake batches
+*/
+int Cloth::updateAwakeBatches(const int batchSize)
+{
+	m_awakeBatchSize = std::max(batchSize, 1);
+	const int nbBatches = (m_resX + m_awakeBatchSize - 1) / m_awakeBatchSize;
+
+	if (!m_sleepSettings.m_isEnabled)
+	{
+		m_awakeBatches.assign(nbBatches, 1);
+		return nbBatches;
+	}
+
+	// Awake rows, including the ones woken by a contact during the last step
+	for (int i = 0; i < m_resX; ++i)
+	{
+		m_isRowAwake[i] = (m_rowAwakeCount[i] > 0 || m_rowWakeRequests[i].load(std::memory_order_relaxed) != 0) ? 1 : 0;
+	}
+
+	const int reach = ClothSpringStencil::getRadius();
+	int nbAwakeBatches = 0;
+	m_awakeBatches.assign(nbBatches, 0);
+	for (int b = 0; b < nbBatches; ++b)
+	{
+		const int rowFrom = std::max(b * m_awakeBatchSize - reach, 0);
+		const int rowTo = std::min((b + 1) * m_awakeBatchSize + reach, m_resX);
+		for (int i = rowFrom; i < rowTo; ++i)
+		{
+			if (m_isRowAwake[i])
+			{
+				m_awakeBatches[b] = 1;
+				nbAwakeBatches++;
+				break;
+			}
+		}
+	}
+
+	// The edge list (halo buffers) and the implicit solver (global system) work on the whole cloth
+	const bool isWholeCloth = (m_integrationMode == IntegrationMode::Implicit)
+		|| (m_integrationMode == IntegrationMode::Explicit && m_springModel == SpringModel::EdgeList);
+	if (isWholeCloth && nbAwakeBatches > 0)
+	{
+		m_awakeBatches.assign(nbBatches, 1);
+		nbAwakeBatches = nbBatches;
+	}
+
+	// The skipped rows are not measured: they do not move, they must not keep the motion of their last step
+	for (int b = 0; b < nbBatches; ++b)
+	{
+		if (!m_awakeBatches[b])
+		{
+			const int rowTo = std::min((b + 1) * m_awakeBatchSize, m_resX);
+			std::fill(m_rowMotionBounds.begin() + b * m_awakeBatchSize, m_rowMotionBounds.begin() + rowTo, ClothMotionBounds());
+		}
+	}
+
+	return nbAwakeBatches;
+}
+
+
+/*
+* Update the sleep state of the particles at the end of a step
 * Only update the particles in the range [resxFrom, resxTo], this way we can parallelize the update
-* 
+*
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::updateSleepStates(const int resxFrom, const int resxTo)
+{
+	if (!m_sleepSettings.m_isEnabled)
+	{
+		return;
+	}
+
+	const uint16_t sleepSteps = std::max<uint16_t>(m_sleepSettings.m_steps, 1);
+	const Real energyThreshold = static_cast<Real>(m_sleepSettings.m_energyThreshold);
+	const Real displacementThreshold2 = static_cast<Real>(m_sleepSettings.m_displacementThreshold * m_sleepSettings.m_displacementThreshold);
+
+	for (int i = resxFrom; i < resxTo; ++i)
+	{
+		int awakeCount = 0;
+
+		for (int j = 0; j < m_resY; ++j)
+		{
+			const size_t index = m_store.getIndex(i, j);
+			uint16_t& stillSteps = m_store.m_stillSteps[index];
+
+			// The fixed particles never move, they do not keep their neighbors awake
+			if (m_store.isFixed(index))
+			{
+				stillSteps = sleepSteps;
+				continue;
+			}
+
+			// Still sleeping (the particles woken by a contact have their counter reset)
+			if (m_store.isSleeping(index) && stillSteps >= sleepSteps)
+			{
+				continue;
+			}
+			m_store.setSleeping(index, false);
+
+			const Vec3R& position = m_store.m_position[index];
+			const Vec3R& velocity = m_store.m_velocity[index];
+			const Real kineticEnergy = static_cast<Real>(0.5) * velocity.dot(velocity) / m_store.m_inverseMass[index];
+			const Vec3R displacement = position - m_store.m_sleepAnchor[index];
+
+			if (kineticEnergy < energyThreshold && displacement.dot(displacement) < displacementThreshold2)
+			{
+				stillSteps = std::min<uint16_t>(stillSteps + 1, sleepSteps);
+			}
+			else
+			{
+				stillSteps = 0;
+				m_store.m_sleepAnchor[index] = position;
+			}
+
+			if (stillSteps >= sleepSteps)
+			{
+				// Fall asleep, the velocity is cleared at the next step (the neighbor rows may still read it here)
+				// The position is kept in both buffers, the batches where all the particles sleep are not integrated
+				m_store.setSleeping(index, true);
+				m_store.m_previousPosition[index] = position;
+			}
+			else
+			{
+				awakeCount++;
+			}
+		}
+
+		m_rowAwakeCount[i] = awakeCount;
+		m_rowWakeRequests[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+
+/*
+* Wake up a particle, when something collides with it
+* Can be called from several threads, during the collisions between the cloths
+*
+* @param i The particle's i index
+* @param j The particle's j index
+* @return void
+*/
+void Cloth::wakeParticle(const int i, const int j)
+{
+	if (!m_sleepSettings.m_isEnabled)
+	{
+		return;
+	}
+
+	m_store.m_stillSteps[m_store.getIndex(i, j)] = 0;
+	m_rowWakeRequests[i].store(1, std::memory_order_relaxed);
+}
+
+
+/*
+* Wake up the sleeping particles of the rows [resxFrom, resxTo] that have an awake neighbor (within the
+* reach of the springs), the wake up propagates through the springs step after step.
+* The particles staying asleep are at rest, and drop the forces they received.
+*
 * @param resxFrom The starting index in the X direction
 * @param resxTo The ending index in the X direction
 * @return void
 */
-void Cloth::updatePreviousPositionAndVelocity(const int resxFrom, const int resxTo)
+void Cloth::wakeSleepingParticles(const int resxFrom, const int resxTo)
 {
+	if (!m_sleepSettings.m_isEnabled)
+	{
+		return;
+	}
+
+	const int reach = ClothSpringStencil::getRadius();
+	const uint16_t sleepSteps = std::max<uint16_t>(m_sleepSettings.m_steps, 1);
+
 	for (int i = resxFrom; i < resxTo; ++i)
 	{
 		for (int j = 0; j < m_resY; ++j)
 		{
-			m_particles[i][j].m_previousPosition = m_particles[i][j].m_position;
-			m_particles[i][j].m_previousVelocity = m_particles[i][j].m_velocity;
+			const size_t index = m_store.getIndex(i, j);
+			if (!m_store.isSleeping(index))
+			{
+				continue;
+			}
+
+			// The counters are only written at the end of the step (and by the contacts), so they can be read here
+			bool hasAwakeNeighbor = (m_store.m_stillSteps[index] < sleepSteps);
+			for (int ii = std::max(i - reach, 0); ii <= std::min(i + reach, m_resX - 1) && !hasAwakeNeighbor; ++ii)
+			{
+				for (int jj = std::max(j - reach, 0); jj <= std::min(j + reach, m_resY - 1); ++jj)
+				{
+					if (m_store.m_stillSteps[m_store.getIndex(ii, jj)] < sleepSteps)
+					{
+						hasAwakeNeighbor = true;
+						break;
+					}
+				}
+			}
+
+			if (hasAwakeNeighbor)
+			{
+				m_store.setSleeping(index, false);
+			}
+			else
+			{
+				// The integration keeps its previous position, at rest
+				m_store.m_externalForces[index] = Vec3R(0.0, 0.0, 0.0);
+			}
 		}
 	}
 }
 
 
+/*
+* Apply the contacts with the other cloths, found during the collisions, to the particles
+* The responses of a particle are summed in the order of the contacts (see ContactBuffer), the result does not
+* depend on the number of collision tasks. A sleeping particle hit by a contact is woken up.
+* Only update the particles in the range [resxFrom, resxTo], this way we can parallelize the update
+* 
+* @param contactBuffers The sorted contacts of all the collision tasks
+* @param resxFrom The starting index in the X direction
+* @param resxTo The ending index in the X direction
+* @return void
+*/
+void Cloth::applyContacts(const std::vector<ContactBuffer>& contactBuffers, const int resxFrom, const int resxTo)
+{
+	ContactBuffer::forEachParticle(contactBuffers, m_uidIndex, m_store.getIndex(resxFrom, 0), m_store.getIndex(resxTo, 0),
+		[this](const size_t index, const Vec3R& displacement, const Vec3R& velocityChange) {
+			if (m_store.isSleeping(index))
+			{
+				wakeParticle(static_cast<int>(index / static_cast<size_t>(m_resY)), static_cast<int>(index % static_cast<size_t>(m_resY)));
+			}
+			m_store.applyContact(index, displacement, velocityChange);
+		});
+}
+
+
+/*
+* End the step: the state written by the step becomes the previous state of the next step (no copy)
+* Must be called once all the tasks of the step are done
+*
+* @return void
+*/
+void Cloth::swapStateBuffers()
+{
+	// The mesh is updated from the previous state, it must not be swapped meanwhile
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_store.swapCurrentAndPrevious();
+}
+
+
 
 /*
 * Check if two particles are neighbors
@@ -262,7 +924,7 @@ bool Cloth::areParticlesNeighbors(
 {
 	if (uidIndex1 == uidIndex2)
 	{
-		int distNoEffect = 2;
+		int distNoEffect = s_noCollisionDistance;
 
 		bool isJneighbor = (j1 == j2);
 		bool isIneighbor = (i1 == i2);
@@ -291,9 +953,9 @@ bool Cloth::areParticlesNeighbors(
 void Cloth::initMesh()
 {
 	// Create the vertices and normals for the bottom and top faces
-	initMeshOneFace(0, m_particles, false);
+	initMeshOneFace(0, false);
 	m_meshFaceIndexTop = m_object3D.m_faces.size();
-	initMeshOneFace(m_object3D.m_vertices.size(), m_particles, true);
+	initMeshOneFace(m_object3D.m_vertices.size(), true);
 
 	// Load textures, Compute the tangent and bitangent vectors
 	m_object3D.postProcess(m_textureFolderPath, true, true);
@@ -304,10 +966,10 @@ void Cloth::initMesh()
 * Initialize the mesh of the cloth with one face (the top one or the bottom one)
 * 
 * @param offset Offset to apply to the vertices
-* @param topBottomFace List of particles for the top or bottom face
+* @param isTop True for the top face, false for the bottom one
 * @return void
 */
-void Cloth::initMeshOneFace(const int offset, const std::vector<std::vector<Particle>>& topBottomFace, const bool isTop)
+void Cloth::initMeshOneFace(const int offset, const bool isTop)
 {
 	// Create the vertices, normals, UVs
 	for (int i = 0; i < m_resX; ++i)
@@ -317,7 +979,7 @@ void Cloth::initMeshOneFace(const int offset, const std::vector<std::vector<Part
 		for (int j = 0; j < m_resY; ++j)
 		{
 			// vertices
-			m_object3D.m_vertices.push_back(topBottomFace[i][j].m_position.toArray());
+			m_object3D.m_vertices.push_back(m_store.m_position[m_store.getIndex(i, j)].toArray());
 			// Normals
 			m_object3D.m_normals.push_back({ 0.0f, 1.0f, 0.0f });
 			// UVs
@@ -387,6 +1049,7 @@ void Cloth::initMeshOneFace(const int offset, const std::vector<std::vector<Part
 /*
 * Update the mesh vertices
 * Need to be called after the update of the particles and before the rendering
+* The vertices are the previous state of the particles: the last completed step
 * 
 * @return void
 */
@@ -407,7 +1070,7 @@ void Cloth::updateMesh()
 		{
 			for (int j = 0; j < m_resY; ++j)
 			{
-				Vec3 p0 = m_particles[i][j].m_position;
+				const Vec3R& p0 = m_store.m_previousPosition[m_store.getIndex(i, j)];
 				int nextI = i + 1;
 				int nextJ = j + 1;
 				bool isInverted = false;
@@ -421,22 +1084,22 @@ void Cloth::updateMesh()
 					nextJ = j - 1;
 					isInverted = !isInverted;
 				}
-				Vec3 p1 = m_particles[nextI][j].m_position;
-				Vec3 p2 = m_particles[i][nextJ].m_position;
-				Vec3 normal = (p1 - p0).cross(p2 - p0).getNormalized();
+				const Vec3R& p1 = m_store.m_previousPosition[m_store.getIndex(nextI, j)];
+				const Vec3R& p2 = m_store.m_previousPosition[m_store.getIndex(i, nextJ)];
+				Vec3R normal = (p1 - p0).cross(p2 - p0).getNormalized();
 				if (!isInverted)
 				{
-					normal = normal * -1.0;
+					normal = normal * static_cast<Real>(-1);
 				}
 
-				const double halfThickness = m_thickness / 2.0;
+				const Real halfThickness = static_cast<Real>(m_thickness / 2.0);
 
 				// Top side is updated on top of the particlesBottom's positions
-				Vec3 posTop = m_particles[i][j].m_position + normal * halfThickness;
+				Vec3R posTop = p0 + normal * halfThickness;
 				m_object3D.m_vertices[offsetTopBottom + i * m_resY + j] = posTop.toArray(); // Top side
 
 				// Bottom side is updated below the particlesBottom's positions
-				Vec3 posBottom = m_particles[i][j].m_position - normal * halfThickness;
+				Vec3R posBottom = p0 - normal * halfThickness;
 				m_object3D.m_vertices[i * m_resY + j] = posBottom.toArray();
 			}
 		}
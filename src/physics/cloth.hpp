@@ -2,6 +2,15 @@
 
 // Includes from project
 #include "particle.hpp"
+#include "clothParticleStore.hpp"
+#include "contactBuffer.hpp"
+#include "clothBounds.hpp"
+#include "springEdgeList.hpp"
+#include "gridSpringStencil.hpp"
+#include "xpbdSolver.hpp"
+#include "implicitSolver.hpp"
+#include "adaptiveTimeStep.hpp"
+#include "simd/clothKernels.hpp"
 #include "../src/math/vec3.hpp"
 #include "../src/view/OpenGl/object3D.hpp"
 #include "../src/physics/collider.hpp"
@@ -12,11 +21,54 @@
 #include <vector>
 #include <mutex>
 #include <shared_mutex>
+#include <atomic>
+#include <cstdint>
 
 
 class ClothesList;
 
 
+/*
+* How the springs of a cloth are represented
+* Stencil: storage free 5x5 grid stencil, forces are gathered per particle (default)
+* EdgeList: explicit list of springs, each one evaluated once and scattered to both particles
+*/
+enum class SpringModel
+{
+	Stencil,
+	EdgeList
+};
+
+
+/*
+* How the particles of a cloth are stepped
+* Explicit: spring forces integrated with semi-implicit Euler, needs small time steps (default)
+* Xpbd: positions predicted then corrected by XPBD constraints, stable with frame sized time steps
+* Implicit: backward Euler on the stencil springs, solved with a conjugate gradient, stable with very stiff springs
+*/
+enum class IntegrationMode
+{
+	Explicit,
+	Xpbd,
+	Implicit
+};
+
+
+/*
+* When the particles of a cloth fall asleep
+* A particle is still when its kinetic energy is below m_energyThreshold and it stayed within
+* m_displacementThreshold of the position where it became still. After m_steps still steps, it falls asleep:
+* it is not integrated nor tested against the colliders anymore, until a neighbor or a contact wakes it up.
+*/
+struct ClothSleepSettings
+{
+	bool m_isEnabled = false;
+	double m_energyThreshold = 5e-5;
+	double m_displacementThreshold = 0.01;
+	uint16_t m_steps = 60;
+};
+
+
 /*
 * Class Cloth
 * The cloth is made of particles, each particle is connected to its neighbors by springs
@@ -24,6 +76,10 @@ class ClothesList;
 class Cloth
 {
 public:
+	// The particles of a cloth closer than this (in rows and columns) do not collide with each other
+	static constexpr int s_noCollisionDistance = 2;
+	static_assert(ClothBounds::s_neighborDistance == s_noCollisionDistance, "The culling must skip the same neighbors");
+
 	int m_resX;
 	int m_resY;
 	double m_width;
@@ -34,6 +90,26 @@ public:
 	mutable std::mutex m_mutex;
 	std::vector<std::vector<Particle>> m_particles;
 
+	// Simulation state of the particles (structure of arrays)
+	ClothParticleStore m_store;
+
+	// Boxes of the patches of particles, updated with the positions, and the patches the grid collider tests
+	ClothBounds m_bounds;
+
+	// Springs linking the particles
+	SpringModel m_springModel = SpringModel::Stencil;
+	ClothSpringStencil m_springStencil;
+	SpringEdgeList m_springEdges; // Only filled with the SpringModel::EdgeList model
+
+	// Constraint solver, only used with the IntegrationMode::Xpbd mode
+	IntegrationMode m_integrationMode = IntegrationMode::Explicit;
+	XpbdSolver m_xpbdSolver;
+
+	// Linear solver, only used with the IntegrationMode::Implicit mode
+	ImplicitSolver m_implicitSolver;
+
+	ClothSleepSettings m_sleepSettings;
+
 	Object3D m_object3D;
 	std::shared_ptr<ObjectRenderingInstance> m_pRenderingInstance;
 
@@ -44,6 +120,23 @@ public:
 private:
 	int m_meshFaceIndexTop = 0;
 
+	// Springs params
+	double m_springStiffness = 1000.0;
+	double m_springDamping = 0.0;
+	double m_distBetweenParticlesX = 0.0;
+	double m_distBetweenParticlesY = 0.0;
+
+	// Motion of each row during the last step, for the adaptive time step
+	std::vector<ClothMotionBounds> m_rowMotionBounds;
+
+	// Sleeping: number of awake particles per row, rows with a particle woken by a contact,
+	// awake rows of the next step (buffer of updateAwakeBatches()), and batches of rows to simulate in the current step
+	std::vector<int> m_rowAwakeCount;
+	std::vector<std::atomic<uint8_t>> m_rowWakeRequests;
+	std::vector<uint8_t> m_isRowAwake;
+	std::vector<uint8_t> m_awakeBatches;
+	int m_awakeBatchSize = 1;
+
 	// Cloth texture params
 	std::string m_textureFolderPath;
 	float m_uvScale = 1.0f;
@@ -60,7 +153,13 @@ public:
 	);
 	virtual ~Cloth();
 
-	void updatePreviousPositionAndVelocity(const int resxFrom, const int resxTo);
+	void applyContacts(const std::vector<ContactBuffer>& contactBuffers, const int resxFrom, const int resxTo);
+	void swapStateBuffers();
+	void setSpringModel(const SpringModel springModel);
+	void computeSpringForces(const int resxFrom, const int resxTo);
+	void setSpringParameters(const double stiffness, const double damping);
+	void setIntegrationMode(const IntegrationMode integrationMode);
+	double getMaxTimeStep() const;
 
 	static bool areParticlesNeighbors(
 		const size_t uidIndex1, 
@@ -68,6 +167,20 @@ public:
 		const int i1, const int j1, 
 		const int i2, const int j2
 	);
+
+	/*
+	* Check if two particles resolved from their grid handles are neighbors (see areParticlesNeighbors() above)
+	*
+	* @param particle1 The first particle
+	* @param particle2 The second particle
+	* @return bool True if the particles are neighbors, false otherwise
+	*/
+	static inline bool areParticlesNeighbors(const GridParticle& particle1, const GridParticle& particle2)
+	{
+		return particle1.m_clothUid == particle2.m_clothUid
+			&& std::abs(particle1.m_i - particle2.m_i) <= s_noCollisionDistance
+			&& std::abs(particle1.m_j - particle2.m_j) <= s_noCollisionDistance;
+	};
 	void updateMesh();
 
 	void updateParticles(
@@ -78,11 +191,43 @@ public:
 		std::shared_ptr<GridCollider> pGridCollider
 	);
 
+	// XPBD step: predictPositions(), solveConstraints() for each iteration, then finalizeParticles()
+	void predictPositions(const double dt, const int resxFrom, const int resxTo);
+	void solveConstraints(const double dt, const int resxFrom, const int resxTo, const int iteration);
+
+	// Implicit step: beginImplicitStep(), the conjugate gradient of m_implicitSolver, then finalizeParticles()
+	void beginImplicitStep(const double dt, const int resxFrom, const int resxTo);
+	void finalizeParticles(
+		const double dt,
+		const int resxFrom,
+		const int resxTo,
+		const std::vector<std::shared_ptr<Collider>>& colliders,
+		std::shared_ptr<GridCollider> pGridCollider
+	);
+
 	void updateGridCollider(std::shared_ptr<GridCollider> pGridCollider, const int indexFrom, const int indexTo);
+	void addActiveParticlesToGrid(std::shared_ptr<GridCollider> pGridCollider, const int indexFrom, const int indexTo);
+
+	void measureMotion(const int resxFrom, const int resxTo);
+	ClothMotionBounds getMotionBounds() const;
+
+	void setSleepSettings(const ClothSleepSettings& sleepSettings);
+	int updateAwakeBatches(const int batchSize);
+	void updateSleepStates(const int resxFrom, const int resxTo);
+	void wakeParticle(const int i, const int j);
+	inline bool isBatchAwake(const int resxFrom) const { return m_awakeBatches[resxFrom / m_awakeBatchSize] != 0; };
 
 private:
+	void buildSpringEdges();
+	void wakeSleepingParticles(const int resxFrom, const int resxTo);
+	void handleCollisions(
+		const int resxFrom,
+		const int resxTo,
+		const std::vector<std::shared_ptr<Collider>>& colliders,
+		std::shared_ptr<GridCollider> pGridCollider
+	);
 	void initMesh();
-	void initMeshOneFace(const int offset, const std::vector<std::vector<Particle>>& topBottomFace, const bool isTop);
+	void initMeshOneFace(const int offset, const bool isTop);
 };
 
 
@@ -0,0 +1,302 @@
+// Includes from project
+#include "clothBounds.hpp"
+
+// Includes from STL
+#include <cstdlib>
+
+
+/*
+* Allocate the boxes of a cloth, all its patches are active until the first culling
+*
+* @param resX The number of rows of the cloth
+* @param resY The number of columns of the cloth
+* @param margin Added around the boxes of the patches: the radius of the particles
+* @return void
+*/
+void ClothBounds::init(const int resX, const int resY, const Real margin)
+{
+	m_resX = resX;
+	m_resY = resY;
+	m_patchRowCount = (resX + s_patchRows - 1) / s_patchRows;
+	m_patchColumnCount = (resY + s_patchColumns - 1) / s_patchColumns;
+	m_margin = margin;
+
+	m_rowBoxes.assign(static_cast<size_t>(resX) * m_patchColumnCount, ClothBox());
+	m_positions.assign(static_cast<size_t>(resX) * resY, Vec3R());
+	m_columnBoxes.assign(static_cast<size_t>(m_patchRowCount) * resY, ClothBox());
+
+	m_leafOffset = 1;
+	while (m_leafOffset < getPatchCount())
+	{
+		m_leafOffset *= 2;
+	}
+	m_nodes.assign(2 * m_leafOffset, ClothBox());
+	m_isPatchActive.assign(getPatchCount(), 1);
+}
+
+
+/*
+* Build the boxes of the patches and the BVH from the boxes of the rows, and the boxes of the columns of the
+* patches from the positions of the particles
+* Must not run while the rows are moved.
+*
+* @return void
+*/
+void ClothBounds::build()
+{
+	for (int patchRow = 0; patchRow < m_patchRowCount; ++patchRow)
+	{
+		const int rowTo = std::min((patchRow + 1) * s_patchRows, m_resX);
+		ClothBox* pColumnBoxes = &m_columnBoxes[static_cast<size_t>(patchRow) * m_resY];
+		std::fill_n(pColumnBoxes, m_resY, ClothBox());
+		for (int i = patchRow * s_patchRows; i < rowTo; ++i)
+		{
+			const Vec3R* pPositions = &m_positions[static_cast<size_t>(i) * m_resY];
+			for (int j = 0; j < m_resY; ++j)
+			{
+				pColumnBoxes[j].expand(pPositions[j]);
+			}
+		}
+
+		for (int patchColumn = 0; patchColumn < m_patchColumnCount; ++patchColumn)
+		{
+			ClothBox& box = m_nodes[m_leafOffset + static_cast<size_t>(patchRow) * m_patchColumnCount + patchColumn];
+			box.clear();
+			for (int i = patchRow * s_patchRows; i < rowTo; ++i)
+			{
+				box.merge(m_rowBoxes[static_cast<size_t>(i) * m_patchColumnCount + patchColumn]);
+			}
+			box.inflate(m_margin);
+		}
+	}
+
+	for (size_t node = m_leafOffset - 1; node >= 1; --node)
+	{
+		m_nodes[node] = m_nodes[2 * node];
+		m_nodes[node].merge(m_nodes[2 * node + 1]);
+	}
+}
+
+
+/*
+* Mark all the patches active or inactive
+*
+* @param isActive True to test all the particles of the cloth
+* @return void
+*/
+void ClothBounds::setAllPatchesActive(const bool isActive)
+{
+	std::fill(m_isPatchActive.begin(), m_isPatchActive.end(), isActive ? 1 : 0);
+}
+
+
+/*
+* Mark a patch and the patches next to it active
+*
+* @param patch The patch
+* @return void
+*/
+void ClothBounds::setPatchActiveAround(const size_t patch)
+{
+	const int patchRow = static_cast<int>(patch) / m_patchColumnCount;
+	const int patchColumn = static_cast<int>(patch) % m_patchColumnCount;
+	for (int row = std::max(patchRow - 1, 0); row <= std::min(patchRow + 1, m_patchRowCount - 1); ++row)
+	{
+		for (int column = std::max(patchColumn - 1, 0); column <= std::min(patchColumn + 1, m_patchColumnCount - 1); ++column)
+		{
+			setPatchActive(static_cast<size_t>(row) * m_patchColumnCount + column);
+		}
+	}
+}
+
+
+/*
+* Count the active patches
+*
+* @return size_t The number of active patches
+*/
+size_t ClothBounds::getActivePatchCount() const
+{
+	return static_cast<size_t>(std::count(m_isPatchActive.begin(), m_isPatchActive.end(), 1));
+}
+
+
+/*
+* Check if two patches of the cloth are the same or touch each other (diagonals included)
+* The boxes of the patches next to each other overlap even when the cloth is flat.
+*
+* @param patch1 The first patch
+* @param patch2 The second patch
+* @return bool True if the patches are adjacent
+*/
+bool ClothBounds::arePatchesAdjacent(const size_t patch1, const size_t patch2) const
+{
+	const int column1 = static_cast<int>(patch1) % m_patchColumnCount;
+	const int column2 = static_cast<int>(patch2) % m_patchColumnCount;
+	const int row1 = static_cast<int>(patch1) / m_patchColumnCount;
+	const int row2 = static_cast<int>(patch2) / m_patchColumnCount;
+	return std::abs(row1 - row2) <= 1 && std::abs(column1 - column2) <= 1;
+}
+
+
+/*
+* Mark active the patches whose particles can touch a particle of the same patch or of a patch next to them
+* (see the class description). Each pair of patches is tested once, with the patches after the first one.
+*
+* @return void
+*/
+void ClothBounds::setLocalFoldsActive()
+{
+	for (int patchRow = 0; patchRow < m_patchRowCount; ++patchRow)
+	{
+		for (int patchColumn = 0; patchColumn < m_patchColumnCount; ++patchColumn)
+		{
+			const size_t patch = static_cast<size_t>(patchRow) * m_patchColumnCount + patchColumn;
+			for (int otherPatchRow = patchRow; otherPatchRow <= std::min(patchRow + 1, m_patchRowCount - 1); ++otherPatchRow)
+			{
+				const int otherPatchColumnFrom = (otherPatchRow == patchRow) ? patchColumn : std::max(patchColumn - 1, 0);
+				for (int otherPatchColumn = otherPatchColumnFrom; otherPatchColumn <= std::min(patchColumn + 1, m_patchColumnCount - 1); ++otherPatchColumn)
+				{
+					if (canPatchesTouch(patchRow, patchColumn, otherPatchRow, otherPatchColumn))
+					{
+						setPatchActive(patch);
+						setPatchActive(static_cast<size_t>(otherPatchRow) * m_patchColumnCount + otherPatchColumn);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+/*
+* Check if a particle of a patch can touch a particle of another patch (or of the same one) that is not its neighbor,
+* from the boxes of their rows and of their columns
+*
+* @param patchRow The row of the first patch
+* @param patchColumn The column of the first patch
+* @param otherPatchRow The row of the second patch
+* @param otherPatchColumn The column of the second patch
+* @return bool True if two particles of the patches can be closer than the sum of their radii
+*/
+bool ClothBounds::canPatchesTouch(const int patchRow, const int patchColumn, const int otherPatchRow, const int otherPatchColumn) const
+{
+	const Real distance = 2 * m_margin;
+
+	const int rowTo = std::min((patchRow + 1) * s_patchRows, m_resX);
+	const int otherRowTo = std::min((otherPatchRow + 1) * s_patchRows, m_resX);
+	for (int i = patchRow * s_patchRows; i < rowTo; ++i)
+	{
+		const ClothBox& rowBox = m_rowBoxes[static_cast<size_t>(i) * m_patchColumnCount + patchColumn];
+		for (int otherI = otherPatchRow * s_patchRows; otherI < otherRowTo; ++otherI)
+		{
+			if (std::abs(i - otherI) > s_neighborDistance
+				&& rowBox.overlaps(m_rowBoxes[static_cast<size_t>(otherI) * m_patchColumnCount + otherPatchColumn], distance))
+			{
+				return true;
+			}
+		}
+	}
+
+	const int columnTo = std::min((patchColumn + 1) * s_patchColumns, m_resY);
+	const int otherColumnTo = std::min((otherPatchColumn + 1) * s_patchColumns, m_resY);
+	for (int j = patchColumn * s_patchColumns; j < columnTo; ++j)
+	{
+		const ClothBox& columnBox = m_columnBoxes[static_cast<size_t>(patchRow) * m_resY + j];
+		for (int otherJ = otherPatchColumn * s_patchColumns; otherJ < otherColumnTo; ++otherJ)
+		{
+			if (std::abs(j - otherJ) > s_neighborDistance
+				&& columnBox.overlaps(m_columnBoxes[static_cast<size_t>(otherPatchRow) * m_resY + otherJ], distance))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/*
+* Mark the patches of the cloths that can touch another particle active, the others inactive
+* The bounds of the cloths must be built (see ClothBounds::build()).
+*
+* @param clothBounds The bounds of the cloths, in the same order at each call
+* @return void
+*/
+void ClothSweepAndPrune::cull(const std::vector<ClothBounds*>& clothBounds)
+{
+	m_stats = ClothCullingStats();
+	m_stats.m_clothCount = clothBounds.size();
+
+	if (m_order.size() != clothBounds.size())
+	{
+		m_order.resize(clothBounds.size());
+		for (size_t k = 0; k < m_order.size(); ++k)
+		{
+			m_order[k] = k;
+		}
+	}
+
+	// Keep the cloths sorted on the start of their boxes on X
+	for (size_t k = 1; k < m_order.size(); ++k)
+	{
+		const size_t cloth = m_order[k];
+		const Real minX = clothBounds[cloth]->getBox().m_min.x;
+		size_t l = k;
+		while (l > 0 && clothBounds[m_order[l - 1]]->getBox().m_min.x > minX)
+		{
+			m_order[l] = m_order[l - 1];
+			l--;
+		}
+		m_order[l] = cloth;
+	}
+
+	for (ClothBounds* pBounds : clothBounds)
+	{
+		pBounds->setAllPatchesActive(false);
+	}
+
+	// Sweep on X: the cloths starting before the end of a cloth overlap it on X
+	for (size_t k = 0; k < m_order.size(); ++k)
+	{
+		ClothBounds& bounds = *clothBounds[m_order[k]];
+		const ClothBox& box = bounds.getBox();
+		for (size_t l = k + 1; l < m_order.size(); ++l)
+		{
+			ClothBounds& otherBounds = *clothBounds[m_order[l]];
+			const ClothBox& otherBox = otherBounds.getBox();
+			if (otherBox.m_min.x > box.m_max.x)
+			{
+				break;
+			}
+			if (!box.overlaps(otherBox))
+			{
+				continue;
+			}
+
+			m_stats.m_overlappingClothPairs++;
+			bounds.forEachOverlap(otherBounds, [&bounds, &otherBounds](const size_t patch, const size_t otherPatch) {
+				bounds.setPatchActive(patch);
+				otherBounds.setPatchActive(otherPatch);
+			});
+		}
+	}
+
+	// Folds of the cloths on themselves
+	for (ClothBounds* pBounds : clothBounds)
+	{
+		ClothBounds& bounds = *pBounds;
+		bounds.forEachOverlap(bounds, [&bounds](const size_t patch, const size_t otherPatch) {
+			if (!bounds.arePatchesAdjacent(patch, otherPatch))
+			{
+				bounds.setPatchActiveAround(patch);
+				bounds.setPatchActiveAround(otherPatch);
+			}
+		});
+		bounds.setLocalFoldsActive();
+
+		m_stats.m_patchCount += bounds.getPatchCount();
+		m_stats.m_activePatchCount += bounds.getActivePatchCount();
+	}
+}
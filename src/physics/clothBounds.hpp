@@ -0,0 +1,249 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+
+// Includes from STL
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+/*
+* Axis aligned box in the precision of the simulation state (see Real)
+* A cleared box is empty: it does not overlap anything, and merging it changes nothing.
+*/
+struct ClothBox
+{
+	Vec3R m_min = Vec3R(std::numeric_limits<Real>::max(), std::numeric_limits<Real>::max(), std::numeric_limits<Real>::max());
+	Vec3R m_max = Vec3R(std::numeric_limits<Real>::lowest(), std::numeric_limits<Real>::lowest(), std::numeric_limits<Real>::lowest());
+
+	inline void clear() { *this = ClothBox(); };
+	inline bool isEmpty() const { return m_min.x > m_max.x; };
+
+	inline void expand(const Vec3R& point)
+	{
+		m_min = Vec3R(std::min(m_min.x, point.x), std::min(m_min.y, point.y), std::min(m_min.z, point.z));
+		m_max = Vec3R(std::max(m_max.x, point.x), std::max(m_max.y, point.y), std::max(m_max.z, point.z));
+	};
+
+	inline void merge(const ClothBox& other)
+	{
+		m_min = Vec3R(std::min(m_min.x, other.m_min.x), std::min(m_min.y, other.m_min.y), std::min(m_min.z, other.m_min.z));
+		m_max = Vec3R(std::max(m_max.x, other.m_max.x), std::max(m_max.y, other.m_max.y), std::max(m_max.z, other.m_max.z));
+	};
+
+	inline void inflate(const Real margin)
+	{
+		if (!isEmpty())
+		{
+			m_min -= Vec3R(margin, margin, margin);
+			m_max += Vec3R(margin, margin, margin);
+		}
+	};
+
+	inline bool overlaps(const ClothBox& other) const
+	{
+		return m_min.x <= other.m_max.x && other.m_min.x <= m_max.x
+			&& m_min.y <= other.m_max.y && other.m_min.y <= m_max.y
+			&& m_min.z <= other.m_max.z && other.m_min.z <= m_max.z;
+	};
+
+	// Overlap once inflated by a distance: a point of each box can be closer than this distance
+	inline bool overlaps(const ClothBox& other, const Real distance) const
+	{
+		return m_min.x - distance <= other.m_max.x && other.m_min.x - distance <= m_max.x
+			&& m_min.y - distance <= other.m_max.y && other.m_min.y - distance <= m_max.y
+			&& m_min.z - distance <= other.m_max.z && other.m_min.z - distance <= m_max.z;
+	};
+};
+
+
+/*
+* Class ClothBounds
+*
+* Bounding volumes of a cloth, to skip the particles that cannot touch another particle before the grid collider.
+* The cloth is split in patches of s_patchRows x s_patchColumns particles. The box of each row of a patch is
+* updated by the task moving the row (clearRow(), addParticle()), then build() merges them in the boxes of the
+* patches, inflated by the radius of the particles, and in a BVH over the patches: a complete binary tree stored in
+* an array (the children of the node k are 2k and 2k + 1, the leaves follow each other in the order of the patches).
+* Its root is the box of the whole cloth.
+* The patches next to each other always overlap, their particles are tested by smaller boxes: the box of each row
+* of a patch against the rows at least s_neighborDistance + 1 rows away, and the box of each column of a patch,
+* built from the positions kept by addParticle(), against the columns at least s_neighborDistance + 1 columns away.
+* Two particles that are not neighbors are that far on the rows or on the columns, so a flat cloth has no contact
+* there while any fold or crumple of a patch onto itself or onto the patches around it is found.
+* The patches that can touch another particle are marked active by a ClothSweepAndPrune, only their particles are
+* tested by the grid collider.
+*/
+class ClothBounds
+{
+public:
+	static constexpr int s_patchRows = 4;
+	static constexpr int s_patchColumns = 4;
+
+	// The particles closer than this on the rows and on the columns do not collide (see Cloth::s_noCollisionDistance)
+	static constexpr int s_neighborDistance = 2;
+
+private:
+	int m_resX = 0;
+	int m_resY = 0;
+	int m_patchRowCount = 0;
+	int m_patchColumnCount = 0;
+	Real m_margin = 0;
+
+	// Box of each row of each column of patches, written by the task moving the row
+	std::vector<ClothBox> m_rowBoxes;
+
+	// Position of each particle, written by the task moving its row, and box of each column of each row of patches
+	std::vector<Vec3R> m_positions;
+	std::vector<ClothBox> m_columnBoxes;
+
+	// Nodes of the BVH, the node 0 is not used, the leaves start at m_leafOffset
+	std::vector<ClothBox> m_nodes;
+	size_t m_leafOffset = 1;
+
+	std::vector<uint8_t> m_isPatchActive;
+
+public:
+	ClothBounds() {};
+	~ClothBounds() {};
+
+	void init(const int resX, const int resY, const Real margin);
+	void build();
+	void setAllPatchesActive(const bool isActive);
+	void setPatchActiveAround(const size_t patch);
+	size_t getActivePatchCount() const;
+	bool arePatchesAdjacent(const size_t patch1, const size_t patch2) const;
+	void setLocalFoldsActive();
+
+	inline void clearRow(const int i)
+	{
+		std::fill_n(m_rowBoxes.begin() + static_cast<ptrdiff_t>(i) * m_patchColumnCount, m_patchColumnCount, ClothBox());
+	};
+	inline void addParticle(const int i, const int j, const Vec3R& position)
+	{
+		m_rowBoxes[static_cast<size_t>(i) * m_patchColumnCount + j / s_patchColumns].expand(position);
+		m_positions[static_cast<size_t>(i) * m_resY + j] = position;
+	};
+
+	inline const ClothBox& getBox() const { return m_nodes[1]; };
+	inline const ClothBox& getPatchBox(const size_t patch) const { return m_nodes[m_leafOffset + patch]; };
+	inline size_t getPatchCount() const { return static_cast<size_t>(m_patchRowCount) * m_patchColumnCount; };
+	inline int getPatchColumnCount() const { return m_patchColumnCount; };
+	inline size_t getPatch(const int i, const int j) const { return static_cast<size_t>(i / s_patchRows) * m_patchColumnCount + j / s_patchColumns; };
+	inline bool isPatchActive(const size_t patch) const { return m_isPatchActive[patch] != 0; };
+	inline void setPatchActive(const size_t patch) { m_isPatchActive[patch] = 1; };
+
+	template <typename Function>
+	void forEachOverlap(const ClothBounds& other, Function&& function) const;
+
+private:
+	bool canPatchesTouch(const int patchRow, const int patchColumn, const int otherPatchRow, const int otherPatchColumn) const;
+};
+
+
+/*
+* Call a function for each pair of overlapping patches of this cloth and of another one, by descending both BVHs
+* together. With the cloth itself, each pair of different patches is given once.
+*
+* @param other The other cloth, or this one for the self collisions
+* @param function Called with (patch, otherPatch) for each pair of overlapping patches
+* @return void
+*/
+template <typename Function>
+void ClothBounds::forEachOverlap(const ClothBounds& other, Function&& function) const
+{
+	const bool isSelf = (&other == this);
+
+	// Pairs of nodes to visit, reused between the calls of a thread
+	thread_local std::vector<std::pair<size_t, size_t>> stack;
+	stack.clear();
+	stack.push_back(std::make_pair(size_t(1), size_t(1)));
+
+	while (!stack.empty())
+	{
+		const auto [node, otherNode] = stack.back();
+		stack.pop_back();
+		if (!m_nodes[node].overlaps(other.m_nodes[otherNode]))
+		{
+			continue;
+		}
+
+		const bool isLeaf = (node >= m_leafOffset);
+		const bool isOtherLeaf = (otherNode >= other.m_leafOffset);
+		if (isSelf && node == otherNode)
+		{
+			// The pairs inside a node: inside each child, and between the two children
+			if (!isLeaf)
+			{
+				stack.push_back(std::make_pair(2 * node, 2 * node));
+				stack.push_back(std::make_pair(2 * node + 1, 2 * node + 1));
+				stack.push_back(std::make_pair(2 * node, 2 * node + 1));
+			}
+		}
+		else if (isLeaf && isOtherLeaf)
+		{
+			function(node - m_leafOffset, otherNode - other.m_leafOffset);
+		}
+		else if (isLeaf)
+		{
+			stack.push_back(std::make_pair(node, 2 * otherNode));
+			stack.push_back(std::make_pair(node, 2 * otherNode + 1));
+		}
+		else if (isOtherLeaf)
+		{
+			stack.push_back(std::make_pair(2 * node, otherNode));
+			stack.push_back(std::make_pair(2 * node + 1, otherNode));
+		}
+		else
+		{
+			stack.push_back(std::make_pair(2 * node, 2 * otherNode));
+			stack.push_back(std::make_pair(2 * node, 2 * otherNode + 1));
+			stack.push_back(std::make_pair(2 * node + 1, 2 * otherNode));
+			stack.push_back(std::make_pair(2 * node + 1, 2 * otherNode + 1));
+		}
+	}
+}
+
+
+/*
+* What the last culling kept for the grid collider
+*/
+struct ClothCullingStats
+{
+	size_t m_clothCount = 0;
+	size_t m_overlappingClothPairs = 0;
+	size_t m_patchCount = 0;
+	size_t m_activePatchCount = 0;
+};
+
+
+/*
+* Class ClothSweepAndPrune
+*
+* Decides which patches of the cloths need a test of their particles (see ClothBounds).
+* The boxes of the cloths are kept sorted on X between the steps (an insertion sort, almost free when the cloths
+* move a little), and swept to find the pairs of cloths whose boxes overlap. The patches of two overlapping cloths
+* are tested by their BVHs, the patches overlapping a patch of the other cloth are active.
+* A cloth collides with itself where it is folded: the patches overlapping a patch of the same cloth that is not
+* next to them are active, with the patches around them (their particles can be close to the fold too), and so are
+* the patches whose particles can touch a particle of the same patch or of a patch next to them, when a fold is
+* sharper than a patch (see ClothBounds::setLocalFoldsActive()).
+*/
+class ClothSweepAndPrune
+{
+private:
+	std::vector<size_t> m_order;
+	ClothCullingStats m_stats;
+
+public:
+	ClothSweepAndPrune() {};
+	~ClothSweepAndPrune() {};
+
+	void cull(const std::vector<ClothBounds*>& clothBounds);
+	inline const ClothCullingStats& getStats() const { return m_stats; };
+};
@@ -0,0 +1,125 @@
+// Includes from project
+#include "clothParticleStore.hpp"
+
+
+/*
+* Allocate the arrays for a grid of resX * resY particles
+* All the particles are initialized at rest, at the origin, with a unit mass
+*
+* @param resX Resolution of the cloth in the X direction
+* @param resY Resolution of the cloth in the Y direction
+* @return void
+*/
+void ClothParticleStore::resize(const int resX, const int resY)
+{
+	m_resX = resX;
+	m_resY = resY;
+
+	const size_t count = static_cast<size_t>(resX) * static_cast<size_t>(resY);
+
+	m_position.assign(count, Vec3R(0.0, 0.0, 0.0));
+	m_previousPosition.assign(count, Vec3R(0.0, 0.0, 0.0));
+	m_velocity.assign(count, Vec3R(0.0, 0.0, 0.0));
+	m_previousVelocity.assign(count, Vec3R(0.0, 0.0, 0.0));
+	m_externalForces.assign(count, Vec3R(0.0, 0.0, 0.0));
+	m_inverseMass.assign(count, static_cast<Real>(1));
+	m_flags.assign(count, PARTICLE_FLAG_NONE);
+	m_stillSteps.assign(count, 0);
+	m_sleepAnchor.assign(count, Vec3R(0.0, 0.0, 0.0));
+}
+
+
+/*
+* Copy the current position and velocity of the particles into their previous position and velocity
+* Only the particles in the range [indexFrom, indexTo[ are updated, this way we can parallelize the copy
+* Used to set the initial state, the steps swap the buffers instead (see swapCurrentAndPrevious())
+*
+* @param indexFrom The first particle index
+* @param indexTo The last particle index (excluded)
+* @return void
+*/
+void ClothParticleStore::copyCurrentToPrevious(const size_t indexFrom, const size_t indexTo)
+{
+	for (size_t i = indexFrom; i < indexTo; ++i)
+	{
+		m_previousPosition[i] = m_position[i];
+		m_previousVelocity[i] = m_velocity[i];
+	}
+}
+
+
+/*
+* Swap the current and previous state buffers, at the end of a step: the state written by the step becomes the
+* previous state of the next one, without copying
+* Must be called by a single thread, when no task reads or writes the state
+*
+* @return void
+*/
+void ClothParticleStore::swapCurrentAndPrevious()
+{
+	m_position.swap(m_previousPosition);
+	m_velocity.swap(m_previousVelocity);
+}
+
+
+/*
+* Apply the summed responses of the contacts of a particle to its current state
+* A particle that is not integrated (fixed or sleeping) is moved in both buffers, it keeps its state until it is
+* integrated again.
+*
+* @param index Index of the particle
+* @param displacement Displacement of the particle
+* @param velocityChange Change of the velocity of the particle
+* @return void
+*/
+void ClothParticleStore::applyContact(const size_t index, const Vec3R& displacement, const Vec3R& velocityChange)
+{
+	m_position[index] += displacement;
+	m_velocity[index] += velocityChange;
+
+	if (isFrozen(index))
+	{
+		m_previousPosition[index] = m_position[index];
+		m_previousVelocity[index] = m_velocity[index];
+	}
+}
+
+
+/*
+* Fix (or release) a particle, a fixed particle is not integrated anymore
+*
+* @param index Index of the particle
+* @param fixState True to fix the particle, false to release it
+* @return void
+*/
+void ClothParticleStore::setFixed(const size_t index, const bool fixState)
+{
+	if (fixState)
+	{
+		m_flags[index] |= PARTICLE_FLAG_FIXED;
+	}
+	else
+	{
+		m_flags[index] &= static_cast<uint8_t>(~PARTICLE_FLAG_FIXED);
+	}
+}
+
+
+/*
+* Put a particle to sleep (or wake it up), a sleeping particle is not integrated until it is woken up
+*
+* @param index Index of the particle
+* @param sleepState True to put the particle to sleep, false to wake it up
+* @return void
+*/
+void ClothParticleStore::setSleeping(const size_t index, const bool sleepState)
+{
+	if (sleepState)
+	{
+		m_flags[index] |= PARTICLE_FLAG_SLEEPING;
+	}
+	else
+	{
+		m_flags[index] &= static_cast<uint8_t>(~PARTICLE_FLAG_SLEEPING);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/math/alignedAllocator.hpp"
+
+// Includes from STL
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+/*
+* Flags of a particle, stored in ClothParticleStore::m_flags
+*/
+enum ParticleFlags : uint8_t
+{
+	PARTICLE_FLAG_NONE = 0,
+	PARTICLE_FLAG_FIXED = 1 << 0,
+	PARTICLE_FLAG_SLEEPING = 1 << 1,
+
+	// The particle is not moved by the integration
+	PARTICLE_FLAGS_FROZEN = PARTICLE_FLAG_FIXED | PARTICLE_FLAG_SLEEPING,
+};
+
+
+/*
+* Class ClothParticleStore
+*
+* Structure of arrays holding the state of all the particles of a cloth.
+* Everything the integration step touches is stored here in contiguous, cache line aligned arrays,
+* so that a step only streams the data it needs instead of whole Particle objects.
+* Particles are stored row by row: the particle (i, j) is at index i * resY + j.
+* The state is stored with the simulation precision (Real), the per cloth parameters stay in double.
+*
+* The position and velocity are double buffered: a step reads the previous state and writes the whole current state,
+* then the buffers are swapped (swapCurrentAndPrevious()) instead of copied. Between two steps, the previous
+* state is the last completed one and the current state is stale. The particles not integrated by a step
+* (fixed or sleeping) get their previous state back (keepPreviousState()).
+* The contacts between the cloths are not written into the state while the collisions run, they are collected in
+* ContactBuffers and applied at the end of the step (applyContact()), so the collisions read a consistent state.
+*/
+class ClothParticleStore
+{
+public:
+	AlignedVector<Vec3R> m_position;
+	AlignedVector<Vec3R> m_previousPosition;
+	AlignedVector<Vec3R> m_velocity;
+	AlignedVector<Vec3R> m_previousVelocity;
+	AlignedVector<Vec3R> m_externalForces;
+	AlignedVector<Real> m_inverseMass;
+	AlignedVector<uint8_t> m_flags;
+
+	// Sleeping: number of consecutive steps the particle barely moved, and where it started to be still
+	AlignedVector<uint16_t> m_stillSteps;
+	AlignedVector<Vec3R> m_sleepAnchor;
+
+	// Parameters shared by all the particles of the cloth
+	double m_radius = 0.0;
+	double m_airFriction = 2.0;
+	double m_objectFriction = 1.0;
+	double m_groundFriction = 4.0;
+
+private:
+	int m_resX = 0;
+	int m_resY = 0;
+
+public:
+	ClothParticleStore() {};
+	~ClothParticleStore() {};
+
+	void resize(const int resX, const int resY);
+	void copyCurrentToPrevious(const size_t indexFrom, const size_t indexTo);
+	void swapCurrentAndPrevious();
+	void applyContact(const size_t index, const Vec3R& displacement, const Vec3R& velocityChange);
+
+	inline size_t size() const { return m_position.size(); };
+	inline int getResX() const { return m_resX; };
+	inline int getResY() const { return m_resY; };
+	inline size_t getIndex(const int i, const int j) const { return static_cast<size_t>(i) * static_cast<size_t>(m_resY) + static_cast<size_t>(j); };
+	inline bool isFixed(const size_t index) const { return (m_flags[index] & PARTICLE_FLAG_FIXED) != 0; };
+	inline bool isSleeping(const size_t index) const { return (m_flags[index] & PARTICLE_FLAG_SLEEPING) != 0; };
+	inline bool isFrozen(const size_t index) const { return (m_flags[index] & PARTICLE_FLAGS_FROZEN) != 0; };
+	void setFixed(const size_t index, const bool fixState);
+	void setSleeping(const size_t index, const bool sleepState);
+
+	/*
+	* Give back its previous state to a particle that is not integrated (fixed or sleeping), a sleeping particle is at rest
+	*
+	* @param index Index of the particle
+	* @return void
+	*/
+	inline void keepPreviousState(const size_t index)
+	{
+		m_position[index] = m_previousPosition[index];
+		m_velocity[index] = isSleeping(index) ? Vec3R(0.0, 0.0, 0.0) : m_previousVelocity[index];
+	};
+};
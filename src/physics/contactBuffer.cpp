@@ -0,0 +1,57 @@
+// Includes from project
+#include "contactBuffer.hpp"
+
+// Includes from STL
+#include <algorithm>
+
+
+/*
+* Add the response of a particle to a contact
+*
+* @param clothUid The cloth of the particle
+* @param index The index of the particle in its cloth
+* @param otherClothUid The cloth of the other particle of the contact
+* @param otherIndex The index of the other particle in its cloth
+* @param displacement Displacement of the particle
+* @param velocityChange Change of the velocity of the particle
+* @return void
+*/
+void ContactBuffer::add(const size_t clothUid, const size_t index, const size_t otherClothUid, const size_t otherIndex, const Vec3R& displacement, const Vec3R& velocityChange)
+{
+	ParticleContact contact;
+	contact.m_clothUid = clothUid;
+	contact.m_index = index;
+	contact.m_otherClothUid = otherClothUid;
+	contact.m_otherIndex = otherIndex;
+	contact.m_displacement = displacement;
+	contact.m_velocityChange = velocityChange;
+	m_contacts.push_back(contact);
+}
+
+
+/*
+* Sort the contacts by particle, then by the other particle of the contact
+*
+* @return void
+*/
+void ContactBuffer::sort()
+{
+	std::sort(m_contacts.begin(), m_contacts.end());
+}
+
+
+/*
+* Find the first contact of a particle, or of the next particle with contacts, in the sorted buffer
+*
+* @param clothUid The cloth of the particle
+* @param index The index of the particle
+* @return size_t The position of the contact, size() if there is none
+*/
+size_t ContactBuffer::findFirst(const size_t clothUid, const size_t index) const
+{
+	const auto it = std::lower_bound(m_contacts.begin(), m_contacts.end(), std::make_pair(clothUid, index),
+		[](const ParticleContact& contact, const std::pair<size_t, size_t>& particle) {
+			return std::tie(contact.m_clothUid, contact.m_index) < std::tie(particle.first, particle.second);
+		});
+	return static_cast<size_t>(it - m_contacts.begin());
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+
+// Includes from STL
+#include <vector>
+#include <cstddef>
+#include <tuple>
+
+
+/*
+* Response of a particle to a contact with another particle
+* The contacts are ordered by particle, then by the other particle of the contact
+*/
+struct ParticleContact
+{
+	size_t m_clothUid = 0;
+	size_t m_index = 0;
+	size_t m_otherClothUid = 0;
+	size_t m_otherIndex = 0;
+	Vec3R m_displacement = Vec3R(0.0, 0.0, 0.0);
+	Vec3R m_velocityChange = Vec3R(0.0, 0.0, 0.0);
+
+	inline bool operator<(const ParticleContact& other) const
+	{
+		return std::tie(m_clothUid, m_index, m_otherClothUid, m_otherIndex) < std::tie(other.m_clothUid, other.m_index, other.m_otherClothUid, other.m_otherIndex);
+	};
+};
+
+
+/*
+* Class ContactBuffer
+*
+* The contacts found by a collision task. Each task writes to its own buffer, and sorts it once done (sort()).
+* The responses of a particle are then summed from all the buffers in the order of the contacts (forEachParticle()),
+* which does not depend on the number of tasks nor on the order the cells were visited: the collisions are
+* deterministic for any number of threads, and no particle is written by two tasks.
+*/
+class ContactBuffer
+{
+private:
+	std::vector<ParticleContact> m_contacts;
+
+public:
+	ContactBuffer() {};
+	~ContactBuffer() {};
+
+	void add(const size_t clothUid, const size_t index, const size_t otherClothUid, const size_t otherIndex, const Vec3R& displacement, const Vec3R& velocityChange);
+	void sort();
+	size_t findFirst(const size_t clothUid, const size_t index) const;
+
+	inline void clear() { m_contacts.clear(); };
+	inline size_t size() const { return m_contacts.size(); };
+	inline const ParticleContact& operator[](const size_t i) const { return m_contacts[i]; };
+
+	template <typename Function>
+	static void forEachParticle(const std::vector<ContactBuffer>& buffers, const size_t clothUid, const size_t indexFrom, const size_t indexTo, Function&& function);
+};
+
+
+/*
+* Sum the responses of each particle of a cloth in [indexFrom, indexTo[ that has contacts, from sorted buffers
+* The buffers are merged in the order of the contacts, so the sums do not depend on how the contacts are split
+* between the buffers.
+*
+* @param buffers The sorted buffers
+* @param clothUid The cloth
+* @param indexFrom The first particle
+* @param indexTo The particle after the last one
+* @param function Called with (index, displacement, velocityChange) for each particle with contacts, in increasing index order
+* @return void
+*/
+template <typename Function>
+void ContactBuffer::forEachParticle(const std::vector<ContactBuffer>& buffers, const size_t clothUid, const size_t indexFrom, const size_t indexTo, Function&& function)
+{
+	// Position of the next contact in each buffer, reused between the calls of a thread
+	thread_local std::vector<size_t> cursors;
+	cursors.resize(buffers.size());
+
+	bool hasContacts = false;
+	for (size_t b = 0; b < buffers.size(); ++b)
+	{
+		cursors[b] = buffers[b].findFirst(clothUid, indexFrom);
+		hasContacts = hasContacts || (cursors[b] < buffers[b].size() && buffers[b][cursors[b]].m_clothUid == clothUid && buffers[b][cursors[b]].m_index < indexTo);
+	}
+	if (!hasContacts)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		// Next contact in the order of the contacts
+		const ParticleContact* pNext = nullptr;
+		size_t nextBuffer = 0;
+		for (size_t b = 0; b < buffers.size(); ++b)
+		{
+			if (cursors[b] >= buffers[b].size())
+			{
+				continue;
+			}
+			const ParticleContact& contact = buffers[b][cursors[b]];
+			if (contact.m_clothUid != clothUid || contact.m_index >= indexTo)
+			{
+				continue;
+			}
+			if (pNext == nullptr || contact < *pNext)
+			{
+				pNext = &contact;
+				nextBuffer = b;
+			}
+		}
+		if (pNext == nullptr)
+		{
+			return;
+		}
+
+		// Sum the contacts of the particle
+		const size_t index = pNext->m_index;
+		Vec3R displacement(0.0, 0.0, 0.0);
+		Vec3R velocityChange(0.0, 0.0, 0.0);
+		while (pNext != nullptr && pNext->m_index == index)
+		{
+			displacement += pNext->m_displacement;
+			velocityChange += pNext->m_velocityChange;
+			cursors[nextBuffer]++;
+
+			pNext = nullptr;
+			for (size_t b = 0; b < buffers.size(); ++b)
+			{
+				if (cursors[b] >= buffers[b].size())
+				{
+					continue;
+				}
+				const ParticleContact& contact = buffers[b][cursors[b]];
+				if (contact.m_clothUid == clothUid && contact.m_index == index && (pNext == nullptr || contact < *pNext))
+				{
+					pNext = &contact;
+					nextBuffer = b;
+				}
+			}
+		}
+
+		function(index, displacement, velocityChange);
+	}
+}
@@ -3,6 +3,7 @@
 
 // Includes from STL
 #include <functional>
+#include <algorithm>
 
 /*
 * Helper function to calculate grid cell coordinates
@@ -13,11 +14,20 @@
 * @param z Z coordinate of the cell
 * @return void
 */
-inline void GridCollider::getCellCoords(const Vec3& position, int& x, int& y, int& z) const
+inline void GridCollider::getCellCoords(const Vec3R& position, int& x, int& y, int& z) const
 {
-	x = static_cast<int>(round(position.x / m_step));
-	y = static_cast<int>(round(position.y / m_step));
-	z = static_cast<int>(round(position.z / m_step));
+	// Clamped before the conversion to int, which is undefined for the values out of its range (and for NaN)
+	auto toCellCoord = [this](const double coord) {
+		const double cell = round(coord / m_step);
+		if (!(cell > -s_cellCoordLimit))
+		{
+			return -s_cellCoordLimit;
+		}
+		return (cell < s_cellCoordLimit) ? static_cast<int>(cell) : s_cellCoordLimit;
+	};
+	x = toCellCoord(position.x);
+	y = toCellCoord(position.y);
+	z = toCellCoord(position.z);
 }
 
 
@@ -76,7 +86,7 @@ inline bool StaticGridCollider::isCoordValid(const int x, const int y, const int
 * @param particleId Particle Id to add (cloth uid + index I + index J)
 * @return void
 */
-void StaticGridCollider::addParticleToCell(const Vec3& position, const std::tuple<size_t, int, int>& particleId)
+void StaticGridCollider::addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId)
 {
 	int x;
 	int y;
@@ -337,7 +347,7 @@ std::shared_ptr<GridCell> HashGridCollider::getCell(const int x, const int y, co
 * @param particleId Particle Id to add (cloth uid + index I + index J)
 * @return void
 */
-void HashGridCollider::addParticleToCell(const Vec3& position, const std::tuple<size_t, int, int>& particleId)
+void HashGridCollider::addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId)
 {
 	int x;
 	int y;
@@ -353,14 +363,19 @@ void HashGridCollider::addParticleToCell(const Vec3& position, const std::tuple<
 	std::lock_guard<std::mutex> lock(m_mutex);
 	
 	// Find the cell in the grid (or create it) and add the particle to it
-	m_gridWrite[key]->m_particlesId.push_back(particleId);
+	std::shared_ptr<GridCell>& pCell = m_gridWrite[key];
+	if (!pCell)
+	{
+		pCell = std::make_shared<GridCell>();
+	}
+	pCell->m_particlesId.push_back(particleId);
 	
 	// If the cell is just created, store it's coordinates
-	if (m_gridWrite[key]->m_particlesId.size() == 1)
+	if (pCell->m_particlesId.size() == 1)
 	{
-		m_gridWrite[key]->x = x;
-		m_gridWrite[key]->y = y;
-		m_gridWrite[key]->z = z;
+		pCell->x = x;
+		pCell->y = y;
+		pCell->z = z;
 	}
 }
 
@@ -385,4 +400,446 @@ size_t HashGridCollider::getMemorySize()
 	}
 
 	return memorySize;
-}
\ No newline at end of file
+}
+
+
+/*
+* Nothing to clear in parallel: the cells of the read grid are removed by swap()
+*
+* @return void
+*/
+void HashGridCollider::clearGridParallelized([[maybe_unused]] const size_t indexFrom, [[maybe_unused]] const size_t indexTo)
+{
+}
+
+
+
+
+/*
+* Dense grid: a box of with x with x height cells from the origin, like StaticGridCollider
+*
+* @param step Size of the cells
+* @param with Number of cells along X and Y
+* @param height Number of cells along Z
+*/
+SortedGridCollider::SortedGridCollider(const double step, const size_t with, const size_t height) : GridCollider(step),
+m_gridWidth(with), m_gridHeight(height), m_cellCount(0)
+{
+	// Whole blocks of cells
+	const size_t blockSize = size_t(1) << s_blockBits;
+	m_blockWidth = (with + blockSize - 1) / blockSize;
+	m_blockLayerSize = m_blockWidth * m_blockWidth;
+	allocateCells(m_blockLayerSize * ((height + blockSize - 1) / blockSize) * s_blockCellCount);
+}
+
+
+/*
+* Unbounded grid: the cells are the entries of a hash table, sized from the registered particles (see registerCloth())
+*
+* @param step Size of the cells
+*/
+SortedGridCollider::SortedGridCollider(const double step) : GridCollider(step),
+m_isHashed(true), m_gridWidth(0), m_gridHeight(0), m_blockWidth(0), m_blockLayerSize(0), m_cellCount(0)
+{
+	allocateCells(s_minHashedCellCount);
+}
+
+
+/*
+* Allocate the cells, all of them empty
+* Allocates, must not be called while the grid is built or read
+*
+* @param cellCount Number of cells (entries of the table of the unbounded grid, a power of 2)
+* @return void
+*/
+void SortedGridCollider::allocateCells(const size_t cellCount)
+{
+	m_cellCount = cellCount;
+	m_cellParticleCount = std::make_unique<std::atomic<uint32_t>[]>(m_cellCount);
+	for (size_t i = 0; i < m_cellCount; ++i)
+	{
+		m_cellParticleCount[i].store(0, std::memory_order_relaxed);
+	}
+	m_cellStart.assign(m_cellCount, 0);
+
+	if (m_isHashed)
+	{
+		m_cellKeys = std::make_unique<std::atomic<uint64_t>[]>(m_cellCount);
+		for (size_t i = 0; i < m_cellCount; ++i)
+		{
+			m_cellKeys[i].store(s_emptyCellKey, std::memory_order_relaxed);
+		}
+	}
+
+	const size_t chunkCount = getCellChunkCount();
+	m_chunkParticleCount.assign(chunkCount, 0);
+	m_chunkNonEmptyCellCount.assign(chunkCount, 0);
+}
+
+
+/*
+* Remove all the cloths and their particles from the grid
+* Must not be called while the grid is built or read
+*
+* @return void
+*/
+void SortedGridCollider::clearCloths()
+{
+	clearGrid();
+
+	m_clothOffsets.clear();
+	m_clothResY.clear();
+	m_clothPointers.clear();
+	m_slotParticles.clear();
+	m_slotCells.clear();
+	m_slotRanks.clear();
+	m_slotPositions.clear();
+	m_sortedParticles.clear();
+	m_sortedPositions.clear();
+	m_nonEmptyCells.clear();
+}
+
+
+/*
+* Give a slot to each particle of a cloth, its particles can be added to the grid from now on
+* Allocates, call it when the cloths change (not at each step). Must not be called while the grid is built or read.
+*
+* @param clothUid The uid of the cloth
+* @param resX Number of particles in the X direction
+* @param resY Number of particles in the Y direction
+* @param pCloth The cloth, returned by getCloth() for its particles
+* @return void
+*/
+void SortedGridCollider::registerCloth(const size_t clothUid, const int resX, const int resY, const Cloth* pCloth)
+{
+	if (clothUid >= m_clothOffsets.size())
+	{
+		m_clothOffsets.resize(clothUid + 1, s_unregisteredCloth);
+		m_clothResY.resize(clothUid + 1, 0);
+		m_clothPointers.resize(clothUid + 1, nullptr);
+	}
+	m_clothOffsets[clothUid] = m_slotParticles.size();
+	m_clothResY[clothUid] = resY;
+	m_clothPointers[clothUid] = pCloth;
+
+	for (int i = 0; i < resX; ++i)
+	{
+		for (int j = 0; j < resY; ++j)
+		{
+			GridParticle particle;
+			particle.m_clothUid = static_cast<uint32_t>(clothUid);
+			particle.m_i = i;
+			particle.m_j = j;
+			m_slotParticles.push_back(particle);
+		}
+	}
+
+	const size_t slotCount = m_slotParticles.size();
+	m_slotCells.resize(slotCount, s_invalidCell);
+	m_slotRanks.resize(slotCount, 0);
+	m_slotPositions.resize(slotCount);
+	m_sortedParticles.resize(slotCount);
+	m_sortedPositions.resize(slotCount);
+	m_nonEmptyCells.resize(slotCount, 0);
+
+	// A particle is in one cell at most: the table of the unbounded grid is kept at most half full
+	if (m_isHashed && 2 * slotCount > m_cellCount)
+	{
+		size_t cellCount = m_cellCount;
+		while (cellCount < 2 * slotCount)
+		{
+			cellCount *= 2;
+		}
+		allocateCells(cellCount);
+	}
+}
+
+
+/*
+* Get the coordinates of a cell from its index
+*
+* @param cell Index of the cell
+* @param x X coordinate of the cell
+* @param y Y coordinate of the cell
+* @param z Z coordinate of the cell
+* @return void
+*/
+void SortedGridCollider::getCellCoordsFromIndex(const size_t cell, int& x, int& y, int& z) const
+{
+	if (m_isHashed)
+	{
+		// Unpack the key of the cell
+		constexpr uint64_t mask = (uint64_t(1) << s_cellCoordBits) - 1;
+		const uint64_t key = m_cellKeys[cell].load(std::memory_order_relaxed);
+		x = static_cast<int>((key >> (2 * s_cellCoordBits)) & mask) - s_maxCellCoord;
+		y = static_cast<int>((key >> s_cellCoordBits) & mask) - s_maxCellCoord;
+		z = static_cast<int>(key & mask) - s_maxCellCoord;
+		return;
+	}
+
+	// Block of the cell, then the bits of its Z-order in the block
+	const size_t block = cell / s_blockCellCount;
+	const int blockCell = static_cast<int>(cell % s_blockCellCount);
+	x = (static_cast<int>(block % m_blockWidth) << s_blockBits) | (blockCell & 1) | ((blockCell >> 2) & 2);
+	y = (static_cast<int>((block / m_blockWidth) % m_blockWidth) << s_blockBits) | ((blockCell >> 1) & 1) | ((blockCell >> 3) & 2);
+	z = (static_cast<int>(block / m_blockLayerSize) << s_blockBits) | ((blockCell >> 2) & 1) | ((blockCell >> 4) & 2);
+}
+
+
+/*
+* Count a particle in the cell corresponding to its position, without lock
+* The particle is written in its cell by scatterParticles(). Ignored if its cloth is not registered.
+*
+* @param position Position of the particle
+* @param particleId Particle Id to add (cloth uid + index I + index J)
+* @return void
+*/
+void SortedGridCollider::addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId)
+{
+	const auto& [clothUid, i, j] = particleId;
+	if (clothUid >= m_clothOffsets.size() || m_clothOffsets[clothUid] == s_unregisteredCloth)
+	{
+		return;
+	}
+	const size_t slot = getParticleHandle(clothUid, i, j);
+
+	int x;
+	int y;
+	int z;
+
+	// Get the cell coordinates
+	getCellCoords(position, x, y, z);
+
+	// Out of the grid, no collision with the other particles
+	const size_t cell = m_isHashed ? insertCell(x, y, z) : (isCoordValid(x, y, z) ? getCellIndex(x, y, z) : s_invalidCell);
+	if (cell == s_invalidCell)
+	{
+		m_slotCells[slot] = s_invalidCell;
+		return;
+	}
+
+	// The particles of a cell are in the same rows of a cloth most of the time, the increments rarely collide
+	m_slotRanks[slot] = m_cellParticleCount[cell].fetch_add(1, std::memory_order_relaxed);
+	m_slotPositions[slot] = position;
+	m_slotCells[slot] = static_cast<uint32_t>(cell);
+}
+
+
+/*
+* Find the entry of a cell in the table of the unbounded grid, or take a free one, without lock
+* Two threads inserting the same cell agree on its entry: the first to write the key takes it.
+*
+* @param x X coordinate of the cell
+* @param y Y coordinate of the cell
+* @param z Z coordinate of the cell
+* @return size_t Index of the cell, s_invalidCell if the coordinates cannot be packed
+*/
+size_t SortedGridCollider::insertCell(const int x, const int y, const int z)
+{
+	if (!isPackable(x, y, z))
+	{
+		return s_invalidCell;
+	}
+
+	// Linear probing, there is always a free entry (see registerCloth())
+	const uint64_t key = packCellKey(x, y, z);
+	const size_t mask = m_cellCount - 1;
+	for (size_t cell = getHashedHomeCell(x, y, z);; cell = (cell + 1) & mask)
+	{
+		uint64_t cellKey = m_cellKeys[cell].load(std::memory_order_relaxed);
+		if (cellKey == s_emptyCellKey && m_cellKeys[cell].compare_exchange_strong(cellKey, key, std::memory_order_relaxed))
+		{
+			return cell;
+		}
+		if (cellKey == key)
+		{
+			return cell;
+		}
+	}
+}
+
+
+/*
+* The cells are not stored as GridCell, see getCellParticles()
+*
+* @return std::shared_ptr<GridCell> nullptr
+*/
+std::shared_ptr<GridCell> SortedGridCollider::getCell([[maybe_unused]] const int x, [[maybe_unused]] const int y, [[maybe_unused]] const int z)
+{
+	return nullptr;
+}
+
+
+/*
+* Count the particles and the non-empty cells of chunks of cells (first phase of the build)
+*
+* @param chunkFrom The first chunk of cells
+* @param chunkTo The chunk after the last one
+* @return void
+*/
+void SortedGridCollider::countCells(const size_t chunkFrom, const size_t chunkTo)
+{
+	for (size_t chunk = chunkFrom; chunk < std::min(chunkTo, getCellChunkCount()); ++chunk)
+	{
+		const size_t cellEnd = std::min((chunk + 1) * s_cellChunkSize, m_cellCount);
+		uint32_t particleCount = 0;
+		uint32_t nonEmptyCellCount = 0;
+		for (size_t cell = chunk * s_cellChunkSize; cell < cellEnd; ++cell)
+		{
+			const uint32_t count = m_cellParticleCount[cell].load(std::memory_order_relaxed);
+			particleCount += count;
+			nonEmptyCellCount += (count > 0) ? 1 : 0;
+		}
+		m_chunkParticleCount[chunk] = particleCount;
+		m_chunkNonEmptyCellCount[chunk] = nonEmptyCellCount;
+	}
+}
+
+
+/*
+* Turn the counts of the chunks into their offsets (second phase of the build, a single thread)
+* There are a few chunks only (s_cellChunkSize cells each).
+*
+* @return void
+*/
+void SortedGridCollider::scanCells()
+{
+	uint32_t particleOffset = 0;
+	uint32_t nonEmptyCellOffset = 0;
+	for (size_t chunk = 0; chunk < m_chunkParticleCount.size(); ++chunk)
+	{
+		const uint32_t particleCount = m_chunkParticleCount[chunk];
+		const uint32_t nonEmptyCellCount = m_chunkNonEmptyCellCount[chunk];
+		m_chunkParticleCount[chunk] = particleOffset;
+		m_chunkNonEmptyCellCount[chunk] = nonEmptyCellOffset;
+		particleOffset += particleCount;
+		nonEmptyCellOffset += nonEmptyCellCount;
+	}
+
+	m_particleCount = particleOffset;
+	m_nonEmptyCellCount = nonEmptyCellOffset;
+}
+
+
+/*
+* Compute where the cells of chunks of cells start, and list their non-empty cells (third phase of the build)
+*
+* @param chunkFrom The first chunk of cells
+* @param chunkTo The chunk after the last one
+* @return void
+*/
+void SortedGridCollider::writeCellStarts(const size_t chunkFrom, const size_t chunkTo)
+{
+	for (size_t chunk = chunkFrom; chunk < std::min(chunkTo, getCellChunkCount()); ++chunk)
+	{
+		const size_t cellEnd = std::min((chunk + 1) * s_cellChunkSize, m_cellCount);
+		uint32_t particleOffset = m_chunkParticleCount[chunk];
+		uint32_t nonEmptyCellOffset = m_chunkNonEmptyCellCount[chunk];
+		for (size_t cell = chunk * s_cellChunkSize; cell < cellEnd; ++cell)
+		{
+			const uint32_t count = m_cellParticleCount[cell].load(std::memory_order_relaxed);
+			if (count > 0)
+			{
+				m_cellStart[cell] = particleOffset;
+				m_nonEmptyCells[nonEmptyCellOffset++] = static_cast<uint32_t>(cell);
+				particleOffset += count;
+			}
+		}
+	}
+}
+
+
+/*
+* Write the particles of chunks of slots in their cells (last phase of the build)
+* The slots are emptied for the next build: a particle not added again is not in the next grid.
+*
+* @param chunkFrom The first chunk of slots
+* @param chunkTo The chunk after the last one
+* @return void
+*/
+void SortedGridCollider::scatterParticles(const size_t chunkFrom, const size_t chunkTo)
+{
+	const size_t slotCount = m_slotParticles.size();
+	for (size_t slot = chunkFrom * s_particleChunkSize; slot < std::min(chunkTo * s_particleChunkSize, slotCount); ++slot)
+	{
+		const uint32_t cell = m_slotCells[slot];
+		if (cell == s_invalidCell)
+		{
+			continue;
+		}
+		const size_t sortedIndex = m_cellStart[cell] + m_slotRanks[slot];
+		m_sortedParticles[sortedIndex] = static_cast<uint32_t>(slot);
+		m_sortedPositions[sortedIndex] = m_slotPositions[slot];
+		m_slotCells[slot] = s_invalidCell;
+	}
+}
+
+
+/*
+* Clear the counts of the non-empty cells in [indexFrom, indexTo[ of the list of non-empty cells
+* This function is called in parallel once the collisions are done.
+*
+* @param indexFrom The first non-empty cell
+* @param indexTo The non-empty cell after the last one
+* @return void
+*/
+void SortedGridCollider::clearGridParallelized(const size_t indexFrom, const size_t indexTo)
+{
+	for (size_t i = indexFrom; i < std::min(indexTo, m_nonEmptyCellCount); ++i)
+	{
+		m_cellParticleCount[m_nonEmptyCells[i]].store(0, std::memory_order_relaxed);
+	}
+
+	// Every entry of the table holds a non-empty cell: the table is empty again
+	if (m_isHashed)
+	{
+		for (size_t i = indexFrom; i < std::min(indexTo, m_nonEmptyCellCount); ++i)
+		{
+			m_cellKeys[m_nonEmptyCells[i]].store(s_emptyCellKey, std::memory_order_relaxed);
+		}
+	}
+}
+
+
+/*
+* Forget the non-empty cells, their counts must have been cleared by clearGridParallelized()
+* There is no grid to swap: the next step builds the grid again from its own positions.
+*
+* @return void
+*/
+void SortedGridCollider::swap()
+{
+	m_nonEmptyCellCount = 0;
+	m_particleCount = 0;
+}
+
+
+/*
+* Clear the counts of the non-empty cells and forget them
+*
+* @return void
+*/
+void SortedGridCollider::clearGrid()
+{
+	clearGridParallelized(0, m_nonEmptyCellCount);
+	swap();
+}
+
+
+/*
+* Get the memory size of the grid collider
+*
+* @return size_t Memory size
+*/
+size_t SortedGridCollider::getMemorySize()
+{
+	size_t memorySize = m_cellCount * (sizeof(std::atomic<uint32_t>) + sizeof(uint32_t));
+	memorySize += m_isHashed ? m_cellCount * sizeof(std::atomic<uint64_t>) : 0;
+	memorySize += (m_chunkParticleCount.size() + m_chunkNonEmptyCellCount.size()) * sizeof(uint32_t);
+	memorySize += (m_clothOffsets.size() * sizeof(size_t)) + (m_clothResY.size() * sizeof(int)) + (m_clothPointers.size() * sizeof(const Cloth*));
+	memorySize += m_slotParticles.size() * sizeof(GridParticle);
+	memorySize += (m_slotPositions.size() + m_sortedPositions.size()) * sizeof(Vec3R);
+	memorySize += (m_slotCells.size() + m_slotRanks.size() + m_sortedParticles.size() + m_nonEmptyCells.size()) * sizeof(uint32_t);
+
+	return memorySize;
+}
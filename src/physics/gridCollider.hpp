@@ -9,6 +9,14 @@
 #include <unordered_map>
 #include <mutex>
 #include <tuple>
+#include <atomic>
+#include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+
+
+class Cloth;
 
 
 class GridCell
@@ -37,6 +45,10 @@ public:
 class GridCollider
 {
 protected:
+	// The cell coordinates are clamped to this, far outside any grid: a diverged (huge or NaN) position never
+	// overflows an int, and the neighbors of its cell can still be computed
+	static constexpr int s_cellCoordLimit = 1 << 30;
+
 	// Size of the cells
 	double m_step;
 	std::mutex m_mutex;
@@ -45,11 +57,12 @@ public:
 	GridCollider(const double step) : m_step(step) {};
 	~GridCollider() {};
 
-	inline void getCellCoords(const Vec3& position, int& x, int& y, int& z) const;
+	inline void getCellCoords(const Vec3R& position, int& x, int& y, int& z) const;
+	inline double getCellSize() const { return m_step; };
 	virtual void clearGrid() = 0;
 	virtual void clearGridParallelized(const size_t indexFrom, const size_t indexTo) = 0;
 	virtual std::shared_ptr<GridCell> getCell(const int x, const int y, const int z) = 0;
-	virtual void addParticleToCell(const Vec3& position, const std::tuple<size_t, int, int>& particleId) = 0;
+	virtual void addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId) = 0;
 	virtual void swap() = 0;
 	virtual size_t getMemorySize() = 0;
 };
@@ -76,7 +89,7 @@ public:
 	inline bool isCoordValid(const int x, const int y, const int z) const;
 	inline size_t getCellIndex(const int x, const int y, const int z) const;
 	virtual std::shared_ptr<GridCell> getCell(const int x, const int y, const int z) override;
-	virtual void addParticleToCell(const Vec3& position, const std::tuple<size_t, int, int>& particleId) override;
+	virtual void addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId) override;
 	virtual void swap() override;
 	virtual size_t getMemorySize() override;
 	virtual void clearGridParallelized(const size_t indexFrom, const size_t indexTo) override;
@@ -98,11 +111,290 @@ public:
 
 	inline size_t hashKey(const int x, const int y, const int z) const;
 	virtual std::shared_ptr<GridCell> getCell(const int x, const int y, const int z) override;
-	virtual void addParticleToCell(const Vec3& position, const std::tuple<size_t, int, int>& particleId) override;
+	virtual void addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId) override;
 	virtual void swap() override;
 	virtual size_t getMemorySize() override;
 	virtual void clearGridParallelized(const size_t indexFrom, const size_t indexTo) override;
 
 private:
 	virtual void clearGrid() override;
-};
\ No newline at end of file
+};
+
+
+/*
+* A particle of a SortedGridCollider, given by its handle: cloth uid, index I, index J
+*/
+struct GridParticle
+{
+	uint32_t m_clothUid = 0;
+	int32_t m_i = 0;
+	int32_t m_j = 0;
+};
+
+
+/*
+* Class SortedGridCollider
+*
+* The grid of StaticGridCollider, built by a counting sort without lock nor allocation:
+* - addParticleToCell() computes the cell of a particle and counts it (an atomic increment gives its rank in the
+*   cell), in the slot of the particle: the cloths are registered first (registerCloth()), each one has a slot per particle;
+* - countCells(), scanCells() and writeCellStarts() compute where each cell starts in a flat array (parallel
+*   prefix sum over chunks of cells), and list the non-empty cells in the order of the grid;
+* - scatterParticles() writes each particle at the start of its cell plus its rank.
+* The particles of a cell are contiguous (getCellParticles()), with a copy of their positions (getCellPositions()):
+* the collisions read the positions in the order of the cells instead of jumping between the cloths.
+* The cells are numbered in Z-order (Morton) inside blocks of 4x4x4 cells, so the adjacent cells of a cell are
+* close in memory too.
+* A particle is a 32 bits handle: its slot in a global index space where each cloth owns a contiguous range
+* (cloth offset + i * resY + j). getParticle() and getCloth() resolve it without touching the shared pointers.
+* The build functions take chunks [chunkFrom, chunkTo[ so the threads can share them, a phase must be done by
+* all the threads before the next one starts.
+* Unlike StaticGridCollider, the grid is built from the positions of the step and read by the same step, there is
+* no second grid: clearGridParallelized() clears the counts of the non-empty cells once the collisions are done,
+* then swap() forgets the non-empty cells.
+* The cells are either a box of the world (dense, like StaticGridCollider), or unbounded: the cells are then the
+* entries of an open addressing table keyed by the packed coordinates of the cells, inserted without lock when a
+* particle is added. The table has twice as many entries as the registered particles, whatever their positions.
+* The blocks of cells are hashed, the cells of a block follow each other in the table.
+* findCell() gives the index of a cell in both cases.
+*/
+class SortedGridCollider : public GridCollider
+{
+public:
+	static constexpr uint32_t s_invalidCell = std::numeric_limits<uint32_t>::max();
+	static constexpr size_t s_cellChunkSize = 4096;
+	static constexpr size_t s_particleChunkSize = 1024;
+
+	// Cells of the unbounded grid: 21 bits per coordinate, around the origin
+	static constexpr uint64_t s_emptyCellKey = std::numeric_limits<uint64_t>::max();
+	static constexpr int s_cellCoordBits = 21;
+	static constexpr int s_maxCellCoord = (1 << (s_cellCoordBits - 1)) - 1;
+	static constexpr size_t s_minHashedCellCount = 1024;
+
+	// Blocks of 4x4x4 cells, numbered in Z-order inside a block
+	static constexpr int s_blockBits = 2;
+	static constexpr size_t s_blockCellCount = 64;
+
+private:
+	static constexpr size_t s_unregisteredCloth = std::numeric_limits<size_t>::max();
+
+	bool m_isHashed = false;
+
+	size_t m_gridWidth; // Left & right
+	size_t m_gridHeight; // Up
+	size_t m_blockWidth; // Blocks of cells along X and Y
+	size_t m_blockLayerSize; // optimization: m_blockWidth * m_blockWidth
+	size_t m_cellCount;
+
+	// Number of particles in each cell, and where the cell starts in m_sortedParticles
+	std::unique_ptr<std::atomic<uint32_t>[]> m_cellParticleCount;
+	std::vector<uint32_t> m_cellStart;
+
+	// Packed coordinates of the cells of the unbounded grid, s_emptyCellKey for the free entries
+	std::unique_ptr<std::atomic<uint64_t>[]> m_cellKeys;
+
+	// Particles and non-empty cells of each chunk of cells, then where the chunk starts once scanned
+	std::vector<uint32_t> m_chunkParticleCount;
+	std::vector<uint32_t> m_chunkNonEmptyCellCount;
+
+	// Slots of the particles, the cloths one after the other: the slot of a particle is its handle
+	std::vector<size_t> m_clothOffsets;
+	std::vector<int> m_clothResY;
+	std::vector<const Cloth*> m_clothPointers;
+	std::vector<GridParticle> m_slotParticles;
+	std::vector<uint32_t> m_slotCells;
+	std::vector<uint32_t> m_slotRanks;
+	std::vector<Vec3R> m_slotPositions;
+
+	// The sorted grid: handles of the particles and their positions, in the order of the cells
+	std::vector<uint32_t> m_sortedParticles;
+	std::vector<Vec3R> m_sortedPositions;
+	std::vector<uint32_t> m_nonEmptyCells;
+	size_t m_nonEmptyCellCount = 0;
+	size_t m_particleCount = 0;
+
+public:
+	SortedGridCollider(const double step, const size_t with, const size_t height);
+	explicit SortedGridCollider(const double step);
+	~SortedGridCollider() {};
+
+	void clearCloths();
+	void registerCloth(const size_t clothUid, const int resX, const int resY, const Cloth* pCloth = nullptr);
+
+	// Read by the collisions for the adjacent cells of each cell
+	inline bool isCoordValid(const int x, const int y, const int z) const
+	{
+		return x >= 0 && x < static_cast<int>(m_gridWidth) && y >= 0 && y < static_cast<int>(m_gridWidth) && z >= 0 && z < static_cast<int>(m_gridHeight);
+	};
+	inline size_t getCellIndex(const int x, const int y, const int z) const
+	{
+		const size_t block = static_cast<size_t>(x >> s_blockBits) + static_cast<size_t>(y >> s_blockBits) * m_blockWidth + static_cast<size_t>(z >> s_blockBits) * m_blockLayerSize;
+		return block * s_blockCellCount + getBlockCellIndex(x, y, z);
+	};
+
+	/*
+	* Get the Z-order (Morton code) of a cell inside its block of 4x4x4 cells: the bits of x, y and z interleaved
+	*
+	* @param x X coordinate of the cell
+	* @param y Y coordinate of the cell
+	* @param z Z coordinate of the cell
+	* @return size_t Index of the cell in its block, in [0, s_blockCellCount[
+	*/
+	static inline size_t getBlockCellIndex(const int x, const int y, const int z)
+	{
+		return static_cast<size_t>((x & 1) | ((y & 1) << 1) | ((z & 1) << 2) | ((x & 2) << 2) | ((y & 2) << 3) | ((z & 2) << 4));
+	};
+	void getCellCoordsFromIndex(const size_t cell, int& x, int& y, int& z) const;
+	inline bool isHashed() const { return m_isHashed; };
+
+	// The coordinates of a cell of the unbounded grid fit in a key (see packCellKey())
+	static inline bool isPackable(const int x, const int y, const int z)
+	{
+		return -s_maxCellCoord <= x && x <= s_maxCellCoord
+			&& -s_maxCellCoord <= y && y <= s_maxCellCoord
+			&& -s_maxCellCoord <= z && z <= s_maxCellCoord;
+	};
+
+	/*
+	* Pack the coordinates of a cell of the unbounded grid in a key
+	*
+	* @param x X coordinate of the cell, in [-s_maxCellCoord, s_maxCellCoord]
+	* @param y Y coordinate of the cell
+	* @param z Z coordinate of the cell
+	* @return uint64_t The key of the cell
+	*/
+	static inline uint64_t packCellKey(const int x, const int y, const int z)
+	{
+		constexpr uint64_t mask = (uint64_t(1) << s_cellCoordBits) - 1;
+		return ((static_cast<uint64_t>(x + s_maxCellCoord) & mask) << (2 * s_cellCoordBits))
+			| ((static_cast<uint64_t>(y + s_maxCellCoord) & mask) << s_cellCoordBits)
+			| (static_cast<uint64_t>(z + s_maxCellCoord) & mask);
+	};
+
+	/*
+	* Hash a key of a cell (finalizer of MurmurHash3): the neighbouring cells are spread over the table
+	*
+	* @param key The key of the cell
+	* @return uint64_t The hash of the key
+	*/
+	static inline uint64_t hashCellKey(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	};
+
+	/*
+	* Get the first entry of the table where a cell of the unbounded grid is looked for
+	* The blocks of cells are hashed, the cells of a block keep their Z-order.
+	*
+	* @param x X coordinate of the cell
+	* @param y Y coordinate of the cell
+	* @param z Z coordinate of the cell
+	* @return size_t The entry of the table
+	*/
+	inline size_t getHashedHomeCell(const int x, const int y, const int z) const
+	{
+		const uint64_t blockHash = hashCellKey(packCellKey(x >> s_blockBits, y >> s_blockBits, z >> s_blockBits));
+		return static_cast<size_t>(blockHash * s_blockCellCount + getBlockCellIndex(x, y, z)) & (m_cellCount - 1);
+	};
+
+	/*
+	* Get the index of a cell, to read its particles once the grid is built
+	*
+	* @param x X coordinate of the cell
+	* @param y Y coordinate of the cell
+	* @param z Z coordinate of the cell
+	* @return size_t Index of the cell, s_invalidCell if the cell is out of the grid or not in the table
+	*/
+	inline size_t findCell(const int x, const int y, const int z) const
+	{
+		if (!m_isHashed)
+		{
+			return isCoordValid(x, y, z) ? getCellIndex(x, y, z) : s_invalidCell;
+		}
+		if (!isPackable(x, y, z))
+		{
+			return s_invalidCell;
+		}
+
+		// Linear probing, the table is at most half full
+		const uint64_t key = packCellKey(x, y, z);
+		const size_t mask = m_cellCount - 1;
+		for (size_t cell = getHashedHomeCell(x, y, z);; cell = (cell + 1) & mask)
+		{
+			const uint64_t cellKey = m_cellKeys[cell].load(std::memory_order_relaxed);
+			if (cellKey == key)
+			{
+				return cell;
+			}
+			if (cellKey == s_emptyCellKey)
+			{
+				return s_invalidCell;
+			}
+		}
+	};
+
+	virtual std::shared_ptr<GridCell> getCell(const int x, const int y, const int z) override;
+	virtual void addParticleToCell(const Vec3R& position, const std::tuple<size_t, int, int>& particleId) override;
+	virtual void swap() override;
+	virtual size_t getMemorySize() override;
+	virtual void clearGridParallelized(const size_t indexFrom, const size_t indexTo) override;
+
+	inline size_t getCellChunkCount() const { return (m_cellCount + s_cellChunkSize - 1) / s_cellChunkSize; };
+	inline size_t getParticleChunkCount() const { return (m_slotParticles.size() + s_particleChunkSize - 1) / s_particleChunkSize; };
+	void countCells(const size_t chunkFrom, const size_t chunkTo);
+	void scanCells();
+	void writeCellStarts(const size_t chunkFrom, const size_t chunkTo);
+	void scatterParticles(const size_t chunkFrom, const size_t chunkTo);
+
+	inline size_t getNonEmptyCellCount() const { return m_nonEmptyCellCount; };
+	inline size_t getNonEmptyCell(const size_t index) const { return m_nonEmptyCells[index]; };
+	inline size_t getParticleCount() const { return m_particleCount; };
+
+	/*
+	* Get the particles of a cell of the sorted grid
+	*
+	* @param cell Index of the cell
+	* @param count Set to the number of particles of the cell
+	* @return const uint32_t* The handle of the first particle of the cell, the others follow it
+	*/
+	inline const uint32_t* getCellParticles(const size_t cell, size_t& count) const
+	{
+		count = m_cellParticleCount[cell].load(std::memory_order_relaxed);
+		return (count > 0) ? &m_sortedParticles[m_cellStart[cell]] : nullptr;
+	};
+
+	/*
+	* Get the positions of the particles of a cell of the sorted grid, in the order of getCellParticles()
+	* Copied when the particles are added to the grid: the positions at the end of the step.
+	*
+	* @param cell Index of a non-empty cell
+	* @return const Vec3R* The position of the first particle of the cell, the others follow it
+	*/
+	inline const Vec3R* getCellPositions(const size_t cell) const { return &m_sortedPositions[m_cellStart[cell]]; };
+
+	// Resolve the handle of a particle
+	inline const GridParticle& getParticle(const uint32_t handle) const { return m_slotParticles[handle]; };
+	inline uint32_t getParticleHandle(const size_t clothUid, const int i, const int j) const
+	{
+		return static_cast<uint32_t>(m_clothOffsets[clothUid] + static_cast<size_t>(i) * static_cast<size_t>(m_clothResY[clothUid]) + static_cast<size_t>(j));
+	};
+
+	/*
+	* Get the cloth of a particle, given to registerCloth()
+	* The cloths must outlive their registration (see clearCloths()).
+	*
+	* @param particle The particle
+	* @return const Cloth* The cloth of the particle
+	*/
+	inline const Cloth* getCloth(const GridParticle& particle) const { return m_clothPointers[particle.m_clothUid]; };
+
+private:
+	void allocateCells(const size_t cellCount);
+	size_t insertCell(const int x, const int y, const int z);
+	virtual void clearGrid() override;
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+
+// Includes from STL
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+
+/*
+* Stiffness falloff of the grid springs: a spring linking two particles at a (Chebyshev) distance
+* 'dist' on the grid has a stiffness of stiffness / (dist * Factor)
+*/
+template <int Factor>
+struct InverseDistanceFalloff
+{
+	static constexpr double scale(const int dist)
+	{
+		return 1.0 / (static_cast<double>(dist) * static_cast<double>(Factor));
+	}
+};
+
+
+/*
+* Class GridSpringStencil
+*
+* Storage free springs for grid cloths. Every particle is linked to all the particles of its
+* (2 * Radius + 1)^2 neighborhood, the springs are not stored: their force is computed directly
+* from the grid neighbors in the ClothParticleStore.
+* The stencil (offsets, falloff) is known at compile time, so the inner loop over the neighbors
+* has a constant trip count and can be fully unrolled and vectorized for the interior particles.
+* Only a few per offset values (rest length, stiffness, index offset) are stored, whatever the resolution.
+*/
+template <int Radius, typename Falloff>
+class GridSpringStencil
+{
+public:
+	static constexpr int s_width = 2 * Radius + 1;
+	static constexpr int s_size = s_width * s_width - 1;
+
+private:
+	struct Offset
+	{
+		int m_di;
+		int m_dj;
+	};
+
+	static constexpr std::array<Offset, s_size> makeOffsets()
+	{
+		std::array<Offset, s_size> offsets{};
+		int k = 0;
+		for (int di = -Radius; di <= Radius; ++di)
+		{
+			for (int dj = -Radius; dj <= Radius; ++dj)
+			{
+				if (di == 0 && dj == 0)
+				{
+					continue;
+				}
+				offsets[k] = { di, dj };
+				++k;
+			}
+		}
+		return offsets;
+	}
+
+	static constexpr std::array<double, s_size> makeFalloff()
+	{
+		std::array<double, s_size> falloff{};
+		constexpr std::array<Offset, s_size> offsets = makeOffsets();
+		for (int k = 0; k < s_size; ++k)
+		{
+			const int dist = std::max(offsets[k].m_di < 0 ? -offsets[k].m_di : offsets[k].m_di, offsets[k].m_dj < 0 ? -offsets[k].m_dj : offsets[k].m_dj);
+			falloff[k] = Falloff::scale(dist);
+		}
+		return falloff;
+	}
+
+	static constexpr std::array<Offset, s_size> s_offsets = makeOffsets();
+	static constexpr std::array<double, s_size> s_falloff = makeFalloff();
+
+	int m_resX = 0;
+	int m_resY = 0;
+	Real m_damping = 0;
+	std::array<std::ptrdiff_t, s_size> m_indexOffset{};
+	std::array<Real, s_size> m_restLength{};
+	std::array<Real, s_size> m_stiffness{};
+
+public:
+	GridSpringStencil() {};
+	~GridSpringStencil() {};
+
+	void init(const int resX, const int resY, const double spacingX, const double spacingY, const double stiffness, const double damping);
+	void accumulateForces(ClothParticleStore& store, const int rowFrom, const int rowTo) const;
+	Vec3R computeParticleForce(const ClothParticleStore& store, const int i, const int j) const;
+
+	// Per offset tables, used by the vectorized kernels
+	inline const std::array<std::ptrdiff_t, s_size>& getIndexOffsets() const { return m_indexOffset; };
+	inline const std::array<Real, s_size>& getRestLengths() const { return m_restLength; };
+	inline const std::array<Real, s_size>& getStiffnesses() const { return m_stiffness; };
+	inline Real getDamping() const { return m_damping; };
+	inline static constexpr int getRadius() { return Radius; };
+	inline static constexpr int getOffsetRow(const int k) { return s_offsets[k].m_di; };
+	inline static constexpr int getOffsetColumn(const int k) { return s_offsets[k].m_dj; };
+
+private:
+	template <bool CheckBounds>
+	inline Vec3R computeForce(const ClothParticleStore& store, const int i, const int j, const size_t index) const;
+};
+
+
+/*
+* Set the grid resolution and the springs parameters
+* The rest lengths are the distances between the particles of the flat grid
+*
+* @param resX Resolution of the cloth in the X direction
+* @param resY Resolution of the cloth in the Y direction
+* @param spacingX Distance between two particles in the X direction
+* @param spacingY Distance between two particles in the Y direction
+* @param stiffness Stiffness of the springs linking direct neighbors (before falloff)
+* @param damping Damping of the springs
+* @return void
+*/
+template <int Radius, typename Falloff>
+void GridSpringStencil<Radius, Falloff>::init(
+	const int resX, const int resY,
+	const double spacingX, const double spacingY,
+	const double stiffness, const double damping
+)
+{
+	m_resX = resX;
+	m_resY = resY;
+	m_damping = static_cast<Real>(damping);
+
+	for (int k = 0; k < s_size; ++k)
+	{
+		const double dx = static_cast<double>(s_offsets[k].m_di) * spacingX;
+		const double dy = static_cast<double>(s_offsets[k].m_dj) * spacingY;
+
+		m_indexOffset[k] = static_cast<std::ptrdiff_t>(s_offsets[k].m_di) * resY + s_offsets[k].m_dj;
+		m_restLength[k] = static_cast<Real>(std::sqrt(dx * dx + dy * dy));
+		m_stiffness[k] = static_cast<Real>(stiffness * s_falloff[k]);
+	}
+}
+
+
+/*
+* Compute the spring forces of the particles of the rows [rowFrom, rowTo[ and add them to their external forces
+* The forces are gathered from the previous positions and velocities of the neighbors,
+* so the batches of rows can be processed in parallel.
+*
+* @param store Particle store of the cloth
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+template <int Radius, typename Falloff>
+void GridSpringStencil<Radius, Falloff>::accumulateForces(ClothParticleStore& store, const int rowFrom, const int rowTo) const
+{
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		const bool isInteriorRow = (i >= Radius) && (i < m_resX - Radius);
+		const int jInteriorFrom = isInteriorRow ? std::min(Radius, m_resY) : m_resY;
+		const int jInteriorTo = isInteriorRow ? std::max(jInteriorFrom, m_resY - Radius) : m_resY;
+		const size_t rowIndex = store.getIndex(i, 0);
+
+		// Border particles, some neighbors are outside the grid
+		for (int j = 0; j < jInteriorFrom; ++j)
+		{
+			store.m_externalForces[rowIndex + j] += computeForce<true>(store, i, j, rowIndex + j);
+		}
+
+		// Interior particles, no bound checks
+		for (int j = jInteriorFrom; j < jInteriorTo; ++j)
+		{
+			store.m_externalForces[rowIndex + j] += computeForce<false>(store, i, j, rowIndex + j);
+		}
+
+		// Border particles
+		for (int j = jInteriorTo; j < m_resY; ++j)
+		{
+			store.m_externalForces[rowIndex + j] += computeForce<true>(store, i, j, rowIndex + j);
+		}
+	}
+}
+
+
+/*
+* Compute the sum of the spring forces applied to one particle by its neighbors
+* Works for any particle of the grid (border included)
+*
+* @param store Particle store of the cloth
+* @param i Row of the particle
+* @param j Column of the particle
+* @return Vec3R Sum of the spring forces
+*/
+template <int Radius, typename Falloff>
+Vec3R GridSpringStencil<Radius, Falloff>::computeParticleForce(const ClothParticleStore& store, const int i, const int j) const
+{
+	return computeForce<true>(store, i, j, store.getIndex(i, j));
+}
+
+
+/*
+* Compute the sum of the spring forces applied to one particle by its neighbors
+*
+* @param store Particle store of the cloth
+* @param i Row of the particle
+* @param j Column of the particle
+* @param index Index of the particle in the store
+* @return Vec3R Sum of the spring forces
+*/
+template <int Radius, typename Falloff>
+template <bool CheckBounds>
+inline Vec3R GridSpringStencil<Radius, Falloff>::computeForce(
+	const ClothParticleStore& store,
+	[[maybe_unused]] const int i,
+	[[maybe_unused]] const int j,
+	const size_t index
+) const
+{
+	const Vec3R& position = store.m_previousPosition[index];
+	const Vec3R& velocity = store.m_previousVelocity[index];
+
+	Vec3R force(0.0, 0.0, 0.0);
+	for (int k = 0; k < s_size; ++k)
+	{
+		if constexpr (CheckBounds)
+		{
+			const int ii = i + s_offsets[k].m_di;
+			const int jj = j + s_offsets[k].m_dj;
+			if (ii < 0 || ii >= m_resX || jj < 0 || jj >= m_resY)
+			{
+				continue;
+			}
+		}
+
+		const size_t neighborIndex = static_cast<size_t>(static_cast<std::ptrdiff_t>(index) + m_indexOffset[k]);
+
+		Vec3R springForce = store.m_previousPosition[neighborIndex] - position;
+		const Real length = springForce.norm();
+		springForce.normalize();
+
+		// damping force is use to reduce the oscillation of the spring
+		springForce *= m_stiffness[k] * (length - m_restLength[k]) - m_damping * (store.m_previousVelocity[neighborIndex] - velocity).dot(springForce);
+
+		force += springForce;
+	}
+
+	return force;
+}
+
+
+// Stencil of the grid cloths: 5x5 neighborhood, stiffness divided by (2 * distance)
+using ClothSpringStencil = GridSpringStencil<2, InverseDistanceFalloff<2>>;
@@ -0,0 +1,437 @@
+// Includes from project
+#include "implicitSolver.hpp"
+
+// Includes from STL
+#include <cmath>
+#include <algorithm>
+
+
+/*
+* Set the grid resolution and the springs of the system, and allocate the solver vectors
+*
+* @param resX Resolution of the cloth in the X direction
+* @param resY Resolution of the cloth in the Y direction
+* @param pStencil Springs of the cloth
+* @return void
+*/
+void ImplicitSolver::init(const int resX, const int resY, const ClothSpringStencil* pStencil)
+{
+	m_resX = resX;
+	m_resY = resY;
+	m_pStencil = pStencil;
+
+	const size_t count = static_cast<size_t>(resX) * static_cast<size_t>(resY);
+	for (AlignedVector<Vec3R>* pVector : { &m_deltaVelocity, &m_residual, &m_direction, &m_product, &m_preconditioned, &m_inverseDiagonal })
+	{
+		pVector->assign(count, Vec3R(0.0, 0.0, 0.0));
+	}
+	m_rowDot.assign(resX, 0.0);
+	m_rowNorm.assign(resX, 0.0);
+
+	m_isActive = false;
+	m_stats = ImplicitSolverStats();
+}
+
+
+/*
+* Release the memory of the solver vectors
+*
+* @return void
+*/
+void ImplicitSolver::release()
+{
+	for (AlignedVector<Vec3R>* pVector : { &m_deltaVelocity, &m_residual, &m_direction, &m_product, &m_preconditioned, &m_inverseDiagonal })
+	{
+		*pVector = AlignedVector<Vec3R>();
+	}
+	m_rowDot = std::vector<double>();
+	m_rowNorm = std::vector<double>();
+	m_pStencil = nullptr;
+}
+
+
+/*
+* Build the right hand side of the system and the preconditioner for the rows [rowFrom, rowTo[,
+* and initialize the conjugate gradient (dv = 0)
+* The forces are evaluated from the previous positions and velocities, the external forces are consumed
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ImplicitSolver::beginStep(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo)
+{
+	const Real realDt = static_cast<Real>(dt);
+	const Real dt2 = static_cast<Real>(dt * dt);
+	const Real airFriction = static_cast<Real>(store.m_airFriction);
+
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		double rowDot = 0.0;
+		double rowNorm = 0.0;
+
+		for (int j = 0; j < m_resY; ++j)
+		{
+			const size_t index = store.getIndex(i, j);
+
+			m_deltaVelocity[index] = Vec3R(0.0, 0.0, 0.0);
+
+			// Filtered out of the system
+			if (store.isFrozen(index))
+			{
+				m_residual[index] = Vec3R(0.0, 0.0, 0.0);
+				m_preconditioned[index] = Vec3R(0.0, 0.0, 0.0);
+				m_direction[index] = Vec3R(0.0, 0.0, 0.0);
+				m_inverseDiagonal[index] = Vec3R(0.0, 0.0, 0.0);
+				continue;
+			}
+
+			const Real mass = static_cast<Real>(1) / store.m_inverseMass[index];
+			const Vec3R& velocity = store.m_previousVelocity[index];
+
+			// Forces at the start of the step: gravity, air friction, external forces and springs
+			const Real velNorm = velocity.norm();
+			Vec3R forces = m_gravity * mass + velocity.getNormalized() * (-airFriction * velNorm * velNorm);
+			forces += store.m_externalForces[index];
+			store.m_externalForces[index] = Vec3R(0.0, 0.0, 0.0);
+			forces += m_pStencil->computeParticleForce(store, i, j);
+
+			// b = dt * (f0 + dt * K * v0)
+			const Vec3R rhs = forces * realDt + applyJacobians(store, store.m_previousVelocity, dt2, static_cast<Real>(0), i, j);
+
+			const Vec3R diagonal = computeDiagonal(store, dt2, realDt, i, j) + Vec3R(mass, mass, mass);
+			const Vec3R inverseDiagonal(static_cast<Real>(1) / diagonal.x, static_cast<Real>(1) / diagonal.y, static_cast<Real>(1) / diagonal.z);
+			const Vec3R preconditioned(rhs.x * inverseDiagonal.x, rhs.y * inverseDiagonal.y, rhs.z * inverseDiagonal.z);
+
+			m_residual[index] = rhs;
+			m_inverseDiagonal[index] = inverseDiagonal;
+			m_preconditioned[index] = preconditioned;
+			m_direction[index] = preconditioned;
+
+			rowDot += static_cast<double>(rhs.dot(preconditioned));
+			rowNorm += static_cast<double>(rhs.dot(rhs));
+		}
+
+		m_rowDot[i] = rowDot;
+		m_rowNorm[i] = rowNorm;
+	}
+}
+
+
+/*
+* Gather the dot products of beginStep() and check if the system needs to be solved at all
+* Single threaded, between the phases
+*
+* @return bool True if the conjugate gradient iterations must run
+*/
+bool ImplicitSolver::startIterations()
+{
+	m_rhsNorm2 = sumRows(m_rowNorm);
+	m_residualDotPreconditioned = sumRows(m_rowDot);
+
+	m_stats = ImplicitSolverStats();
+	m_stats.m_converged = (m_rhsNorm2 <= 0.0);
+	m_isActive = !m_stats.m_converged && m_maxIterations > 0;
+	if (!m_stats.m_converged && !m_isActive)
+	{
+		m_stats.m_relativeResidual = 1.0;
+	}
+
+	return m_isActive;
+}
+
+
+/*
+* Apply the system matrix to the search direction for the rows [rowFrom, rowTo[
+* Reads the direction of the neighbor rows, so all the batches must have finished updateDirection()
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ImplicitSolver::computeProduct(const ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo)
+{
+	const Real realDt = static_cast<Real>(dt);
+	const Real dt2 = static_cast<Real>(dt * dt);
+
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		double rowDot = 0.0;
+
+		for (int j = 0; j < m_resY; ++j)
+		{
+			const size_t index = store.getIndex(i, j);
+
+			if (store.isFrozen(index))
+			{
+				m_product[index] = Vec3R(0.0, 0.0, 0.0);
+				continue;
+			}
+
+			// A * p = M * p - (dt * D + dt^2 * K) * p
+			const Real mass = static_cast<Real>(1) / store.m_inverseMass[index];
+			const Vec3R product = m_direction[index] * mass - applyJacobians(store, m_direction, dt2, realDt, i, j);
+
+			m_product[index] = product;
+			rowDot += static_cast<double>(m_direction[index].dot(product));
+		}
+
+		m_rowDot[i] = rowDot;
+	}
+}
+
+
+/*
+* Compute the step length along the search direction from the dot products of computeProduct()
+* Single threaded, between the phases
+*
+* @return void
+*/
+void ImplicitSolver::computeStepLength()
+{
+	const double directionDotProduct = sumRows(m_rowDot);
+	m_alpha = (directionDotProduct > 0.0) ? m_residualDotPreconditioned / directionDotProduct : 0.0;
+}
+
+
+/*
+* Move the solution along the search direction and update the residual for the rows [rowFrom, rowTo[
+*
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ImplicitSolver::updateResidual(const int rowFrom, const int rowTo)
+{
+	const Real alpha = static_cast<Real>(m_alpha);
+
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		double rowDot = 0.0;
+		double rowNorm = 0.0;
+
+		const size_t indexFrom = static_cast<size_t>(i) * static_cast<size_t>(m_resY);
+		const size_t indexTo = indexFrom + static_cast<size_t>(m_resY);
+		for (size_t index = indexFrom; index < indexTo; ++index)
+		{
+			m_deltaVelocity[index] += m_direction[index] * alpha;
+
+			Vec3R& residual = m_residual[index];
+			residual -= m_product[index] * alpha;
+
+			const Vec3R& inverseDiagonal = m_inverseDiagonal[index];
+			const Vec3R preconditioned(residual.x * inverseDiagonal.x, residual.y * inverseDiagonal.y, residual.z * inverseDiagonal.z);
+			m_preconditioned[index] = preconditioned;
+
+			rowDot += static_cast<double>(residual.dot(preconditioned));
+			rowNorm += static_cast<double>(residual.dot(residual));
+		}
+
+		m_rowDot[i] = rowDot;
+		m_rowNorm[i] = rowNorm;
+	}
+}
+
+
+/*
+* Check the convergence from the dot products of updateResidual(), and prepare the next search direction
+* Single threaded, between the phases
+*
+* @return bool True if another iteration must run
+*/
+bool ImplicitSolver::finishIteration()
+{
+	const double residualNorm2 = sumRows(m_rowNorm);
+	const double residualDotPreconditioned = sumRows(m_rowDot);
+
+	m_stats.m_iterations++;
+	m_stats.m_relativeResidual = std::sqrt(residualNorm2 / m_rhsNorm2);
+	m_stats.m_converged = (m_stats.m_relativeResidual <= m_tolerance);
+
+	if (m_stats.m_converged || m_stats.m_iterations >= m_maxIterations || residualDotPreconditioned <= 0.0)
+	{
+		m_isActive = false;
+		return false;
+	}
+
+	m_beta = residualDotPreconditioned / m_residualDotPreconditioned;
+	m_residualDotPreconditioned = residualDotPreconditioned;
+
+	return true;
+}
+
+
+/*
+* Update the search direction of the rows [rowFrom, rowTo[
+*
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ImplicitSolver::updateDirection(const int rowFrom, const int rowTo)
+{
+	const Real beta = static_cast<Real>(m_beta);
+
+	const size_t indexFrom = static_cast<size_t>(rowFrom) * static_cast<size_t>(m_resY);
+	const size_t indexTo = static_cast<size_t>(rowTo) * static_cast<size_t>(m_resY);
+	for (size_t index = indexFrom; index < indexTo; ++index)
+	{
+		m_direction[index] = m_preconditioned[index] + m_direction[index] * beta;
+	}
+}
+
+
+/*
+* Apply the velocity change to the particles of the rows [rowFrom, rowTo[ and move them
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ImplicitSolver::endStep(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo)
+{
+	const Real realDt = static_cast<Real>(dt);
+
+	const size_t indexFrom = store.getIndex(rowFrom, 0);
+	const size_t indexTo = store.getIndex(rowTo, 0);
+	for (size_t index = indexFrom; index < indexTo; ++index)
+	{
+		// Do not update the particle if it is fixed or sleeping
+		if (store.isFrozen(index))
+		{
+			store.keepPreviousState(index);
+			continue;
+		}
+
+		store.m_velocity[index] = store.m_previousVelocity[index] + m_deltaVelocity[index];
+		store.m_position[index] = store.m_previousPosition[index] + store.m_velocity[index] * realDt;
+	}
+}
+
+
+/*
+* Apply the spring Jacobians of one particle to a vector: sum over the springs of (stiffnessScale * K_ij + dampingScale * D_ij) * (v_j - v_i)
+* The Jacobian blocks are built from the previous positions: along the spring the stiffness (and damping),
+* across it the stiffness scaled by (1 - restLength / length), clamped at 0 to keep the system positive definite
+*
+* @param store Particle store of the cloth
+* @param vector Vector to multiply, one value per particle
+* @param stiffnessScale Scale of the stiffness Jacobian
+* @param dampingScale Scale of the damping Jacobian
+* @param i Row of the particle
+* @param j Column of the particle
+* @return Vec3R The product for the particle (i, j)
+*/
+Vec3R ImplicitSolver::applyJacobians(
+	const ClothParticleStore& store,
+	const AlignedVector<Vec3R>& vector,
+	const Real stiffnessScale,
+	const Real dampingScale,
+	const int i, const int j
+) const
+{
+	const size_t index = store.getIndex(i, j);
+	const Vec3R& position = store.m_previousPosition[index];
+	const Vec3R& value = vector[index];
+	const Real damping = m_pStencil->getDamping();
+
+	Vec3R result(0.0, 0.0, 0.0);
+	for (int k = 0; k < ClothSpringStencil::s_size; ++k)
+	{
+		const int ii = i + ClothSpringStencil::getOffsetRow(k);
+		const int jj = j + ClothSpringStencil::getOffsetColumn(k);
+		if (ii < 0 || ii >= m_resX || jj < 0 || jj >= m_resY)
+		{
+			continue;
+		}
+
+		const size_t neighborIndex = store.getIndex(ii, jj);
+
+		Vec3R direction = store.m_previousPosition[neighborIndex] - position;
+		const Real length = direction.norm();
+		if (length <= 0)
+		{
+			continue;
+		}
+		direction /= length;
+
+		const Real stiffness = m_pStencil->getStiffnesses()[k];
+		const Real transverse = std::max(static_cast<Real>(0), static_cast<Real>(1) - m_pStencil->getRestLengths()[k] / length);
+
+		const Vec3R delta = vector[neighborIndex] - value;
+		const Vec3R along = direction * direction.dot(delta);
+
+		result += along * (stiffnessScale * stiffness + dampingScale * damping) + (delta - along) * (stiffnessScale * stiffness * transverse);
+	}
+
+	return result;
+}
+
+
+/*
+* Compute the diagonal of the Jacobians block of one particle: sum over the springs of the diagonal of (stiffnessScale * K_ij + dampingScale * D_ij)
+*
+* @param store Particle store of the cloth
+* @param stiffnessScale Scale of the stiffness Jacobian
+* @param dampingScale Scale of the damping Jacobian
+* @param i Row of the particle
+* @param j Column of the particle
+* @return Vec3R The diagonal of the block
+*/
+Vec3R ImplicitSolver::computeDiagonal(const ClothParticleStore& store, const Real stiffnessScale, const Real dampingScale, const int i, const int j) const
+{
+	const Vec3R& position = store.m_previousPosition[store.getIndex(i, j)];
+	const Real damping = m_pStencil->getDamping();
+
+	Vec3R diagonal(0.0, 0.0, 0.0);
+	for (int k = 0; k < ClothSpringStencil::s_size; ++k)
+	{
+		const int ii = i + ClothSpringStencil::getOffsetRow(k);
+		const int jj = j + ClothSpringStencil::getOffsetColumn(k);
+		if (ii < 0 || ii >= m_resX || jj < 0 || jj >= m_resY)
+		{
+			continue;
+		}
+
+		Vec3R direction = store.m_previousPosition[store.getIndex(ii, jj)] - position;
+		const Real length = direction.norm();
+		if (length <= 0)
+		{
+			continue;
+		}
+		direction /= length;
+
+		const Real stiffness = m_pStencil->getStiffnesses()[k];
+		const Real transverse = std::max(static_cast<Real>(0), static_cast<Real>(1) - m_pStencil->getRestLengths()[k] / length);
+		const Real alongScale = stiffnessScale * stiffness + dampingScale * damping;
+		const Real acrossScale = stiffnessScale * stiffness * transverse;
+
+		const Vec3R squared(direction.x * direction.x, direction.y * direction.y, direction.z * direction.z);
+		diagonal += squared * alongScale + (Vec3R(1.0, 1.0, 1.0) - squared) * acrossScale;
+	}
+
+	return diagonal;
+}
+
+
+/*
+* Sum the per row partial dot products, always in the same order whatever the batches
+*
+* @param rowValues One value per row
+* @return double The sum
+*/
+double ImplicitSolver::sumRows(const std::vector<double>& rowValues) const
+{
+	double sum = 0.0;
+	for (const double value : rowValues)
+	{
+		sum += value;
+	}
+	return sum;
+}
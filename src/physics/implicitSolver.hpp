@@ -0,0 +1,100 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/math/alignedAllocator.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+
+// Includes from STL
+#include <vector>
+
+
+/*
+* Statistics of the last linear solve of an ImplicitSolver
+*/
+struct ImplicitSolverStats
+{
+	int m_iterations = 0;
+	double m_relativeResidual = 0.0;
+	bool m_converged = true;
+};
+
+
+/*
+* Class ImplicitSolver
+*
+* Backward Euler integrator for grid cloths (Baraff & Witkin), linearized once per step:
+*     (M - dt * D - dt^2 * K) dv = dt * (f0 + dt * K * v0)
+* where K and D are the Jacobians of the stencil spring forces with respect to the positions and velocities.
+* The system is solved with a Jacobi preconditioned conjugate gradient. It is matrix free: the 3x3 spring
+* Jacobian blocks are assembled on the fly from the stencil topology when the matrix is applied.
+* The fixed and sleeping particles are filtered out of the system (their velocity change is 0).
+*
+* The solver works on batches of rows, so the orchestrator can split each phase between its workers.
+* The dot products are accumulated per row and summed by the single threaded steps between the phases:
+*     beginStep() -> startIterations() -> [computeProduct() -> computeStepLength() -> updateResidual()
+*     -> finishIteration() -> updateDirection()] while active -> endStep()
+*/
+class ImplicitSolver
+{
+public:
+	int m_maxIterations = 50;
+	double m_tolerance = 1e-4; // On the residual, relative to the right hand side
+	Vec3R m_gravity = Vec3R(0.0, -9.81, 0.0);
+
+private:
+	const ClothSpringStencil* m_pStencil = nullptr;
+	int m_resX = 0;
+	int m_resY = 0;
+
+	// Conjugate gradient vectors
+	AlignedVector<Vec3R> m_deltaVelocity;
+	AlignedVector<Vec3R> m_residual;
+	AlignedVector<Vec3R> m_direction;
+	AlignedVector<Vec3R> m_product;
+	AlignedVector<Vec3R> m_preconditioned;
+	AlignedVector<Vec3R> m_inverseDiagonal;
+
+	// Per row partial dot products, written by the batches owning the rows
+	std::vector<double> m_rowDot;
+	std::vector<double> m_rowNorm;
+
+	double m_rhsNorm2 = 0.0;
+	double m_residualDotPreconditioned = 0.0;
+	double m_alpha = 0.0;
+	double m_beta = 0.0;
+	bool m_isActive = false;
+
+	ImplicitSolverStats m_stats;
+
+public:
+	ImplicitSolver() {};
+	~ImplicitSolver() {};
+
+	void init(const int resX, const int resY, const ClothSpringStencil* pStencil);
+	void release();
+
+	void beginStep(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo);
+	bool startIterations();
+	void computeProduct(const ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo);
+	void computeStepLength();
+	void updateResidual(const int rowFrom, const int rowTo);
+	bool finishIteration();
+	void updateDirection(const int rowFrom, const int rowTo);
+	void endStep(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo);
+
+	inline bool isActive() const { return m_isActive; };
+	inline const ImplicitSolverStats& getStats() const { return m_stats; };
+
+private:
+	Vec3R applyJacobians(
+		const ClothParticleStore& store,
+		const AlignedVector<Vec3R>& vector,
+		const Real stiffnessScale,
+		const Real dampingScale,
+		const int i, const int j
+	) const;
+	Vec3R computeDiagonal(const ClothParticleStore& store, const Real stiffnessScale, const Real dampingScale, const int i, const int j) const;
+	double sumRows(const std::vector<double>& rowValues) const;
+};
@@ -6,83 +6,38 @@
 #include "../src/view/OpenGl/OpenGl3DWidget.hpp"
 #include "../src/physics/collider.hpp"
 #include "../src/physics/aabb.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/contactBuffer.hpp"
 
 // Includes from STL
 #include <vector>
 #include <memory>
 
-class Particle;
-
-/*
-* Spring class
-* 
-* This class is used to represent a spring in a physics simulation
-* 
-* The spring is used to link two particles together
-*/
-class Spring
-{
-private:
-	Particle* m_pParticle;
-	double m_restLength;
-	double m_stiffness;
-	double m_damping;
-
-public:
-	Spring(Particle* pParticle, const double restLength, const double stiffness, const double damping);
-	~Spring();
-
-	Vec3 computeForce(const Vec3& position, const Vec3& velocity) const;
-};
-
 
 /*
 * Particle class
 * 
 * This class is used to represent a particle in a physics simulation
 * 
-* The particle can be linked to other particles with springs
+* The particle is linked to other particles by the springs of its cloth (see SpringEdgeList)
+* Its simulation state (position, velocity, mass...) lives in the ClothParticleStore of its cloth,
+* at index m_storeIndex, and is integrated by ClothKernels. This class only keeps the data not needed
+* by the integration loop.
 */
 class Particle
 {
 public:
-	Vec3 m_position;
-	Vec3 m_previousPosition;
-	Vec3 m_velocity;
-	Vec3 m_previousVelocity;
-	Vec3 m_acceleration;
-	Vec3 m_externalForces;
-
-	double m_mass = 1.0;
-	double m_airFriction = 2.0;
-	double m_objectFriction = 1.0;
-	double m_groundFriction = 4.0;
-
 	int m_indexI = -1;
 	int m_indexJ = -1;
-
-	std::vector<Spring> m_springs;
-
-	std::shared_ptr<AABB> m_pAabb;
-
-	std::shared_ptr<ObjectRenderingInstance> m_debugSphere3DRenderer;
+	size_t m_storeIndex = 0;
 
 	size_t m_id;
 
-private:
-	bool isFixed = false;
-
 public:
-	Particle(Vec3 position, double mass);
+	Particle(const size_t storeIndex);
 	~Particle();
 
-	void update(const double dt, const std::vector<std::shared_ptr<Collider>>& colliders);
-	void setFixed(const bool fixState) { isFixed = fixState; };
-	void bounceOnCollision(const Vec3& normal, const double restitution);
-	static bool detectCollision(Particle& p1, Particle& p2);
+	static void bounceOnCollision(ClothParticleStore& store, const size_t index, const Vec3R& normal, const double restitution);
+	static bool detectCollision(const ClothParticleStore& store1, const size_t clothUid1, const size_t index1, const ClothParticleStore& store2, const size_t clothUid2, const size_t index2, ContactBuffer& contacts);
 	static void resolveElasticCollision(Particle& p1, Particle& p2, const double restitution);
-
-private:
-	Vec3 computeForces(const Vec3& gravity);
-	void computePFD(const Vec3& forces, const double dt);
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+
+
+/*
+* Parameters of the integration of a cloth over one time step, in the simulation precision
+*/
+struct ClothIntegrationParams
+{
+	Real m_dt = 0;
+	Vec3R m_gravity = Vec3R(0.0, -9.81, 0.0);
+	Real m_maxVelocity = 5;
+
+	// Springs gathered during the integration, nullptr if the spring forces are already in the external forces
+	const ClothSpringStencil* m_pStencil = nullptr;
+};
+
+
+/*
+* Class ClothKernels
+*
+* Integration of the particles of a cloth over one time step, for a batch of rows:
+* spring forces (stencil), air friction, external forces, gravity, velocity clamp and explicit Euler update.
+* The state is read from the previous positions / velocities and written to the current ones.
+*
+* The vectorized versions process 4 (AVX2) or 8 (AVX-512) consecutive particles of a row per iteration,
+* and fall back to the scalar version for the border of the grid and the fixed or sleeping particles.
+* integrateRows() dispatches to the best version supported by the CPU (see SimdDispatch).
+*/
+class ClothKernels
+{
+public:
+	ClothKernels() = delete;
+	~ClothKernels() = delete;
+
+	static void integrateRows(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo);
+
+	static void integrateRowsScalar(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo);
+	static void integrateRowsAvx2(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo);
+	static void integrateRowsAvx512(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo);
+
+	static void integrateParticle(ClothParticleStore& store, const ClothIntegrationParams& params, const int i, const int j);
+};
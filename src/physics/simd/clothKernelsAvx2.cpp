@@ -0,0 +1,176 @@
+// Includes from project
+#include "clothKernels.hpp"
+#include "simdTarget.hpp"
+#include "simdInterleave.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef CLOTH_SIMD_X86
+#include <immintrin.h>
+
+CLOTH_SIMD_TARGET_PUSH_AVX2
+
+/*
+* AVX2 traits of the vectorized kernels: 4 doubles per register
+*/
+struct Avx2Double
+{
+	using Scalar = double;
+	using Vector = __m256d;
+	using Mask = __m256d;
+	static constexpr int s_width = 4;
+
+	static inline Vector set1(const double value) { return _mm256_set1_pd(value); }
+	static inline Vector zero() { return _mm256_setzero_pd(); }
+	static inline Vector load(const double* p) { return _mm256_loadu_pd(p); }
+	static inline Vector add(const Vector a, const Vector b) { return _mm256_add_pd(a, b); }
+	static inline Vector sub(const Vector a, const Vector b) { return _mm256_sub_pd(a, b); }
+	static inline Vector mul(const Vector a, const Vector b) { return _mm256_mul_pd(a, b); }
+	static inline Vector div(const Vector a, const Vector b) { return _mm256_div_pd(a, b); }
+	static inline Vector sqrt(const Vector a) { return _mm256_sqrt_pd(a); }
+	static inline Vector fmadd(const Vector a, const Vector b, const Vector c) { return _mm256_fmadd_pd(a, b, c); }
+	static inline Vector fnmadd(const Vector a, const Vector b, const Vector c) { return _mm256_fnmadd_pd(a, b, c); }
+	static inline Mask greater(const Vector a, const Vector b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static inline Vector select(const Mask mask, const Vector a, const Vector b) { return _mm256_blendv_pd(b, a, mask); }
+
+	/*
+	* Load 4 interleaved Vec3 (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) as x, y, z registers
+	*/
+	static inline void load3(const double* p, Vector& x, Vector& y, Vector& z)
+	{
+		const Vector a = _mm256_loadu_pd(p);
+		const Vector b = _mm256_loadu_pd(p + 4);
+		const Vector c = _mm256_loadu_pd(p + 8);
+
+		const Vector xy02 = _mm256_blend_pd(a, b, 0b1100);         // x0 y0 x2 y2
+		const Vector zx02 = _mm256_permute2f128_pd(a, c, 0x21);    // z0 x1 z2 x3
+		const Vector yz13 = _mm256_blend_pd(b, c, 0b1100);         // y1 z1 y3 z3
+
+		x = _mm256_blend_pd(xy02, zx02, 0b1010);
+		y = _mm256_shuffle_pd(xy02, yz13, 0b0101);
+		z = _mm256_blend_pd(zx02, yz13, 0b1010);
+	}
+
+	/*
+	* Store x, y, z registers as 4 interleaved Vec3
+	*/
+	static inline void store3(double* p, const Vector x, const Vector y, const Vector z)
+	{
+		const Vector xy02 = _mm256_unpacklo_pd(x, y);              // x0 y0 x2 y2
+		const Vector zx02 = _mm256_blend_pd(z, x, 0b1010);         // z0 x1 z2 x3
+		const Vector yz13 = _mm256_unpackhi_pd(y, z);              // y1 z1 y3 z3
+
+		_mm256_storeu_pd(p, _mm256_permute2f128_pd(xy02, zx02, 0x20));
+		_mm256_storeu_pd(p + 4, _mm256_permute2f128_pd(yz13, xy02, 0x30));
+		_mm256_storeu_pd(p + 8, _mm256_permute2f128_pd(zx02, yz13, 0x31));
+	}
+};
+
+
+/*
+* AVX2 traits of the vectorized kernels: 8 floats per register
+*/
+struct Avx2Float
+{
+	using Scalar = float;
+	using Vector = __m256;
+	using Mask = __m256;
+	static constexpr int s_width = 8;
+
+	using Tables = InterleaveTables<8, int32_t>;
+	static constexpr Tables::Tables3x3 s_loadIndex = Tables::loadFrom(false);
+	static constexpr Tables::Tables3x3 s_loadMask = Tables::loadFrom(true);
+	static constexpr Tables::Tables3x3 s_storeIndex = Tables::storeFrom(false);
+	static constexpr Tables::Tables3x3 s_storeMask = Tables::storeFrom(true);
+
+	static inline Vector set1(const float value) { return _mm256_set1_ps(value); }
+	static inline Vector zero() { return _mm256_setzero_ps(); }
+	static inline Vector load(const float* p) { return _mm256_loadu_ps(p); }
+	static inline Vector add(const Vector a, const Vector b) { return _mm256_add_ps(a, b); }
+	static inline Vector sub(const Vector a, const Vector b) { return _mm256_sub_ps(a, b); }
+	static inline Vector mul(const Vector a, const Vector b) { return _mm256_mul_ps(a, b); }
+	static inline Vector div(const Vector a, const Vector b) { return _mm256_div_ps(a, b); }
+	static inline Vector sqrt(const Vector a) { return _mm256_sqrt_ps(a); }
+	static inline Vector fmadd(const Vector a, const Vector b, const Vector c) { return _mm256_fmadd_ps(a, b, c); }
+	static inline Vector fnmadd(const Vector a, const Vector b, const Vector c) { return _mm256_fnmadd_ps(a, b, c); }
+	static inline Mask greater(const Vector a, const Vector b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline Vector select(const Mask mask, const Vector a, const Vector b) { return _mm256_blendv_ps(b, a, mask); }
+
+	static inline Vector permute(const Vector v, const Tables::Table& index)
+	{
+		return _mm256_permutevar8x32_ps(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index.data())));
+	}
+
+	static inline Vector blend(const Vector a, const Vector b, const Tables::Table& mask)
+	{
+		return _mm256_blendv_ps(a, b, _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask.data()))));
+	}
+
+	// Merge the lanes of one component (or one output register) spread over three registers
+	static inline Vector merge(const Vector r0, const Vector r1, const Vector r2, const Tables::Tables3x3& index, const Tables::Tables3x3& mask, const int reg0, const int comp0, const int reg1, const int comp1, const int reg2, const int comp2)
+	{
+		Vector result = permute(r0, index[reg0][comp0]);
+		result = blend(result, permute(r1, index[reg1][comp1]), mask[reg1][comp1]);
+		return blend(result, permute(r2, index[reg2][comp2]), mask[reg2][comp2]);
+	}
+
+	/*
+	* Load 8 interleaved Vec3 as x, y, z registers
+	*/
+	static inline void load3(const float* p, Vector& x, Vector& y, Vector& z)
+	{
+		const Vector a = _mm256_loadu_ps(p);
+		const Vector b = _mm256_loadu_ps(p + 8);
+		const Vector c = _mm256_loadu_ps(p + 16);
+
+		x = merge(a, b, c, s_loadIndex, s_loadMask, 0, 0, 1, 0, 2, 0);
+		y = merge(a, b, c, s_loadIndex, s_loadMask, 0, 1, 1, 1, 2, 1);
+		z = merge(a, b, c, s_loadIndex, s_loadMask, 0, 2, 1, 2, 2, 2);
+	}
+
+	/*
+	* Store x, y, z registers as 8 interleaved Vec3
+	*/
+	static inline void store3(float* p, const Vector x, const Vector y, const Vector z)
+	{
+		_mm256_storeu_ps(p, merge(x, y, z, s_storeIndex, s_storeMask, 0, 0, 0, 1, 0, 2));
+		_mm256_storeu_ps(p + 8, merge(x, y, z, s_storeIndex, s_storeMask, 1, 0, 1, 1, 1, 2));
+		_mm256_storeu_ps(p + 16, merge(x, y, z, s_storeIndex, s_storeMask, 2, 0, 2, 1, 2, 2));
+	}
+};
+
+// Traits of the simulation precision
+using Avx2Real = std::conditional_t<std::is_same_v<Real, float>, Avx2Float, Avx2Double>;
+
+#include "clothKernelsSimd.hpp"
+
+
+/*
+* Integrate the rows [rowFrom, rowTo[ of a cloth, 4 (double) or 8 (float) particles at a time
+* Must only be called if the CPU supports AVX2 and FMA (see SimdDispatch)
+*
+* @param store Particle store of the cloth
+* @param params Integration parameters
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ClothKernels::integrateRowsAvx2(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	integrateRowsSimd<Avx2Real>(store, params, rowFrom, rowTo);
+}
+
+CLOTH_SIMD_TARGET_POP
+
+#else
+
+void ClothKernels::integrateRowsAvx2(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	integrateRowsScalar(store, params, rowFrom, rowTo);
+}
+
+#endif
@@ -0,0 +1,167 @@
+// Includes from project
+#include "clothKernels.hpp"
+#include "simdTarget.hpp"
+#include "simdInterleave.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef CLOTH_SIMD_X86
+#include <immintrin.h>
+
+CLOTH_SIMD_TARGET_PUSH_AVX512
+
+/*
+* AVX-512 traits of the vectorized kernels: 8 doubles per register, masks in the opmask registers
+*/
+struct Avx512Double
+{
+	using Scalar = double;
+	using Vector = __m512d;
+	using Mask = __mmask8;
+	static constexpr int s_width = 8;
+
+	using Tables = InterleaveTables<8, int64_t>;
+	static constexpr Tables::Tables s_loadLow = Tables::loadLow();
+	static constexpr Tables::Tables s_loadHigh = Tables::loadHigh();
+	static constexpr Tables::Tables s_storeLow = Tables::storeLow();
+	static constexpr Tables::Tables s_storeHigh = Tables::storeHigh();
+
+	static inline Vector set1(const double value) { return _mm512_set1_pd(value); }
+	static inline Vector zero() { return _mm512_setzero_pd(); }
+	static inline Vector load(const double* p) { return _mm512_loadu_pd(p); }
+	static inline Vector add(const Vector a, const Vector b) { return _mm512_add_pd(a, b); }
+	static inline Vector sub(const Vector a, const Vector b) { return _mm512_sub_pd(a, b); }
+	static inline Vector mul(const Vector a, const Vector b) { return _mm512_mul_pd(a, b); }
+	static inline Vector div(const Vector a, const Vector b) { return _mm512_div_pd(a, b); }
+	static inline Vector sqrt(const Vector a) { return _mm512_sqrt_pd(a); }
+	static inline Vector fmadd(const Vector a, const Vector b, const Vector c) { return _mm512_fmadd_pd(a, b, c); }
+	static inline Vector fnmadd(const Vector a, const Vector b, const Vector c) { return _mm512_fnmadd_pd(a, b, c); }
+	static inline Mask greater(const Vector a, const Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+	static inline Vector select(const Mask mask, const Vector a, const Vector b) { return _mm512_mask_blend_pd(mask, b, a); }
+
+	static inline Vector permute(const Vector a, const Tables::Table& index, const Vector b)
+	{
+		return _mm512_permutex2var_pd(a, _mm512_loadu_si512(index.data()), b);
+	}
+
+	/*
+	* Load 8 interleaved Vec3 as x, y, z registers
+	* The 24 doubles are loaded once, then deinterleaved with two-source permutes
+	*/
+	static inline void load3(const double* p, Vector& x, Vector& y, Vector& z)
+	{
+		const Vector a = _mm512_loadu_pd(p);
+		const Vector b = _mm512_loadu_pd(p + 8);
+		const Vector c = _mm512_loadu_pd(p + 16);
+
+		x = permute(permute(a, s_loadLow[0], b), s_loadHigh[0], c);
+		y = permute(permute(a, s_loadLow[1], b), s_loadHigh[1], c);
+		z = permute(permute(a, s_loadLow[2], b), s_loadHigh[2], c);
+	}
+
+	/*
+	* Store x, y, z registers as 8 interleaved Vec3
+	*/
+	static inline void store3(double* p, const Vector x, const Vector y, const Vector z)
+	{
+		_mm512_storeu_pd(p, permute(permute(x, s_storeLow[0], y), s_storeHigh[0], z));
+		_mm512_storeu_pd(p + 8, permute(permute(x, s_storeLow[1], y), s_storeHigh[1], z));
+		_mm512_storeu_pd(p + 16, permute(permute(x, s_storeLow[2], y), s_storeHigh[2], z));
+	}
+};
+
+
+/*
+* AVX-512 traits of the vectorized kernels: 16 floats per register
+*/
+struct Avx512Float
+{
+	using Scalar = float;
+	using Vector = __m512;
+	using Mask = __mmask16;
+	static constexpr int s_width = 16;
+
+	using Tables = InterleaveTables<16, int32_t>;
+	static constexpr Tables::Tables s_loadLow = Tables::loadLow();
+	static constexpr Tables::Tables s_loadHigh = Tables::loadHigh();
+	static constexpr Tables::Tables s_storeLow = Tables::storeLow();
+	static constexpr Tables::Tables s_storeHigh = Tables::storeHigh();
+
+	static inline Vector set1(const float value) { return _mm512_set1_ps(value); }
+	static inline Vector zero() { return _mm512_setzero_ps(); }
+	static inline Vector load(const float* p) { return _mm512_loadu_ps(p); }
+	static inline Vector add(const Vector a, const Vector b) { return _mm512_add_ps(a, b); }
+	static inline Vector sub(const Vector a, const Vector b) { return _mm512_sub_ps(a, b); }
+	static inline Vector mul(const Vector a, const Vector b) { return _mm512_mul_ps(a, b); }
+	static inline Vector div(const Vector a, const Vector b) { return _mm512_div_ps(a, b); }
+	static inline Vector sqrt(const Vector a) { return _mm512_sqrt_ps(a); }
+	static inline Vector fmadd(const Vector a, const Vector b, const Vector c) { return _mm512_fmadd_ps(a, b, c); }
+	static inline Vector fnmadd(const Vector a, const Vector b, const Vector c) { return _mm512_fnmadd_ps(a, b, c); }
+	static inline Mask greater(const Vector a, const Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static inline Vector select(const Mask mask, const Vector a, const Vector b) { return _mm512_mask_blend_ps(mask, b, a); }
+
+	static inline Vector permute(const Vector a, const Tables::Table& index, const Vector b)
+	{
+		return _mm512_permutex2var_ps(a, _mm512_loadu_si512(index.data()), b);
+	}
+
+	/*
+	* Load 16 interleaved Vec3 as x, y, z registers
+	*/
+	static inline void load3(const float* p, Vector& x, Vector& y, Vector& z)
+	{
+		const Vector a = _mm512_loadu_ps(p);
+		const Vector b = _mm512_loadu_ps(p + 16);
+		const Vector c = _mm512_loadu_ps(p + 32);
+
+		x = permute(permute(a, s_loadLow[0], b), s_loadHigh[0], c);
+		y = permute(permute(a, s_loadLow[1], b), s_loadHigh[1], c);
+		z = permute(permute(a, s_loadLow[2], b), s_loadHigh[2], c);
+	}
+
+	/*
+	* Store x, y, z registers as 16 interleaved Vec3
+	*/
+	static inline void store3(float* p, const Vector x, const Vector y, const Vector z)
+	{
+		_mm512_storeu_ps(p, permute(permute(x, s_storeLow[0], y), s_storeHigh[0], z));
+		_mm512_storeu_ps(p + 16, permute(permute(x, s_storeLow[1], y), s_storeHigh[1], z));
+		_mm512_storeu_ps(p + 32, permute(permute(x, s_storeLow[2], y), s_storeHigh[2], z));
+	}
+};
+
+// Traits of the simulation precision
+using Avx512Real = std::conditional_t<std::is_same_v<Real, float>, Avx512Float, Avx512Double>;
+
+#include "clothKernelsSimd.hpp"
+
+
+/*
+* Integrate the rows [rowFrom, rowTo[ of a cloth, 8 (double) or 16 (float) particles at a time
+* Must only be called if the CPU supports AVX-512F (see SimdDispatch)
+*
+* @param store Particle store of the cloth
+* @param params Integration parameters
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ClothKernels::integrateRowsAvx512(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	integrateRowsSimd<Avx512Real>(store, params, rowFrom, rowTo);
+}
+
+CLOTH_SIMD_TARGET_POP
+
+#else
+
+void ClothKernels::integrateRowsAvx512(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	integrateRowsScalar(store, params, rowFrom, rowTo);
+}
+
+#endif
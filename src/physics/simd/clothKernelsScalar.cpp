@@ -0,0 +1,103 @@
+// Includes from project
+#include "clothKernels.hpp"
+#include "simdDispatch.hpp"
+
+
+/*
+* Integrate the rows [rowFrom, rowTo[ of a cloth with the best kernel supported by the CPU
+*
+* @param store Particle store of the cloth
+* @param params Integration parameters
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ClothKernels::integrateRows(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	switch (SimdDispatch::getActiveIsa())
+	{
+	case SimdIsa::Avx512:
+		integrateRowsAvx512(store, params, rowFrom, rowTo);
+		break;
+	case SimdIsa::Avx2:
+		integrateRowsAvx2(store, params, rowFrom, rowTo);
+		break;
+	default:
+		integrateRowsScalar(store, params, rowFrom, rowTo);
+		break;
+	}
+}
+
+
+/*
+* Integrate the rows [rowFrom, rowTo[ of a cloth, one particle at a time
+* Reference version of the vectorized kernels
+*
+* @param store Particle store of the cloth
+* @param params Integration parameters
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void ClothKernels::integrateRowsScalar(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	const int resY = store.getResY();
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		for (int j = 0; j < resY; ++j)
+		{
+			integrateParticle(store, params, i, j);
+		}
+	}
+}
+
+
+/*
+* Integrate one particle over a time step
+*
+* @param store Particle store of the cloth
+* @param params Integration parameters
+* @param i Row of the particle
+* @param j Column of the particle
+* @return void
+*/
+void ClothKernels::integrateParticle(ClothParticleStore& store, const ClothIntegrationParams& params, const int i, const int j)
+{
+	const size_t index = store.getIndex(i, j);
+
+	// Do not update the particle if it is fixed or sleeping
+	if (store.isFrozen(index))
+	{
+		store.keepPreviousState(index);
+		return;
+	}
+
+	const Vec3R& previousVelocity = store.m_previousVelocity[index];
+
+	// Air friction
+	Real velNorm = previousVelocity.norm();
+	Vec3R forces = previousVelocity.getNormalized() * (-static_cast<Real>(store.m_airFriction) * velNorm * velNorm);
+
+	// External forces (including the scattered spring forces) and stencil springs
+	forces += store.m_externalForces[index];
+	store.m_externalForces[index] = Vec3R(0.0, 0.0, 0.0);
+	if (params.m_pStencil)
+	{
+		forces += params.m_pStencil->computeParticleForce(store, i, j);
+	}
+
+	// Gravity does not depend on the mass
+	const Vec3R acceleration = params.m_gravity + forces * store.m_inverseMass[index];
+
+	// Update velocity using the new acceleration
+	Vec3R& velocity = store.m_velocity[index];
+	velocity = previousVelocity + acceleration * params.m_dt;
+	Real normVel = velocity.norm();
+	if (normVel > params.m_maxVelocity)
+	{
+		velocity *= params.m_maxVelocity / normVel;
+	}
+
+	// Update position using the new velocity (semi-implicit Euler)
+	store.m_position[index] = store.m_previousPosition[index] + velocity * params.m_dt;
+}
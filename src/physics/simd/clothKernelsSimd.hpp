@@ -0,0 +1,201 @@
+#pragma once
+
+/*
+* Vectorized cloth integration, shared by the AVX2 and AVX-512 kernels
+*
+* Must be included between CLOTH_SIMD_TARGET_PUSH_xxx and CLOTH_SIMD_TARGET_POP (see simdTarget.hpp),
+* after the definition of the Simd traits of the instruction set:
+*	Scalar, Vector, Mask, s_width, set1, zero, load, add, sub, mul, div, sqrt, fmadd (a * b + c),
+*	fnmadd (c - a * b), greater, select (mask ? a : b), load3 / store3 (s_width interleaved Vec3 <-> x, y, z)
+*/
+
+// Includes from project
+#include "clothKernels.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+
+static_assert(sizeof(Vec3R) == 3 * sizeof(Real), "Vec3R must be three packed scalars");
+
+
+/*
+* Integrate Simd::s_width consecutive particles, starting at the index 'index' in the store
+* None of them is fixed or sleeping, and all their stencil neighbors are inside the grid
+*/
+template <typename Simd>
+static inline void integrateChunk(
+	const typename Simd::Scalar* pPreviousPosition,
+	const typename Simd::Scalar* pPreviousVelocity,
+	typename Simd::Scalar* pPosition,
+	typename Simd::Scalar* pVelocity,
+	typename Simd::Scalar* pExternalForces,
+	const typename Simd::Scalar* pInverseMass,
+	const size_t index,
+	const ClothIntegrationParams& params,
+	const typename Simd::Scalar airFriction
+)
+{
+	using Vector = typename Simd::Vector;
+	using Mask = typename Simd::Mask;
+
+	const Vector zero = Simd::zero();
+	const Vector one = Simd::set1(1);
+
+	Vector posX, posY, posZ;
+	Simd::load3(pPreviousPosition + 3 * index, posX, posY, posZ);
+	Vector velX, velY, velZ;
+	Simd::load3(pPreviousVelocity + 3 * index, velX, velY, velZ);
+
+	// External forces (including the scattered spring forces), reset for the next step
+	Vector forceX, forceY, forceZ;
+	Simd::load3(pExternalForces + 3 * index, forceX, forceY, forceZ);
+	Simd::store3(pExternalForces + 3 * index, zero, zero, zero);
+
+	// Stencil springs
+	if (params.m_pStencil)
+	{
+		const auto& indexOffsets = params.m_pStencil->getIndexOffsets();
+		const auto& restLengths = params.m_pStencil->getRestLengths();
+		const auto& stiffnesses = params.m_pStencil->getStiffnesses();
+		const Vector damping = Simd::set1(params.m_pStencil->getDamping());
+
+		for (int k = 0; k < ClothSpringStencil::s_size; ++k)
+		{
+			const size_t neighborIndex = static_cast<size_t>(static_cast<std::ptrdiff_t>(index) + indexOffsets[k]);
+
+			Vector dirX, dirY, dirZ;
+			Simd::load3(pPreviousPosition + 3 * neighborIndex, dirX, dirY, dirZ);
+			dirX = Simd::sub(dirX, posX);
+			dirY = Simd::sub(dirY, posY);
+			dirZ = Simd::sub(dirZ, posZ);
+
+			const Vector length = Simd::sqrt(Simd::fmadd(dirX, dirX, Simd::fmadd(dirY, dirY, Simd::mul(dirZ, dirZ))));
+			const Mask isNotNull = Simd::greater(length, zero);
+			const Vector invLength = Simd::select(isNotNull, Simd::div(one, length), zero);
+			dirX = Simd::mul(dirX, invLength);
+			dirY = Simd::mul(dirY, invLength);
+			dirZ = Simd::mul(dirZ, invLength);
+
+			Vector relVelX, relVelY, relVelZ;
+			Simd::load3(pPreviousVelocity + 3 * neighborIndex, relVelX, relVelY, relVelZ);
+			relVelX = Simd::sub(relVelX, velX);
+			relVelY = Simd::sub(relVelY, velY);
+			relVelZ = Simd::sub(relVelZ, velZ);
+			const Vector relVelAlongDir = Simd::fmadd(relVelX, dirX, Simd::fmadd(relVelY, dirY, Simd::mul(relVelZ, dirZ)));
+
+			// stiffness * (length - restLength) - damping * relVel.dir
+			const Vector magnitude = Simd::fnmadd(damping, relVelAlongDir,
+				Simd::mul(Simd::set1(stiffnesses[k]), Simd::sub(length, Simd::set1(restLengths[k]))));
+
+			forceX = Simd::fmadd(dirX, magnitude, forceX);
+			forceY = Simd::fmadd(dirY, magnitude, forceY);
+			forceZ = Simd::fmadd(dirZ, magnitude, forceZ);
+		}
+	}
+
+	// Air friction: -normalized(v) * airFriction * |v|^2 = -v * airFriction * |v|
+	const Vector velNorm = Simd::sqrt(Simd::fmadd(velX, velX, Simd::fmadd(velY, velY, Simd::mul(velZ, velZ))));
+	const Vector airScale = Simd::mul(Simd::set1(airFriction), velNorm);
+	forceX = Simd::fnmadd(velX, airScale, forceX);
+	forceY = Simd::fnmadd(velY, airScale, forceY);
+	forceZ = Simd::fnmadd(velZ, airScale, forceZ);
+
+	// Acceleration, gravity does not depend on the mass
+	const Vector inverseMass = Simd::load(pInverseMass + index);
+	const Vector dt = Simd::set1(params.m_dt);
+
+	Vector newVelX, newVelY, newVelZ;
+	newVelX = Simd::fmadd(Simd::fmadd(forceX, inverseMass, Simd::set1(params.m_gravity.x)), dt, velX);
+	newVelY = Simd::fmadd(Simd::fmadd(forceY, inverseMass, Simd::set1(params.m_gravity.y)), dt, velY);
+	newVelZ = Simd::fmadd(Simd::fmadd(forceZ, inverseMass, Simd::set1(params.m_gravity.z)), dt, velZ);
+
+	// Velocity clamp
+	const Vector maxVelocity = Simd::set1(params.m_maxVelocity);
+	const Vector newVelNorm = Simd::sqrt(Simd::fmadd(newVelX, newVelX, Simd::fmadd(newVelY, newVelY, Simd::mul(newVelZ, newVelZ))));
+	const Vector clampScale = Simd::select(Simd::greater(newVelNorm, maxVelocity), Simd::div(maxVelocity, newVelNorm), one);
+	newVelX = Simd::mul(newVelX, clampScale);
+	newVelY = Simd::mul(newVelY, clampScale);
+	newVelZ = Simd::mul(newVelZ, clampScale);
+	Simd::store3(pVelocity + 3 * index, newVelX, newVelY, newVelZ);
+
+	// Position, using the new velocity (semi-implicit Euler)
+	Vector newPosX, newPosY, newPosZ;
+	newPosX = Simd::fmadd(newVelX, dt, posX);
+	newPosY = Simd::fmadd(newVelY, dt, posY);
+	newPosZ = Simd::fmadd(newVelZ, dt, posZ);
+	Simd::store3(pPosition + 3 * index, newPosX, newPosY, newPosZ);
+}
+
+
+/*
+* Integrate the rows [rowFrom, rowTo[ of a cloth, Simd::s_width particles at a time
+* The particles whose stencil crosses the border of the grid, and the chunks containing a fixed or sleeping particle,
+* go through the scalar kernel.
+*/
+template <typename Simd>
+static void integrateRowsSimd(ClothParticleStore& store, const ClothIntegrationParams& params, const int rowFrom, const int rowTo)
+{
+	using Scalar = typename Simd::Scalar;
+	static_assert(std::is_same_v<Scalar, Real>, "The traits must match the simulation precision");
+
+	constexpr int width = Simd::s_width;
+
+	const int resX = store.getResX();
+	const int resY = store.getResY();
+	const int radius = params.m_pStencil ? ClothSpringStencil::getRadius() : 0;
+
+	const Scalar* pPreviousPosition = reinterpret_cast<const Scalar*>(store.m_previousPosition.data());
+	const Scalar* pPreviousVelocity = reinterpret_cast<const Scalar*>(store.m_previousVelocity.data());
+	Scalar* pPosition = reinterpret_cast<Scalar*>(store.m_position.data());
+	Scalar* pVelocity = reinterpret_cast<Scalar*>(store.m_velocity.data());
+	Scalar* pExternalForces = reinterpret_cast<Scalar*>(store.m_externalForces.data());
+	const Scalar* pInverseMass = store.m_inverseMass.data();
+	const uint8_t* pFlags = store.m_flags.data();
+
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		const bool isInteriorRow = (i >= radius) && (i < resX - radius);
+		const int jInteriorFrom = isInteriorRow ? std::min(radius, resY) : resY;
+		const int jInteriorTo = isInteriorRow ? std::max(jInteriorFrom, resY - radius) : resY;
+		const size_t rowIndex = store.getIndex(i, 0);
+
+		int j = 0;
+		for (; j < jInteriorFrom; ++j)
+		{
+			ClothKernels::integrateParticle(store, params, i, j);
+		}
+
+		for (; j + width <= jInteriorTo; j += width)
+		{
+			const size_t index = rowIndex + j;
+
+			uint8_t flags = 0;
+			for (int k = 0; k < width; ++k)
+			{
+				flags |= pFlags[index + k];
+			}
+
+			if (flags & PARTICLE_FLAGS_FROZEN)
+			{
+				for (int k = 0; k < width; ++k)
+				{
+					ClothKernels::integrateParticle(store, params, i, j + k);
+				}
+				continue;
+			}
+
+			integrateChunk<Simd>(
+				pPreviousPosition, pPreviousVelocity, pPosition, pVelocity,
+				pExternalForces, pInverseMass, index, params, static_cast<Scalar>(store.m_airFriction)
+			);
+		}
+
+		for (; j < resY; ++j)
+		{
+			ClothKernels::integrateParticle(store, params, i, j);
+		}
+	}
+}
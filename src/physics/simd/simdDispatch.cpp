@@ -0,0 +1,186 @@
+// Includes from project
+#include "simdDispatch.hpp"
+#include "simdTarget.hpp"
+
+// Includes from STL
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#ifdef CLOTH_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+// -1: not selected yet
+std::atomic<int> SimdDispatch::s_activeIsa(-1);
+
+
+#ifdef CLOTH_SIMD_X86
+static void cpuid(const unsigned int leaf, const unsigned int subLeaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+	for (int k = 0; k < 4; ++k)
+	{
+		regs[k] = static_cast<unsigned int>(info[k]);
+	}
+#else
+	__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax = 0;
+	unsigned int edx = 0;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+
+/*
+* Detect the best instruction set supported by both the CPU and the OS
+* AVX2 requires FMA too, AVX-512 only needs the foundation (AVX512F) instructions
+*
+* @return SimdIsa The best supported instruction set
+*/
+SimdIsa SimdDispatch::detectSupportedIsa()
+{
+#ifdef CLOTH_SIMD_X86
+	unsigned int regs[4] = { 0, 0, 0, 0 };
+	cpuid(0, 0, regs);
+	const unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 7)
+	{
+		return SimdIsa::Scalar;
+	}
+
+	cpuid(1, 0, regs);
+	const bool hasFma = (regs[2] & (1u << 12)) != 0;
+	const bool hasOsxsave = (regs[2] & (1u << 27)) != 0;
+	const bool hasAvx = (regs[2] & (1u << 28)) != 0;
+	if (!hasOsxsave || !hasAvx || !hasFma)
+	{
+		return SimdIsa::Scalar;
+	}
+
+	// The OS must save the YMM (and ZMM / opmask) registers on context switches
+	const uint64_t xcr0 = xgetbv();
+	const bool osSavesYmm = (xcr0 & 0x6) == 0x6;
+	const bool osSavesZmm = (xcr0 & 0xE6) == 0xE6;
+
+	cpuid(7, 0, regs);
+	const bool hasAvx2 = (regs[1] & (1u << 5)) != 0;
+	const bool hasAvx512f = (regs[1] & (1u << 16)) != 0;
+
+	if (hasAvx512f && osSavesZmm)
+	{
+		return SimdIsa::Avx512;
+	}
+	if (hasAvx2 && osSavesYmm)
+	{
+		return SimdIsa::Avx2;
+	}
+#endif
+
+	return SimdIsa::Scalar;
+}
+
+
+/*
+* Select the instruction set used by the kernels: the supported one,
+* or the one asked in the CLOTH_SIMD environment variable if it is supported
+*
+* @return SimdIsa The instruction set to use
+*/
+SimdIsa SimdDispatch::selectIsa()
+{
+	const SimdIsa supported = detectSupportedIsa();
+
+	const char* pRequested = std::getenv("CLOTH_SIMD");
+	if (pRequested == nullptr)
+	{
+		return supported;
+	}
+
+	SimdIsa requested = supported;
+	if (std::strcmp(pRequested, "scalar") == 0)
+	{
+		requested = SimdIsa::Scalar;
+	}
+	else if (std::strcmp(pRequested, "avx2") == 0)
+	{
+		requested = SimdIsa::Avx2;
+	}
+	else if (std::strcmp(pRequested, "avx512") == 0)
+	{
+		requested = SimdIsa::Avx512;
+	}
+
+	// Never go above what the CPU supports
+	return static_cast<int>(requested) < static_cast<int>(supported) ? requested : supported;
+}
+
+
+/*
+* Get the instruction set used by the kernels, selected on the first call
+*
+* @return SimdIsa The active instruction set
+*/
+SimdIsa SimdDispatch::getActiveIsa()
+{
+	int isa = s_activeIsa.load(std::memory_order_relaxed);
+	if (isa < 0)
+	{
+		// Several threads may select it at the same time, they all get the same result
+		isa = static_cast<int>(selectIsa());
+		s_activeIsa.store(isa, std::memory_order_relaxed);
+	}
+	return static_cast<SimdIsa>(isa);
+}
+
+
+/*
+* Force the instruction set used by the kernels (clamped to the supported one)
+*
+* @param isa The instruction set to use
+* @return void
+*/
+void SimdDispatch::setActiveIsa(const SimdIsa isa)
+{
+	const SimdIsa supported = detectSupportedIsa();
+	const SimdIsa active = static_cast<int>(isa) < static_cast<int>(supported) ? isa : supported;
+	s_activeIsa.store(static_cast<int>(active), std::memory_order_relaxed);
+}
+
+
+/*
+* Get a printable name of an instruction set
+*
+* @param isa The instruction set
+* @return const char* Its name
+*/
+const char* SimdDispatch::getIsaName(const SimdIsa isa)
+{
+	switch (isa)
+	{
+	case SimdIsa::Avx512:
+		return "avx512";
+	case SimdIsa::Avx2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Includes from STL
+#include <atomic>
+
+
+/*
+* Instruction sets the physics kernels are compiled for
+*/
+enum class SimdIsa
+{
+	Scalar,
+	Avx2,
+	Avx512
+};
+
+
+/*
+* Class SimdDispatch
+*
+* Select, once at runtime, the instruction set used by the vectorized kernels (see ClothKernels).
+* The best set supported by the CPU and the OS is detected with CPUID/XGETBV.
+* The environment variable CLOTH_SIMD ("scalar", "avx2", "avx512") can force a lower one,
+* e.g. to validate the vectorized kernels against the scalar ones.
+*/
+class SimdDispatch
+{
+private:
+	static std::atomic<int> s_activeIsa;
+
+public:
+	SimdDispatch() = delete;
+	~SimdDispatch() = delete;
+
+	static SimdIsa detectSupportedIsa();
+	static SimdIsa getActiveIsa();
+	static void setActiveIsa(const SimdIsa isa);
+	static const char* getIsaName(const SimdIsa isa);
+
+private:
+	static SimdIsa selectIsa();
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+// Includes from STL
+#include <array>
+
+
+/*
+* Permutation tables to convert Width interleaved Vec3 (x0 y0 z0 x1 ..., spread over the three registers
+* a, b, c) into the registers x, y, z and back, for any register width.
+* The element g of the interleaved sequence is the component g % 3 of the particle g / 3, and lives in
+* the lane g % Width of the register g / Width.
+*
+* Two-source permutes (AVX-512 permutex2var): an index < Width selects a lane of the first source,
+* an index >= Width selects the lane (index - Width) of the second source.
+* Single-source permutes (AVX2 permutevar8x32) are combined with blend masks (-1 for the selected lanes).
+*/
+template <int Width, typename Index>
+struct InterleaveTables
+{
+	using Table = std::array<Index, Width>;
+	using Tables = std::array<Table, 3>;
+	using Tables3x3 = std::array<Tables, 3>;
+
+	// Load, two-source, per component: first from (a, b), then completed from (previous result, c)
+	static constexpr Tables loadLow()
+	{
+		Tables tables{};
+		for (int comp = 0; comp < 3; ++comp)
+		{
+			for (int lane = 0; lane < Width; ++lane)
+			{
+				const int g = 3 * lane + comp;
+				tables[comp][lane] = static_cast<Index>(g < 2 * Width ? g : 0);
+			}
+		}
+		return tables;
+	}
+
+	static constexpr Tables loadHigh()
+	{
+		Tables tables{};
+		for (int comp = 0; comp < 3; ++comp)
+		{
+			for (int lane = 0; lane < Width; ++lane)
+			{
+				const int g = 3 * lane + comp;
+				tables[comp][lane] = static_cast<Index>(g >= 2 * Width ? g - Width : lane);
+			}
+		}
+		return tables;
+	}
+
+	// Store, two-source, per output register: first from (x, y), then completed from (previous result, z)
+	static constexpr Tables storeLow()
+	{
+		Tables tables{};
+		for (int reg = 0; reg < 3; ++reg)
+		{
+			for (int lane = 0; lane < Width; ++lane)
+			{
+				const int g = reg * Width + lane;
+				tables[reg][lane] = static_cast<Index>(g % 3 == 0 ? g / 3 : (g % 3 == 1 ? Width + g / 3 : 0));
+			}
+		}
+		return tables;
+	}
+
+	static constexpr Tables storeHigh()
+	{
+		Tables tables{};
+		for (int reg = 0; reg < 3; ++reg)
+		{
+			for (int lane = 0; lane < Width; ++lane)
+			{
+				const int g = reg * Width + lane;
+				tables[reg][lane] = static_cast<Index>(g % 3 == 2 ? Width + g / 3 : lane);
+			}
+		}
+		return tables;
+	}
+
+	// Load, single-source: [reg][comp] lanes of the component 'comp' found in the register 'reg' (or their mask)
+	static constexpr Tables3x3 loadFrom(const bool isMask)
+	{
+		Tables3x3 tables{};
+		for (int reg = 0; reg < 3; ++reg)
+		{
+			for (int comp = 0; comp < 3; ++comp)
+			{
+				for (int lane = 0; lane < Width; ++lane)
+				{
+					const int g = 3 * lane + comp;
+					const bool isInReg = (g / Width) == reg;
+					tables[reg][comp][lane] = static_cast<Index>(isMask ? (isInReg ? -1 : 0) : (isInReg ? g % Width : 0));
+				}
+			}
+		}
+		return tables;
+	}
+
+	// Store, single-source: [reg][comp] lanes of the register 'reg' coming from the component 'comp' (or their mask)
+	static constexpr Tables3x3 storeFrom(const bool isMask)
+	{
+		Tables3x3 tables{};
+		for (int reg = 0; reg < 3; ++reg)
+		{
+			for (int comp = 0; comp < 3; ++comp)
+			{
+				for (int lane = 0; lane < Width; ++lane)
+				{
+					const int g = reg * Width + lane;
+					const bool isFromComp = (g % 3) == comp;
+					tables[reg][comp][lane] = static_cast<Index>(isMask ? (isFromComp ? -1 : 0) : (isFromComp ? g / 3 : 0));
+				}
+			}
+		}
+		return tables;
+	}
+};
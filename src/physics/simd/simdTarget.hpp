@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+* Helpers to compile the vectorized kernels for a given instruction set, without changing the
+* compilation flags of the project: only the functions defined between CLOTH_SIMD_TARGET_PUSH_xxx
+* and CLOTH_SIMD_TARGET_POP are allowed to use the instruction set, so the rest of the binary
+* still runs on any x86-64 CPU. The headers (STL, project) must be included before the push.
+* MSVC accepts the intrinsics without any flag.
+*/
+
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || ((defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)))
+#define CLOTH_SIMD_X86
+#endif
+
+#if defined(__clang__)
+#define CLOTH_SIMD_TARGET_PUSH_AVX2 _Pragma("clang attribute push (__attribute__((target(\"avx2,fma\"))), apply_to = function)")
+#define CLOTH_SIMD_TARGET_PUSH_AVX512 _Pragma("clang attribute push (__attribute__((target(\"avx512f,avx2,fma\"))), apply_to = function)")
+#define CLOTH_SIMD_TARGET_POP _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define CLOTH_SIMD_TARGET_PUSH_AVX2 _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define CLOTH_SIMD_TARGET_PUSH_AVX512 _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,avx2,fma\")")
+#define CLOTH_SIMD_TARGET_POP _Pragma("GCC pop_options")
+#else
+#define CLOTH_SIMD_TARGET_PUSH_AVX2
+#define CLOTH_SIMD_TARGET_PUSH_AVX512
+#define CLOTH_SIMD_TARGET_POP
+#endif
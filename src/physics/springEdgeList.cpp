@@ -0,0 +1,167 @@
+// Includes from project
+#include "springEdgeList.hpp"
+
+// Includes from STL
+#include <algorithm>
+
+
+/*
+* Clear the list and set the grid resolution of the cloth
+*
+* @param resX Resolution of the cloth in the X direction
+* @param resY Resolution of the cloth in the Y direction
+* @return void
+*/
+void SpringEdgeList::reset(const int resX, const int resY)
+{
+	m_resX = resX;
+	m_resY = resY;
+	m_haloRows = 0;
+	m_edges.clear();
+	m_rowEdgeStart.clear();
+	m_haloForces.clear();
+}
+
+
+/*
+* Add a spring between two particles
+* The edge is stored with its smallest particle index first
+*
+* @param i Index of the first particle in the store
+* @param j Index of the second particle in the store
+* @param restLength Rest length of the spring
+* @param stiffness Stiffness of the spring
+* @param damping Damping of the spring
+* @return void
+*/
+void SpringEdgeList::addEdge(const size_t i, const size_t j, const double restLength, const double stiffness, const double damping)
+{
+	SpringEdge edge;
+	edge.m_i = static_cast<uint32_t>(std::min(i, j));
+	edge.m_j = static_cast<uint32_t>(std::max(i, j));
+	edge.m_restLength = static_cast<Real>(restLength);
+	edge.m_stiffness = static_cast<Real>(stiffness);
+	edge.m_damping = static_cast<Real>(damping);
+
+	m_edges.push_back(edge);
+}
+
+
+/*
+* Sort the edges and build the per row lookup tables
+* Must be called once all the edges have been added
+*
+* @return void
+*/
+void SpringEdgeList::finalize()
+{
+	std::stable_sort(m_edges.begin(), m_edges.end(), [](const SpringEdge& a, const SpringEdge& b) {
+		return a.m_i < b.m_i;
+	});
+
+	// Index of the first edge of each row (m_rowEdgeStart[m_resX] is the end of the list)
+	m_rowEdgeStart.assign(m_resX + 1, m_edges.size());
+	m_haloRows = 0;
+	for (size_t e = m_edges.size(); e-- > 0;)
+	{
+		const int rowI = static_cast<int>(m_edges[e].m_i / m_resY);
+		const int rowJ = static_cast<int>(m_edges[e].m_j / m_resY);
+		m_rowEdgeStart[rowI] = e;
+		m_haloRows = std::max(m_haloRows, rowJ - rowI);
+	}
+	for (int r = m_resX - 1; r >= 0; --r)
+	{
+		m_rowEdgeStart[r] = std::min(m_rowEdgeStart[r], m_rowEdgeStart[r + 1]);
+	}
+
+	// Halo buffers are allocated on first use by the batch owning them
+	m_haloForces.assign(m_resX + 1, AlignedVector<Vec3R>());
+}
+
+
+/*
+* Compute the force of every spring starting in the rows [rowFrom, rowTo[ and scatter it to both particles
+* The forces are read from the previous positions and velocities, and accumulated into the external forces
+* of the store. The forces applied beyond rowTo are written into the halo buffer of this batch instead,
+* so that several batches can run in parallel without writing to the same particle.
+*
+* @param store Particle store of the cloth
+* @param rowFrom First row of the batch
+* @param rowTo Last row of the batch (excluded)
+* @return void
+*/
+void SpringEdgeList::accumulateForces(ClothParticleStore& store, const int rowFrom, const int rowTo)
+{
+	const size_t haloStart = static_cast<size_t>(rowTo) * static_cast<size_t>(m_resY);
+
+	AlignedVector<Vec3R>* pHalo = nullptr;
+	if (rowTo < m_resX && m_haloRows > 0)
+	{
+		// Only this batch writes this buffer, and it is fully consumed (zeroed) before the next step
+		pHalo = &m_haloForces[rowTo];
+		if (pHalo->empty())
+		{
+			pHalo->assign(static_cast<size_t>(m_haloRows) * static_cast<size_t>(m_resY), Vec3R(0.0, 0.0, 0.0));
+		}
+	}
+
+	const size_t edgeFrom = m_rowEdgeStart[rowFrom];
+	const size_t edgeTo = m_rowEdgeStart[rowTo];
+	for (size_t e = edgeFrom; e < edgeTo; ++e)
+	{
+		const SpringEdge& edge = m_edges[e];
+
+		Vec3R force = store.m_previousPosition[edge.m_j] - store.m_previousPosition[edge.m_i];
+		const Real length = force.norm();
+		force.normalize();
+
+		// damping force is use to reduce the oscillation of the spring
+		force *= edge.m_stiffness * (length - edge.m_restLength) - edge.m_damping * (store.m_previousVelocity[edge.m_j] - store.m_previousVelocity[edge.m_i]).dot(force);
+
+		// Equal and opposite forces
+		store.m_externalForces[edge.m_i] += force;
+		if (edge.m_j < haloStart)
+		{
+			store.m_externalForces[edge.m_j] -= force;
+		}
+		else
+		{
+			(*pHalo)[edge.m_j - haloStart] -= force;
+		}
+	}
+}
+
+
+/*
+* Add to the external forces of the rows [rowFrom, rowTo[ the forces written in the halo buffers
+* of the previous batches, then clear these halo entries for the next step
+*
+* @param store Particle store of the cloth
+* @param rowFrom First row of the batch
+* @param rowTo Last row of the batch (excluded)
+* @return void
+*/
+void SpringEdgeList::gatherHaloForces(ClothParticleStore& store, const int rowFrom, const int rowTo)
+{
+	// The previous batches end at or before rowFrom, and their halo spans m_haloRows rows
+	for (int haloRow = std::max(1, rowFrom - m_haloRows + 1); haloRow <= rowFrom; ++haloRow)
+	{
+		AlignedVector<Vec3R>& halo = m_haloForces[haloRow];
+		if (halo.empty())
+		{
+			continue;
+		}
+
+		const int rowStart = std::max(haloRow, rowFrom);
+		const int rowEnd = std::min(haloRow + m_haloRows, rowTo);
+		for (int r = rowStart; r < rowEnd; ++r)
+		{
+			for (int j = 0; j < m_resY; ++j)
+			{
+				Vec3R& haloForce = halo[static_cast<size_t>(r - haloRow) * static_cast<size_t>(m_resY) + j];
+				store.m_externalForces[store.getIndex(r, j)] += haloForce;
+				haloForce = Vec3R(0.0, 0.0, 0.0);
+			}
+		}
+	}
+}
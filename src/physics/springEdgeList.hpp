@@ -0,0 +1,70 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/math/alignedAllocator.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+
+// Includes from STL
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+* SpringEdge struct
+*
+* A spring linking the particles m_i and m_j (indexes in the ClothParticleStore), with m_i < m_j
+*/
+struct SpringEdge
+{
+	uint32_t m_i;
+	uint32_t m_j;
+	Real m_restLength;
+	Real m_stiffness;
+	Real m_damping;
+};
+
+
+/*
+* Class SpringEdgeList
+*
+* Cloth level list of springs. Each physical spring is stored once and its force is evaluated once,
+* then applied with opposite signs to both particles (scatter pass).
+*
+* Edges are sorted by their first particle, so the edges starting in a range of rows are contiguous.
+* This allows to scatter the forces in parallel over batches of rows: a batch [rowFrom, rowTo[ writes
+* the forces of its own rows directly into the store, and the forces landing in the following rows
+* (at most m_haloRows rows after rowTo) into a halo buffer owned by the batch.
+* The halo buffers are then gathered by the batches owning these rows, before the integration.
+*/
+class SpringEdgeList
+{
+public:
+	std::vector<SpringEdge> m_edges;
+
+private:
+	int m_resX = 0;
+	int m_resY = 0;
+	int m_haloRows = 0;
+
+	// m_rowEdgeStart[r] is the index of the first edge starting in the row r
+	std::vector<size_t> m_rowEdgeStart;
+
+	// m_haloForces[r] holds the forces applied to the rows [r, r + m_haloRows[ by the batch ending at row r
+	std::vector<AlignedVector<Vec3R>> m_haloForces;
+
+public:
+	SpringEdgeList() {};
+	~SpringEdgeList() {};
+
+	void reset(const int resX, const int resY);
+	void addEdge(const size_t i, const size_t j, const double restLength, const double stiffness, const double damping);
+	void finalize();
+
+	void accumulateForces(ClothParticleStore& store, const int rowFrom, const int rowTo);
+	void gatherHaloForces(ClothParticleStore& store, const int rowFrom, const int rowTo);
+
+	inline size_t size() const { return m_edges.size(); };
+	inline int getHaloRows() const { return m_haloRows; };
+};
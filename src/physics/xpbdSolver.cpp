@@ -0,0 +1,203 @@
+// Includes from project
+#include "xpbdSolver.hpp"
+
+// Includes from STL
+#include <cmath>
+#include <algorithm>
+
+
+/*
+* Set the grid resolution and the rest lengths of the constraints, and allocate the multipliers
+* The rest lengths are the distances between the particles of the flat grid
+*
+* @param resX Resolution of the cloth in the X direction
+* @param resY Resolution of the cloth in the Y direction
+* @param spacingX Distance between two particles in the X direction
+* @param spacingY Distance between two particles in the Y direction
+* @return void
+*/
+void XpbdSolver::init(const int resX, const int resY, const double spacingX, const double spacingY)
+{
+	m_resX = resX;
+	m_resY = resY;
+
+	// Stretch, shear, bending
+	const int offsets[s_familyCount][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 }, { 0, 2 }, { 2, 0 } };
+	for (int f = 0; f < s_familyCount; ++f)
+	{
+		const double dx = static_cast<double>(offsets[f][0]) * spacingX;
+		const double dy = static_cast<double>(offsets[f][1]) * spacingY;
+
+		m_families[f].m_di = offsets[f][0];
+		m_families[f].m_dj = offsets[f][1];
+		m_families[f].m_restLength = static_cast<Real>(std::sqrt(dx * dx + dy * dy));
+
+		m_lambda[f].assign(static_cast<size_t>(resX) * static_cast<size_t>(resY), static_cast<Real>(0));
+	}
+}
+
+
+/*
+* Set the compliance (inverse stiffness) of the constraints
+*
+* @param stretchCompliance Compliance of the constraints between direct neighbors
+* @param shearCompliance Compliance of the diagonal constraints
+* @param bendCompliance Compliance of the constraints between the neighbors at a distance of 2
+* @return void
+*/
+void XpbdSolver::setCompliances(const double stretchCompliance, const double shearCompliance, const double bendCompliance)
+{
+	m_families[0].m_compliance = static_cast<Real>(stretchCompliance);
+	m_families[1].m_compliance = static_cast<Real>(stretchCompliance);
+	m_families[2].m_compliance = static_cast<Real>(shearCompliance);
+	m_families[3].m_compliance = static_cast<Real>(shearCompliance);
+	m_families[4].m_compliance = static_cast<Real>(bendCompliance);
+	m_families[5].m_compliance = static_cast<Real>(bendCompliance);
+}
+
+
+/*
+* Release the memory of the multipliers
+*
+* @return void
+*/
+void XpbdSolver::release()
+{
+	for (AlignedVector<Real>& lambda : m_lambda)
+	{
+		lambda = AlignedVector<Real>();
+	}
+}
+
+
+/*
+* Predict the positions of the particles of the rows [rowFrom, rowTo[ from the external forces and gravity
+* The air friction is integrated implicitly on the speed, so that a large time step can not reverse the velocity
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void XpbdSolver::predict(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo) const
+{
+	const Real realDt = static_cast<Real>(dt);
+	const Real airFriction = static_cast<Real>(store.m_airFriction);
+
+	const size_t indexFrom = store.getIndex(rowFrom, 0);
+	const size_t indexTo = store.getIndex(rowTo, 0);
+	for (size_t index = indexFrom; index < indexTo; ++index)
+	{
+		// Do not update the particle if it is fixed or sleeping
+		if (store.isFrozen(index))
+		{
+			store.keepPreviousState(index);
+			continue;
+		}
+
+		const Real inverseMass = store.m_inverseMass[index];
+		const Vec3R& previousVelocity = store.m_previousVelocity[index];
+		Vec3R& velocity = store.m_velocity[index];
+
+		const Vec3R acceleration = m_gravity + store.m_externalForces[index] * inverseMass;
+		store.m_externalForces[index] = Vec3R(0.0, 0.0, 0.0);
+
+		const Real drag = airFriction * previousVelocity.norm() * inverseMass * realDt;
+		velocity = (previousVelocity + acceleration * realDt) / (static_cast<Real>(1) + drag);
+
+		store.m_position[index] = store.m_previousPosition[index] + velocity * realDt;
+	}
+}
+
+
+/*
+* Project the constraints starting in the rows [rowFrom, rowTo[ (Gauss-Seidel)
+* The positions of the rows [rowFrom, rowTo + getReachRows()[ are modified
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @param iteration Index of the iteration in the step, the multipliers are reset by the first one
+* @return void
+*/
+void XpbdSolver::solve(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo, const int iteration)
+{
+	const Real inverseDt2 = static_cast<Real>(1.0 / (dt * dt));
+
+	for (int i = rowFrom; i < rowTo; ++i)
+	{
+		for (int f = 0; f < s_familyCount; ++f)
+		{
+			const XpbdConstraintFamily& family = m_families[f];
+			if (i + family.m_di >= m_resX)
+			{
+				continue;
+			}
+
+			AlignedVector<Real>& lambdas = m_lambda[f];
+			const Real alphaTilde = family.m_compliance * inverseDt2;
+			const size_t offset = store.getIndex(family.m_di, 0) + family.m_dj; // (di, dj) may be negative, wraps back on the addition
+			const int jFrom = std::max(0, -family.m_dj);
+			const int jTo = std::min(m_resY, m_resY - family.m_dj);
+
+			for (int j = jFrom; j < jTo; ++j)
+			{
+				const size_t indexA = store.getIndex(i, j);
+				const size_t indexB = indexA + offset;
+
+				Real& lambda = lambdas[indexA];
+				if (iteration == 0)
+				{
+					lambda = 0;
+				}
+
+				const Real weightA = store.isFrozen(indexA) ? static_cast<Real>(0) : store.m_inverseMass[indexA];
+				const Real weightB = store.isFrozen(indexB) ? static_cast<Real>(0) : store.m_inverseMass[indexB];
+				const Real weightSum = weightA + weightB + alphaTilde;
+				if (weightSum <= 0)
+				{
+					continue;
+				}
+
+				Vec3R direction = store.m_position[indexA] - store.m_position[indexB];
+				const Real length = direction.norm();
+				if (length <= 0)
+				{
+					continue;
+				}
+				direction /= length;
+
+				// C = length - restLength, gradients: direction for A, -direction for B
+				const Real deltaLambda = (family.m_restLength - length - alphaTilde * lambda) / weightSum;
+				lambda += deltaLambda;
+
+				store.m_position[indexA] += direction * (weightA * deltaLambda);
+				store.m_position[indexB] -= direction * (weightB * deltaLambda);
+			}
+		}
+	}
+}
+
+
+/*
+* Compute the velocities of the particles of the rows [rowFrom, rowTo[ from their displacement over the step
+*
+* @param store Particle store of the cloth
+* @param dt Time step
+* @param rowFrom First row
+* @param rowTo Last row (excluded)
+* @return void
+*/
+void XpbdSolver::updateVelocities(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo) const
+{
+	const Real inverseDt = static_cast<Real>(1.0 / dt);
+
+	const size_t indexFrom = store.getIndex(rowFrom, 0);
+	const size_t indexTo = store.getIndex(rowTo, 0);
+	for (size_t index = indexFrom; index < indexTo; ++index)
+	{
+		store.m_velocity[index] = (store.m_position[index] - store.m_previousPosition[index]) * inverseDt;
+	}
+}
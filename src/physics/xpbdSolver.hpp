@@ -0,0 +1,69 @@
+#pragma once
+
+// Includes from project
+#include "../src/math/vec3.hpp"
+#include "../src/math/alignedAllocator.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+
+// Includes from STL
+#include <array>
+
+
+/*
+* A family of grid constraints: every particle (i, j) is linked to the particle (i + m_di, j + m_dj)
+*/
+struct XpbdConstraintFamily
+{
+	int m_di = 0;
+	int m_dj = 0;
+	Real m_restLength = 0;
+	Real m_compliance = 0;
+};
+
+
+/*
+* Class XpbdSolver
+*
+* Extended position based dynamics (XPBD) solver for grid cloths.
+* The particles are linked by distance constraints: stretch (direct neighbors), shear (diagonals)
+* and bending (neighbors at a distance of 2 on the grid). Like the stencil springs, the constraints are
+* not stored, only one Lagrange multiplier per constraint is.
+* The stiffness is given as a compliance (inverse stiffness, 0 for an inextensible constraint),
+* so the behavior does not depend on the time step or on the number of iterations.
+*
+* A step is: predict() the positions from the forces, solve() the constraints m_iterations times,
+* then updateVelocities() from the corrected positions.
+* solve() works on batches of rows and handles the constraints starting in its rows, which reach
+* getReachRows() rows further. With batches of at least getReachRows() rows, the even batches can be
+* solved in parallel, then the odd ones.
+*/
+class XpbdSolver
+{
+public:
+	static constexpr int s_familyCount = 6;
+
+	int m_iterations = 10;
+	Vec3R m_gravity = Vec3R(0.0, -9.81, 0.0);
+
+private:
+	int m_resX = 0;
+	int m_resY = 0;
+	std::array<XpbdConstraintFamily, s_familyCount> m_families{};
+
+	// Lagrange multipliers, indexed by the first particle of the constraint
+	std::array<AlignedVector<Real>, s_familyCount> m_lambda;
+
+public:
+	XpbdSolver() {};
+	~XpbdSolver() {};
+
+	void init(const int resX, const int resY, const double spacingX, const double spacingY);
+	void setCompliances(const double stretchCompliance, const double shearCompliance, const double bendCompliance);
+	void release();
+
+	void predict(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo) const;
+	void solve(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo, const int iteration);
+	void updateVelocities(ClothParticleStore& store, const double dt, const int rowFrom, const int rowTo) const;
+
+	inline static constexpr int getReachRows() { return 2; };
+};
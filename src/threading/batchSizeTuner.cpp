@@ -0,0 +1,141 @@
+// Includes from project
+#include "../src/threading/batchSizeTuner.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+/*
+* Start tuning again from a batch size
+*
+* @param initialBatchSize The batch size used until the first measures
+* @param minBatchSize The smallest batch size allowed
+* @param maxBatchSize The largest batch size allowed
+* @return void
+*/
+void BatchSizeTuner::reset(const int initialBatchSize, const int minBatchSize, const int maxBatchSize)
+{
+	m_minBatchSize = std::max(minBatchSize, 1);
+	m_maxBatchSize = std::max(maxBatchSize, m_minBatchSize);
+
+	m_stats = BatchSizeTunerStats();
+	m_stats.m_batchSize = std::clamp(initialBatchSize, m_minBatchSize, m_maxBatchSize);
+	m_stableRoundCount = 0;
+	resetRound();
+}
+
+
+/*
+* Report the duration of a task of the phase, can be called from any thread
+* Does nothing once the batch size is locked.
+*
+* @param nanoseconds The duration of the task
+* @param itemCount The number of items handled by the task
+* @return void
+*/
+void BatchSizeTuner::addSample(const uint64_t nanoseconds, const size_t itemCount)
+{
+	if (m_stats.m_isLocked)
+	{
+		return;
+	}
+	m_sampleNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+	m_sampleItemCount.fetch_add(itemCount, std::memory_order_relaxed);
+	m_sampleTaskCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/*
+* Called once the tasks of a step are done, computes the batch size again at the end of a round of measures
+*
+* @param threadCount The number of threads executing the tasks
+* @param itemCount The number of items of the phase during the step
+* @return bool True if the batch size changed
+*/
+bool BatchSizeTuner::endStep(const size_t threadCount, const size_t itemCount)
+{
+	if (m_stats.m_isLocked)
+	{
+		return false;
+	}
+
+	m_roundItemCount += itemCount;
+	m_roundStepCount++;
+	if (m_roundStepCount < m_samplingSteps)
+	{
+		return false;
+	}
+
+	const uint64_t nanoseconds = m_sampleNanoseconds.load(std::memory_order_relaxed);
+	const uint64_t sampleItemCount = m_sampleItemCount.load(std::memory_order_relaxed);
+	const uint64_t taskCount = m_sampleTaskCount.load(std::memory_order_relaxed);
+	const double itemsPerStep = static_cast<double>(m_roundItemCount) / static_cast<double>(m_roundStepCount);
+	resetRound();
+
+	// Nothing ran (e.g. the scene sleeps), keep measuring
+	if (sampleItemCount == 0 || taskCount == 0)
+	{
+		return false;
+	}
+
+	m_stats.m_costPerItem = static_cast<double>(nanoseconds) * 1e-9 / static_cast<double>(sampleItemCount);
+	m_stats.m_averageTaskDuration = static_cast<double>(nanoseconds) * 1e-9 / static_cast<double>(taskCount);
+	m_stats.m_itemsPerStep = itemsPerStep;
+
+	const int batchSize = computeBatchSize(itemsPerStep, threadCount, m_stats.m_costPerItem);
+	const int difference = std::abs(batchSize - m_stats.m_batchSize);
+	if (difference <= static_cast<int>(m_tolerance * static_cast<double>(m_stats.m_batchSize)))
+	{
+		m_stableRoundCount++;
+		m_stats.m_isLocked = (m_stableRoundCount >= m_stableRounds);
+		return false;
+	}
+
+	m_stats.m_batchSize = batchSize;
+	m_stats.m_changeCount++;
+	m_stats.m_isLocked = (m_stats.m_changeCount >= m_maxChangeCount);
+	m_stableRoundCount = 0;
+	return true;
+}
+
+
+/*
+* Compute the batch size for a workload
+*
+* @param itemsPerStep The number of items of the phase during a step
+* @param threadCount The number of threads executing the tasks
+* @param costPerItem The time to process an item, in seconds
+* @return int The batch size, clamped between the minimum and maximum ones
+*/
+int BatchSizeTuner::computeBatchSize(const double itemsPerStep, const size_t threadCount, const double costPerItem) const
+{
+	// Enough tasks for each thread
+	const double taskCount = std::max(m_targetTasksPerWorker * static_cast<double>(std::max<size_t>(threadCount, 1)), 1.0);
+	double batchSize = std::ceil(itemsPerStep / taskCount);
+
+	// But not so short that scheduling them costs more than the work
+	if (costPerItem > 0.0)
+	{
+		batchSize = std::max(batchSize, std::ceil(m_minTaskDuration / costPerItem));
+	}
+
+	batchSize = std::clamp(batchSize, static_cast<double>(m_minBatchSize), static_cast<double>(m_maxBatchSize));
+	return static_cast<int>(batchSize);
+}
+
+
+/*
+* Start a new round of measures
+*
+* @return void
+*/
+void BatchSizeTuner::resetRound()
+{
+	m_sampleNanoseconds.store(0, std::memory_order_relaxed);
+	m_sampleItemCount.store(0, std::memory_order_relaxed);
+	m_sampleTaskCount.store(0, std::memory_order_relaxed);
+	m_roundItemCount = 0;
+	m_roundStepCount = 0;
+}
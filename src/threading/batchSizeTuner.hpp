@@ -0,0 +1,76 @@
+#pragma once
+
+// Includes from STL
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+* State of a BatchSizeTuner, for instrumentation
+* m_costPerItem is the measured time (in seconds) to process an item (a row, a cell) in a task
+*/
+struct BatchSizeTunerStats
+{
+	int m_batchSize = 1;
+	double m_costPerItem = 0.0;
+	double m_averageTaskDuration = 0.0;
+	double m_itemsPerStep = 0.0;
+	int m_changeCount = 0;
+	bool m_isLocked = false;
+};
+
+
+/*
+* Class BatchSizeTuner
+*
+* Picks the number of items (rows of the cloths, cells of the grid) handled by a task of a phase of the step.
+* The tasks of the phase report their duration and their number of items (addSample(), from any thread), and
+* every m_samplingSteps steps the batch size is computed again from the measured cost of an item:
+* - there should be m_targetTasksPerWorker tasks per thread, so the threads can balance the work
+* - a task should last at least m_minTaskDuration, so the cost of scheduling a task stays small
+* The duration wins over the number of tasks: small workloads use fewer, longer tasks.
+* Once the batch size stays within m_tolerance of the computed one for m_stableRounds rounds, or after
+* m_maxChangeCount changes (in case it oscillates), it is locked and the tuner stops measuring.
+*
+* Usage, for each step: getBatchSize() to build the tasks, addSample() from each task, then endStep()
+*/
+class BatchSizeTuner
+{
+public:
+	double m_targetTasksPerWorker = 4.0;
+	double m_minTaskDuration = 50e-6;
+	int m_samplingSteps = 20;
+	int m_stableRounds = 3;
+	int m_maxChangeCount = 10;
+	double m_tolerance = 0.2;
+
+private:
+	int m_minBatchSize = 1;
+	int m_maxBatchSize = 1;
+	BatchSizeTunerStats m_stats;
+
+	// Samples of the current round
+	std::atomic<uint64_t> m_sampleNanoseconds = 0;
+	std::atomic<uint64_t> m_sampleItemCount = 0;
+	std::atomic<uint64_t> m_sampleTaskCount = 0;
+	size_t m_roundItemCount = 0;
+	int m_roundStepCount = 0;
+	int m_stableRoundCount = 0;
+
+public:
+	BatchSizeTuner() {};
+	~BatchSizeTuner() {};
+
+	void reset(const int initialBatchSize, const int minBatchSize, const int maxBatchSize);
+	void addSample(const uint64_t nanoseconds, const size_t itemCount);
+	bool endStep(const size_t threadCount, const size_t itemCount);
+	int computeBatchSize(const double itemsPerStep, const size_t threadCount, const double costPerItem) const;
+
+	inline int getBatchSize() const { return m_stats.m_batchSize; };
+	inline bool isLocked() const { return m_stats.m_isLocked; };
+	inline const BatchSizeTunerStats& getStats() const { return m_stats; };
+
+private:
+	void resetRound();
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+// Includes from STL
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+
+
+/*
+* Class ChaseLevDeque
+*
+* Lock free work stealing deque (Chase and Lev, with the memory orders of Le et al. for weak memory models).
+* The owner thread pushes and pops at the bottom, the other threads steal from the top.
+* The owner works in LIFO order (hot caches), the thieves take the oldest items (the largest chunks of work).
+* Only trivially copyable values are stored (pointers to the tasks).
+* The buffer grows when full, the old buffers are kept until the deque is destroyed since a thief may still read them.
+*/
+template <typename T>
+class ChaseLevDeque
+{
+	static_assert(std::is_trivially_copyable_v<T>, "ChaseLevDeque only stores trivially copyable values");
+
+private:
+	struct Buffer
+	{
+		int64_t m_capacity;
+		std::unique_ptr<std::atomic<T>[]> m_items;
+
+		Buffer(const int64_t capacity) : m_capacity(capacity), m_items(new std::atomic<T>[static_cast<size_t>(capacity)]) {};
+
+		inline void put(const int64_t index, const T value) { m_items[static_cast<size_t>(index & (m_capacity - 1))].store(value, std::memory_order_relaxed); };
+		inline T get(const int64_t index) const { return m_items[static_cast<size_t>(index & (m_capacity - 1))].load(std::memory_order_relaxed); };
+	};
+
+	// Owner and thieves indexes on their own cache lines
+	alignas(64) std::atomic<int64_t> m_top = 0;
+	alignas(64) std::atomic<int64_t> m_bottom = 0;
+	alignas(64) std::atomic<Buffer*> m_pBuffer;
+
+	// All the buffers ever allocated, only touched by the owner
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+
+public:
+	ChaseLevDeque(const int64_t initialCapacity = 256);
+	~ChaseLevDeque() {};
+
+	ChaseLevDeque(const ChaseLevDeque&) = delete;
+	ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+	void push(const T value);
+	bool pop(T& value);
+	bool steal(T& value);
+
+	// Approximate number of items, exact when called by the owner without concurrent thieves
+	inline int64_t size() const { return std::max<int64_t>(m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed), 0); };
+	inline bool empty() const { return size() == 0; };
+
+private:
+	Buffer* grow(Buffer* pBuffer, const int64_t top, const int64_t bottom);
+};
+
+
+/*
+* @param initialCapacity Initial number of slots, rounded up to a power of two
+*/
+template <typename T>
+ChaseLevDeque<T>::ChaseLevDeque(const int64_t initialCapacity)
+{
+	int64_t capacity = 1;
+	while (capacity < initialCapacity)
+	{
+		capacity *= 2;
+	}
+
+	m_buffers.push_back(std::make_unique<Buffer>(capacity));
+	m_pBuffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+}
+
+
+/*
+* Push a value at the bottom of the deque
+* Must only be called by the owner thread
+*
+* @param value The value to push
+* @return void
+*/
+template <typename T>
+void ChaseLevDeque<T>::push(const T value)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	Buffer* pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+
+	if (bottom - top > pBuffer->m_capacity - 1)
+	{
+		pBuffer = grow(pBuffer, top, bottom);
+	}
+
+	// Release: a thief that sees the new bottom also sees the value
+	pBuffer->put(bottom, value);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+}
+
+
+/*
+* Pop the last pushed value from the bottom of the deque
+* Must only be called by the owner thread
+*
+* @param value Receives the popped value
+* @return bool True if a value was popped, false if the deque was empty (or the last value was stolen)
+*/
+template <typename T>
+bool ChaseLevDeque<T>::pop(T& value)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	Buffer* pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// Empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	value = pBuffer->get(bottom);
+	if (top == bottom)
+	{
+		// Last value, race against the thieves for it
+		const bool isWon = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return isWon;
+	}
+
+	return true;
+}
+
+
+/*
+* Steal the oldest value from the top of the deque
+* Can be called by any thread
+*
+* @param value Receives the stolen value
+* @return bool True if a value was stolen, false if the deque was empty or another thread won the race
+*/
+template <typename T>
+bool ChaseLevDeque<T>::steal(T& value)
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return false;
+	}
+
+	Buffer* pBuffer = m_pBuffer.load(std::memory_order_acquire);
+	value = pBuffer->get(top);
+	return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+
+/*
+* Double the capacity of the buffer, and copy the values of [top, bottom[ in the new one
+*
+* @param pBuffer The current (full) buffer
+* @param top The top index
+* @param bottom The bottom index
+* @return Buffer* The new buffer
+*/
+template <typename T>
+typename ChaseLevDeque<T>::Buffer* ChaseLevDeque<T>::grow(Buffer* pBuffer, const int64_t top, const int64_t bottom)
+{
+	m_buffers.push_back(std::make_unique<Buffer>(pBuffer->m_capacity * 2));
+	Buffer* pNewBuffer = m_buffers.back().get();
+	for (int64_t index = top; index < bottom; ++index)
+	{
+		pNewBuffer->put(index, pBuffer->get(index));
+	}
+
+	m_pBuffer.store(pNewBuffer, std::memory_order_release);
+	return pNewBuffer;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+// Includes from STL
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+
+/*
+* Class MpmcRing
+*
+* Lock free bounded multi producer multi consumer queue (Vyukov's ring).
+* Each slot has a sequence number telling whether it can be written (sequence == position) or read
+* (sequence == position + 1): a producer or a consumer claims a position with a single compare and swap on
+* its own index, then only touches its slot. There is no allocation after the construction.
+* The values are moved in and out of the slots, each slot fills a cache line when the value is small enough,
+* so two threads working on neighbouring slots do not share a line.
+* tryPush() fails when the ring is full, tryPop() when it is empty: the caller decides how to wait.
+*/
+template <typename T>
+class MpmcRing
+{
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<size_t> m_sequence = 0;
+		T m_value;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_mask = 0;
+
+	// Producers and consumers indexes on their own cache lines
+	alignas(64) std::atomic<size_t> m_enqueuePosition = 0;
+	alignas(64) std::atomic<size_t> m_dequeuePosition = 0;
+
+public:
+	MpmcRing(const size_t capacity = 1024);
+	~MpmcRing() {};
+
+	MpmcRing(const MpmcRing&) = delete;
+	MpmcRing& operator=(const MpmcRing&) = delete;
+
+	bool tryPush(T& value);
+	bool tryPop(T& value);
+
+	// Approximate number of values, exact when no thread pushes or pops
+	inline size_t size() const
+	{
+		const size_t dequeuePosition = m_dequeuePosition.load(std::memory_order_relaxed);
+		const size_t enqueuePosition = m_enqueuePosition.load(std::memory_order_relaxed);
+		return (enqueuePosition > dequeuePosition) ? enqueuePosition - dequeuePosition : 0;
+	};
+	inline bool empty() const { return size() == 0; };
+	inline size_t capacity() const { return m_mask + 1; };
+};
+
+
+/*
+* @param capacity Number of slots, rounded up to a power of two (at least 2)
+*/
+template <typename T>
+MpmcRing<T>::MpmcRing(const size_t capacity)
+{
+	size_t roundedCapacity = 2;
+	while (roundedCapacity < capacity)
+	{
+		roundedCapacity *= 2;
+	}
+
+	m_slots = std::make_unique<Slot[]>(roundedCapacity);
+	m_mask = roundedCapacity - 1;
+	for (size_t i = 0; i < roundedCapacity; ++i)
+	{
+		m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+
+/*
+* Push a value at the end of the ring
+* Can be called by any thread
+*
+* @param value The value to push, moved into the ring only if it is pushed
+* @return bool True if the value was pushed, false if the ring was full
+*/
+template <typename T>
+bool MpmcRing<T>::tryPush(T& value)
+{
+	Slot* pSlot = nullptr;
+	size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+	while (true)
+	{
+		pSlot = &m_slots[position & m_mask];
+		const size_t sequence = pSlot->m_sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+		if (difference == 0)
+		{
+			// The slot is free, claim its position
+			if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot still holds the value of the previous lap: full
+			return false;
+		}
+		else
+		{
+			// Another producer took the position
+			position = m_enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Release: a consumer that sees the new sequence also sees the value
+	pSlot->m_value = std::move(value);
+	pSlot->m_sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+
+/*
+* Pop the oldest value of the ring
+* Can be called by any thread
+*
+* @param value Receives the popped value
+* @return bool True if a value was popped, false if the ring was empty
+*/
+template <typename T>
+bool MpmcRing<T>::tryPop(T& value)
+{
+	Slot* pSlot = nullptr;
+	size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+	while (true)
+	{
+		pSlot = &m_slots[position & m_mask];
+		const size_t sequence = pSlot->m_sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+		if (difference == 0)
+		{
+			// The slot is written, claim its position
+			if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot is not written yet: empty
+			return false;
+		}
+		else
+		{
+			// Another consumer took the position
+			position = m_dequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Release: the slot can be written again on the next lap
+	value = std::move(pSlot->m_value);
+	pSlot->m_sequence.store(position + m_mask + 1, std::memory_order_release);
+	return true;
+}
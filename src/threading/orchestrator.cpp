@@ -1,13 +1,163 @@
 // Includes from project
 #include "../src/threading/orchestrator.hpp"
+#include "../src/physics/simd/simdDispatch.hpp"
 
 // Includes from STL
 #include <iostream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
 
-Orchestrator::Orchestrator(const size_t  numberOfThreads) : m_numberOfThreads(numberOfThreads)
+// Rows of a cloth handled by a task, before the batch sizes are tuned (see BatchSizeTuner)
+static constexpr int s_defaultRowBatchSize = 5;
+static constexpr int s_maxRowBatchSize = 64;
+
+// Non-empty cells of the grid handled by a task, for the collisions between the cloths
+static constexpr int s_defaultCellBatchSize = 50;
+static constexpr int s_maxCellBatchSize = 4096;
+
+// Events a thread can record in a trace before the next ones are dropped
+static constexpr size_t s_defaultTraceEventsPerThread = 1 << 16;
+
+// Scopes of the profiler (and names of the events of the trace): the phases of the orchestrator loop and of a step,
+// the types of tasks, then the waits for other tasks
+// Registered in this order by the constructor, so the ids are the values of the enum
+enum ProfileScopeId : uint32_t
+{
+	Frame,
+	FrameWait,
+	Step,
+	StepAwakeBatches,
+	StepBuildGraph,
+	StepRunGraph,
+	StepTuning,
+	StepSwap,
+	TaskUpdate,
+	TaskSprings,
+	TaskPredict,
+	TaskSolve,
+	TaskFinalize,
+	TaskImplicitBegin,
+	TaskImplicitSolve,
+	TaskCollisions,
+	TaskClearGrid,
+	TaskBuildGrid,
+	TaskBounds,
+	TaskCulling,
+	TaskContacts,
+	TaskMeasure,
+	TaskImplicitCg,
+	WaitImplicitCg,
+	ProfileScopeCount
+};
+
+static const char* s_profileScopeNames[ProfileScopeCount] = {
+	"frame",
+	"frame.wait",
+	"step",
+	"step.awake_batches",
+	"step.build_graph",
+	"step.run_graph",
+	"step.tuning",
+	"step.swap",
+	"task.update",
+	"task.springs",
+	"task.xpbd_predict",
+	"task.xpbd_solve",
+	"task.finalize",
+	"task.implicit_begin",
+	"task.implicit_solve",
+	"task.collisions",
+	"task.clear_grid",
+	"task.build_grid",
+	"task.bounds",
+	"task.culling",
+	"task.contacts",
+	"task.measure",
+	"task.implicit_cg",
+	"wait.implicit_cg"
+};
+
+
+/*
+* Give the measure of a scope to the profiler, and to the trace when it is recording
+*
+* @param profiler The profiler
+* @param traceRecorder The trace
+* @param scopeId The scope
+* @param startTime When the scope started (see Profiler::now())
+* @param duration How long it lasted, in nanoseconds
+* @param clothUid The cloth the scope worked on, -1 if none
+* @param pRangeName The name of the range of items the scope worked on ("rows", "cells"), nullptr if none
+* @param rangeBegin The first item
+* @param rangeEnd The item after the last one
+* @return void
+*/
+static void recordScope(Profiler& profiler, TraceRecorder& traceRecorder, const uint32_t scopeId, const int64_t startTime, const int64_t duration,
+	const int64_t clothUid = -1, const char* pRangeName = nullptr, const int64_t rangeBegin = 0, const int64_t rangeEnd = 0)
+{
+	profiler.addSample(scopeId, startTime, duration);
+	if (traceRecorder.isEnabled())
+	{
+		TraceEvent event;
+		event.m_pName = s_profileScopeNames[scopeId];
+		event.m_pRangeName = pRangeName;
+		event.m_startNanoseconds = startTime;
+		event.m_durationNanoseconds = duration;
+		event.m_clothUid = clothUid;
+		event.m_rangeBegin = rangeBegin;
+		event.m_rangeEnd = rangeEnd;
+		traceRecorder.record(event);
+	}
+}
+
+
+/*
+* Class MeasuredScope
+*
+* Measures the lifetime of the object for the profiler and the trace, does nothing if both are disabled
+*/
+class MeasuredScope
+{
+private:
+	Profiler& m_profiler;
+	TraceRecorder& m_traceRecorder;
+	const uint32_t m_scopeId;
+	const int64_t m_clothUid;
+	const char* m_pRangeName;
+	const int64_t m_rangeBegin;
+	const int64_t m_rangeEnd;
+	const int64_t m_startTime;
+
+public:
+	MeasuredScope(Profiler& profiler, TraceRecorder& traceRecorder, const uint32_t scopeId,
+		const int64_t clothUid = -1, const char* pRangeName = nullptr, const int64_t rangeBegin = 0, const int64_t rangeEnd = 0) :
+		m_profiler(profiler), m_traceRecorder(traceRecorder), m_scopeId(scopeId),
+		m_clothUid(clothUid), m_pRangeName(pRangeName), m_rangeBegin(rangeBegin), m_rangeEnd(rangeEnd),
+		m_startTime((profiler.isEnabled() || traceRecorder.isEnabled()) ? profiler.now() : -1) {};
+	~MeasuredScope()
+	{
+		if (m_startTime >= 0)
+		{
+			recordScope(m_profiler, m_traceRecorder, m_scopeId, m_startTime, m_profiler.now() - m_startTime, m_clothUid, m_pRangeName, m_rangeBegin, m_rangeEnd);
+		}
+	};
+
+	MeasuredScope(const MeasuredScope&) = delete;
+	MeasuredScope& operator=(const MeasuredScope&) = delete;
+};
+
+
+Orchestrator::Orchestrator(const ThreadPoolSettings& threadPoolSettings) :
+	m_pTaskQueue(std::make_unique<TaskQueue>(ThreadPoolConfig::applyEnvironment(threadPoolSettings).m_taskQueueBackend)),
+	m_threadPoolSettings(threadPoolSettings)
 {
-	
+	for (const char* pName : s_profileScopeNames)
+	{
+		m_profiler.registerScope(pName);
+	}
 }
 
 
@@ -35,7 +185,8 @@ Orchestrator::~Orchestrator()
 */
 Orchestrator& Orchestrator::getInstance()
 {
-	static Orchestrator instance(10);
+	// Sized from the hardware when it starts, unless the environment sets it
+	static Orchestrator instance(ThreadPoolSettings{});
 	return instance;
 }
 
@@ -53,31 +204,24 @@ void Orchestrator::start(ApplicationData& appData)
 
 	if (m_workerThreads.size() == 0)
 	{
-		// Worker thread lambda function
-		// This just endlessley loops to gets and execute tasks from the task queue
-		auto workerThreadLambda = [this]()
-			{
-				while (m_workerRunning)
-				{
-					std::function<void()> task;
-					m_taskQueue.getTask(task);
-					if (task)
-					{
-						task();
-						m_taskQueue.markTaskAsDone();
-					}
-				}
-			};
+		startWorkers();
+	}
 
-		// Create the worker threads
-		for (size_t i = 0; i < m_numberOfThreads; ++i)
-		{
-			m_workerThreads.push_back(std::thread(workerThreadLambda));
-		}
+	// The batch sizes are tuned again for the new pool and scene
+	resetBatchSizeTuners();
+
+	// Trace the whole simulation
+	const char* pTracePath = std::getenv("CLOTH_TRACE_OUTPUT");
+	if (pTracePath != nullptr && *pTracePath != '\0' && !m_orchestratorThread.joinable())
+	{
+		m_traceRecorder.start(s_defaultTraceEventsPerThread);
 	}
 
-	// Initialize the last update time
+	// Initialize the last update time and the time statistics
 	m_lastUpdateTime = std::chrono::steady_clock::now();
+	m_simulatedTime = 0.0;
+	m_wallTime = 0.0;
+	m_droppedTime = 0.0;
 
 	// Launch the orchestrator thread if it is not running yet
 	if (!m_orchestratorThread.joinable())
@@ -115,217 +259,1426 @@ void Orchestrator::stop()
 	{
 		if (workerThread.joinable())
 		{
-			m_taskQueue.releaseAll(m_numberOfThreads);
+			m_pTaskQueue->releaseAll(m_numberOfThreads);
 			workerThread.join();
 		}
 	}
+	if (!m_workerThreads.empty())
+	{
+		reportWorkerUtilisation();
+	}
 	m_workerThreads.clear();
 
-	m_taskQueue.clearTaskQueue();
+	// The calling thread gets its CPUs back, the next pool is sized from all the CPUs of the process
+	ThreadPoolConfig::releaseMainThreadCore(m_mainThreadCpus);
+
+	m_pTaskQueue->clearTaskQueue();
+
+	// No task is running, write the trace if it was requested, or if the whole simulation was traced
+	applyTraceRequests();
+	const char* pTracePath = std::getenv("CLOTH_TRACE_OUTPUT");
+	if (m_traceRecorder.isEnabled() && pTracePath != nullptr && *pTracePath != '\0')
+	{
+		stopTrace(pTracePath);
+		applyTraceRequests();
+	}
+
+	// Export the profile of the simulation
+	const char* pProfilePath = std::getenv("CLOTH_PROFILE_OUTPUT");
+	if (pProfilePath != nullptr && *pProfilePath != '\0')
+	{
+		if (m_profiler.exportToFile(pProfilePath))
+		{
+			std::cout << "Profile written to " << pProfilePath << std::endl;
+		}
+		else
+		{
+			std::cerr << "Error: can not write the profile to " << pProfilePath << std::endl;
+		}
+	}
 }
 
 
 /*
-* Run the orchestrator
-* This is the main simulation thread
-* Dispatches tasks to the worker threads via the task queue
-* 
+* Create the worker threads, with the settings of the thread pool and the environment overrides
+* When the threads are pinned, each worker gets a core, and the orchestrator thread can run on all of them.
+* If a core is reserved for the GUI/render thread, it is the first available one: the calling thread (the GUI
+* thread, see ApplicationData) is pinned to it until stop(), and it is left out of the cores of the simulation.
+*
 * @return void
 */
-void Orchestrator::runOrchestrator()
+void Orchestrator::startWorkers()
 {
-	const size_t cellsBatchSize = 50;
-	const int resxBatchSize = 5;
-
-	double sommeDt = 0.0;
-	double avg = 0.0;
-	int count = 0;
+	const ThreadPoolSettings settings = ThreadPoolConfig::resolve(m_threadPoolSettings);
+	m_numberOfThreads = settings.m_workerCount;
 
-	std::cout << "Orchestrator running" << std::endl;
+	const std::vector<int> cpus = ThreadPoolConfig::reservePoolCpus(settings, m_mainThreadCpus);
+	m_orchestratorCpus = cpus;
 
-	// Main simulation loop
-	while (m_orchestratorRunning)
+	m_workerCounters.clear();
+	for (size_t i = 0; i < m_numberOfThreads; ++i)
 	{
-		// Calculate the time elapsed since the last update
-		auto currentTime = std::chrono::steady_clock::now();
-		std::chrono::duration<float> deltaTime = currentTime - m_lastUpdateTime;
-		m_lastUpdateTime = currentTime;
-		double elapsedTimeInSeconds = static_cast<double>(deltaTime.count()); // Convert deltaTime to seconds
-
-		// Calculate the average time step for debugging performance
-		sommeDt += elapsedTimeInSeconds;
-		count++;
-		avg = sommeDt / static_cast<double>(count);
-
-		// Clamp the time step to avoid huge time steps
-		// This is a simple way to avoid instability in the simulation
-		// But we lose real time in that case
-		if (elapsedTimeInSeconds > 0.005)
+		m_workerCounters.push_back(std::make_unique<WorkerCounters>());
+		if (!cpus.empty())
 		{
-			elapsedTimeInSeconds = 0.005;
+			m_workerCounters[i]->m_cpu = cpus[i % cpus.size()];
 		}
+	}
 
-		// First, update all the cloths' particles and the collisions with static colliders
+	// The queue is only replaced while no thread uses it, it keeps its wait policy
+	if (m_pTaskQueue->getBackend() != settings.m_taskQueueBackend)
+	{
+		const TaskWaitPolicy waitPolicy = m_pTaskQueue->getWaitPolicy();
+		m_pTaskQueue = std::make_unique<TaskQueue>(settings.m_taskQueueBackend);
+		m_pTaskQueue->setWaitPolicy(waitPolicy);
+	}
 
-		auto t1 = std::chrono::steady_clock::now(); // For performance debugging
+	std::cout << "Starting " << m_numberOfThreads << " worker threads (" << (cpus.empty() ? "not pinned" : "pinned")
+		<< (settings.m_reserveMainThreadCore ? ", a core reserved for the GUI" : "")
+		<< ((settings.m_taskQueueBackend == TaskQueueBackend::BoundedRing) ? ", ring task queue" : ", work stealing task queue")
+		<< ")" << std::endl;
 
-		// Update all the cloths' particles and the collisions with static colliders
-		// Add the particles to the hash grid collider
-		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	// One work stealing deque per worker thread
+	m_pTaskQueue->setWorkerCount(m_numberOfThreads);
+
+	// Worker thread lambda function
+	// This just endlessley loops to gets and execute tasks from the task queue
+	auto workerThreadLambda = [this](const size_t workerIndex)
 		{
-			if (pCloth)
+			WorkerCounters& counters = *m_workerCounters[workerIndex];
+			m_traceRecorder.setThreadName("worker " + std::to_string(workerIndex));
+			if (counters.m_cpu >= 0 && !ThreadPoolConfig::pinCurrentThread({ counters.m_cpu }))
+			{
+				counters.m_cpu = -1;
+			}
+
+			while (m_workerRunning)
 			{
-				// Create tasks to update the particles of the cloth
-				for (int i = 0; i < pCloth->m_resX; i += resxBatchSize)
+				TaskQueue::TaskSlot task;
+				m_pTaskQueue->getTask(task, workerIndex);
+				if (task)
 				{
-					int startResX = i;
-					int endResX = std::min(startResX + resxBatchSize, pCloth->m_resX);
-				
-					m_taskQueue.addTask(
-						[this , pCloth, elapsedTimeInSeconds, startResX, endResX]() {
-							// Update the simulation
-							pCloth->updateParticles(
-								elapsedTimeInSeconds, 
-								startResX, endResX, 
-								m_pAppData->m_colliders, 
-								m_pAppData->m_pGridCollider
-							);
-						});
+					const auto startTime = std::chrono::steady_clock::now();
+					task();
+					const auto endTime = std::chrono::steady_clock::now();
+					m_pTaskQueue->markTaskAsDone();
+
+					// Only this thread writes its counters
+					const uint64_t busyNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+					counters.m_busyNanoseconds.store(counters.m_busyNanoseconds.load(std::memory_order_relaxed) + busyNanoseconds, std::memory_order_relaxed);
+					counters.m_taskCount.store(counters.m_taskCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 				}
 			}
-		}
+		};
+
+	// Create the worker threads
+	m_workersStartTime = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < m_numberOfThreads; ++i)
+	{
+		m_workerThreads.push_back(std::thread(workerThreadLambda, i));
+	}
+}
 
-		// Wait until all clothes' particles have been updated before setting their previous position and velocity
-		m_taskQueue.waitUntilEmpty();
 
-		// Calculate the average time step for debugging performance
-		auto t2 = std::chrono::steady_clock::now();
-		std::chrono::duration<float> dt1 = t2 - t1;
-		static double sommeDt1 = 0.0;
-		sommeDt1 += static_cast<double>(dt1.count());
-		double avg1 = sommeDt1 / static_cast<double>(count);
+/*
+* Set how the pool of worker threads is sized and pinned
+* The environment variables still override these settings (see ThreadPoolConfig).
+* Takes effect the next time the orchestrator starts (the pool is created by start() and destroyed by stop()).
+*
+* @param threadPoolSettings The settings of the pool
+* @return void
+*/
+void Orchestrator::setThreadPoolSettings(const ThreadPoolSettings& threadPoolSettings)
+{
+	m_threadPoolSettings = threadPoolSettings;
+}
 
-		// Create tasks to update the previous position and velocity of the particles
-		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+
+/*
+* Get the time each worker thread spent executing tasks since the pool started
+* Can be called while the simulation is running, from the thread that starts and stops it.
+*
+* @return std::vector<WorkerUtilisation> The utilisation of each worker thread
+*/
+std::vector<WorkerUtilisation> Orchestrator::getWorkerUtilisation() const
+{
+	const double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_workersStartTime).count();
+
+	std::vector<WorkerUtilisation> utilisation;
+	for (size_t i = 0; i < m_workerCounters.size(); ++i)
+	{
+		WorkerUtilisation worker;
+		worker.m_workerIndex = i;
+		worker.m_cpu = m_workerCounters[i]->m_cpu;
+		worker.m_busyTime = static_cast<double>(m_workerCounters[i]->m_busyNanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+		worker.m_wallTime = wallTime;
+		worker.m_taskCount = m_workerCounters[i]->m_taskCount.load(std::memory_order_relaxed);
+		utilisation.push_back(worker);
+	}
+	return utilisation;
+}
+
+
+/*
+* Print the utilisation of the worker threads, to compare the pool settings (pinning, size) on a machine
+*
+* @return void
+*/
+void Orchestrator::reportWorkerUtilisation() const
+{
+	for (const WorkerUtilisation& worker : getWorkerUtilisation())
+	{
+		std::cout << "Worker " << worker.m_workerIndex;
+		if (worker.m_cpu >= 0)
 		{
-			if (pCloth)
-			{
-				for (int i = 0; i < pCloth->m_resX; i += resxBatchSize)
-				{
-					int startResX = i;
-					int endResX = std::min(startResX + resxBatchSize, pCloth->m_resX);
-
-					m_taskQueue.addTask(
-						[this, pCloth, startResX, endResX]() {
-							// Update the previous position and velocity
-							pCloth->updatePreviousPositionAndVelocity(startResX, endResX);
-						});
-				}
-			}
+			std::cout << " (cpu " << worker.m_cpu << ")";
 		}
+		std::cout << ": " << 100.0 * worker.getUtilisation() << "% busy, " << worker.m_taskCount << " tasks" << std::endl;
+	}
+}
 
-		// Wait until all clothes' to be ready to check collisions
-		m_taskQueue.waitUntilEmpty();
 
-		// Calculate the average time step for debugging performance
-		auto t3 = std::chrono::steady_clock::now();
-		std::chrono::duration<float> dt2 = t3 - t2;
-		static double sommeDt2 = 0.0;
-		sommeDt2 += static_cast<double>(dt2.count());
-		double avg2 = sommeDt2 / static_cast<double>(count);
+/*
+* Enable or disable the tuning of the batch sizes, the batch sizes go back to their defaults
+* Can be called while the simulation is running.
+*
+* @param isEnabled Tune the batch sizes, or keep the default ones
+* @return void
+*/
+void Orchestrator::setBatchSizeTuning(const bool isEnabled)
+{
+	m_useBatchSizeTuning = isEnabled;
+	m_resetBatchSizes = true;
+}
 
-		// From here, all particles' position and previousPosition are the same
-		// So we can resolve the collisions between the particles using the particles' previousPosition
 
-		// Then, resolve the collisions between the cloths
-		if (m_pAppData->m_pGridCollider)
-		{
-			std::vector<std::vector<std::shared_ptr<GridCell>>> CellsFromReadGrid;
-			size_t cellsCount = 0;
+/*
+* Choose how the grid of the collisions between the cloths is built
+* Can be called while the simulation is running, the graph of the next step is rebuilt.
+*
+* @param isEnabled Build the grid by a counting sort (SortedGridCollider), or lock its cells (StaticGridCollider)
+* @return void
+*/
+void Orchestrator::setSortedGridCollider(const bool isEnabled)
+{
+	m_useSortedGridCollider = isEnabled;
+}
 
-			// Loop over all the non-empty (existing) grid cells
-			//for (auto& cell : m_pAppData->m_pGridCollider->m_gridRead) // HashGrid
-			for (auto& pCell : m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead)
-			{
-				// Create batches of cells to allow parallelism
-				if (cellsCount > cellsBatchSize || CellsFromReadGrid.size() == 0)
-				{
-					CellsFromReadGrid.push_back(std::vector<std::shared_ptr<GridCell>>());
-					cellsCount = 0;
-				}
-				cellsCount++;
 
-				//CellsFromReadGrid.back().push_back(cell.second); // HashGrid
-				CellsFromReadGrid.back().push_back(pCell);
-			}
+/*
+* Enable or disable the culling of the particles before the sorted grid: only the patches of the cloths whose boxes
+* overlap another cloth, or a fold of their cloth, are added to the grid (see ClothSweepAndPrune)
+* Can be called while the simulation is running, the graph of the next step is rebuilt. Needs the sorted grid.
+*
+* @param isEnabled Cull the particles, or add all of them to the grid
+* @return void
+*/
+void Orchestrator::setCollisionCulling(const bool isEnabled)
+{
+	m_useCollisionCulling = isEnabled;
+}
 
-			// Create tasks to resolve the collisions between the particles
-			for (auto& cellsBatch : CellsFromReadGrid)
-			{
-				m_taskQueue.addTask(
-					[this, cellsBatch]() {
-						m_pAppData->updateCollisions(cellsBatch);
-					});
-			}
+
+/*
+* Get what the culling of the last step kept for the grid
+*
+* @return ClothCullingStats The overlapping cloths and the active patches
+*/
+ClothCullingStats Orchestrator::getCullingStats() const
+{
+	std::lock_guard<std::mutex> lock(m_cullingStatsMutex);
+	return m_cullingStats;
+}
+
+
+/*
+* Get the state of the tuning of the number of rows of a cloth handled by a task
+*
+* @return BatchSizeTunerStats The batch size of the rows and how it was chosen
+*/
+BatchSizeTunerStats Orchestrator::getRowBatchStats() const
+{
+	std::lock_guard<std::mutex> lock(m_batchStatsMutex);
+	return m_rowBatchStats;
+}
+
+
+/*
+* Get the state of the tuning of the number of cells of the grid handled by a collision task
+*
+* @return BatchSizeTunerStats The batch size of the cells and how it was chosen
+*/
+BatchSizeTunerStats Orchestrator::getCellBatchStats() const
+{
+	std::lock_guard<std::mutex> lock(m_batchStatsMutex);
+	return m_cellBatchStats;
+}
+
+
+/*
+* Start recording a trace of the tasks executed by each thread, the previous trace is discarded
+* The trace starts before the next step (or when the simulation starts).
+*
+* @param maxEventsPerThread The number of events a thread can record, the next ones are dropped
+* @return void
+*/
+void Orchestrator::startTrace(const size_t maxEventsPerThread)
+{
+	std::lock_guard<std::mutex> lock(m_traceRequestMutex);
+	m_isTraceStartRequested = true;
+	m_traceMaxEventsPerThread = maxEventsPerThread;
+	m_traceStopPath.clear();
+	m_hasTraceRequest = true;
+}
+
+
+/*
+* Stop recording the trace and write it to a file in the Chrome trace event JSON format
+* The trace stops after the current step (or when the simulation stops).
+*
+* @param path The path of the file
+* @return void
+*/
+void Orchestrator::stopTrace(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_traceRequestMutex);
+	m_isTraceStartRequested = false;
+	m_traceStopPath = path;
+	m_hasTraceRequest = true;
+}
+
+
+/*
+* Start or stop the trace as requested, must be called while no task is running
+*
+* @return void
+*/
+void Orchestrator::applyTraceRequests()
+{
+	std::lock_guard<std::mutex> lock(m_traceRequestMutex);
+	m_hasTraceRequest = false;
+
+	if (m_isTraceStartRequested)
+	{
+		m_isTraceStartRequested = false;
+		m_traceRecorder.start(m_traceMaxEventsPerThread);
+	}
+	else if (!m_traceStopPath.empty())
+	{
+		m_traceRecorder.stop();
+		if (m_traceRecorder.writeChromeTrace(m_traceStopPath))
+		{
+			std::cout << "Trace written to " << m_traceStopPath << " (" << m_traceRecorder.getEventCount() << " events, "
+				<< m_traceRecorder.getDroppedEventCount() << " dropped)" << std::endl;
+		}
+		else
+		{
+			std::cerr << "Error: can not write the trace to " << m_traceStopPath << std::endl;
 		}
+		m_traceStopPath.clear();
+	}
+}
+
+
+/*
+* Use a fixed time step (or go back to the clamped wall clock time step)
+* With a fixed time step, every tick of 'tickTime' seconds of wall time is simulated in 'substepCount' steps.
+* If the simulation is late by more than 'maxCatchUpTime' seconds, the extra time is dropped instead of
+* being caught up, to avoid a spiral of death when the machine is too slow.
+* Can be called while the simulation is running.
+*
+* @param isEnabled True to use a fixed time step
+* @param tickTime Simulated time of a tick
+* @param substepCount Number of steps per tick (raised if a substep would be larger than the cloths allow)
+* @param maxCatchUpTime Maximum simulated time that can be owed to the wall clock
+* @return void
+*/
+void Orchestrator::setFixedTimeStep(const bool isEnabled, const double tickTime, const int substepCount, const double maxCatchUpTime)
+{
+	m_fixedTimeStep = std::max(tickTime, 1e-6);
+	m_substepCount = std::max(substepCount, 1);
+	m_maxCatchUpTime = maxCatchUpTime;
+	m_useFixedTimeStep = isEnabled;
+}
 
-		// Wait until all collisions to be reselved before setting their previous position and velocity
-		m_taskQueue.waitUntilEmpty();
 
-		// Calculate the average time step for debugging performance
-		auto t4 = std::chrono::steady_clock::now();
-		std::chrono::duration<float> dt3 = t4 - t3;
-		static double sommeDt3 = 0.0;
-		sommeDt3 += static_cast<double>(dt3.count());
-		double avg3 = sommeDt3 / static_cast<double>(count);
+/*
+* Get the simulated time and the wall time since the simulation started
+*
+* @return OrchestratorTimeStats The time statistics
+*/
+OrchestratorTimeStats Orchestrator::getTimeStats() const
+{
+	OrchestratorTimeStats stats;
+	stats.m_simulatedTime = m_simulatedTime;
+	stats.m_wallTime = m_wallTime;
+	stats.m_droppedTime = m_droppedTime;
+	stats.m_lastTimeStep = m_lastTimeStep;
+	return stats;
+}
+
 
-		// Update previousPositions
-		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+/*
+* Let the time step follow the motion of the cloths (or go back to the largest stable time step)
+* The time step is picked before each step from the speed of the particles (CFL condition, on the smallest
+* of the particle collider radius and of the grid cell size) and from the strain of the springs.
+* Can be called while the simulation is running.
+*
+* @param isEnabled True to use an adaptive time step
+* @param tolerance Fraction of the CFL length (and of the strain limit) allowed per step
+* @param strainLimit Largest strain of the springs before slowing down
+* @param minTimeStep Smallest time step
+* @param maxTimeStep Largest time step (the stability limit of the cloths still applies)
+* @return void
+*/
+void Orchestrator::setAdaptiveTimeStep(const bool isEnabled, const double tolerance, const double strainLimit, const double minTimeStep, const double maxTimeStep)
+{
+	m_adaptiveTolerance = tolerance;
+	m_adaptiveStrainLimit = strainLimit;
+	m_adaptiveMinTimeStep = std::max(minTimeStep, 1e-6);
+	m_adaptiveMaxTimeStep = std::max(maxTimeStep, m_adaptiveMinTimeStep.load());
+	m_useAdaptiveTimeStep = isEnabled;
+}
+
+
+/*
+* Get the details of the last time step selected by the adaptive time step
+*
+* @return AdaptiveTimeStepStats The stats of the adaptive time step
+*/
+AdaptiveTimeStepStats Orchestrator::getAdaptiveTimeStepStats() const
+{
+	std::lock_guard<std::mutex> lock(m_adaptiveStatsMutex);
+	return m_adaptiveTimeStepStats;
+}
+
+
+/*
+* Change how the worker threads wait for tasks, and how the orchestrator thread waits for the phases of a step:
+* spinning a while before sleeping reacts faster, sleeping right away leaves the cores to the other threads (rendering)
+* Can be called while the simulation is running.
+*
+* @param waitPolicy The wait policy
+* @return void
+*/
+void Orchestrator::setWaitPolicy(const TaskWaitPolicy& waitPolicy)
+{
+	m_pTaskQueue->setWaitPolicy(waitPolicy);
+}
+
+
+/*
+* Select the next time step from the motion of the cloths during the last step
+*
+* @param maxTimeStep Largest time step all the cloths are stable with
+* @return double The time step
+*/
+double Orchestrator::selectTimeStep(const double maxTimeStep)
+{
+	m_adaptiveTimeStep.m_tolerance = m_adaptiveTolerance;
+	m_adaptiveTimeStep.m_strainLimit = m_adaptiveStrainLimit;
+	m_adaptiveTimeStep.m_minTimeStep = m_adaptiveMinTimeStep;
+	m_adaptiveTimeStep.m_maxTimeStep = m_adaptiveMaxTimeStep;
+
+	// The grid cell size is the natural CFL length, unless the particles are smaller
+	const double cellSize = m_pAppData->m_pGridCollider ? m_pAppData->m_pGridCollider->getCellSize() : std::numeric_limits<double>::max();
+
+	m_adaptiveTimeStep.reset();
+	for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	{
+		if (pCloth)
 		{
-			if (pCloth)
-			{
-				for (int i = 0; i < pCloth->m_resX; i += resxBatchSize)
-				{
-					int startResX = i;
-					int endResX = std::min(startResX + resxBatchSize, pCloth->m_resX);
-
-					m_taskQueue.addTask(
-						[this, pCloth, startResX, endResX]() {
-							// Update the previous position and velocity
-							pCloth->updatePreviousPositionAndVelocity(startResX, endResX);
-						});
-				}
-			}
+			m_adaptiveTimeStep.addCloth(pCloth->getMotionBounds(), std::min(pCloth->m_store.m_radius, cellSize));
 		}
+	}
+	const double timeStep = m_adaptiveTimeStep.selectTimeStep(maxTimeStep);
 
-		// Clear the read grid
-		for (size_t i = 0; i < m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead.size(); i += cellsBatchSize)
+	std::lock_guard<std::mutex> lock(m_adaptiveStatsMutex);
+	m_adaptiveTimeStepStats = m_adaptiveTimeStep.getStats();
+
+	return timeStep;
+}
+
+
+/*
+* Get the largest time step all the cloths are stable with
+*
+* @return double The maximum time step
+*/
+double Orchestrator::getMaxTimeStep() const
+{
+	double maxTimeStep = std::numeric_limits<double>::max();
+	for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	{
+		if (pCloth)
 		{
-			size_t start = i;
-			size_t end = std::min(start + cellsBatchSize, m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead.size());
-			m_taskQueue.addTask(
-				[this, start, end]() {
-					m_pAppData->m_pGridCollider->clearGridParallelized(start, end);
-				});
+			maxTimeStep = std::min(maxTimeStep, pCloth->getMaxTimeStep());
 		}
+	}
 
-		// Wait until all clothes' to be ready for the next update
-		m_taskQueue.waitUntilEmpty();
+	// Default limit, without any cloth
+	if (maxTimeStep == std::numeric_limits<double>::max())
+	{
+		maxTimeStep = 0.005;
+	}
 
-		//std::cout << "MEMORY : " << (m_pAppData->m_pGridCollider->getMemorySize() / (1024 * 1024)) << " Mo" << std::endl;
+	return maxTimeStep;
+}
 
 
-		// Clear the list of pointers to non-empty cells of the read grid
-		m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead.clear();
-		// Swap the read and write grids (fast if m_listOfPointerToNonEmptyCellsRead is already cleared)
-		m_pAppData->m_pGridCollider->swap();
+/*
+* Run the orchestrator
+* This is the main simulation thread
+* Converts the wall time into simulation steps: either one step per loop with the (clamped) elapsed time,
+* or with a fixed time step, ticks of a constant length consumed from an accumulator
+* 
+* @return void
+*/
+void Orchestrator::runOrchestrator()
+{
+	// Fixed time step state
+	double accumulator = 0.0;
+	double lastReportTime = 0.0;
 
-		// Calculate the average time step for debugging performance
-		auto t5 = std::chrono::steady_clock::now();
-		std::chrono::duration<float> dt4 = t5 - t4;
-		static double sommeDt4 = 0.0;
-		sommeDt4 += static_cast<double>(dt4.count());
-		double avg4 = sommeDt4 / static_cast<double>(count);
-		avg4 = avg4;
+	// The orchestrator thread executes tasks while it waits, it runs on the cores of the workers
+	if (!m_orchestratorCpus.empty())
+	{
+		ThreadPoolConfig::pinCurrentThread(m_orchestratorCpus);
 	}
-}
\ No newline at end of file
+
+	m_traceRecorder.setThreadName("orchestrator");
+	std::cout << "Orchestrator running (" << SimdDispatch::getIsaName(SimdDispatch::getActiveIsa()) << " kernels)" << std::endl;
+
+	// Main simulation loop
+	// An exception thrown by a task of a step is rethrown here, it stops the simulation
+	try
+	{
+		while (m_orchestratorRunning)
+		{
+			// Start or stop the trace between two steps
+			if (m_hasTraceRequest)
+			{
+				applyTraceRequests();
+			}
+
+			// Calculate the time elapsed since the last update
+			auto currentTime = std::chrono::steady_clock::now();
+			std::chrono::duration<double> deltaTime = currentTime - m_lastUpdateTime;
+			m_lastUpdateTime = currentTime;
+			double elapsedTimeInSeconds = deltaTime.count();
+
+			// Time between two loops, with the waits of the fixed time step
+			const int64_t frameNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(deltaTime).count();
+			m_profiler.addSample(Frame, m_profiler.now() - frameNanoseconds, frameNanoseconds);
+
+			const double maxTimeStep = getMaxTimeStep();
+
+			if (m_useFixedTimeStep)
+			{
+				// Fixed time step: the wall time is accumulated and consumed by ticks of a constant length,
+				// each tick is simulated in several substeps (more if the cloths need smaller steps)
+				const double tickTime = m_fixedTimeStep;
+				const int substeps = std::max({ 1, m_substepCount.load(), static_cast<int>(std::ceil(tickTime / maxTimeStep - 1e-9)) });
+				const double substepTime = tickTime / static_cast<double>(substeps);
+
+				// When the simulation can not keep up, the time beyond the catch up budget is dropped
+				const double maxCatchUpTime = std::max(m_maxCatchUpTime.load(), tickTime);
+				accumulator += elapsedTimeInSeconds;
+				if (accumulator > maxCatchUpTime)
+				{
+					m_droppedTime = m_droppedTime + (accumulator - maxCatchUpTime);
+					accumulator = maxCatchUpTime;
+				}
+
+				while (accumulator >= tickTime && m_orchestratorRunning)
+				{
+					if (m_useAdaptiveTimeStep)
+					{
+						// The tick is consumed by steps picked from the motion of the cloths, the last one ends it exactly
+						double remainingTime = tickTime;
+						while (remainingTime > 0.0)
+						{
+							const double timeStep = m_adaptiveTimeStep.fitToRemainingTime(selectTimeStep(maxTimeStep), remainingTime);
+							stepSimulation(timeStep);
+							remainingTime -= timeStep;
+						}
+					}
+					else
+					{
+						for (int substep = 0; substep < substeps; ++substep)
+						{
+							stepSimulation(substepTime);
+						}
+					}
+					accumulator -= tickTime;
+					m_simulatedTime = m_simulatedTime + tickTime;
+				}
+
+				// Wait for the next tick instead of spinning
+				MeasuredScope scope(m_profiler, m_traceRecorder, FrameWait);
+				std::this_thread::sleep_for(std::chrono::duration<double>(tickTime - accumulator));
+			}
+			else
+			{
+				// Clamp the time step to avoid huge time steps
+				// This is a simple way to avoid instability in the simulation
+				// But we lose real time in that case
+				// The limit is set by the integration mode of the cloths, the XPBD cloths allow frame sized steps,
+				// or by the motion of the cloths with the adaptive time step
+				const double timeStep = m_useAdaptiveTimeStep ? selectTimeStep(maxTimeStep) : maxTimeStep;
+				if (elapsedTimeInSeconds > timeStep)
+				{
+					m_droppedTime = m_droppedTime + (elapsedTimeInSeconds - timeStep);
+					elapsedTimeInSeconds = timeStep;
+				}
+
+				stepSimulation(elapsedTimeInSeconds);
+				m_simulatedTime = m_simulatedTime + elapsedTimeInSeconds;
+			}
+
+			m_wallTime = m_wallTime + deltaTime.count();
+
+			// Report if the simulation keeps real time
+			if (m_wallTime - lastReportTime >= 5.0)
+			{
+				lastReportTime = m_wallTime;
+				const OrchestratorTimeStats stats = getTimeStats();
+				std::cout << "Simulated time / wall time: " << stats.getRealTimeRatio() << " (" << stats.m_droppedTime << " s dropped)" << std::endl;
+			}
+		}
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "Error: the simulation stopped, " << exception.what() << std::endl;
+		m_orchestratorRunning = false;
+	}
+}
+
+
+/*
+* Advance the simulation by one step
+* Runs the graph of the tasks of the step (see buildStepGraph()), rebuilt only when the cloths change
+* 
+* @param elapsedTimeInSeconds Time step, must not be larger than getMaxTimeStep()
+* @return void
+*/
+void Orchestrator::stepSimulation(const double elapsedTimeInSeconds)
+{
+	m_stepCount++;
+	m_lastTimeStep = elapsedTimeInSeconds;
+
+	if (m_resetBatchSizes.exchange(false))
+	{
+		resetBatchSizeTuners();
+	}
+
+	const int64_t stepStartTime = m_profiler.now();
+
+	// Select the batches of rows to simulate, the batches where all the particles sleep are skipped
+	// (with the batch size the graph is built with below)
+	const int rowBatchSize = m_rowBatchTuner.getBatchSize();
+	int awakeBatches = 0;
+	{
+		MeasuredScope scope(m_profiler, m_traceRecorder, StepAwakeBatches);
+		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+		{
+			if (pCloth)
+			{
+				awakeBatches += pCloth->updateAwakeBatches(rowBatchSize);
+			}
+		}
+	}
+	if (awakeBatches == 0)
+	{
+		// The whole scene is at rest, nothing can move until something wakes it up
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return;
+	}
+
+	if (!isStepGraphValid())
+	{
+		MeasuredScope scope(m_profiler, m_traceRecorder, StepBuildGraph);
+		buildStepGraph();
+	}
+
+	// The tasks of the graph read the parameters of the step from here
+	m_stepTimeStep = elapsedTimeInSeconds;
+	m_stepMeasureMotion = m_useAdaptiveTimeStep;
+	// The sorted grid is built by the graph, its scan sets the number of cells
+	m_stepCellCount = 0;
+	if (!m_stepUsesSortedGrid && m_pAppData->m_pGridCollider)
+	{
+		m_stepCellCount = m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead.size();
+	}
+	m_stepCellBatchSize = static_cast<size_t>(m_cellBatchTuner.getBatchSize());
+	m_nextCollisionCell = 0;
+	m_nextClearedCell = 0;
+
+	// The orchestrator thread executes tasks while waiting for the end of the graph
+	{
+		MeasuredScope scope(m_profiler, m_traceRecorder, StepRunGraph);
+		m_stepGraph.run(*m_pTaskQueue);
+	}
+
+	//std::cout << "MEMORY : " << (m_pAppData->m_pGridCollider->getMemorySize() / (1024 * 1024)) << " Mo" << std::endl;
+
+	// Tune the batch sizes from the durations of the tasks, a new row batch size rebuilds the graph at the next step
+	{
+		MeasuredScope scope(m_profiler, m_traceRecorder, StepTuning);
+		updateBatchSizes(static_cast<size_t>(awakeBatches) * static_cast<size_t>(rowBatchSize));
+	}
+
+	{
+		MeasuredScope scope(m_profiler, m_traceRecorder, StepSwap);
+
+		// The state written by the step becomes the previous state of the next one
+		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+		{
+			if (pCloth)
+			{
+				pCloth->swapStateBuffers();
+			}
+		}
+
+		if (m_stepUsesSortedGrid)
+		{
+			// Forget the non-empty cells, their counts have been cleared by the graph
+			m_pAppData->m_pSortedGridCollider->swap();
+		}
+		else if (m_pAppData->m_pGridCollider)
+		{
+			// Clear the list of pointers to non-empty cells of the read grid
+			m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead.clear();
+			// Swap the read and write grids (fast if m_listOfPointerToNonEmptyCellsRead is already cleared)
+			m_pAppData->m_pGridCollider->swap();
+		}
+	}
+
+	// Aggregate the samples of the step, no task is running
+	recordScope(m_profiler, m_traceRecorder, Step, stepStartTime, m_profiler.now() - stepStartTime);
+	m_profiler.collect();
+}
+
+
+/*
+* Start tuning the batch sizes again from their defaults
+* The rows of an XPBD batch must cover the reach of its constraints (see XpbdSolver)
+*
+* @return void
+*/
+void Orchestrator::resetBatchSizeTuners()
+{
+	m_rowBatchTuner.reset(s_defaultRowBatchSize, XpbdSolver::getReachRows(), s_maxRowBatchSize);
+	m_cellBatchTuner.reset(s_defaultCellBatchSize, 1, s_maxCellBatchSize);
+
+	std::lock_guard<std::mutex> lock(m_batchStatsMutex);
+	m_rowBatchStats = m_rowBatchTuner.getStats();
+	m_cellBatchStats = m_cellBatchTuner.getStats();
+}
+
+
+/*
+* Give the tasks durations of the step to the batch size tuners, and report the batch sizes once they are locked
+* Called after the graph of a step, when no task is running.
+*
+* @param awakeRowCount The number of rows simulated during the step
+* @return void
+*/
+void Orchestrator::updateBatchSizes(const size_t awakeRowCount)
+{
+	if (!m_useBatchSizeTuning)
+	{
+		return;
+	}
+
+	// The orchestrator thread executes tasks too
+	const size_t threadCount = m_numberOfThreads + 1;
+	const bool wasLocked = m_rowBatchTuner.isLocked() && m_cellBatchTuner.isLocked();
+	m_rowBatchTuner.endStep(threadCount, awakeRowCount);
+	m_cellBatchTuner.endStep(threadCount, m_stepCellCount);
+	{
+		std::lock_guard<std::mutex> lock(m_batchStatsMutex);
+		m_rowBatchStats = m_rowBatchTuner.getStats();
+		m_cellBatchStats = m_cellBatchTuner.getStats();
+	}
+
+	if (!wasLocked && m_rowBatchTuner.isLocked() && m_cellBatchTuner.isLocked())
+	{
+		const BatchSizeTunerStats& rowStats = m_rowBatchTuner.getStats();
+		const BatchSizeTunerStats& cellStats = m_cellBatchTuner.getStats();
+		std::cout << "Batch sizes locked: " << rowStats.m_batchSize << " rows (" << rowStats.m_costPerItem * 1e6 << " us per row), "
+			<< cellStats.m_batchSize << " cells (" << cellStats.m_costPerItem * 1e6 << " us per cell)" << std::endl;
+	}
+}
+
+
+/*
+* Get what the graph of a step depends on for a cloth
+*
+* @param cloth The cloth
+* @return StepGraphCloth The description of the cloth
+*/
+Orchestrator::StepGraphCloth Orchestrator::getStepGraphCloth(const Cloth& cloth) const
+{
+	StepGraphCloth stepGraphCloth;
+	stepGraphCloth.m_pCloth = &cloth;
+	stepGraphCloth.m_resX = cloth.m_resX;
+	stepGraphCloth.m_integrationMode = cloth.m_integrationMode;
+	stepGraphCloth.m_springModel = cloth.m_springModel;
+	stepGraphCloth.m_xpbdIterations = (cloth.m_integrationMode == IntegrationMode::Xpbd) ? cloth.m_xpbdSolver.m_iterations : 0;
+	return stepGraphCloth;
+}
+
+
+/*
+* Check if the graph of a step has been built for the current cloths
+* Does not allocate, it is called before each step
+*
+* @return bool True if the graph can be replayed
+*/
+bool Orchestrator::isStepGraphValid() const
+{
+	if (!m_stepGraph.isBuilt() || m_stepRowBatchSize != m_rowBatchTuner.getBatchSize())
+	{
+		return false;
+	}
+	if (m_stepUsesSortedGrid != (m_useSortedGridCollider && m_pAppData->m_pSortedGridCollider))
+	{
+		return false;
+	}
+	if (m_stepUsesCulling != (m_stepUsesSortedGrid && m_useCollisionCulling))
+	{
+		return false;
+	}
+
+	size_t clothIndex = 0;
+	for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	{
+		if (!pCloth)
+		{
+			continue;
+		}
+		if (clothIndex >= m_stepGraphCloths.size() || !(m_stepGraphCloths[clothIndex] == getStepGraphCloth(*pCloth)))
+		{
+			return false;
+		}
+		clothIndex++;
+	}
+
+	return clothIndex == m_stepGraphCloths.size();
+}
+
+
+/*
+* Build the graph of the tasks of a step
+* The tasks work on batches of rows of a cloth, and only wait for the batches they share rows with (the reach
+* of the springs is smaller than a batch): the batches of a cloth form a pipeline, and the cloths do not wait for
+* each other.
+* The collisions between the cloths are the only join: they need the state of all the cloths, they run on
+* regions of the grid (batches of non-empty cells), then the cloths apply the contacts while the read grid is cleared.
+* The bounds of each cloth are built after its last batch (see ClothBounds).
+* With the sorted grid, the grid of the step is built between the join and the collisions (see addSortedGridNodes()).
+* With the culling, the particles are added to it after the join, only those of the patches that can touch another
+* particle (see ClothSweepAndPrune).
+* The contacts are summed in a fixed order (see ContactBuffer): the step is deterministic for any number of threads.
+* The state is double buffered, the buffers are swapped after the graph (see ClothParticleStore).
+* The asleep batches are checked by the tasks when the graph runs, they do not change the graph.
+* The graph is built for the current row batch size, a new one from the tuner rebuilds it (see updateBatchSizes()).
+*
+* @return void
+*/
+void Orchestrator::buildStepGraph()
+{
+	m_stepGraph.clear();
+	m_stepGraphCloths.clear();
+	m_stepRowBatchSize = m_rowBatchTuner.getBatchSize();
+	m_stepUsesSortedGrid = m_useSortedGridCollider && m_pAppData->m_pSortedGridCollider;
+	m_stepUsesCulling = m_stepUsesSortedGrid && m_useCollisionCulling;
+	m_stepClothBounds.clear();
+	if (m_stepUsesSortedGrid)
+	{
+		// Each particle of the cloths has a handle in the sorted grid, the graph is rebuilt when the cloths change
+		m_pAppData->m_pSortedGridCollider->clearCloths();
+		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+		{
+			if (pCloth)
+			{
+				m_pAppData->m_pSortedGridCollider->registerCloth(pCloth->m_uidIndex, pCloth->m_resX, pCloth->m_resY, pCloth.get());
+			}
+		}
+	}
+
+	// Task building the bounds of each cloth, after the last task writing the positions of each of its batches
+	std::vector<TaskGraph::NodeId> boundsNodes;
+
+	for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	{
+		if (!pCloth)
+		{
+			continue;
+		}
+		m_stepGraphCloths.push_back(getStepGraphCloth(*pCloth));
+		m_stepClothBounds.push_back(&pCloth->m_bounds);
+
+		std::vector<TaskGraph::NodeId> integrationNodes;
+		if (pCloth->m_integrationMode == IntegrationMode::Xpbd)
+		{
+			addXpbdClothNodes(pCloth, integrationNodes);
+		}
+		else if (pCloth->m_integrationMode == IntegrationMode::Implicit)
+		{
+			addImplicitClothNodes(pCloth, integrationNodes);
+		}
+		else
+		{
+			addExplicitClothNodes(pCloth, integrationNodes);
+		}
+
+		boundsNodes.push_back(m_stepGraph.addNode(
+			[this, pCloth]() {
+				MeasuredScope scope(m_profiler, m_traceRecorder, TaskBounds, static_cast<int64_t>(pCloth->m_uidIndex));
+				pCloth->m_bounds.build();
+			}));
+		for (const TaskGraph::NodeId integrationNode : integrationNodes)
+		{
+			m_stepGraph.addDependency(integrationNode, boundsNodes.back());
+		}
+	}
+
+	// From here, the current state of all the particles is written, and not modified by the collisions:
+	// they accumulate their responses, so they read a consistent state
+	const TaskGraph::NodeId collisionsReadyNode = m_stepGraph.addNode([]() {});
+	for (const TaskGraph::NodeId boundsNode : boundsNodes)
+	{
+		m_stepGraph.addDependency(boundsNode, collisionsReadyNode);
+	}
+	const TaskGraph::NodeId collisionsDoneNode = m_stepGraph.addNode([]() {});
+
+	// Add the particles of the patches that can touch another particle to the grid, by batches of rows
+	TaskGraph::NodeId gridFilledNode = collisionsReadyNode;
+	if (m_stepUsesCulling)
+	{
+		const TaskGraph::NodeId cullingNode = m_stepGraph.addNode(
+			[this]() {
+				MeasuredScope scope(m_profiler, m_traceRecorder, TaskCulling);
+				m_clothSweepAndPrune.cull(m_stepClothBounds);
+
+				std::lock_guard<std::mutex> lock(m_cullingStatsMutex);
+				m_cullingStats = m_clothSweepAndPrune.getStats();
+			});
+		m_stepGraph.addDependency(collisionsReadyNode, cullingNode);
+
+		gridFilledNode = m_stepGraph.addNode([]() {});
+		for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+		{
+			if (!pCloth)
+			{
+				continue;
+			}
+			for (int startResX = 0; startResX < pCloth->m_resX; startResX += m_stepRowBatchSize)
+			{
+				const int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+				const TaskGraph::NodeId fillNode = m_stepGraph.addNode(
+					[this, pCloth, startResX, endResX]() {
+						MeasuredScope scope(m_profiler, m_traceRecorder, TaskBuildGrid, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+						pCloth->addActiveParticlesToGrid(m_pAppData->m_pSortedGridCollider, startResX, endResX);
+					});
+				m_stepGraph.addDependency(cullingNode, fillNode);
+				m_stepGraph.addDependency(fillNode, gridFilledNode);
+			}
+		}
+	}
+
+	// Resolve the collisions between the cloths: each task takes batches of non-empty cells of the read grid until
+	// there are none left (their number changes at each step, not the number of tasks)
+	// Each task writes the contacts it finds to its own buffer, sorted so the cloths can sum them in a fixed order
+	const size_t cellTaskCount = m_numberOfThreads + 1;
+	m_contactBuffers.resize(cellTaskCount);
+	const TaskGraph::NodeId gridReadyNode = m_stepUsesSortedGrid ? addSortedGridNodes(gridFilledNode, cellTaskCount) : collisionsReadyNode;
+	for (size_t t = 0; t < cellTaskCount; ++t)
+	{
+		const TaskGraph::NodeId collisionNode = m_stepGraph.addNode(
+			[this, t]() {
+				ContactBuffer& contacts = m_contactBuffers[t];
+				contacts.clear();
+
+				size_t cellFrom = m_nextCollisionCell.fetch_add(m_stepCellBatchSize, std::memory_order_relaxed);
+				while (cellFrom < m_stepCellCount)
+				{
+					const size_t cellTo = std::min(cellFrom + m_stepCellBatchSize, m_stepCellCount);
+					const int64_t startTime = m_profiler.now();
+					if (m_stepUsesSortedGrid)
+					{
+						m_pAppData->updateCollisions(*m_pAppData->m_pSortedGridCollider, cellFrom, cellTo, contacts);
+					}
+					else
+					{
+						m_pAppData->updateCollisions(m_pAppData->m_pGridCollider->m_listOfPointerToNonEmptyCellsRead, cellFrom, cellTo, contacts);
+					}
+					const int64_t duration = m_profiler.now() - startTime;
+					m_cellBatchTuner.addSample(static_cast<uint64_t>(duration), cellTo - cellFrom);
+					recordScope(m_profiler, m_traceRecorder, TaskCollisions, startTime, duration, -1, "cells", static_cast<int64_t>(cellFrom), static_cast<int64_t>(cellTo));
+
+					cellFrom = m_nextCollisionCell.fetch_add(m_stepCellBatchSize, std::memory_order_relaxed);
+				}
+				contacts.sort();
+			});
+		m_stepGraph.addDependency(gridReadyNode, collisionNode);
+		m_stepGraph.addDependency(collisionNode, collisionsDoneNode);
+
+		// Clear the read grid
+		const TaskGraph::NodeId clearNode = m_stepGraph.addNode(
+			[this]() {
+				MeasuredScope scope(m_profiler, m_traceRecorder, TaskClearGrid);
+				GridCollider& grid = m_stepUsesSortedGrid ? static_cast<GridCollider&>(*m_pAppData->m_pSortedGridCollider) : *m_pAppData->m_pGridCollider;
+				size_t cellFrom = m_nextClearedCell.fetch_add(m_stepCellBatchSize, std::memory_order_relaxed);
+				while (cellFrom < m_stepCellCount)
+				{
+					grid.clearGridParallelized(cellFrom, std::min(cellFrom + m_stepCellBatchSize, m_stepCellCount));
+					cellFrom = m_nextClearedCell.fetch_add(m_stepCellBatchSize, std::memory_order_relaxed);
+				}
+			});
+		m_stepGraph.addDependency(collisionsDoneNode, clearNode);
+	}
+
+	for (auto& pCloth : m_pAppData->m_pCloths.m_pCloths)
+	{
+		if (!pCloth)
+		{
+			continue;
+		}
+
+		// Apply the contacts, the asleep batches too: a contact wakes them up
+		std::vector<TaskGraph::NodeId> contactNodes;
+		for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+		{
+			int startResX = i;
+			int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+			contactNodes.push_back(m_stepGraph.addNode(
+				[this, pCloth, startResX, endResX]() {
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskContacts, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+					pCloth->applyContacts(m_contactBuffers, startResX, endResX);
+				}));
+			m_stepGraph.addDependency(collisionsDoneNode, contactNodes.back());
+		}
+
+		// The measure of a batch reads the first row of the next batch
+		const int nbBatches = static_cast<int>(contactNodes.size());
+		for (int b = 0; b < nbBatches; ++b)
+		{
+			const int startResX = b * m_stepRowBatchSize;
+			const int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+			const TaskGraph::NodeId measureNode = m_stepGraph.addNode(
+				[this, pCloth, startResX, endResX]() {
+					if (!pCloth->isBatchAwake(startResX))
+					{
+						return;
+					}
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskMeasure, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+
+					// Measure the motion of the step to select the next time step
+					if (m_stepMeasureMotion)
+					{
+						pCloth->measureMotion(startResX, endResX);
+					}
+
+					// Put the particles at rest to sleep, and count the awake ones for the next step
+					pCloth->updateSleepStates(startResX, endResX);
+				});
+			m_stepGraph.addDependency(contactNodes[b], measureNode);
+			if (b + 1 < nbBatches)
+			{
+				m_stepGraph.addDependency(contactNodes[b + 1], measureNode);
+			}
+		}
+	}
+
+	m_stepGraph.build();
+}
+
+
+/*
+* Add the tasks building the sorted grid from the particles added to it by the step
+* The chunks of cells and of particles are split in contiguous ranges, one per task, and each phase waits for the
+* previous one: count the particles of the cells, scan the counts (a single task, one value per chunk), write where
+* each cell starts, then scatter the particles to their cells.
+*
+* @param gridFilledNode The task after which all the particles of the step are added to the grid
+* @param taskCount The number of tasks of each parallel phase
+* @return TaskGraph::NodeId The task after which the grid is built
+*/
+TaskGraph::NodeId Orchestrator::addSortedGridNodes(const TaskGraph::NodeId gridFilledNode, const size_t taskCount)
+{
+	SortedGridCollider* pGrid = m_pAppData->m_pSortedGridCollider.get();
+	const size_t cellChunkCount = pGrid->getCellChunkCount();
+	const size_t particleChunkCount = pGrid->getParticleChunkCount();
+
+	// Tasks of a parallel phase over the chunks, joined by an empty task
+	auto addPhase = [this, taskCount](const TaskGraph::NodeId previousNode, const size_t chunkCount, std::function<void(size_t, size_t)> work) {
+		const TaskGraph::NodeId phaseDoneNode = m_stepGraph.addNode([]() {});
+		for (size_t t = 0; t < taskCount; ++t)
+		{
+			const size_t chunkFrom = chunkCount * t / taskCount;
+			const size_t chunkTo = chunkCount * (t + 1) / taskCount;
+			if (chunkFrom == chunkTo)
+			{
+				continue;
+			}
+			const TaskGraph::NodeId phaseNode = m_stepGraph.addNode(
+				[this, chunkFrom, chunkTo, work]() {
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskBuildGrid);
+					work(chunkFrom, chunkTo);
+				});
+			m_stepGraph.addDependency(previousNode, phaseNode);
+			m_stepGraph.addDependency(phaseNode, phaseDoneNode);
+		}
+		return phaseDoneNode;
+	};
+
+	const TaskGraph::NodeId countedNode = addPhase(gridFilledNode, cellChunkCount,
+		[pGrid](const size_t chunkFrom, const size_t chunkTo) { pGrid->countCells(chunkFrom, chunkTo); });
+
+	const TaskGraph::NodeId scanNode = m_stepGraph.addNode(
+		[this, pGrid]() {
+			MeasuredScope scope(m_profiler, m_traceRecorder, TaskBuildGrid);
+			pGrid->scanCells();
+			m_stepCellCount = pGrid->getNonEmptyCellCount();
+		});
+	m_stepGraph.addDependency(countedNode, scanNode);
+
+	const TaskGraph::NodeId startsNode = addPhase(scanNode, cellChunkCount,
+		[pGrid](const size_t chunkFrom, const size_t chunkTo) { pGrid->writeCellStarts(chunkFrom, chunkTo); });
+
+	return addPhase(startsNode, particleChunkCount,
+		[pGrid](const size_t chunkFrom, const size_t chunkTo) { pGrid->scatterParticles(chunkFrom, chunkTo); });
+}
+
+
+/*
+* Get the grid the particles are added to by the tasks moving them during a step
+*
+* @return std::shared_ptr<GridCollider> The sorted grid, the grid with the locked cells, or nullptr when the particles are added after the culling
+*/
+std::shared_ptr<GridCollider> Orchestrator::getStepGridCollider() const
+{
+	if (m_stepUsesCulling)
+	{
+		return nullptr;
+	}
+	if (m_stepUsesSortedGrid)
+	{
+		return m_pAppData->m_pSortedGridCollider;
+	}
+	return m_pAppData->m_pGridCollider;
+}
+
+
+/*
+* Add a task working on a batch of rows of a cloth to the graph of a step, and measure it for the profiler and the
+* row batch size tuner
+* The asleep batches are not given to the tuner, they cost almost nothing.
+*
+* @param pCloth The cloth
+* @param startResX The first row of the batch
+* @param endResX The row after the last one of the batch
+* @param profileScopeId The scope of the profiler measuring the task
+* @param work The work of the task
+* @return TaskGraph::NodeId The task
+*/
+TaskGraph::NodeId Orchestrator::addRowBatchNode(const std::shared_ptr<Cloth>& pCloth, const int startResX, const int endResX, const uint32_t profileScopeId, std::function<void()>&& work)
+{
+	return m_stepGraph.addNode(
+		[this, pCloth, startResX, endResX, profileScopeId, work = std::move(work)]() {
+			const bool isAwake = pCloth->isBatchAwake(startResX);
+
+			const int64_t startTime = m_profiler.now();
+			work();
+			const int64_t duration = m_profiler.now() - startTime;
+			recordScope(m_profiler, m_traceRecorder, profileScopeId, startTime, duration, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+			if (isAwake)
+			{
+				m_rowBatchTuner.addSample(static_cast<uint64_t>(duration), static_cast<size_t>(endResX - startResX));
+			}
+		});
+}
+
+
+/*
+* Add the tasks of an explicit cloth to the graph of a step
+* With the edge list, the spring forces of a batch are accumulated first, the update of a batch gathers the
+* forces written at its border by the previous batch.
+* The asleep batches are only added to the grid collider, the other particles can still collide with them.
+*
+* @param pCloth The cloth
+* @param finalNodes The last task writing the positions of each batch
+* @return void
+*/
+void Orchestrator::addExplicitClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes)
+{
+	const bool useEdgeList = (pCloth->m_springModel == SpringModel::EdgeList);
+
+	TaskGraph::NodeId previousSpringNode = 0;
+	for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+	{
+		int startResX = i;
+		int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+		const TaskGraph::NodeId updateNode = addRowBatchNode(pCloth, startResX, endResX, TaskUpdate,
+			[this, pCloth, startResX, endResX]() {
+				if (!pCloth->isBatchAwake(startResX))
+				{
+					// Sleeping batch, its particles do not move but the other particles can still collide with them
+					pCloth->updateGridCollider(getStepGridCollider(), startResX, endResX);
+					return;
+				}
+
+				// Update the simulation
+				pCloth->updateParticles(
+					m_stepTimeStep,
+					startResX, endResX,
+					m_pAppData->m_colliders,
+					getStepGridCollider()
+				);
+			});
+
+		// Accumulate the spring forces of the cloths using an edge list (each spring is evaluated once)
+		if (useEdgeList)
+		{
+			const TaskGraph::NodeId springNode = addRowBatchNode(pCloth, startResX, endResX, TaskSprings,
+				[pCloth, startResX, endResX]() {
+					if (pCloth->isBatchAwake(startResX))
+					{
+						pCloth->computeSpringForces(startResX, endResX);
+					}
+				});
+			m_stepGraph.addDependency(springNode, updateNode);
+			if (startResX > 0)
+			{
+				m_stepGraph.addDependency(previousSpringNode, updateNode);
+			}
+			previousSpringNode = springNode;
+		}
+
+		finalNodes.push_back(updateNode);
+	}
+}
+
+
+/*
+* Add the tasks of an XPBD cloth to the graph of a step
+* A batch moves the particles of the rows following it: a batch waits for the previous iteration (or parity) of
+* the batches around it, the even and odd batches still alternate but without waiting for the whole cloth.
+*
+* @param pCloth The cloth
+* @param finalNodes The last task writing the positions of each batch
+* @return void
+*/
+void Orchestrator::addXpbdClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes)
+{
+	// The batches are at least as large as the reach of the constraints (see resetBatchSizeTuners())
+	const int nbBatches = (pCloth->m_resX + m_stepRowBatchSize - 1) / m_stepRowBatchSize;
+
+	// Last task moving the particles of each batch
+	std::vector<TaskGraph::NodeId> lastNodes;
+	for (int b = 0; b < nbBatches; ++b)
+	{
+		const int startResX = b * m_stepRowBatchSize;
+		const int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+		// Only predict the positions, the constraints are solved below
+		lastNodes.push_back(addRowBatchNode(pCloth, startResX, endResX, TaskPredict,
+			[this, pCloth, startResX, endResX]() {
+				if (!pCloth->isBatchAwake(startResX))
+				{
+					pCloth->updateGridCollider(getStepGridCollider(), startResX, endResX);
+					return;
+				}
+				pCloth->predictPositions(m_stepTimeStep, startResX, endResX);
+			}));
+	}
+
+	// Solve the constraints, the batches of a parity do not share rows
+	for (int iteration = 0; iteration < pCloth->m_xpbdSolver.m_iterations; ++iteration)
+	{
+		for (int parity = 0; parity < 2; ++parity)
+		{
+			for (int b = parity; b < nbBatches; b += 2)
+			{
+				const int startResX = b * m_stepRowBatchSize;
+				const int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+				const TaskGraph::NodeId solveNode = addRowBatchNode(pCloth, startResX, endResX, TaskSolve,
+					[this, pCloth, startResX, endResX, iteration]() {
+						if (pCloth->isBatchAwake(startResX))
+						{
+							pCloth->solveConstraints(m_stepTimeStep, startResX, endResX, iteration);
+						}
+					});
+				for (int neighbor = std::max(b - 1, 0); neighbor <= std::min(b + 1, nbBatches - 1); ++neighbor)
+				{
+					m_stepGraph.addDependency(lastNodes[neighbor], solveNode);
+				}
+				lastNodes[b] = solveNode;
+			}
+		}
+	}
+
+	// Compute the velocities from the solver, and handle the collisions
+	// The rows of a batch are moved by its own constraints and by the ones of the previous batch
+	for (int b = 0; b < nbBatches; ++b)
+	{
+		const int startResX = b * m_stepRowBatchSize;
+		const int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+		const TaskGraph::NodeId finalizeNode = addRowBatchNode(pCloth, startResX, endResX, TaskFinalize,
+			[this, pCloth, startResX, endResX]() {
+				if (pCloth->isBatchAwake(startResX))
+				{
+					pCloth->finalizeParticles(
+						m_stepTimeStep,
+						startResX, endResX,
+						m_pAppData->m_colliders,
+						getStepGridCollider()
+					);
+				}
+			});
+		m_stepGraph.addDependency(lastNodes[b], finalizeNode);
+		if (b > 0)
+		{
+			m_stepGraph.addDependency(lastNodes[b - 1], finalizeNode);
+		}
+		finalNodes.push_back(finalizeNode);
+	}
+}
+
+
+/*
+* Add the tasks of an implicit cloth to the graph of a step
+* The linear system of the cloth is built by batches, then solved by a single task driving the conjugate
+* gradient (see solveImplicitCloth()), then the batches are finalized.
+*
+* @param pCloth The cloth
+* @param finalNodes The last task writing the positions of each batch
+* @return void
+*/
+void Orchestrator::addImplicitClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes)
+{
+	const TaskGraph::NodeId solveNode = m_stepGraph.addNode(
+		[this, pCloth]() {
+			MeasuredScope scope(m_profiler, m_traceRecorder, TaskImplicitSolve, static_cast<int64_t>(pCloth->m_uidIndex));
+			solveImplicitCloth(pCloth);
+		});
+
+	for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+	{
+		int startResX = i;
+		int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+		// Only build the linear systems, they are solved below
+		const TaskGraph::NodeId beginNode = addRowBatchNode(pCloth, startResX, endResX, TaskImplicitBegin,
+			[this, pCloth, startResX, endResX]() {
+				if (!pCloth->isBatchAwake(startResX))
+				{
+					pCloth->updateGridCollider(getStepGridCollider(), startResX, endResX);
+					return;
+				}
+				pCloth->beginImplicitStep(m_stepTimeStep, startResX, endResX);
+			});
+		m_stepGraph.addDependency(beginNode, solveNode);
+
+		const TaskGraph::NodeId finalizeNode = addRowBatchNode(pCloth, startResX, endResX, TaskFinalize,
+			[this, pCloth, startResX, endResX]() {
+				if (pCloth->isBatchAwake(startResX))
+				{
+					pCloth->finalizeParticles(
+						m_stepTimeStep,
+						startResX, endResX,
+						m_pAppData->m_colliders,
+						getStepGridCollider()
+					);
+				}
+			});
+		m_stepGraph.addDependency(solveNode, finalizeNode);
+		finalNodes.push_back(finalizeNode);
+	}
+}
+
+
+/*
+* Solve the linear system of an implicit cloth with a conjugate gradient
+* Each iteration has three phases run by batches, the dot products of a phase are summed before the next one.
+* The cloths iterate independently: each one stops when it converges.
+*
+* @param pCloth The cloth
+* @return void
+*/
+void Orchestrator::solveImplicitCloth(const std::shared_ptr<Cloth>& pCloth)
+{
+	// A sleeping implicit cloth is asleep as a whole
+	if (!pCloth->isBatchAwake(0) || !pCloth->m_implicitSolver.startIterations())
+	{
+		return;
+	}
+
+	const double elapsedTimeInSeconds = m_stepTimeStep;
+	const int64_t clothUid = static_cast<int64_t>(pCloth->m_uidIndex);
+	TaskGroup solverTasks(*m_pTaskQueue);
+
+	// Wait for the tasks of a phase, the calling thread executes tasks meanwhile
+	auto waitForPhase = [this, &solverTasks, clothUid]() {
+			MeasuredScope scope(m_profiler, m_traceRecorder, WaitImplicitCg, clothUid);
+			solverTasks.wait();
+		};
+
+	while (true)
+	{
+		// Apply the system matrix to the search directions
+		for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+		{
+			int startResX = i;
+			int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+			solverTasks.run(
+				[this, pCloth, elapsedTimeInSeconds, startResX, endResX]() {
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskImplicitCg, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+					pCloth->m_implicitSolver.computeProduct(pCloth->m_store, elapsedTimeInSeconds, startResX, endResX);
+				});
+		}
+		waitForPhase();
+
+		// Update the solution and the residual
+		pCloth->m_implicitSolver.computeStepLength();
+		for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+		{
+			int startResX = i;
+			int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+			solverTasks.run(
+				[this, pCloth, startResX, endResX]() {
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskImplicitCg, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+					pCloth->m_implicitSolver.updateResidual(startResX, endResX);
+				});
+		}
+		waitForPhase();
+
+		// Stop once converged, or update the search direction
+		if (!pCloth->m_implicitSolver.finishIteration())
+		{
+			break;
+		}
+		for (int i = 0; i < pCloth->m_resX; i += m_stepRowBatchSize)
+		{
+			int startResX = i;
+			int endResX = std::min(startResX + m_stepRowBatchSize, pCloth->m_resX);
+
+			solverTasks.run(
+				[this, pCloth, startResX, endResX]() {
+					MeasuredScope scope(m_profiler, m_traceRecorder, TaskImplicitCg, static_cast<int64_t>(pCloth->m_uidIndex), "rows", startResX, endResX);
+					pCloth->m_implicitSolver.updateDirection(startResX, endResX);
+				});
+		}
+		waitForPhase();
+	}
+}
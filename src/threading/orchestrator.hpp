@@ -3,35 +3,168 @@
 // Includes from project
 #include "../src/applicationData.hpp"
 #include "../src/threading/taskQueue.hpp"
+#include "../src/threading/taskGroup.hpp"
+#include "../src/threading/taskGraph.hpp"
+#include "../src/threading/threadPoolConfig.hpp"
+#include "../src/threading/batchSizeTuner.hpp"
+#include "../src/threading/profiler.hpp"
+#include "../src/threading/traceRecorder.hpp"
+#include "../src/physics/adaptiveTimeStep.hpp"
+#include "../src/physics/clothBounds.hpp"
 
 // Includes from STL
 #include <thread>
 #include <atomic>
 #include <memory>
 #include <chrono>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
 
 
 
+/*
+* Simulated time against wall time, to check if the simulation keeps real time
+* m_droppedTime is the wall time that was not simulated (clamped steps, catch up budget exceeded)
+*/
+struct OrchestratorTimeStats
+{
+	double m_simulatedTime = 0.0;
+	double m_wallTime = 0.0;
+	double m_droppedTime = 0.0;
+	double m_lastTimeStep = 0.0;
+
+	inline double getRealTimeRatio() const { return (m_wallTime > 0.0) ? m_simulatedTime / m_wallTime : 0.0; };
+};
+
+
 /*
 * Class Orchestrator
 * This class is a singleton that orchestrates the simulation
 * It is responsible for starting and stopping the simulation
 * and for managing the simulation's threads
+* The pool of worker threads is sized from the hardware when it starts (see ThreadPoolConfig),
+* and the time each worker spends executing tasks is measured (getWorkerUtilisation()).
+* The tasks go through a work stealing TaskQueue, or a lock free bounded ring (ThreadPoolSettings::m_taskQueueBackend).
+* The phases of the steps and the tasks are measured by a Profiler (getProfiler()), its statistics are written
+* to the file named by the environment variable CLOTH_PROFILE_OUTPUT when the simulation stops.
+* A trace of the tasks executed by each thread can be recorded (startTrace(), stopTrace(), or the environment
+* variable CLOTH_TRACE_OUTPUT to trace the whole simulation), it opens in chrome://tracing or Perfetto.
 */
 class Orchestrator
 {
 private:
+	// What the graph of a step depends on, for each cloth
+	struct StepGraphCloth
+	{
+		const Cloth* m_pCloth = nullptr;
+		int m_resX = 0;
+		IntegrationMode m_integrationMode = IntegrationMode::Explicit;
+		SpringModel m_springModel = SpringModel::Stencil;
+		int m_xpbdIterations = 0;
+
+		bool operator==(const StepGraphCloth& other) const = default;
+	};
+
+	// Activity of a worker thread, written by the worker only
+	struct alignas(64) WorkerCounters
+	{
+		std::atomic<uint64_t> m_busyNanoseconds = 0;
+		std::atomic<uint64_t> m_taskCount = 0;
+		int m_cpu = -1;
+	};
+
 	std::thread m_orchestratorThread;
 	std::vector<std::thread> m_workerThreads;
 	ApplicationData* m_pAppData;
-	TaskQueue m_taskQueue;
+	std::unique_ptr<TaskQueue> m_pTaskQueue;
 	std::chrono::steady_clock::time_point m_lastUpdateTime;
-	size_t m_numberOfThreads;
+	size_t m_numberOfThreads = 0;
 	std::atomic<bool> m_workerRunning = false;
 	std::atomic<bool> m_orchestratorRunning = false;
+	size_t m_stepCount = 0;
+
+	// Thread pool settings, applied when the pool starts
+	ThreadPoolSettings m_threadPoolSettings;
+	std::vector<int> m_orchestratorCpus;
+	std::vector<int> m_mainThreadCpus;
+	std::vector<std::unique_ptr<WorkerCounters>> m_workerCounters;
+	std::chrono::steady_clock::time_point m_workersStartTime;
+
+	// Fixed time step settings
+	std::atomic<bool> m_useFixedTimeStep = false;
+	std::atomic<double> m_fixedTimeStep = 1.0 / 60.0;
+	std::atomic<int> m_substepCount = 4;
+	std::atomic<double> m_maxCatchUpTime = 0.1;
+
+	// Adaptive time step settings
+	std::atomic<bool> m_useAdaptiveTimeStep = false;
+	std::atomic<double> m_adaptiveTolerance = 0.5;
+	std::atomic<double> m_adaptiveStrainLimit = 0.1;
+	std::atomic<double> m_adaptiveMinTimeStep = 1e-4;
+	std::atomic<double> m_adaptiveMaxTimeStep = 1.0 / 30.0;
+	AdaptiveTimeStep m_adaptiveTimeStep;
+	AdaptiveTimeStepStats m_adaptiveTimeStepStats;
+	mutable std::mutex m_adaptiveStatsMutex;
+
+	// Time statistics, written by the orchestrator thread
+	std::atomic<double> m_simulatedTime = 0.0;
+	std::atomic<double> m_wallTime = 0.0;
+	std::atomic<double> m_droppedTime = 0.0;
+	std::atomic<double> m_lastTimeStep = 0.0;
+
+	// Batch sizes of the tasks (rows of the cloths, cells of the grid), tuned while the simulation runs
+	std::atomic<bool> m_useBatchSizeTuning = true;
+	std::atomic<bool> m_resetBatchSizes = false;
+	BatchSizeTuner m_rowBatchTuner;
+	BatchSizeTuner m_cellBatchTuner;
+	BatchSizeTunerStats m_rowBatchStats;
+	BatchSizeTunerStats m_cellBatchStats;
+	mutable std::mutex m_batchStatsMutex;
+
+	// Durations of the phases of the steps and of the tasks
+	Profiler m_profiler;
+
+	// Timeline of the tasks, started and stopped between two steps by the orchestrator thread
+	TraceRecorder m_traceRecorder;
+	std::atomic<bool> m_hasTraceRequest = false;
+	bool m_isTraceStartRequested = false;
+	size_t m_traceMaxEventsPerThread = 0;
+	std::string m_traceStopPath;
+	std::mutex m_traceRequestMutex;
+
+	// Grid of the collisions between the cloths: built by a counting sort, or by locking its cells
+	std::atomic<bool> m_useSortedGridCollider = true;
+
+	// Culling of the particles that cannot touch another particle before the sorted grid (see ClothSweepAndPrune)
+	std::atomic<bool> m_useCollisionCulling = true;
+	ClothSweepAndPrune m_clothSweepAndPrune;
+	ClothCullingStats m_cullingStats;
+	mutable std::mutex m_cullingStatsMutex;
+
+	// Tasks of a step and their dependencies, built for the current cloths and replayed at each step
+	TaskGraph m_stepGraph;
+	std::vector<StepGraphCloth> m_stepGraphCloths;
+	int m_stepRowBatchSize = 1;
+	bool m_stepUsesSortedGrid = false;
+	bool m_stepUsesCulling = false;
+	std::vector<ClothBounds*> m_stepClothBounds;
+
+	// Parameters of the step being run, read by the tasks of the graph
+	double m_stepTimeStep = 0.0;
+	bool m_stepMeasureMotion = false;
+	size_t m_stepCellCount = 0;
+	size_t m_stepCellBatchSize = 1;
+	std::atomic<size_t> m_nextCollisionCell = 0;
+	std::atomic<size_t> m_nextClearedCell = 0;
+
+	// Contacts found by each collision task of the graph
+	std::vector<ContactBuffer> m_contactBuffers;
 
 public:
-	Orchestrator(const size_t numberOfThreads);
+	Orchestrator(const ThreadPoolSettings& threadPoolSettings);
 
 	// Delete copy constructor and assignment operator
 	Orchestrator(const Orchestrator&) = delete;
@@ -46,4 +179,43 @@ public:
 	void runOrchestrator();
 	void start(ApplicationData& appData);
 	void stop();
+
+	void setFixedTimeStep(const bool isEnabled, const double tickTime, const int substepCount, const double maxCatchUpTime);
+	OrchestratorTimeStats getTimeStats() const;
+	void setAdaptiveTimeStep(const bool isEnabled, const double tolerance, const double strainLimit, const double minTimeStep, const double maxTimeStep);
+	AdaptiveTimeStepStats getAdaptiveTimeStepStats() const;
+	void setWaitPolicy(const TaskWaitPolicy& waitPolicy);
+	void setThreadPoolSettings(const ThreadPoolSettings& threadPoolSettings);
+	inline size_t getWorkerCount() const { return m_numberOfThreads; };
+	std::vector<WorkerUtilisation> getWorkerUtilisation() const;
+	void reportWorkerUtilisation() const;
+	void setBatchSizeTuning(const bool isEnabled);
+	void setSortedGridCollider(const bool isEnabled);
+	void setCollisionCulling(const bool isEnabled);
+	ClothCullingStats getCullingStats() const;
+	BatchSizeTunerStats getRowBatchStats() const;
+	BatchSizeTunerStats getCellBatchStats() const;
+	inline Profiler& getProfiler() { return m_profiler; };
+	void startTrace(const size_t maxEventsPerThread);
+	void stopTrace(const std::string& path);
+	inline bool isTracing() const { return m_traceRecorder.isEnabled(); };
+
+private:
+	void startWorkers();
+	void stepSimulation(const double elapsedTimeInSeconds);
+	void applyTraceRequests();
+	void resetBatchSizeTuners();
+	void updateBatchSizes(const size_t awakeRowCount);
+	double getMaxTimeStep() const;
+	double selectTimeStep(const double maxTimeStep);
+	StepGraphCloth getStepGraphCloth(const Cloth& cloth) const;
+	bool isStepGraphValid() const;
+	void buildStepGraph();
+	TaskGraph::NodeId addSortedGridNodes(const TaskGraph::NodeId gridFilledNode, const size_t taskCount);
+	std::shared_ptr<GridCollider> getStepGridCollider() const;
+	TaskGraph::NodeId addRowBatchNode(const std::shared_ptr<Cloth>& pCloth, const int startResX, const int endResX, const uint32_t profileScopeId, std::function<void()>&& work);
+	void addExplicitClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes);
+	void addXpbdClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes);
+	void addImplicitClothNodes(const std::shared_ptr<Cloth>& pCloth, std::vector<TaskGraph::NodeId>& finalNodes);
+	void solveImplicitCloth(const std::shared_ptr<Cloth>& pCloth);
 };
@@ -0,0 +1,417 @@
+// Includes from project
+#include "../src/threading/profiler.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+
+/*
+* Write a name as a CSV field, quoted if it contains a separator or a quote
+*
+* @param stream The stream to write to
+* @param name The name
+* @return void
+*/
+static void writeCsvField(std::ostream& stream, const std::string& name)
+{
+	if (name.find_first_of(",\"\n") == std::string::npos)
+	{
+		stream << name;
+		return;
+	}
+	stream << '"';
+	for (const char c : name)
+	{
+		if (c == '"')
+		{
+			stream << '"';
+		}
+		stream << c;
+	}
+	stream << '"';
+}
+
+
+/*
+* Create a ring of samples
+*
+* @param capacity The number of samples the ring holds, rounded up to a power of 2
+*/
+ProfileRingBuffer::ProfileRingBuffer(const size_t capacity)
+{
+	size_t roundedCapacity = 1;
+	while (roundedCapacity < capacity)
+	{
+		roundedCapacity *= 2;
+	}
+	m_samples = std::make_unique<ProfileSample[]>(roundedCapacity);
+	m_mask = static_cast<uint64_t>(roundedCapacity - 1);
+}
+
+
+/*
+* Add a sample, called by the producer thread only
+*
+* @param sample The sample
+* @return bool False if the ring is full, the sample is dropped
+*/
+bool ProfileRingBuffer::push(const ProfileSample& sample)
+{
+	const uint64_t head = m_head.load(std::memory_order_relaxed);
+	if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+	{
+		m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	m_samples[head & m_mask] = sample;
+	m_head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+
+/*
+* Move the samples of the ring to a vector, called by the consumer only
+*
+* @param samples The vector the samples are appended to
+* @return size_t The number of samples moved
+*/
+size_t ProfileRingBuffer::drain(std::vector<ProfileSample>& samples)
+{
+	const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+	const uint64_t head = m_head.load(std::memory_order_acquire);
+	for (uint64_t i = tail; i != head; ++i)
+	{
+		samples.push_back(m_samples[i & m_mask]);
+	}
+	m_tail.store(head, std::memory_order_release);
+	return static_cast<size_t>(head - tail);
+}
+
+
+/*
+* Create a profiler
+*
+* @param bufferCapacity The number of samples a thread can measure between two calls to collect()
+* @param windowSize The number of durations of a scope the statistics are computed from
+*/
+Profiler::Profiler(const size_t bufferCapacity, const size_t windowSize) :
+	m_bufferCapacity(bufferCapacity),
+	m_windowSize(std::max<size_t>(windowSize, 1)),
+	m_startTime(std::chrono::steady_clock::now())
+{
+
+}
+
+
+/*
+* Register a scope, or get the id of the scope with the same name
+*
+* @param name The name of the scope
+* @return uint32_t The id of the scope, to measure it
+*/
+uint32_t Profiler::registerScope(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_scopesMutex);
+	for (size_t i = 0; i < m_scopes.size(); ++i)
+	{
+		if (m_scopes[i].m_name == name)
+		{
+			return static_cast<uint32_t>(i);
+		}
+	}
+
+	ScopeWindow scope;
+	scope.m_name = name;
+	scope.m_durations.reserve(m_windowSize);
+	m_scopes.push_back(std::move(scope));
+	return static_cast<uint32_t>(m_scopes.size() - 1);
+}
+
+
+/*
+* Get the time since the profiler was created
+*
+* @return int64_t The time, in nanoseconds
+*/
+int64_t Profiler::now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+
+/*
+* Add a measure of a scope, from any thread
+* Does not lock, except for the first sample of a thread
+*
+* @param scopeId The id of the scope (see registerScope())
+* @param startNanoseconds When the scope started (see now())
+* @param durationNanoseconds How long it lasted
+* @return void
+*/
+void Profiler::addSample(const uint32_t scopeId, const int64_t startNanoseconds, const int64_t durationNanoseconds)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	ProfileSample sample;
+	sample.m_scopeId = scopeId;
+	sample.m_startNanoseconds = startNanoseconds;
+	sample.m_durationNanoseconds = durationNanoseconds;
+	getThreadBuffer().push(sample);
+}
+
+
+/*
+* Get the buffer of the calling thread, registers the thread on its first sample
+*
+* @return ProfileRingBuffer& The buffer of the thread
+*/
+ProfileRingBuffer& Profiler::getThreadBuffer()
+{
+	return m_threadBuffers.get([this]() { return std::make_unique<ProfileRingBuffer>(m_bufferCapacity); });
+}
+
+
+/*
+* Move the samples of all the threads to the rolling windows of their scopes
+*
+* @return void
+*/
+void Profiler::collect()
+{
+	std::lock_guard<std::mutex> lock(m_scopesMutex);
+	collectLocked();
+}
+
+
+/*
+* Move the samples of all the threads to the rolling windows of their scopes, m_scopesMutex must be locked
+*
+* @return void
+*/
+void Profiler::collectLocked()
+{
+	m_drainedSamples.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+		const auto& buffers = m_threadBuffers.getBuffers();
+		for (size_t i = 0; i < buffers.size(); ++i)
+		{
+			const size_t first = m_drainedSamples.size();
+			buffers[i]->drain(m_drainedSamples);
+			for (size_t s = first; s < m_drainedSamples.size(); ++s)
+			{
+				m_drainedSamples[s].m_threadIndex = static_cast<uint32_t>(i);
+			}
+		}
+	}
+
+	for (const ProfileSample& sample : m_drainedSamples)
+	{
+		if (sample.m_scopeId >= m_scopes.size())
+		{
+			continue;
+		}
+
+		ScopeWindow& scope = m_scopes[sample.m_scopeId];
+		if (scope.m_durations.size() < m_windowSize)
+		{
+			scope.m_durations.push_back(sample.m_durationNanoseconds);
+		}
+		else
+		{
+			scope.m_durations[scope.m_next] = sample.m_durationNanoseconds;
+		}
+		scope.m_next = (scope.m_next + 1) % m_windowSize;
+		scope.m_count++;
+		scope.m_totalNanoseconds += sample.m_durationNanoseconds;
+	}
+}
+
+
+/*
+* Forget the samples measured so far, the scopes stay registered
+*
+* @return void
+*/
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(m_scopesMutex);
+	collectLocked();
+	for (ScopeWindow& scope : m_scopes)
+	{
+		scope.m_durations.clear();
+		scope.m_next = 0;
+		scope.m_count = 0;
+		scope.m_totalNanoseconds = 0;
+	}
+}
+
+
+/*
+* Compute the statistics of a scope from its rolling window
+* The percentiles use the nearest rank: the smallest duration with at least p% of the durations below or equal
+*
+* @param scope The scope
+* @return ProfileScopeStats The statistics, in seconds
+*/
+ProfileScopeStats Profiler::computeStats(const ScopeWindow& scope) const
+{
+	ProfileScopeStats stats;
+	stats.m_name = scope.m_name;
+	stats.m_count = scope.m_count;
+	stats.m_totalTime = static_cast<double>(scope.m_totalNanoseconds) * 1e-9;
+	stats.m_windowCount = scope.m_durations.size();
+	if (scope.m_durations.empty())
+	{
+		return stats;
+	}
+
+	std::vector<int64_t> durations = scope.m_durations;
+	std::sort(durations.begin(), durations.end());
+
+	const size_t count = durations.size();
+	auto percentile = [&durations, count](const double p) {
+			const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(count)));
+			return static_cast<double>(durations[std::clamp<size_t>(rank, 1, count) - 1]) * 1e-9;
+		};
+
+	int64_t sum = 0;
+	for (const int64_t duration : durations)
+	{
+		sum += duration;
+	}
+
+	stats.m_min = static_cast<double>(durations.front()) * 1e-9;
+	stats.m_max = static_cast<double>(durations.back()) * 1e-9;
+	stats.m_mean = static_cast<double>(sum) * 1e-9 / static_cast<double>(count);
+	stats.m_p50 = percentile(0.50);
+	stats.m_p95 = percentile(0.95);
+	stats.m_p99 = percentile(0.99);
+	return stats;
+}
+
+
+/*
+* Get the statistics of all the scopes, with the samples measured up to now
+*
+* @return std::vector<ProfileScopeStats> The statistics, in the order the scopes were registered
+*/
+std::vector<ProfileScopeStats> Profiler::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_scopesMutex);
+	collectLocked();
+
+	std::vector<ProfileScopeStats> stats;
+	for (const ScopeWindow& scope : m_scopes)
+	{
+		stats.push_back(computeStats(scope));
+	}
+	return stats;
+}
+
+
+/*
+* Get the number of samples dropped because the buffer of their thread was full
+*
+* @return uint64_t The number of dropped samples, for all the threads
+*/
+uint64_t Profiler::getDroppedSampleCount() const
+{
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+	uint64_t droppedCount = 0;
+	for (const auto& pBuffer : m_threadBuffers.getBuffers())
+	{
+		droppedCount += pBuffer->getDroppedCount();
+	}
+	return droppedCount;
+}
+
+
+/*
+* Write the statistics of the scopes in JSON, the durations in microseconds
+*
+* @param stream The stream to write to
+* @return void
+*/
+void Profiler::exportJson(std::ostream& stream)
+{
+	const std::vector<ProfileScopeStats> allStats = getStats();
+
+	stream << "{\n";
+	stream << "  \"windowSize\": " << m_windowSize << ",\n";
+	stream << "  \"droppedSamples\": " << getDroppedSampleCount() << ",\n";
+	stream << "  \"scopes\": [";
+	for (size_t i = 0; i < allStats.size(); ++i)
+	{
+		const ProfileScopeStats& stats = allStats[i];
+		stream << (i == 0 ? "\n" : ",\n") << "    { \"name\": ";
+		writeJsonString(stream, stats.m_name);
+		stream << ", \"count\": " << stats.m_count
+			<< ", \"totalMs\": " << stats.m_totalTime * 1e3
+			<< ", \"windowCount\": " << stats.m_windowCount
+			<< ", \"minUs\": " << stats.m_min * 1e6
+			<< ", \"meanUs\": " << stats.m_mean * 1e6
+			<< ", \"p50Us\": " << stats.m_p50 * 1e6
+			<< ", \"p95Us\": " << stats.m_p95 * 1e6
+			<< ", \"p99Us\": " << stats.m_p99 * 1e6
+			<< ", \"maxUs\": " << stats.m_max * 1e6 << " }";
+	}
+	stream << "\n  ]\n}\n";
+}
+
+
+/*
+* Write the statistics of the scopes in CSV, a line per scope, the durations in microseconds
+*
+* @param stream The stream to write to
+* @return void
+*/
+void Profiler::exportCsv(std::ostream& stream)
+{
+	stream << "name,count,total_ms,window_count,min_us,mean_us,p50_us,p95_us,p99_us,max_us\n";
+	for (const ProfileScopeStats& stats : getStats())
+	{
+		writeCsvField(stream, stats.m_name);
+		stream << ',' << stats.m_count
+			<< ',' << stats.m_totalTime * 1e3
+			<< ',' << stats.m_windowCount
+			<< ',' << stats.m_min * 1e6
+			<< ',' << stats.m_mean * 1e6
+			<< ',' << stats.m_p50 * 1e6
+			<< ',' << stats.m_p95 * 1e6
+			<< ',' << stats.m_p99 * 1e6
+			<< ',' << stats.m_max * 1e6 << '\n';
+	}
+}
+
+
+/*
+* Write the statistics of the scopes to a file, in CSV if its extension is ".csv", in JSON otherwise
+*
+* @param path The path of the file
+* @return bool True if the file was written
+*/
+bool Profiler::exportToFile(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	const bool isCsv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+	if (isCsv)
+	{
+		exportCsv(file);
+	}
+	else
+	{
+		exportJson(file);
+	}
+	return static_cast<bool>(file);
+}
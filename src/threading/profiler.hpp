@@ -0,0 +1,174 @@
+#pragma once
+
+// Includes from project
+#include "../src/threading/profilingUtils.hpp"
+
+// Includes from STL
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+* A measure of a scope: when it started (in nanoseconds since the profiler was created) and how long it lasted
+* m_threadIndex is the index of the buffer of the thread that measured it, in the order the threads registered
+*/
+struct ProfileSample
+{
+	uint32_t m_scopeId = 0;
+	uint32_t m_threadIndex = 0;
+	int64_t m_startNanoseconds = 0;
+	int64_t m_durationNanoseconds = 0;
+};
+
+
+/*
+* Statistics of a scope, the durations are in seconds
+* m_count and m_totalTime cover all the samples since the last reset, the other ones the rolling window
+*/
+struct ProfileScopeStats
+{
+	std::string m_name;
+	uint64_t m_count = 0;
+	double m_totalTime = 0.0;
+	size_t m_windowCount = 0;
+	double m_min = 0.0;
+	double m_mean = 0.0;
+	double m_p50 = 0.0;
+	double m_p95 = 0.0;
+	double m_p99 = 0.0;
+	double m_max = 0.0;
+};
+
+
+/*
+* Class ProfileRingBuffer
+*
+* Lock free single producer, single consumer ring of samples: a thread pushes its samples, the profiler drains them.
+* When the ring is full the new samples are dropped (and counted), the producer never waits.
+*/
+class ProfileRingBuffer
+{
+private:
+	std::unique_ptr<ProfileSample[]> m_samples;
+	uint64_t m_mask;
+
+	// Producer and consumer indexes on their own cache lines
+	alignas(64) std::atomic<uint64_t> m_head = 0;
+	alignas(64) std::atomic<uint64_t> m_tail = 0;
+	std::atomic<uint64_t> m_droppedCount = 0;
+
+public:
+	ProfileRingBuffer(const size_t capacity);
+	~ProfileRingBuffer() {};
+
+	ProfileRingBuffer(const ProfileRingBuffer&) = delete;
+	ProfileRingBuffer& operator=(const ProfileRingBuffer&) = delete;
+
+	bool push(const ProfileSample& sample);
+	size_t drain(std::vector<ProfileSample>& samples);
+
+	inline size_t getCapacity() const { return static_cast<size_t>(m_mask + 1); };
+	inline uint64_t getDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); };
+};
+
+
+/*
+* Class Profiler
+*
+* Measures named scopes (the phases of a step, the types of tasks) from any thread.
+* Each thread writes its samples to its own ProfileRingBuffer, without locking once the thread is registered
+* (the first sample of a thread registers it). collect() drains the buffers into a rolling window of the last
+* m_windowSize durations of each scope, the statistics (min, mean, p50, p95, p99, max) are computed from the window.
+* collect() must be called often enough for the buffers not to fill up (the orchestrator calls it after each step).
+* The statistics can be exported in JSON or CSV at any time, from any thread.
+*
+* Usage: const uint32_t id = profiler.registerScope("name"); then { ProfileScope scope(profiler, id); ... }
+*/
+class Profiler
+{
+private:
+	struct ScopeWindow
+	{
+		std::string m_name;
+		std::vector<int64_t> m_durations;
+		size_t m_next = 0;
+		uint64_t m_count = 0;
+		int64_t m_totalNanoseconds = 0;
+	};
+
+	const size_t m_bufferCapacity;
+	const size_t m_windowSize;
+	const std::chrono::steady_clock::time_point m_startTime;
+	std::atomic<bool> m_isEnabled = true;
+
+	// Buffers of the threads, they live as long as the profiler
+	ThreadBuffers<ProfileRingBuffer> m_threadBuffers;
+
+	// Aggregated samples
+	std::vector<ScopeWindow> m_scopes;
+	std::vector<ProfileSample> m_drainedSamples;
+	mutable std::mutex m_scopesMutex;
+
+public:
+	Profiler(const size_t bufferCapacity = 8192, const size_t windowSize = 1024);
+	~Profiler() {};
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	uint32_t registerScope(const std::string& name);
+	void addSample(const uint32_t scopeId, const int64_t startNanoseconds, const int64_t durationNanoseconds);
+	void collect();
+	void reset();
+	std::vector<ProfileScopeStats> getStats();
+	uint64_t getDroppedSampleCount() const;
+
+	void exportJson(std::ostream& stream);
+	void exportCsv(std::ostream& stream);
+	bool exportToFile(const std::string& path);
+
+	int64_t now() const;
+	inline void setEnabled(const bool isEnabled) { m_isEnabled = isEnabled; };
+	inline bool isEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); };
+
+private:
+	ProfileRingBuffer& getThreadBuffer();
+	void collectLocked();
+	ProfileScopeStats computeStats(const ScopeWindow& scope) const;
+};
+
+
+/*
+* Class ProfileScope
+*
+* Measures the lifetime of the object as a sample of a scope of a profiler, does nothing if the profiler is disabled
+*/
+class ProfileScope
+{
+private:
+	Profiler& m_profiler;
+	const uint32_t m_scopeId;
+	const int64_t m_startNanoseconds;
+
+public:
+	ProfileScope(Profiler& profiler, const uint32_t scopeId) :
+		m_profiler(profiler), m_scopeId(scopeId), m_startNanoseconds(profiler.isEnabled() ? profiler.now() : -1) {};
+	~ProfileScope()
+	{
+		if (m_startNanoseconds >= 0)
+		{
+			m_profiler.addSample(m_scopeId, m_startNanoseconds, m_profiler.now() - m_startNanoseconds);
+		}
+	};
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
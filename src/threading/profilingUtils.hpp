@@ -0,0 +1,115 @@
+#pragma once
+
+// Includes from STL
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+
+/*
+* Write a string as a JSON string
+* The quotes, the backslashes and the control characters (below 0x20) are escaped.
+*
+* @param stream The stream to write to
+* @param text The string
+* @return void
+*/
+inline void writeJsonString(std::ostream& stream, const std::string& text)
+{
+	stream << '"';
+	for (const char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			stream << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+			stream << escaped;
+		}
+		else
+		{
+			stream << c;
+		}
+	}
+	stream << '"';
+}
+
+
+/*
+* Class ThreadBuffers
+*
+* A buffer per thread for the profiling classes (Profiler, TraceRecorder): a thread registers its buffer the first
+* time it asks for it, then finds it again without locking. The buffers live as long as their ThreadBuffers.
+* Each ThreadBuffers gets its own id, so the buffer a thread cached for a destroyed one is never reused.
+* The buffers are read under the mutex (getMutex(), getBuffers()), in the order the threads registered.
+*/
+template <typename Buffer>
+class ThreadBuffers
+{
+private:
+	static inline std::atomic<uint64_t> s_nextId = 1;
+
+	const uint64_t m_id;
+	std::vector<std::unique_ptr<Buffer>> m_buffers;
+	std::vector<std::thread::id> m_bufferThreads;
+	mutable std::mutex m_mutex;
+
+public:
+	ThreadBuffers() : m_id(s_nextId.fetch_add(1)) {};
+	~ThreadBuffers() {};
+
+	ThreadBuffers(const ThreadBuffers&) = delete;
+	ThreadBuffers& operator=(const ThreadBuffers&) = delete;
+
+	template <typename Create>
+	Buffer& get(Create&& create);
+
+	inline std::mutex& getMutex() const { return m_mutex; };
+	inline const std::vector<std::unique_ptr<Buffer>>& getBuffers() const { return m_buffers; };
+};
+
+
+/*
+* Get the buffer of the calling thread, registers the thread the first time
+*
+* @param create Called under the mutex to create the buffer of a new thread, returns a std::unique_ptr<Buffer>
+* @return Buffer& The buffer of the thread
+*/
+template <typename Buffer>
+template <typename Create>
+Buffer& ThreadBuffers<Buffer>::get(Create&& create)
+{
+	// Last ThreadBuffers used by the thread
+	thread_local uint64_t cachedId = 0;
+	thread_local Buffer* pCachedBuffer = nullptr;
+	if (cachedId == m_id)
+	{
+		return *pCachedBuffer;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const std::thread::id threadId = std::this_thread::get_id();
+	const auto it = std::find(m_bufferThreads.begin(), m_bufferThreads.end(), threadId);
+	if (it != m_bufferThreads.end())
+	{
+		pCachedBuffer = m_buffers[static_cast<size_t>(it - m_bufferThreads.begin())].get();
+	}
+	else
+	{
+		m_buffers.push_back(create());
+		m_bufferThreads.push_back(threadId);
+		pCachedBuffer = m_buffers.back().get();
+	}
+	cachedId = m_id;
+	return *pCachedBuffer;
+}
@@ -0,0 +1,268 @@
+// Includes from project
+#include "../src/threading/taskGraph.hpp"
+
+// Includes from STL
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+
+/*
+* Add a node to the graph, the graph must be built again before running
+*
+* @param work The work of the node
+* @return NodeId The identifier of the node, to declare its dependencies
+*/
+TaskGraph::NodeId TaskGraph::addNode(std::function<void()>&& work)
+{
+	m_isBuilt = false;
+
+	Node node;
+	node.m_work = std::move(work);
+	m_nodes.push_back(std::move(node));
+	return static_cast<NodeId>(m_nodes.size() - 1);
+}
+
+
+/*
+* Declare that a node must be done before another one starts, the graph must be built again before running
+* Declaring the same dependency several times is allowed
+*
+* @param predecessor The node to complete first
+* @param successor The node waiting for the predecessor
+* @return void
+*/
+void TaskGraph::addDependency(const NodeId predecessor, const NodeId successor)
+{
+	if (predecessor >= m_nodes.size() || successor >= m_nodes.size() || predecessor == successor)
+	{
+		throw std::invalid_argument("TaskGraph: invalid dependency");
+	}
+
+	m_isBuilt = false;
+	m_nodes[predecessor].m_successors.push_back(successor);
+}
+
+
+/*
+* Prepare the graph to be run: count the predecessors of the nodes, find the roots, and check that there is no cycle
+* Called by run() if the graph changed since the last build
+*
+* @return void
+*/
+void TaskGraph::build()
+{
+	for (Node& node : m_nodes)
+	{
+		node.m_predecessorCount = 0;
+	}
+	for (Node& node : m_nodes)
+	{
+		std::sort(node.m_successors.begin(), node.m_successors.end());
+		node.m_successors.erase(std::unique(node.m_successors.begin(), node.m_successors.end()), node.m_successors.end());
+		for (const NodeId successor : node.m_successors)
+		{
+			m_nodes[successor].m_predecessorCount++;
+		}
+	}
+
+	m_roots.clear();
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+	{
+		const NodeId nodeId = static_cast<NodeId>(i);
+		m_nodes[i].m_task.m_callback = [this, nodeId]() { executeNode(nodeId); };
+		if (m_nodes[i].m_predecessorCount == 0)
+		{
+			m_roots.push_back(nodeId);
+		}
+	}
+
+	// Visit the graph in topological order, the nodes of a cycle are never reached
+	std::vector<int> pendingPredecessors(m_nodes.size());
+	std::vector<NodeId> readyNodes = m_roots;
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+	{
+		pendingPredecessors[i] = m_nodes[i].m_predecessorCount;
+	}
+	size_t visitedCount = 0;
+	while (!readyNodes.empty())
+	{
+		const NodeId nodeId = readyNodes.back();
+		readyNodes.pop_back();
+		visitedCount++;
+		for (const NodeId successor : m_nodes[nodeId].m_successors)
+		{
+			if (--pendingPredecessors[successor] == 0)
+			{
+				readyNodes.push_back(successor);
+			}
+		}
+	}
+	if (visitedCount != m_nodes.size())
+	{
+		throw std::logic_error("TaskGraph: the dependencies form a cycle");
+	}
+
+	m_pendingPredecessors = std::make_unique<std::atomic<int>[]>(m_nodes.size());
+	m_isBuilt = true;
+}
+
+
+/*
+* Run all the nodes of the graph, in the order of their dependencies, and wait until they are done
+* The calling thread executes pending tasks of the queue meanwhile, then spins and sleeps according to
+* the wait policy of the queue.
+* Rethrows the first exception thrown by a node.
+*
+* @param queue The queue executing the nodes
+* @return void
+*/
+void TaskGraph::run(TaskQueue& queue)
+{
+	if (!m_isBuilt)
+	{
+		build();
+	}
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	m_pQueue = &queue;
+	m_hasFailed = false;
+	m_isCompleted = false;
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+	{
+		m_pendingPredecessors[i].store(m_nodes[i].m_predecessorCount, std::memory_order_relaxed);
+	}
+	m_remainingCount.store(m_nodes.size(), std::memory_order_release);
+
+	for (const NodeId root : m_roots)
+	{
+		queue.addTask(m_nodes[root].m_task);
+	}
+
+	const TaskWaitPolicy waitPolicy = queue.getWaitPolicy();
+	int idleRounds = 0;
+	while (m_remainingCount.load(std::memory_order_acquire) > 0)
+	{
+		// Help the workers, the task may not belong to the graph
+		if (queue.runPendingTask())
+		{
+			idleRounds = 0;
+			continue;
+		}
+
+		if (idleRounds < waitPolicy.m_spinRounds || !waitPolicy.m_canPark)
+		{
+			idleRounds++;
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Nothing left to execute, the last nodes are running on the workers
+		break;
+	}
+
+	// The latch is set once the last node is done with the graph
+	std::exception_ptr pException;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return m_isCompleted; });
+		std::swap(pException, m_pException);
+	}
+	if (pException)
+	{
+		std::rethrow_exception(pException);
+	}
+}
+
+
+/*
+* Remove all the nodes of the graph
+*
+* @return void
+*/
+void TaskGraph::clear()
+{
+	m_nodes.clear();
+	m_roots.clear();
+	m_pendingPredecessors.reset();
+	m_isBuilt = false;
+}
+
+
+/*
+* Execute a node, release its successors, and continue with one of the released successors
+*
+* @param nodeId The node to execute
+* @return void
+*/
+void TaskGraph::executeNode(const NodeId nodeId)
+{
+	constexpr NodeId NO_NODE = std::numeric_limits<NodeId>::max();
+
+	NodeId currentNodeId = nodeId;
+	while (currentNodeId != NO_NODE)
+	{
+		Node& node = m_nodes[currentNodeId];
+
+		// The nodes are skipped after a failure, but still complete to finish the run
+		if (!m_hasFailed.load(std::memory_order_relaxed))
+		{
+			try
+			{
+				node.m_work();
+			}
+			catch (...)
+			{
+				// Only the first exception is kept
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_pException)
+				{
+					m_pException = std::current_exception();
+				}
+				m_hasFailed = true;
+			}
+		}
+
+		// The first successor released continues on this thread, the others are submitted
+		NodeId nextNodeId = NO_NODE;
+		for (const NodeId successor : node.m_successors)
+		{
+			if (m_pendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				if (nextNodeId == NO_NODE)
+				{
+					nextNodeId = successor;
+				}
+				else
+				{
+					m_pQueue->addTask(m_nodes[successor].m_task);
+				}
+			}
+		}
+
+		// The graph can not complete before the next node, it is still counted
+		completeNode();
+		currentNodeId = nextNodeId;
+	}
+}
+
+
+/*
+* Called at the end of each node, the last one sets the completion latch
+*
+* @return void
+*/
+void TaskGraph::completeNode()
+{
+	if (m_remainingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// Notify under the lock, the graph may be run again or destroyed as soon as the waiting thread sees the latch
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isCompleted = true;
+		m_cv.notify_all();
+	}
+}
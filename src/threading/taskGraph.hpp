@@ -0,0 +1,82 @@
+#pragma once
+
+// Includes from project
+#include "../src/threading/taskQueue.hpp"
+
+// Includes from STL
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+
+/*
+* Class TaskGraph
+*
+* A set of tasks (nodes) with dependencies between them, built once and run (replayed) as many times as needed.
+* A node is submitted to the TaskQueue as soon as all its predecessors are done, so independent chains of nodes
+* overlap instead of waiting for each other at barriers. When a node releases several successors, the first one
+* is executed right away by the same thread (its data is hot in the cache), the others are submitted to the queue.
+* Running the graph does not allocate: the nodes are persistent tasks of the queue, and their dependency counters
+* are reset at the beginning of each run.
+* run() waits until all the nodes are done, the calling thread executes pending tasks meanwhile (like TaskGroup::wait()).
+* If a node throws, the nodes not started yet are skipped, and the first exception is rethrown by run().
+* The graph must not be modified or destroyed while it runs.
+*/
+class TaskGraph
+{
+public:
+	using NodeId = uint32_t;
+
+private:
+	struct Node
+	{
+		std::function<void()> m_work;
+		std::vector<NodeId> m_successors;
+		int m_predecessorCount = 0;
+
+		// Task submitted to the queue, executes the node
+		TaskQueue::Task m_task;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<NodeId> m_roots;
+	std::unique_ptr<std::atomic<int>[]> m_pendingPredecessors;
+	bool m_isBuilt = false;
+
+	// State of the current run
+	TaskQueue* m_pQueue = nullptr;
+	std::atomic<size_t> m_remainingCount = 0;
+	std::atomic<bool> m_hasFailed = false;
+
+	// Completion latch
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_isCompleted = false;
+
+	std::exception_ptr m_pException;
+
+public:
+	TaskGraph() = default;
+	~TaskGraph() = default;
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	NodeId addNode(std::function<void()>&& work);
+	void addDependency(const NodeId predecessor, const NodeId successor);
+	void build();
+	void run(TaskQueue& queue);
+	void clear();
+
+	inline size_t getNodeCount() const { return m_nodes.size(); };
+	inline bool isBuilt() const { return m_isBuilt; };
+
+private:
+	void executeNode(const NodeId nodeId);
+	void completeNode();
+};
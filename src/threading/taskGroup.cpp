@@ -0,0 +1,125 @@
+// Includes from project
+#include "../src/threading/taskGroup.hpp"
+
+// Includes from STL
+#include <thread>
+
+
+TaskGroup::~TaskGroup()
+{
+	// The tasks reference the group, they must be completed before it is destroyed
+	if (m_pendingCount != 1)
+	{
+		try
+		{
+			wait();
+		}
+		catch (...)
+		{
+		}
+	}
+}
+
+
+/*
+* Submit a task to the queue, as part of the group
+* An exception thrown by the task is caught and rethrown by wait()
+*
+* @param taskCallback The task to run
+* @return void
+*/
+void TaskGroup::run(std::function<void()>&& taskCallback)
+{
+	m_pendingCount++;
+
+	m_queue.addTask([this, task = std::move(taskCallback)]() {
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			// Only the first exception is kept
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_pException)
+			{
+				m_pException = std::current_exception();
+			}
+		}
+		completeTask();
+	});
+}
+
+
+/*
+* Wait until all the tasks submitted to the group are completed
+* The calling thread executes pending tasks of the queue meanwhile, then spins and sleeps according to
+* the wait policy of the queue.
+* Rethrows the first exception thrown by a task of the group.
+*
+* @return void
+*/
+void TaskGroup::wait()
+{
+	// Release the reference of the group, if it was the last one no task is pending
+	if (m_pendingCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		const TaskWaitPolicy waitPolicy = m_queue.getWaitPolicy();
+
+		int idleRounds = 0;
+		while (m_pendingCount.load(std::memory_order_acquire) > 0)
+		{
+			// Help the workers, the task may belong to another group
+			if (m_queue.runPendingTask())
+			{
+				idleRounds = 0;
+				continue;
+			}
+
+			if (idleRounds < waitPolicy.m_spinRounds || !waitPolicy.m_canPark)
+			{
+				idleRounds++;
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Nothing left to execute, the last tasks are running on the workers
+			break;
+		}
+
+		// The latch is set once the task reaching zero is done with the group
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return m_isCompleted; });
+		m_isCompleted = false;
+	}
+
+	// Ready for the next tasks
+	m_pendingCount = 1;
+
+	std::exception_ptr pException;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::swap(pException, m_pException);
+	}
+	if (pException)
+	{
+		std::rethrow_exception(pException);
+	}
+}
+
+
+/*
+* Called at the end of each task of the group, the last one sets the completion latch
+*
+* @return void
+*/
+void TaskGroup::completeTask()
+{
+	if (m_pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// Notify under the lock, the group may be destroyed as soon as the waiting thread sees the latch
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isCompleted = true;
+		m_cv.notify_all();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Includes from project
+#include "../src/threading/taskQueue.hpp"
+
+// Includes from STL
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+
+/*
+* Class TaskGroup
+*
+* A set of tasks submitted to a TaskQueue, that can be waited for as a whole.
+* wait() only waits for the tasks of the group (not for the whole queue), and the waiting thread executes
+* pending tasks meanwhile instead of spinning. When there is nothing left to execute, it waits according to the
+* queue's TaskWaitPolicy: it spins for a while, then sleeps until the last task of the group completes it.
+* If a task throws, the other tasks still run, and the first exception is rethrown by wait().
+* The group can be reused after wait(). The tasks are submitted by the waiting thread, or by the tasks of the group.
+*/
+class TaskGroup
+{
+private:
+	TaskQueue& m_queue;
+
+	// Tasks not completed yet, plus one held by the group until wait() is called:
+	// the count can only reach zero once per wait(), the task reaching it sets the completion latch
+	std::atomic<int> m_pendingCount = 1;
+
+	// Completion latch
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_isCompleted = false;
+
+	std::exception_ptr m_pException;
+
+public:
+	TaskGroup(TaskQueue& queue) : m_queue(queue) {};
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void run(std::function<void()>&& taskCallback);
+	void wait();
+
+private:
+	void completeTask();
+};
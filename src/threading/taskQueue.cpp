@@ -3,21 +3,69 @@
 
 // Includes from STL
 #include <iostream>
+#include <thread>
+#include <algorithm>
+
+
+// Worker of the calling thread, set when a worker thread gets its first task
+static thread_local const TaskQueue* s_pCurrentQueue = nullptr;
+static thread_local size_t s_currentWorkerIndex = 0;
+
+// Victim selection of the threads helping without being a worker
+static thread_local uint32_t s_helperRandomState = 0x9E3779B9u;
+
+
+/*
+* @param backend How the tasks are stored
+* @param ringCapacity Number of slots of the ring (BoundedRing backend), rounded up to a power of two
+*/
+TaskQueue::TaskQueue(const TaskQueueBackend backend, const size_t ringCapacity) : m_backend(backend)
+{
+	if (m_backend == TaskQueueBackend::BoundedRing)
+	{
+		m_pRing = std::make_unique<MpmcRing<TaskSlot>>(ringCapacity);
+	}
+}
+
+
+TaskQueue::~TaskQueue()
+{
+	clearTaskQueue();
+}
 
 
 /*
-* Release all tasks from the queue
-* 
+* Create the deques of the worker threads
+* Must be called before starting the worker threads, the worker indexes are in [0, numberOfWorkers[
+*
+* @param numberOfWorkers The number of worker threads calling getTask()
 * @return void
 */
-void TaskQueue::releaseAll(const size_t numberOfThreads)
+void TaskQueue::setWorkerCount(const size_t numberOfWorkers)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	m_tasks.clear();
+	clearTaskQueue();
+
+	m_workers.clear();
+	for (size_t i = 0; i < numberOfWorkers; ++i)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+		m_workers.back()->m_randomState = static_cast<uint32_t>(i * 2654435761u + 1u);
+	}
+}
+
 
-	for (size_t i = 0; i < numberOfThreads; ++i)
+/*
+* Release all the worker threads waiting for a task, getTask() returns without task from now on
+*
+* @param numberOfThreads The number of worker threads (all the waiting workers are released anyway)
+* @return void
+*/
+void TaskQueue::releaseAll([[maybe_unused]] const size_t numberOfThreads)
+{
 	{
-		m_tasks.push_back([]() {}); // Add dummy tasks to wake up all worker threads
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_isReleased = true;
+		m_wakeEpoch++;
 	}
 
 	m_cv.notify_all();
@@ -26,71 +74,198 @@ void TaskQueue::releaseAll(const size_t numberOfThreads)
 
 /*
 * Clear the task queue
-* 
+* Must not be called while the worker threads are running
+*
 * @return void
 */
 void TaskQueue::clearTaskQueue()
 {
-	m_tasks.clear();
+	TaskSlot task;
+	for (Task* pTask : m_injectionQueue)
+	{
+		releaseTask(pTask, task);
+	}
+	m_injectionQueue.clear();
+	m_injectionCount = 0;
+
+	if (m_pRing)
+	{
+		while (popRingTask(task))
+		{
+		}
+	}
+
+	for (auto& pWorker : m_workers)
+	{
+		Task* pTask = nullptr;
+		while (pWorker->m_deque.pop(pTask))
+		{
+			releaseTask(pTask, task);
+		}
+	}
+
 	m_taskCount = 0;
+	m_isReleased = false;
 }
 
 
 /*
 * Add a task to the queue
-* 
+* A worker thread pushes it on its own deque, any other thread on the injection queue (or on the ring).
+* Only one sleeping worker is woken up, if any.
+*
 * @param taskCallback The task to add to the queue
 * @return void
 */
 void TaskQueue::addTask(std::function<void()>&& taskCallback)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pRing)
+	{
+		TaskSlot ringTask;
+		ringTask.m_callback = std::move(taskCallback);
+		pushRingTask(ringTask);
+		return;
+	}
 
-	m_tasks.push_back(std::move(taskCallback));
-	m_taskCount++;
+	Task* pTask = new Task();
+	pTask->m_callback = std::move(taskCallback);
+	pushTask(pTask);
+}
+
+
+/*
+* Add a persistent task to the queue, without allocation
+* The task is only referenced: it must stay alive until it is executed, and must not be added again before
+*
+* @param persistentTask The task to add to the queue, owned by the caller
+* @return void
+*/
+void TaskQueue::addTask(Task& persistentTask)
+{
+	persistentTask.m_isPersistent = true;
+	if (m_pRing)
+	{
+		TaskSlot ringTask;
+		ringTask.m_pPersistentTask = &persistentTask;
+		pushRingTask(ringTask);
+		return;
+	}
 
-	// Wake up all worker thread (if waiting in gettask())
-	m_cv.notify_all(); // notify_one() may be better ? but in case...
+	pushTask(&persistentTask);
 }
 
 
 /*
-* Get a task from the queue, and remove it from the queue
-* The task is moved into the taskCallback parameter
-* 
-* @param taskCallback The task to get from the queue
+* Get a task for a worker thread, the task is moved into the task parameter
+* Looks for a task in the worker's deque, then in the injection queue, then in the other workers' deques
+* (or in the ring). Spins for a while if there is none, then sleeps until a task is added.
+* Returns an empty task if the queue has been released.
+*
+* @param task The task to get from the queue
+* @param workerIndex Index of the calling worker thread, in [0, numberOfWorkers[ (see setWorkerCount())
 * @return void
 */
-void TaskQueue::getTask(std::function<void()>& taskCallback)
+void TaskQueue::getTask(TaskSlot& task, const size_t workerIndex)
+{
+	s_pCurrentQueue = this;
+	s_currentWorkerIndex = workerIndex;
+
+	int idleRounds = 0;
+	while (!m_isReleased)
+	{
+		if (m_pRing)
+		{
+			if (popRingTask(task))
+			{
+				return;
+			}
+		}
+		else
+		{
+			Task* pTask = findTask(workerIndex);
+			if (pTask)
+			{
+				releaseTask(pTask, task);
+				return;
+			}
+		}
+
+		// Tasks often come in bursts (one per batch of rows), keep looking for a short while
+		if (++idleRounds < m_spinRounds || !m_canPark)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Sleep until a task is added, the sleeping count is raised before checking the queues again,
+		// so either this worker sees the new task, or addTask() sees this worker and wakes it up
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		const uint64_t epoch = m_wakeEpoch;
+		m_sleepingCount++;
+		if (!hasPendingTasks() && !m_isReleased)
+		{
+			m_cv.wait(lock, [this, epoch]() { return m_wakeEpoch != epoch || m_isReleased; });
+		}
+		m_sleepingCount--;
+		idleRounds = 0;
+	}
+}
+
+
+/*
+* Execute one of the waiting tasks in the calling thread, used by the threads waiting for tasks to help the workers
+* A worker looks in its own deque first, any other thread in the injection queue, then they steal from the workers.
+* With the BoundedRing backend, every thread takes the oldest task of the ring.
+*
+* @return bool True if a task was executed, false if no task was found
+*/
+bool TaskQueue::runPendingTask()
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
+	TaskSlot task;
+	if (m_pRing)
+	{
+		if (!popRingTask(task))
+		{
+			return false;
+		}
+		task();
+		markTaskAsDone();
+		return true;
+	}
 
-	// Wait until a task is available
-	while (m_tasks.empty())
+	Task* pTask = nullptr;
+	if (s_pCurrentQueue == this)
 	{
-		// wait() unlock the mutex and wait until the condition variable is notified
-		// The lambda function is used to check if the task queue is empty
-		// The mutex is locked again before returning
-		m_cv.wait(lock, [this]() { return !m_tasks.empty(); });  // Sleep until a task is available
-		// The notify_all() in addTask() will wake up all the worker threads waiting here. 
-		// The first one to get the lock will get the task, the others will go back to waiting.
+		pTask = findTask(s_currentWorkerIndex);
+	}
+	else
+	{
+		if (m_injectionCount.load(std::memory_order_relaxed) > 0)
+		{
+			pTask = takeFromInjectionQueue(nullptr);
+		}
+		if (!pTask)
+		{
+			pTask = stealTask(s_helperRandomState, m_workers.size());
+		}
 	}
 
-	// Can happen, because the orchestrator thread can wake up more worker threads than there are tasks
-	if (m_tasks.empty())
+	if (!pTask)
 	{
-		return;
+		return false;
 	}
 
-	taskCallback = std::move(m_tasks.front());
-	m_tasks.pop_front();
+	releaseTask(pTask, task);
+	task();
+	markTaskAsDone();
+	return true;
 }
 
 
 /*
 * Mark a task as done
 * This is used to decrement the task count when a task has been completed
-* 
+*
 * @return void
 */
 void TaskQueue::markTaskAsDone()
@@ -101,19 +276,301 @@ void TaskQueue::markTaskAsDone()
 
 
 /*
-* Wait until the task queue is empty
-* This is used for the orchestrator thread to wait until all tasks have been completed
-* 
+* Wait until the task queue is empty, executing the waiting tasks meanwhile
+* Waits for all the tasks of the queue, prefer TaskGroup::wait() to only wait for the tasks of a group
+*
 * @return void
 */
 void TaskQueue::waitUntilEmpty()
 {
-	//std::unique_lock<std::mutex> lock(m_mutex);
-	//m_cv.wait(lock, [this]() { return m_taskCount == 0; });  // Sleep until all tasks are done
 	// Atomic operation so no mutex needed here
 	while (m_taskCount > 0)
 	{
-		// Try not consuming too much CPU by letting the scheduler do other things
-		std::this_thread::yield();
+		if (!runPendingTask())
+		{
+			// Try not consuming too much CPU by letting the scheduler do other things
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+/*
+* Change how the idle workers and the TaskGroup::wait() calls wait
+* Can be called while the workers are running, the sleeping workers are woken up to apply it
+*
+* @param waitPolicy The new wait policy
+* @return void
+*/
+void TaskQueue::setWaitPolicy(const TaskWaitPolicy& waitPolicy)
+{
+	m_spinRounds = std::max(waitPolicy.m_spinRounds, 0);
+	m_canPark = waitPolicy.m_canPark;
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wakeEpoch++;
+	}
+	m_cv.notify_all();
+}
+
+
+/*
+* Get the current wait policy
+*
+* @return TaskWaitPolicy The wait policy
+*/
+TaskWaitPolicy TaskQueue::getWaitPolicy() const
+{
+	TaskWaitPolicy waitPolicy;
+	waitPolicy.m_spinRounds = m_spinRounds;
+	waitPolicy.m_canPark = m_canPark;
+	return waitPolicy;
+}
+
+
+/*
+* Find a task for a worker: its own deque first (last pushed task, hot in cache),
+* then the injection queue, then the other workers' deques
+*
+* @param workerIndex Index of the worker
+* @return Task* The task, nullptr if none was found
+*/
+TaskQueue::Task* TaskQueue::findTask(const size_t workerIndex)
+{
+	Worker& worker = *m_workers[workerIndex];
+
+	Task* pTask = nullptr;
+	if (worker.m_deque.pop(pTask))
+	{
+		return pTask;
+	}
+
+	if (m_injectionCount.load(std::memory_order_relaxed) > 0)
+	{
+		pTask = takeFromInjectionQueue(&worker);
+		if (pTask)
+		{
+			return pTask;
+		}
 	}
-}
\ No newline at end of file
+
+	return stealTask(worker.m_randomState, workerIndex);
+}
+
+
+/*
+* Take a chunk of tasks from the injection queue, to lock it less often
+* The first task is returned, the others are pushed on the worker's deque where they can be stolen
+*
+* @param pWorker The calling worker, nullptr to take a single task from another thread
+* @return Task* The first task of the chunk, nullptr if the injection queue is empty
+*/
+TaskQueue::Task* TaskQueue::takeFromInjectionQueue(Worker* pWorker)
+{
+	Task* pFirstTask = nullptr;
+	size_t takenCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_injectionMutex);
+		if (m_injectionQueue.empty())
+		{
+			return nullptr;
+		}
+
+		// Leave some tasks for the other workers when there are only a few
+		const size_t workerCount = std::max<size_t>(m_workers.size(), 1);
+		takenCount = pWorker ? std::min(s_injectionChunkSize, (m_injectionQueue.size() + workerCount - 1) / workerCount) : 1;
+
+		pFirstTask = m_injectionQueue.front();
+		m_injectionQueue.pop_front();
+		for (size_t k = 1; k < takenCount; ++k)
+		{
+			pWorker->m_deque.push(m_injectionQueue.front());
+			m_injectionQueue.pop_front();
+		}
+		m_injectionCount -= takenCount;
+	}
+
+	// The other tasks of the chunk can be stolen
+	if (takenCount > 1)
+	{
+		wakeWorker();
+	}
+
+	return pFirstTask;
+}
+
+
+/*
+* Steal a task from a worker, the victims are visited from a random one
+*
+* @param randomState State of the random victim selection of the thief
+* @param thiefIndex Index of the thief, not a worker index if the thief is not a worker
+* @return Task* The stolen task, nullptr if all the deques were empty
+*/
+TaskQueue::Task* TaskQueue::stealTask(uint32_t& randomState, const size_t thiefIndex)
+{
+	const size_t workerCount = m_workers.size();
+	if (workerCount == 0)
+	{
+		return nullptr;
+	}
+
+	// Xorshift, each thief has its own state
+	uint32_t& state = randomState;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	const size_t firstVictim = state % workerCount;
+	for (size_t k = 0; k < workerCount; ++k)
+	{
+		const size_t victimIndex = (firstVictim + k) % workerCount;
+		if (victimIndex == thiefIndex)
+		{
+			continue;
+		}
+
+		Task* pTask = nullptr;
+		if (m_workers[victimIndex]->m_deque.steal(pTask))
+		{
+			return pTask;
+		}
+	}
+
+	return nullptr;
+}
+
+
+/*
+* Push a task on the deque of the calling worker, or on the injection queue for the other threads
+*
+* @param pTask The task to push
+* @return void
+*/
+void TaskQueue::pushTask(Task* pTask)
+{
+	m_taskCount++;
+
+	if (s_pCurrentQueue == this)
+	{
+		m_workers[s_currentWorkerIndex]->m_deque.push(pTask);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_injectionMutex);
+		m_injectionQueue.push_back(pTask);
+		m_injectionCount++;
+	}
+
+	wakeWorker();
+}
+
+
+/*
+* Push a task on the ring, executes the waiting tasks while the ring is full
+*
+* @param ringTask The task to push, moved into the ring
+* @return void
+*/
+void TaskQueue::pushRingTask(TaskSlot& ringTask)
+{
+	m_taskCount++;
+
+	while (!m_pRing->tryPush(ringTask))
+	{
+		// Free a slot, the tasks of a phase are often more than the slots
+		if (!runPendingTask())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	wakeWorker();
+}
+
+
+/*
+* Pop the oldest task of the ring, a persistent task stays referenced
+*
+* @param task The task, moved out of its slot
+* @return bool True if a task was popped, false if the ring was empty
+*/
+bool TaskQueue::popRingTask(TaskSlot& task)
+{
+	return m_pRing->tryPop(task);
+}
+
+
+/*
+* Get the callback of a task taken from the queue, and delete the task unless it is persistent
+* A persistent task is only referenced, its callback stays in it to be executed again later
+*
+* @param pTask The task taken from the queue
+* @param task The task to execute
+* @return void
+*/
+void TaskQueue::releaseTask(Task* pTask, TaskSlot& task)
+{
+	if (pTask->m_isPersistent)
+	{
+		task.m_callback = nullptr;
+		task.m_pPersistentTask = pTask;
+		return;
+	}
+
+	task.m_callback = std::move(pTask->m_callback);
+	task.m_pPersistentTask = nullptr;
+	delete pTask;
+}
+
+
+/*
+* Check if a task is waiting in the ring, in the injection queue or in a worker's deque
+*
+* @return bool True if a task is waiting
+*/
+bool TaskQueue::hasPendingTasks() const
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_pRing && !m_pRing->empty())
+	{
+		return true;
+	}
+
+	if (m_injectionCount.load(std::memory_order_relaxed) > 0)
+	{
+		return true;
+	}
+
+	for (const auto& pWorker : m_workers)
+	{
+		if (!pWorker->m_deque.empty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+* Wake up one sleeping worker, if any
+*
+* @return void
+*/
+void TaskQueue::wakeWorker()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_sleepingCount.load(std::memory_order_relaxed) > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_wakeEpoch++;
+		}
+		m_cv.notify_one();
+	}
+}
@@ -1,36 +1,158 @@
 #pragma once
 
+// Includes from project
+#include "../src/threading/chaseLevDeque.hpp"
+#include "../src/threading/mpmcRing.hpp"
+
 // Includes from STL
 #include <deque>
+#include <vector>
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <condition_variable>
 
+
+/*
+* How a thread waits for tasks (idle worker) or for the end of tasks (TaskGroup::wait())
+* It first spins for m_spinRounds rounds (looking for a task and yielding in between), then sleeps
+* on a condition variable if m_canPark is true. Spinning reacts faster to short waits, sleeping frees the core.
+*/
+struct TaskWaitPolicy
+{
+	int m_spinRounds = 64;
+	bool m_canPark = true;
+};
+
+
+/*
+* How a TaskQueue stores its tasks
+* WorkStealing: a deque per worker and a global injection queue (see TaskQueue).
+* BoundedRing: a single lock free ring shared by all the threads, with fixed size slots holding the tasks,
+* no allocation nor lock per task, but no locality: any worker takes the oldest task.
+*/
+enum class TaskQueueBackend
+{
+	WorkStealing,
+	BoundedRing
+};
+
+
 /*
 * TaskQueue
-* A simple task queue that can be used to queue up tasks to be executed by a thread pool.
-* The tasks are stored in a deque and can be added, retrieved and marked as done.
-* The orchestrator thread can also wait until all tasks have been completed.
+* A work stealing task queue, used to dispatch tasks to a pool of worker threads.
+* Each worker owns a Chase-Lev deque: the tasks added by a worker go to its own deque, the tasks added by
+* other threads (the orchestrator) go to a global injection queue. An idle worker takes a chunk of tasks from
+* the injection queue (the extra ones go to its deque, where the other workers can steal them), or steals
+* from the deque of another worker, starting from a random victim.
+* The idle workers sleep on a condition variable, and are only woken up (one at a time) when tasks arrive.
+* A thread waiting for tasks can help executing them (runPendingTask()), see TaskGroup.
 * The tasks are stored as std::function<void()> so they can be any callable object.
+* With the BoundedRing backend, the tasks are moved into the slots of a MpmcRing instead (no Task allocated,
+* no mutex, a persistent task only takes a pointer): every thread pushes and pops at the same ring. A thread adding a task to a full ring executes the
+* waiting tasks until a slot is free.
 */
 class TaskQueue
 {
+public:
+	/*
+	* A task of the queue
+	* The tasks added as a callback are allocated and deleted by the queue. The persistent tasks are owned by
+	* the caller (see TaskGraph): the queue only references them, they can be added again once executed.
+	*/
+	struct Task
+	{
+		std::function<void()> m_callback;
+		bool m_isPersistent = false;
+	};
+
+	/*
+	* A task taken from the queue, and a slot of the ring: a callback moved in, or a persistent task only
+	* referenced, whose callback is executed in place (a replayed TaskGraph does not copy its callbacks)
+	*/
+	struct TaskSlot
+	{
+		std::function<void()> m_callback;
+		Task* m_pPersistentTask = nullptr;
+
+		inline explicit operator bool() const { return m_pPersistentTask != nullptr || static_cast<bool>(m_callback); };
+		inline void operator()()
+		{
+			if (m_pPersistentTask)
+			{
+				m_pPersistentTask->m_callback();
+			}
+			else
+			{
+				m_callback();
+			}
+		};
+	};
+
 private:
-	std::deque<std::function<void()>> m_tasks;
-	std::mutex m_mutex;
-	std::atomic<int> m_taskCount = 0;
+	// Tasks taken at once from the injection queue by an idle worker
+	static constexpr size_t s_injectionChunkSize = 8;
+
+	const TaskQueueBackend m_backend;
+	std::unique_ptr<MpmcRing<TaskSlot>> m_pRing;
+
+	struct alignas(64) Worker
+	{
+		ChaseLevDeque<Task*> m_deque;
+		uint32_t m_randomState = 1;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	// Tasks added from outside the worker threads
+	std::deque<Task*> m_injectionQueue;
+	std::mutex m_injectionMutex;
+	std::atomic<size_t> m_injectionCount = 0;
+
+	// Sleeping workers
+	std::mutex m_sleepMutex;
 	std::condition_variable m_cv;
+	std::atomic<int> m_sleepingCount = 0;
+	uint64_t m_wakeEpoch = 0;
+	std::atomic<bool> m_isReleased = false;
+	std::atomic<int> m_spinRounds = TaskWaitPolicy().m_spinRounds;
+	std::atomic<bool> m_canPark = TaskWaitPolicy().m_canPark;
+
+	std::atomic<int> m_taskCount = 0;
 
 public:
-	TaskQueue() = default;
-	~TaskQueue() = default;
+	static constexpr size_t s_defaultRingCapacity = 4096;
+
+	explicit TaskQueue(const TaskQueueBackend backend = TaskQueueBackend::WorkStealing, const size_t ringCapacity = s_defaultRingCapacity);
+	~TaskQueue();
+
+	TaskQueue(const TaskQueue&) = delete;
+	TaskQueue& operator=(const TaskQueue&) = delete;
 
+	void setWorkerCount(const size_t numberOfWorkers);
 	void addTask(std::function<void()>&& taskCallback);
-	void getTask(std::function<void()>& taskCallback);
+	void addTask(Task& persistentTask);
+	void getTask(TaskSlot& task, const size_t workerIndex);
+	bool runPendingTask();
 	void markTaskAsDone();
 	void waitUntilEmpty();
+	void setWaitPolicy(const TaskWaitPolicy& waitPolicy);
+	TaskWaitPolicy getWaitPolicy() const;
 	void releaseAll(const size_t numberOfThreads);
 	void clearTaskQueue();
-};
\ No newline at end of file
+
+	inline TaskQueueBackend getBackend() const { return m_backend; };
+
+private:
+	Task* findTask(const size_t workerIndex);
+	Task* takeFromInjectionQueue(Worker* pWorker);
+	Task* stealTask(uint32_t& randomState, const size_t thiefIndex);
+	void pushTask(Task* pTask);
+	void pushRingTask(TaskSlot& ringTask);
+	bool popRingTask(TaskSlot& task);
+	static void releaseTask(Task* pTask, TaskSlot& task);
+	bool hasPendingTasks() const;
+	void wakeWorker();
+};
@@ -0,0 +1,465 @@
+// Includes from project
+#include "../src/threading/threadPoolConfig.hpp"
+
+// Includes from STL
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+/*
+* Read the first line of a file
+*
+* @param path The path of the file
+* @param line The first line, empty if the file can not be read
+* @return bool True if the file was read
+*/
+static bool readFirstLine(const char* path, std::string& line)
+{
+	std::ifstream file(path);
+	line.clear();
+	return file.is_open() && static_cast<bool>(std::getline(file, line));
+}
+
+
+/*
+* Read a boolean from an environment variable ("0" or "1")
+*
+* @param name The name of the variable
+* @param value Set to the value of the variable, unchanged if it is not set or not a boolean
+* @return void
+*/
+static void readBoolean(const char* name, bool& value)
+{
+	const char* pValue = std::getenv(name);
+	if (pValue == nullptr)
+	{
+		return;
+	}
+	if (std::strcmp(pValue, "1") == 0)
+	{
+		value = true;
+	}
+	else if (std::strcmp(pValue, "0") == 0)
+	{
+		value = false;
+	}
+}
+
+
+/*
+* Read the CPUs the process is allowed to run on (its affinity mask)
+* On Linux the mask is the one of the calling thread, it must not have been pinned yet.
+*
+* @return std::vector<int> The indices of the CPUs, in increasing order, empty if they can not be read
+*/
+static std::vector<int> readProcessCpus()
+{
+	std::vector<int> cpus;
+
+#if defined(_WIN32)
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu)
+		{
+			if (processMask & (static_cast<DWORD_PTR>(1) << cpu))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &set))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#endif
+	return cpus;
+}
+
+
+/*
+* Get the CPUs the process is allowed to run on (its affinity mask)
+* The mask is read once, by the first call, before the pool pins any thread (on Linux it is read from the calling
+* thread, which can be the GUI thread pinned to its reserved core by a previous pool, see reservePoolCpus()).
+* Without affinity support, all the hardware threads are assumed to be available
+*
+* @return std::vector<int> The indices of the CPUs, in increasing order, never empty
+*/
+std::vector<int> ThreadPoolConfig::getAvailableCpus()
+{
+	static const std::vector<int> s_cpus = []() {
+		std::vector<int> cpus = readProcessCpus();
+		if (cpus.empty())
+		{
+			const int hardwareThreadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+			for (int cpu = 0; cpu < hardwareThreadCount; ++cpu)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}();
+	return s_cpus;
+}
+
+
+/*
+* Get the CPUs the calling thread is allowed to run on
+* Only Linux and Windows have a mask per thread, the other systems give the CPUs of the process.
+*
+* @return std::vector<int> The indices of the CPUs, in increasing order, never empty
+*/
+std::vector<int> ThreadPoolConfig::getCurrentThreadCpus()
+{
+	std::vector<int> cpus;
+
+#if defined(_WIN32)
+	// Windows only gives the mask of a thread when it is replaced: set the mask of the process, then put it back
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		const DWORD_PTR threadMask = SetThreadAffinityMask(GetCurrentThread(), processMask);
+		if (threadMask != 0)
+		{
+			SetThreadAffinityMask(GetCurrentThread(), threadMask);
+			for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu)
+			{
+				if (threadMask & (static_cast<DWORD_PTR>(1) << cpu))
+				{
+					cpus.push_back(cpu);
+				}
+			}
+		}
+	}
+#elif defined(__linux__)
+	cpus = readProcessCpus();
+#endif
+
+	return cpus.empty() ? getAvailableCpus() : cpus;
+}
+
+
+/*
+* Get the CPU quota of the cgroup of the process, as a number of CPUs (e.g. 2.5 for "250000 100000")
+* The cgroup of the process is found in /proc/self/cgroup, its cgroup v2 file cpu.max is read, then its cgroup v1
+* files cpu.cfs_quota_us and cpu.cfs_period_us. The files at the root of the hierarchy are read when the cgroup of
+* the process is not mounted (e.g. in a container with its own cgroup namespace, where its cgroup is the root).
+*
+* @return double The number of CPUs the process can use, 0 if it is not limited (or not on Linux)
+*/
+double ThreadPoolConfig::getCgroupCpuLimit()
+{
+#if defined(__linux__)
+	std::string processCgroups;
+	{
+		std::ifstream file("/proc/self/cgroup");
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		processCgroups = stream.str();
+	}
+
+	std::string content;
+	const std::string v2Path = parseProcCgroupPath(processCgroups, "");
+	if ((!v2Path.empty() && readFirstLine(("/sys/fs/cgroup" + v2Path + "/cpu.max").c_str(), content))
+		|| readFirstLine("/sys/fs/cgroup/cpu.max", content))
+	{
+		return parseCgroupV2CpuMax(content);
+	}
+
+	std::string quota;
+	std::string period;
+	const std::string v1Directory = "/sys/fs/cgroup/cpu" + parseProcCgroupPath(processCgroups, "cpu");
+	if ((readFirstLine((v1Directory + "/cpu.cfs_quota_us").c_str(), quota) && readFirstLine((v1Directory + "/cpu.cfs_period_us").c_str(), period))
+		|| (readFirstLine("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", quota) && readFirstLine("/sys/fs/cgroup/cpu/cpu.cfs_period_us", period)))
+	{
+		return parseCgroupV1CpuQuota(quota, period);
+	}
+#endif
+
+	return 0.0;
+}
+
+
+/*
+* Find the cgroup of the process in the content of /proc/self/cgroup, one "<id>:<controllers>:<path>" line per
+* hierarchy: "0::/path" for the cgroup v2 hierarchy, "4:cpu,cpuacct:/path" for a cgroup v1 hierarchy
+*
+* @param content The content of /proc/self/cgroup
+* @param controller The cgroup v1 controller of the hierarchy (e.g. "cpu"), empty for the cgroup v2 hierarchy
+* @return std::string The path of the cgroup in its hierarchy, empty if the hierarchy is not found
+*/
+std::string ThreadPoolConfig::parseProcCgroupPath(const std::string& content, const std::string& controller)
+{
+	std::istringstream stream(content);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		const size_t controllersStart = line.find(':');
+		const size_t pathStart = (controllersStart == std::string::npos) ? std::string::npos : line.find(':', controllersStart + 1);
+		if (pathStart == std::string::npos)
+		{
+			continue;
+		}
+
+		const std::string controllers = line.substr(controllersStart + 1, pathStart - controllersStart - 1);
+		bool isHierarchy = controller.empty() && controllers.empty() && line.compare(0, controllersStart, "0") == 0;
+		std::istringstream controllerStream(controllers);
+		std::string lineController;
+		while (!controller.empty() && !isHierarchy && std::getline(controllerStream, lineController, ','))
+		{
+			isHierarchy = (lineController == controller);
+		}
+		if (isHierarchy)
+		{
+			return line.substr(pathStart + 1);
+		}
+	}
+	return std::string();
+}
+
+
+/*
+* Parse the content of the cgroup v2 file cpu.max: "<quota> <period>", the quota being "max" without limit
+*
+* @param content The content of the file
+* @return double The number of CPUs allowed by the quota, 0 if there is no limit or the content is invalid
+*/
+double ThreadPoolConfig::parseCgroupV2CpuMax(const std::string& content)
+{
+	std::istringstream stream(content);
+	std::string quota;
+	std::string period;
+	if (!(stream >> quota >> period) || quota == "max")
+	{
+		return 0.0;
+	}
+	return parseCgroupV1CpuQuota(quota, period);
+}
+
+
+/*
+* Parse a cgroup CPU quota and its period (in microseconds), a negative quota meaning no limit
+*
+* @param quota The quota, in microseconds of CPU time per period
+* @param period The period, in microseconds
+* @return double The number of CPUs allowed by the quota, 0 if there is no limit or the values are invalid
+*/
+double ThreadPoolConfig::parseCgroupV1CpuQuota(const std::string& quota, const std::string& period)
+{
+	char* pEnd = nullptr;
+	const double quotaValue = std::strtod(quota.c_str(), &pEnd);
+	if (pEnd == quota.c_str())
+	{
+		return 0.0;
+	}
+	const double periodValue = std::strtod(period.c_str(), &pEnd);
+	if (pEnd == period.c_str() || quotaValue <= 0.0 || periodValue <= 0.0)
+	{
+		return 0.0;
+	}
+	return quotaValue / periodValue;
+}
+
+
+/*
+* Get the number of threads the process can run at the same time without oversubscribing its CPUs:
+* the CPUs of its affinity mask, limited by the CPU quota of its cgroup (rounded down, at least 1)
+*
+* @return size_t The CPU budget of the process
+*/
+size_t ThreadPoolConfig::getCpuBudget()
+{
+	size_t budget = getAvailableCpus().size();
+
+	const double cgroupLimit = getCgroupCpuLimit();
+	if (cgroupLimit > 0.0)
+	{
+		budget = std::min(budget, std::max(static_cast<size_t>(1), static_cast<size_t>(std::floor(cgroupLimit))));
+	}
+	return budget;
+}
+
+
+/*
+* Number of worker threads for a CPU budget
+* The orchestrator thread executes tasks while it waits for a step, so it takes a core of the budget,
+* and so does the GUI/render thread if a core is reserved for it.
+*
+* @param cpuBudget The number of threads the process can run at the same time
+* @param reserveMainThreadCore Keep a core for the GUI/render thread
+* @return size_t The number of worker threads, at least 1
+*/
+size_t ThreadPoolConfig::computeWorkerCount(const size_t cpuBudget, const bool reserveMainThreadCore)
+{
+	const size_t otherThreadCount = reserveMainThreadCore ? 2 : 1;
+	return (cpuBudget > otherThreadCount) ? cpuBudget - otherThreadCount : 1;
+}
+
+
+/*
+* Override the settings with the environment variables CLOTH_WORKER_THREADS, CLOTH_PIN_THREADS, CLOTH_RESERVE_CORE
+* and CLOTH_TASK_QUEUE
+* The variables that are not set, or not valid, leave the settings unchanged.
+*
+* @param settings The settings from the application
+* @return ThreadPoolSettings The settings with the overrides applied
+*/
+ThreadPoolSettings ThreadPoolConfig::applyEnvironment(const ThreadPoolSettings& settings)
+{
+	ThreadPoolSettings result = settings;
+
+	const char* pWorkerCount = std::getenv("CLOTH_WORKER_THREADS");
+	if (pWorkerCount != nullptr)
+	{
+		char* pEnd = nullptr;
+		const long workerCount = std::strtol(pWorkerCount, &pEnd, 10);
+		if (pEnd != pWorkerCount && *pEnd == '\0' && workerCount >= 0)
+		{
+			result.m_workerCount = static_cast<size_t>(workerCount);
+		}
+	}
+	readBoolean("CLOTH_PIN_THREADS", result.m_pinThreads);
+	readBoolean("CLOTH_RESERVE_CORE", result.m_reserveMainThreadCore);
+
+	const char* pTaskQueue = std::getenv("CLOTH_TASK_QUEUE");
+	if (pTaskQueue != nullptr && std::strcmp(pTaskQueue, "stealing") == 0)
+	{
+		result.m_taskQueueBackend = TaskQueueBackend::WorkStealing;
+	}
+	else if (pTaskQueue != nullptr && std::strcmp(pTaskQueue, "ring") == 0)
+	{
+		result.m_taskQueueBackend = TaskQueueBackend::BoundedRing;
+	}
+
+	return result;
+}
+
+
+/*
+* Get the settings to start the pool with: the environment overrides applied, and the number of workers
+* computed from the CPU budget if it is not set
+*
+* @param settings The settings from the application
+* @return ThreadPoolSettings The settings with a number of workers
+*/
+ThreadPoolSettings ThreadPoolConfig::resolve(const ThreadPoolSettings& settings)
+{
+	ThreadPoolSettings result = applyEnvironment(settings);
+	if (result.m_workerCount == 0)
+	{
+		result.m_workerCount = computeWorkerCount(getCpuBudget(), result.m_reserveMainThreadCore);
+	}
+	return result;
+}
+
+
+/*
+* Get the CPUs of the threads of a pool, and pin the calling thread (the GUI thread) to the core reserved for it
+* The previous CPUs of the calling thread are saved, to give them back when the pool stops (see releaseMainThreadCore()).
+*
+* @param settings The resolved settings of the pool (see resolve())
+* @param mainThreadCpus Set to the CPUs of the calling thread before it was pinned, empty if it was not pinned
+* @return std::vector<int> The CPUs of the workers and of the orchestrator thread, empty if they are not pinned
+*/
+std::vector<int> ThreadPoolConfig::reservePoolCpus(const ThreadPoolSettings& settings, std::vector<int>& mainThreadCpus)
+{
+	mainThreadCpus.clear();
+	if (!settings.m_pinThreads)
+	{
+		return {};
+	}
+
+	std::vector<int> cpus = getAvailableCpus();
+	if (settings.m_reserveMainThreadCore && cpus.size() > 1)
+	{
+		const std::vector<int> previousCpus = getCurrentThreadCpus();
+		if (pinCurrentThread({ cpus.front() }))
+		{
+			mainThreadCpus = previousCpus;
+		}
+		cpus.erase(cpus.begin());
+	}
+	return cpus;
+}
+
+
+/*
+* Give back to the calling thread the CPUs it had before the pool reserved a core for it
+*
+* @param mainThreadCpus The CPUs saved by reservePoolCpus(), cleared
+* @return void
+*/
+void ThreadPoolConfig::releaseMainThreadCore(std::vector<int>& mainThreadCpus)
+{
+	if (!mainThreadCpus.empty())
+	{
+		pinCurrentThread(mainThreadCpus);
+		mainThreadCpus.clear();
+	}
+}
+
+
+/*
+* Restrict the calling thread to a set of CPUs
+*
+* @param cpus The indices of the CPUs the thread can run on
+* @return bool True if the affinity of the thread was changed
+*/
+bool ThreadPoolConfig::pinCurrentThread(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+	{
+		return false;
+	}
+
+#if defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (const int cpu : cpus)
+	{
+		if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+		{
+			mask |= static_cast<DWORD_PTR>(1) << cpu;
+		}
+	}
+	return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const int cpu : cpus)
+	{
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+		{
+			CPU_SET(cpu, &set);
+		}
+	}
+	return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Includes from project
+#include "../src/threading/taskQueue.hpp"
+
+// Includes from STL
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+* How the pool of worker threads of the orchestrator is set up
+* m_workerCount = 0 sizes the pool from the CPUs the process can use (see ThreadPoolConfig::computeWorkerCount()).
+* m_reserveMainThreadCore keeps a core for the GUI/render thread: one worker less, and when the threads are pinned,
+* the GUI thread gets a core of its own that the other threads never use.
+* m_taskQueueBackend is how the task queue of the pool stores its tasks (see TaskQueueBackend).
+*/
+struct ThreadPoolSettings
+{
+	size_t m_workerCount = 0;
+	bool m_pinThreads = false;
+	bool m_reserveMainThreadCore = true;
+	TaskQueueBackend m_taskQueueBackend = TaskQueueBackend::WorkStealing;
+};
+
+
+/*
+* Time spent by a worker thread executing tasks, since the pool was started
+* m_cpu is the core the worker is pinned to, or -1 if it is not pinned
+*/
+struct WorkerUtilisation
+{
+	size_t m_workerIndex = 0;
+	int m_cpu = -1;
+	double m_busyTime = 0.0;
+	double m_wallTime = 0.0;
+	uint64_t m_taskCount = 0;
+
+	inline double getUtilisation() const { return (m_wallTime > 0.0) ? m_busyTime / m_wallTime : 0.0; };
+};
+
+
+/*
+* Class ThreadPoolConfig
+*
+* Size the thread pool from the hardware and pin the threads to cores.
+* The CPU budget of the process is the number of CPUs it is allowed to run on (affinity mask), limited by the
+* CPU quota of its cgroup (containers, Linux only), so a pool does not oversubscribe a throttled container.
+* The environment variables override the settings:
+*   CLOTH_WORKER_THREADS  number of worker threads (0: sized from the hardware)
+*   CLOTH_PIN_THREADS     "1" to pin the threads to cores, "0" to let the OS schedule them
+*   CLOTH_RESERVE_CORE    "1" to keep a core for the GUI/render thread, "0" to use all the cores for the simulation
+*   CLOTH_TASK_QUEUE      "stealing" for the work stealing task queue, "ring" for the lock free bounded ring
+* Pinning uses pthread_setaffinity_np on Linux and SetThreadAffinityMask on Windows (first 64 CPUs),
+* it is not supported on the other systems.
+*/
+class ThreadPoolConfig
+{
+public:
+	ThreadPoolConfig() = delete;
+	~ThreadPoolConfig() = delete;
+
+	static std::vector<int> getAvailableCpus();
+	static std::vector<int> getCurrentThreadCpus();
+	static double getCgroupCpuLimit();
+	static std::string parseProcCgroupPath(const std::string& content, const std::string& controller);
+	static double parseCgroupV2CpuMax(const std::string& content);
+	static double parseCgroupV1CpuQuota(const std::string& quota, const std::string& period);
+	static size_t getCpuBudget();
+	static size_t computeWorkerCount(const size_t cpuBudget, const bool reserveMainThreadCore);
+	static ThreadPoolSettings applyEnvironment(const ThreadPoolSettings& settings);
+	static ThreadPoolSettings resolve(const ThreadPoolSettings& settings);
+	static bool pinCurrentThread(const std::vector<int>& cpus);
+	static std::vector<int> reservePoolCpus(const ThreadPoolSettings& settings, std::vector<int>& mainThreadCpus);
+	static void releaseMainThreadCore(std::vector<int>& mainThreadCpus);
+};
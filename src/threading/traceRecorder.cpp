@@ -0,0 +1,228 @@
+// Includes from project
+#include "../src/threading/traceRecorder.hpp"
+
+// Includes from STL
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+
+TraceRecorder::TraceRecorder()
+{
+
+}
+
+
+/*
+* Start recording, the events of the previous trace are discarded
+* Must not be called while a thread records events.
+*
+* @param maxEventsPerThread The number of events a thread can record, the next ones are dropped
+* @return void
+*/
+void TraceRecorder::start(const size_t maxEventsPerThread)
+{
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+	m_maxEventsPerThread = maxEventsPerThread;
+	for (auto& pBuffer : m_threadBuffers.getBuffers())
+	{
+		if (pBuffer->m_capacity != m_maxEventsPerThread)
+		{
+			pBuffer->m_events = std::make_unique<TraceEvent[]>(m_maxEventsPerThread);
+			pBuffer->m_capacity = m_maxEventsPerThread;
+		}
+		pBuffer->m_count.store(0, std::memory_order_relaxed);
+		pBuffer->m_droppedCount.store(0, std::memory_order_relaxed);
+	}
+	m_isEnabled = true;
+}
+
+
+/*
+* Stop recording, the events recorded so far are kept until the next start()
+*
+* @return void
+*/
+void TraceRecorder::stop()
+{
+	m_isEnabled = false;
+}
+
+
+/*
+* Record an event for the calling thread, does nothing if the recorder is disabled
+*
+* @param event The event
+* @return void
+*/
+void TraceRecorder::record(const TraceEvent& event)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	ThreadBuffer& buffer = getThreadBuffer();
+	const size_t count = buffer.m_count.load(std::memory_order_relaxed);
+	if (count >= buffer.m_capacity)
+	{
+		buffer.m_droppedCount.store(buffer.m_droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	buffer.m_events[count] = event;
+	buffer.m_count.store(count + 1, std::memory_order_release);
+}
+
+
+/*
+* Name the calling thread in the trace (registers it if needed)
+*
+* @param name The name of the thread
+* @return void
+*/
+void TraceRecorder::setThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+	buffer.m_threadName = name;
+}
+
+
+/*
+* Get the buffer of the calling thread, registers the thread the first time
+* The events of a buffer are allocated when it is registered while recording, or by start()
+*
+* @return ThreadBuffer& The buffer of the thread
+*/
+TraceRecorder::ThreadBuffer& TraceRecorder::getThreadBuffer()
+{
+	return m_threadBuffers.get([this]() {
+		auto pBuffer = std::make_unique<ThreadBuffer>();
+		if (isEnabled())
+		{
+			pBuffer->m_events = std::make_unique<TraceEvent[]>(m_maxEventsPerThread);
+			pBuffer->m_capacity = m_maxEventsPerThread;
+		}
+		return pBuffer;
+	});
+}
+
+
+/*
+* Get the number of events recorded by all the threads
+*
+* @return size_t The number of events
+*/
+size_t TraceRecorder::getEventCount() const
+{
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+	size_t count = 0;
+	for (const auto& pBuffer : m_threadBuffers.getBuffers())
+	{
+		count += pBuffer->m_count.load(std::memory_order_acquire);
+	}
+	return count;
+}
+
+
+/*
+* Get the number of events dropped because the buffer of their thread was full
+*
+* @return uint64_t The number of dropped events, for all the threads
+*/
+uint64_t TraceRecorder::getDroppedEventCount() const
+{
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+	uint64_t droppedCount = 0;
+	for (const auto& pBuffer : m_threadBuffers.getBuffers())
+	{
+		droppedCount += pBuffer->m_droppedCount.load(std::memory_order_relaxed);
+	}
+	return droppedCount;
+}
+
+
+/*
+* Write the trace in the Chrome trace event JSON format
+* Each event is a complete event ("ph": "X": its beginning and its duration), the threads are named by metadata
+* events, the cloth and the range of the event are in its arguments. The times are in microseconds.
+*
+* @param stream The stream to write to
+* @return void
+*/
+void TraceRecorder::writeChromeTrace(std::ostream& stream) const
+{
+	std::lock_guard<std::mutex> lock(m_threadBuffers.getMutex());
+
+	const auto flags = stream.flags();
+	const auto precision = stream.precision();
+	stream << std::fixed << std::setprecision(3);
+
+	uint64_t droppedCount = 0;
+	stream << "{\"traceEvents\":[\n";
+	stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Cloth simulation\"}}";
+	const auto& buffers = m_threadBuffers.getBuffers();
+	for (size_t tid = 0; tid < buffers.size(); ++tid)
+	{
+		const ThreadBuffer& buffer = *buffers[tid];
+		droppedCount += buffer.m_droppedCount.load(std::memory_order_relaxed);
+
+		stream << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+		writeJsonString(stream, buffer.m_threadName.empty() ? "thread " + std::to_string(tid) : buffer.m_threadName);
+		stream << "}}";
+		stream << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"sort_index\":" << tid << "}}";
+
+		const size_t count = buffer.m_count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const TraceEvent& event = buffer.m_events[i];
+			const std::string name = (event.m_pName != nullptr) ? event.m_pName : "";
+			const size_t separator = name.find('.');
+
+			stream << ",\n{\"name\":";
+			writeJsonString(stream, name);
+			stream << ",\"cat\":";
+			writeJsonString(stream, (separator != std::string::npos) ? name.substr(0, separator) : name);
+			stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+				<< ",\"ts\":" << static_cast<double>(event.m_startNanoseconds) * 1e-3
+				<< ",\"dur\":" << static_cast<double>(event.m_durationNanoseconds) * 1e-3;
+			if (event.m_clothUid >= 0 || event.m_pRangeName != nullptr)
+			{
+				stream << ",\"args\":{";
+				if (event.m_clothUid >= 0)
+				{
+					stream << "\"cloth\":" << event.m_clothUid << (event.m_pRangeName != nullptr ? "," : "");
+				}
+				if (event.m_pRangeName != nullptr)
+				{
+					writeJsonString(stream, event.m_pRangeName);
+					stream << ":[" << event.m_rangeBegin << "," << event.m_rangeEnd << "]";
+				}
+				stream << "}";
+			}
+			stream << "}";
+		}
+	}
+	stream << "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"droppedEvents\":" << droppedCount << "}}\n";
+
+	stream.flags(flags);
+	stream.precision(precision);
+}
+
+
+/*
+* Write the trace to a file in the Chrome trace event JSON format
+*
+* @param path The path of the file
+* @return bool True if the file was written
+*/
+bool TraceRecorder::writeChromeTrace(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	writeChromeTrace(file);
+	return static_cast<bool>(file);
+}
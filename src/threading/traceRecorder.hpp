@@ -0,0 +1,88 @@
+#pragma once
+
+// Includes from project
+#include "../src/threading/profilingUtils.hpp"
+
+// Includes from STL
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+* An event of the trace: a scope executed by a thread, with the cloth and the range of items it worked on
+* The name must be a string literal (only the pointer is stored).
+* m_clothUid is -1 if the event is not about a cloth, the range is empty if it has none (m_pRangeName == nullptr).
+*/
+struct TraceEvent
+{
+	const char* m_pName = nullptr;
+	const char* m_pRangeName = nullptr;
+	int64_t m_startNanoseconds = 0;
+	int64_t m_durationNanoseconds = 0;
+	int64_t m_clothUid = -1;
+	int64_t m_rangeBegin = 0;
+	int64_t m_rangeEnd = 0;
+};
+
+
+/*
+* Class TraceRecorder
+*
+* Records the scopes executed by each thread, to see their timeline (idle gaps, waits, stragglers) in
+* chrome://tracing or Perfetto (writeChromeTrace() writes the Chrome trace event JSON format).
+* Each thread appends its events to its own buffer, without locking once the thread is registered (its first event
+* registers it). The buffers are bounded: once a thread has recorded m_maxEventsPerThread events, its new events are
+* dropped (and counted), the beginning of the trace is kept.
+* When the recorder is disabled, record() only reads a flag.
+* start() and stop() must be called while no thread records events (the orchestrator calls them between steps),
+* writeChromeTrace() can be called at any time.
+*/
+class TraceRecorder
+{
+private:
+	struct ThreadBuffer
+	{
+		std::string m_threadName;
+		std::unique_ptr<TraceEvent[]> m_events;
+		size_t m_capacity = 0;
+
+		// Written by the thread of the buffer only
+		std::atomic<size_t> m_count = 0;
+		std::atomic<uint64_t> m_droppedCount = 0;
+	};
+
+	std::atomic<bool> m_isEnabled = false;
+	size_t m_maxEventsPerThread = 0;
+
+	// Buffers of the threads, they live as long as the recorder
+	ThreadBuffers<ThreadBuffer> m_threadBuffers;
+
+public:
+	TraceRecorder();
+	~TraceRecorder() {};
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	void start(const size_t maxEventsPerThread);
+	void stop();
+	void record(const TraceEvent& event);
+	void setThreadName(const std::string& name);
+
+	size_t getEventCount() const;
+	uint64_t getDroppedEventCount() const;
+	void writeChromeTrace(std::ostream& stream) const;
+	bool writeChromeTrace(const std::string& path) const;
+
+	inline bool isEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); };
+
+private:
+	ThreadBuffer& getThreadBuffer();
+};
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "../src/physics/adaptiveTimeStep.hpp"
+
+
+static ClothMotionBounds makeBounds(const double maxSpeed, const double maxStrain, const double maxStrainRate)
+{
+    ClothMotionBounds bounds;
+    bounds.m_maxSpeed = static_cast<Real>(maxSpeed);
+    bounds.m_maxStrain = static_cast<Real>(maxStrain);
+    bounds.m_maxStrainRate = static_cast<Real>(maxStrainRate);
+    return bounds;
+}
+
+
+TEST(AdaptiveTimeStepTest, RestingClothsUseTheLargestStep)
+{
+    AdaptiveTimeStep controller;
+    controller.m_maxTimeStep = 0.02;
+
+    controller.reset();
+    controller.addCloth(makeBounds(0.0, 0.0, 0.0), 0.07);
+    EXPECT_DOUBLE_EQ(controller.selectTimeStep(1.0), 0.02);
+
+    // The stability limit of the integrators still applies
+    controller.reset();
+    controller.addCloth(makeBounds(0.0, 0.0, 0.0), 0.07);
+    EXPECT_DOUBLE_EQ(controller.selectTimeStep(0.005), 0.005);
+}
+
+
+TEST(AdaptiveTimeStepTest, FastestClothSetsTheCflStep)
+{
+    AdaptiveTimeStep controller;
+    controller.m_tolerance = 0.5;
+    controller.m_maxTimeStep = 0.1;
+
+    controller.reset();
+    controller.addCloth(makeBounds(1.0, 0.0, 0.0), 0.07);
+    controller.addCloth(makeBounds(10.0, 0.0, 0.0), 0.07);
+    const double timeStep = controller.selectTimeStep(1.0);
+
+    // A particle moves at most half of its CFL length
+    EXPECT_NEAR(timeStep, 0.5 * 0.07 / 10.0, 1e-7);
+    EXPECT_NEAR(controller.getStats().m_maxSpeed, 10.0, 1e-6);
+    EXPECT_DOUBLE_EQ(controller.getStats().m_timeStep, timeStep);
+}
+
+
+TEST(AdaptiveTimeStepTest, StrainLimitsTheStep)
+{
+    AdaptiveTimeStep controller;
+    controller.m_tolerance = 0.5;
+    controller.m_strainLimit = 0.1;
+    controller.m_maxTimeStep = 0.1;
+
+    // Strain changing at 5 per second: at most 0.05 per step
+    controller.reset();
+    controller.addCloth(makeBounds(0.0, 0.05, 5.0), 0.07);
+    EXPECT_NEAR(controller.selectTimeStep(1.0), 0.01, 1e-7);
+
+    // Over stretched springs slow the simulation down
+    controller.reset();
+    controller.addCloth(makeBounds(0.0, 0.2, 5.0), 0.07);
+    EXPECT_NEAR(controller.selectTimeStep(1.0), 0.005, 1e-7);
+}
+
+
+TEST(AdaptiveTimeStepTest, StepIsClampedToTheMinimum)
+{
+    AdaptiveTimeStep controller;
+    controller.m_minTimeStep = 1e-4;
+
+    controller.reset();
+    controller.addCloth(makeBounds(1e6, 0.0, 0.0), 0.07);
+    EXPECT_DOUBLE_EQ(controller.selectTimeStep(1.0), 1e-4);
+}
+
+
+TEST(AdaptiveTimeStepTest, RemainingTimeIsConsumedWithoutATinyLastStep)
+{
+    AdaptiveTimeStep controller;
+    controller.m_minTimeStep = 1e-4;
+
+    // A step shorter than the remaining time is kept, a longer one is cut
+    EXPECT_DOUBLE_EQ(controller.fitToRemainingTime(0.004, 0.01), 0.004);
+    EXPECT_DOUBLE_EQ(controller.fitToRemainingTime(0.004, 0.003), 0.003);
+
+    // A rounding leftover is simulated by the step, not by another one
+    EXPECT_DOUBLE_EQ(controller.fitToRemainingTime(0.004, 0.004 + 1e-17), 0.004 + 1e-17);
+
+    // Consuming a tick with steps that do not divide it ends on the tick exactly
+    double remainingTime = 1.0 / 60.0;
+    int stepCount = 0;
+    while (remainingTime > 0.0)
+    {
+        const double timeStep = controller.fitToRemainingTime(1.0 / 180.0, remainingTime);
+        EXPECT_GE(timeStep, controller.m_minTimeStep);
+        remainingTime -= timeStep;
+        stepCount++;
+    }
+    EXPECT_EQ(stepCount, 3);
+    EXPECT_EQ(remainingTime, 0.0);
+}
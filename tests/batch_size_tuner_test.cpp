@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "../src/threading/batchSizeTuner.hpp"
+
+
+// Run a round of steps where each item costs 'costPerItem' seconds
+static bool runRound(BatchSizeTuner& tuner, const size_t threadCount, const size_t itemsPerStep, const double costPerItem)
+{
+    bool hasChanged = false;
+    for (int step = 0; step < tuner.m_samplingSteps; ++step)
+    {
+        const size_t batchSize = static_cast<size_t>(tuner.getBatchSize());
+        for (size_t itemFrom = 0; itemFrom < itemsPerStep; itemFrom += batchSize)
+        {
+            const size_t itemCount = std::min(batchSize, itemsPerStep - itemFrom);
+            tuner.addSample(static_cast<uint64_t>(costPerItem * 1e9 * static_cast<double>(itemCount)), itemCount);
+        }
+        hasChanged = tuner.endStep(threadCount, itemsPerStep) || hasChanged;
+    }
+    return hasChanged;
+}
+
+
+TEST(BatchSizeTunerTest, TargetsTasksPerWorkerAndMinimumDuration)
+{
+    BatchSizeTuner tuner;
+    tuner.m_targetTasksPerWorker = 4.0;
+    tuner.m_minTaskDuration = 50e-6;
+    tuner.reset(5, 2, 64);
+
+    // Expensive items: 4 tasks for each of the 8 threads
+    EXPECT_EQ(tuner.computeBatchSize(640.0, 8, 1e-4), 20);
+
+    // Cheap items: the tasks must last at least 50 us
+    EXPECT_EQ(tuner.computeBatchSize(640.0, 8, 1.6e-6), 32);
+
+    // Clamped to the allowed batch sizes
+    EXPECT_EQ(tuner.computeBatchSize(640.0, 8, 1e-8), 64);
+    EXPECT_EQ(tuner.computeBatchSize(8.0, 8, 1e-4), 2);
+}
+
+
+TEST(BatchSizeTunerTest, ConvergesThenLocks)
+{
+    BatchSizeTuner tuner;
+    tuner.m_samplingSteps = 5;
+    tuner.m_stableRounds = 2;
+    tuner.reset(5, 1, 1000);
+
+    // 900 rows on 9 threads, 1 ms per row: 25 rows per task
+    EXPECT_TRUE(runRound(tuner, 9, 900, 1e-3));
+    EXPECT_EQ(tuner.getBatchSize(), 25);
+    EXPECT_FALSE(tuner.isLocked());
+
+    EXPECT_FALSE(runRound(tuner, 9, 900, 1e-3));
+    EXPECT_FALSE(runRound(tuner, 9, 900, 1e-3));
+    EXPECT_TRUE(tuner.isLocked());
+
+    const BatchSizeTunerStats& stats = tuner.getStats();
+    EXPECT_EQ(stats.m_batchSize, 25);
+    EXPECT_EQ(stats.m_changeCount, 1);
+    EXPECT_NEAR(stats.m_costPerItem, 1e-3, 1e-9);
+    EXPECT_NEAR(stats.m_averageTaskDuration, 25e-3, 1e-9);
+
+    // Once locked, the workload does not change the batch size anymore
+    EXPECT_FALSE(runRound(tuner, 9, 9000, 1e-3));
+    EXPECT_EQ(tuner.getBatchSize(), 25);
+}
+
+
+TEST(BatchSizeTunerTest, SmallChangesDoNotRetune)
+{
+    BatchSizeTuner tuner;
+    tuner.m_samplingSteps = 1;
+    tuner.m_stableRounds = 100;
+    tuner.m_tolerance = 0.2;
+    tuner.reset(100, 1, 1000);
+
+    // 10% more items per task than the current batch size
+    EXPECT_FALSE(runRound(tuner, 1, 440, 1.0));
+    EXPECT_EQ(tuner.getBatchSize(), 100);
+
+    // Twice as many
+    EXPECT_TRUE(runRound(tuner, 1, 800, 1.0));
+    EXPECT_EQ(tuner.getBatchSize(), 200);
+}
+
+
+TEST(BatchSizeTunerTest, OscillationsAreLockedAfterTheMaximumChangeCount)
+{
+    BatchSizeTuner tuner;
+    tuner.m_samplingSteps = 1;
+    tuner.m_maxChangeCount = 3;
+    tuner.reset(10, 1, 1000);
+
+    const size_t workloads[] = { 400, 40, 400, 40, 400 };
+    for (const size_t itemsPerStep : workloads)
+    {
+        runRound(tuner, 1, itemsPerStep, 1.0);
+    }
+    EXPECT_TRUE(tuner.isLocked());
+    EXPECT_EQ(tuner.getStats().m_changeCount, 3);
+}
+
+
+TEST(BatchSizeTunerTest, IdleStepsKeepMeasuring)
+{
+    BatchSizeTuner tuner;
+    tuner.m_samplingSteps = 2;
+    tuner.reset(7, 1, 100);
+
+    // No task ran: nothing to learn from
+    EXPECT_FALSE(tuner.endStep(4, 0));
+    EXPECT_FALSE(tuner.endStep(4, 0));
+    EXPECT_EQ(tuner.getBatchSize(), 7);
+    EXPECT_FALSE(tuner.isLocked());
+    EXPECT_EQ(tuner.getStats().m_changeCount, 0);
+}
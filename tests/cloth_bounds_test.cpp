@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+
+#include "../src/physics/clothBounds.hpp"
+
+#include <cmath>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+static const int s_res = 24;
+static const double s_spacing = 0.07;
+static const Real s_radius = static_cast<Real>(0.07);
+
+
+// Bounds of a cloth of s_res x s_res particles, updated from the positions given for each particle
+static void buildBounds(ClothBounds& bounds, const std::function<Vec3R(int, int)>& getPosition)
+{
+    bounds.init(s_res, s_res, s_radius);
+    for (int i = 0; i < s_res; ++i)
+    {
+        bounds.clearRow(i);
+        for (int j = 0; j < s_res; ++j)
+        {
+            bounds.addParticle(i, j, getPosition(i, j));
+        }
+    }
+    bounds.build();
+}
+
+
+static Vec3R flatPosition(const int i, const int j, const Vec3R& origin)
+{
+    return origin + Vec3R(i * s_spacing, 0.0, j * s_spacing);
+}
+
+
+// Pairs of particles of the cloth closer than the sum of their radii that are not neighbors (see Cloth::areParticlesNeighbors()),
+// all of them or only the ones of the active patches, as seen by the grid collider
+static std::vector<std::pair<int, int>> findSelfContacts(const ClothBounds& bounds, const std::function<Vec3R(int, int)>& getPosition, const bool isCulled)
+{
+    std::vector<std::pair<int, int>> contacts;
+    for (int particle1 = 0; particle1 < s_res * s_res; ++particle1)
+    {
+        const int i1 = particle1 / s_res;
+        const int j1 = particle1 % s_res;
+        for (int particle2 = particle1 + 1; particle2 < s_res * s_res; ++particle2)
+        {
+            const int i2 = particle2 / s_res;
+            const int j2 = particle2 % s_res;
+            const bool areNeighbors = std::abs(i1 - i2) <= ClothBounds::s_neighborDistance && std::abs(j1 - j2) <= ClothBounds::s_neighborDistance;
+            if (areNeighbors || (getPosition(i1, j1) - getPosition(i2, j2)).norm() >= 2 * s_radius)
+            {
+                continue;
+            }
+            if (!isCulled || (bounds.isPatchActive(bounds.getPatch(i1, j1)) && bounds.isPatchActive(bounds.getPatch(i2, j2))))
+            {
+                contacts.push_back(std::make_pair(particle1, particle2));
+            }
+        }
+    }
+    return contacts;
+}
+
+
+// The culling keeps all the contacts of the cloth with itself
+static void expectSelfContactsKept(const std::function<Vec3R(int, int)>& getPosition)
+{
+    ClothBounds bounds;
+    buildBounds(bounds, getPosition);
+
+    ClothSweepAndPrune sweepAndPrune;
+    sweepAndPrune.cull({ &bounds });
+
+    const std::vector<std::pair<int, int>> contacts = findSelfContacts(bounds, getPosition, false);
+    EXPECT_FALSE(contacts.empty());
+    EXPECT_EQ(findSelfContacts(bounds, getPosition, true), contacts);
+    EXPECT_LT(sweepAndPrune.getStats().m_activePatchCount, bounds.getPatchCount());
+}
+
+
+TEST(ClothBoundsTest, RootBoxHoldsTheCloth)
+{
+    ClothBounds bounds;
+    buildBounds(bounds, [](const int i, const int j) { return flatPosition(i, j, Vec3R(1.0, 2.0, 3.0)); });
+
+    const ClothBox& box = bounds.getBox();
+    EXPECT_NEAR(box.m_min.x, 1.0 - s_radius, 1e-5);
+    EXPECT_NEAR(box.m_max.x, 1.0 + (s_res - 1) * s_spacing + s_radius, 1e-5);
+    EXPECT_NEAR(box.m_min.y, 2.0 - s_radius, 1e-5);
+    EXPECT_NEAR(box.m_max.y, 2.0 + s_radius, 1e-5);
+    EXPECT_EQ(bounds.getPatchCount(), static_cast<size_t>(6 * 6));
+
+    // Each patch holds its particles
+    for (int i = 0; i < s_res; ++i)
+    {
+        for (int j = 0; j < s_res; ++j)
+        {
+            ClothBox particleBox;
+            particleBox.expand(flatPosition(i, j, Vec3R(1.0, 2.0, 3.0)));
+            EXPECT_TRUE(bounds.getPatchBox(bounds.getPatch(i, j)).overlaps(particleBox));
+        }
+    }
+}
+
+
+TEST(ClothBoundsTest, DistantClothsAreCulled)
+{
+    ClothBounds bounds1;
+    ClothBounds bounds2;
+    ClothBounds bounds3;
+    buildBounds(bounds1, [](const int i, const int j) { return flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)); });
+    buildBounds(bounds2, [](const int i, const int j) { return flatPosition(i, j, Vec3R(5.0, 1.0, 0.0)); });
+    // Above the first one, but too far to touch it
+    buildBounds(bounds3, [](const int i, const int j) { return flatPosition(i, j, Vec3R(0.0, 1.5, 0.0)); });
+
+    ClothSweepAndPrune sweepAndPrune;
+    sweepAndPrune.cull({ &bounds1, &bounds2, &bounds3 });
+
+    const ClothCullingStats& stats = sweepAndPrune.getStats();
+    EXPECT_EQ(stats.m_clothCount, 3u);
+    EXPECT_EQ(stats.m_overlappingClothPairs, 0u);
+    EXPECT_EQ(stats.m_patchCount, 3 * bounds1.getPatchCount());
+    EXPECT_EQ(stats.m_activePatchCount, 0u);
+}
+
+
+TEST(ClothBoundsTest, OnlyTheTouchingPatchesAreActive)
+{
+    // The second cloth lies on the corner of the first one: its first rows and columns are above the last ones
+    ClothBounds bounds1;
+    ClothBounds bounds2;
+    buildBounds(bounds1, [](const int i, const int j) { return flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)); });
+    buildBounds(bounds2, [](const int i, const int j) { return flatPosition(i, j, Vec3R(20 * s_spacing, 1.1, 20 * s_spacing)); });
+
+    // Cull twice: the order of the sweep is kept between the calls
+    ClothSweepAndPrune sweepAndPrune;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        sweepAndPrune.cull({ &bounds2, &bounds1 });
+        EXPECT_EQ(sweepAndPrune.getStats().m_overlappingClothPairs, 1u);
+
+        // The particles of the first cloth from (20, 20) touch the particles of the second one from (0, 0)
+        for (int i = 20; i < s_res; ++i)
+        {
+            for (int j = 20; j < s_res; ++j)
+            {
+                EXPECT_TRUE(bounds1.isPatchActive(bounds1.getPatch(i, j)));
+                EXPECT_TRUE(bounds2.isPatchActive(bounds2.getPatch(i - 20, j - 20)));
+            }
+        }
+        EXPECT_FALSE(bounds1.isPatchActive(bounds1.getPatch(0, 0)));
+        EXPECT_FALSE(bounds2.isPatchActive(bounds2.getPatch(s_res - 1, s_res - 1)));
+        EXPECT_LT(sweepAndPrune.getStats().m_activePatchCount, bounds1.getPatchCount() / 2);
+    }
+}
+
+
+TEST(ClothBoundsTest, FoldsAreActive)
+{
+    ClothBounds flatBounds;
+    buildBounds(flatBounds, [](const int i, const int j) { return flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)); });
+
+    // Folded in half across the rows: the second half of each row lies above its first half
+    ClothBounds foldedBounds;
+    buildBounds(foldedBounds, [](const int i, const int j) {
+        const int half = s_res / 2;
+        return (j < half) ? flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)) : Vec3R(i * s_spacing, 1.1, (s_res - 1 - j) * s_spacing);
+    });
+
+    ClothSweepAndPrune sweepAndPrune;
+    sweepAndPrune.cull({ &flatBounds });
+    EXPECT_EQ(sweepAndPrune.getStats().m_activePatchCount, 0u);
+
+    sweepAndPrune.cull({ &foldedBounds });
+    EXPECT_EQ(sweepAndPrune.getStats().m_overlappingClothPairs, 0u);
+    // Both layers, far from the fold
+    EXPECT_TRUE(foldedBounds.isPatchActive(foldedBounds.getPatch(10, 0)));
+    EXPECT_TRUE(foldedBounds.isPatchActive(foldedBounds.getPatch(10, s_res - 1)));
+    EXPECT_EQ(sweepAndPrune.getStats().m_activePatchCount, foldedBounds.getPatchCount());
+}
+
+
+TEST(ClothBoundsTest, FoldsInsideAPatchAreActive)
+{
+    // The last two rows are folded back above the two rows before them, all in the last row of patches
+    expectSelfContactsKept([](const int i, const int j) {
+        return (i < s_res - 2) ? flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)) : Vec3R((2 * s_res - 5 - i) * s_spacing, 1.1, j * s_spacing);
+    });
+
+    // Same with the last two columns, folded across the patches of the last column of patches
+    expectSelfContactsKept([](const int i, const int j) {
+        return (j < s_res - 2) ? flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)) : Vec3R(i * s_spacing, 1.1, (2 * s_res - 5 - j) * s_spacing);
+    });
+
+    // A fold between two patches next to each other, on the corner of the cloth
+    expectSelfContactsKept([](const int i, const int j) {
+        return (i < 3 || j >= 8) ? flatPosition(i, j, Vec3R(0.0, 1.0, 0.0)) : Vec3R((5 - i) * s_spacing, 1.1, j * s_spacing);
+    });
+}
+
+
+TEST(ClothBoundsTest, CrumpledClothKeepsItsContacts)
+{
+    // Half of the cloth is crumpled: compressed and shaken
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> noise(-0.05, 0.05);
+    std::vector<Vec3R> positions(s_res * s_res);
+    for (int i = 0; i < s_res; ++i)
+    {
+        for (int j = 0; j < s_res; ++j)
+        {
+            positions[i * s_res + j] = flatPosition(i, j, Vec3R(0.0, 1.0, 0.0));
+            if (j >= s_res / 2)
+            {
+                positions[i * s_res + j] = Vec3R(i * s_spacing * 0.6 + noise(generator), 1.0 + noise(generator), j * s_spacing + noise(generator));
+            }
+        }
+    }
+
+    expectSelfContactsKept([&positions](const int i, const int j) { return positions[i * s_res + j]; });
+}
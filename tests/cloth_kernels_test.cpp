@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <type_traits>
+
+#include "../src/math/Vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/contactBuffer.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+#include "../src/physics/simd/clothKernels.hpp"
+#include "../src/physics/simd/simdDispatch.hpp"
+#include "utils.hpp"
+
+
+using IntegrateRowsFunction = void (*)(ClothParticleStore&, const ClothIntegrationParams&, const int, const int);
+
+// The vectorized kernels use FMA, so they match the scalar one up to the rounding of the simulation precision
+static const double s_tolerance = std::is_same_v<Real, float> ? 1e-4 : 1e-9;
+
+
+// Slightly deformed and moving resX x resY grid, with a few fixed and sleeping particles and some external forces
+static void buildStore(ClothParticleStore& store, const int resX, const int resY)
+{
+    buildFlatStore(store, resX, resY, 0.1, 0.0);
+    for (int i = 0; i < resX; ++i)
+    {
+        for (int j = 0; j < resY; ++j)
+        {
+            const size_t index = store.getIndex(i, j);
+            store.m_position[index] += Vec3R(0.01 * std::sin(7.0 * j), 0.02 * std::cos(3.0 * i + j), 0.0);
+            store.m_velocity[index] = Vec3R(2.0 * std::sin(1.0 * index), 0.5, 2.0 * std::cos(2.0 * index));
+            store.m_externalForces[index] = Vec3R(0.0, 0.1 * std::sin(5.0 * index), 0.0);
+            store.m_inverseMass[index] = static_cast<Real>(1.0 + 0.1 * (index % 3));
+        }
+    }
+    store.setFixed(store.getIndex(0, 0), true);
+    store.setFixed(store.getIndex(resX / 2, resY / 2), true);
+    store.setSleeping(store.getIndex(resX - 1, 3), true);
+    store.copyCurrentToPrevious(0, store.size());
+}
+
+
+static void runSteps(ClothParticleStore& store, const ClothSpringStencil* pStencil, IntegrateRowsFunction integrateRows)
+{
+    ClothIntegrationParams params;
+    params.m_dt = static_cast<Real>(0.002);
+    params.m_pStencil = pStencil;
+
+    for (int step = 0; step < 20; ++step)
+    {
+        // Batches of rows, as the orchestrator does
+        forEachRowBatch(store.getResX(), (store.getResX() + 1) / 2, [&](int from, int to) { integrateRows(store, params, from, to); });
+        store.copyCurrentToPrevious(0, store.size());
+    }
+}
+
+
+static void expectSameAsScalar(const SimdIsa isa, IntegrateRowsFunction integrateRows)
+{
+    if (static_cast<int>(SimdDispatch::detectSupportedIsa()) < static_cast<int>(isa))
+    {
+        GTEST_SKIP() << SimdDispatch::getIsaName(isa) << " is not supported by this CPU";
+    }
+
+    // 23 columns: full vector chunks (up to 16 floats), a partial one and the stencil border
+    ClothSpringStencil stencil;
+    stencil.init(11, 23, 0.1, 0.1, 1000.0, 0.5);
+
+    const ClothSpringStencil* stencils[] = { &stencil, nullptr };
+    for (const ClothSpringStencil* pStencil : stencils)
+    {
+        ClothParticleStore reference;
+        buildStore(reference, 11, 23);
+        runSteps(reference, pStencil, &ClothKernels::integrateRowsScalar);
+
+        ClothParticleStore store;
+        buildStore(store, 11, 23);
+        runSteps(store, pStencil, integrateRows);
+
+        for (size_t k = 0; k < store.size(); ++k)
+        {
+            assertVec3Near(Vec3(store.m_position[k]), Vec3(reference.m_position[k]), s_tolerance);
+            assertVec3Near(Vec3(store.m_velocity[k]), Vec3(reference.m_velocity[k]), s_tolerance);
+            assertVec3Near(Vec3(store.m_externalForces[k]), Vec3(reference.m_externalForces[k]), s_tolerance);
+        }
+    }
+}
+
+
+TEST(ClothKernelsTest, Avx2MatchesScalar)
+{
+    expectSameAsScalar(SimdIsa::Avx2, &ClothKernels::integrateRowsAvx2);
+}
+
+
+TEST(ClothKernelsTest, Avx512MatchesScalar)
+{
+    expectSameAsScalar(SimdIsa::Avx512, &ClothKernels::integrateRowsAvx512);
+}
+
+
+TEST(ClothKernelsTest, FixedParticlesDoNotMove)
+{
+    ClothSpringStencil stencil;
+    stencil.init(11, 13, 0.1, 0.1, 1000.0, 0.5);
+
+    ClothParticleStore store;
+    buildStore(store, 11, 13);
+    const size_t fixedIndex = store.getIndex(5, 6);
+    const Vec3 fixedPosition(store.m_position[fixedIndex]);
+
+    runSteps(store, &stencil, &ClothKernels::integrateRows);
+
+    assertVec3Near(Vec3(store.m_position[fixedIndex]), fixedPosition, 0.0);
+}
+
+
+TEST(ClothKernelsTest, SleepingParticlesDoNotMoveUntilWokenUp)
+{
+    ClothSpringStencil stencil;
+    stencil.init(11, 13, 0.1, 0.1, 1000.0, 0.5);
+
+    ClothParticleStore store;
+    buildStore(store, 11, 13);
+    const size_t sleepingIndex = store.getIndex(10, 3);
+    const Vec3 sleepingPosition(store.m_position[sleepingIndex]);
+    EXPECT_TRUE(store.isSleeping(sleepingIndex));
+    EXPECT_TRUE(store.isFrozen(sleepingIndex));
+    EXPECT_FALSE(store.isFixed(sleepingIndex));
+
+    runSteps(store, &stencil, &ClothKernels::integrateRows);
+    assertVec3Near(Vec3(store.m_position[sleepingIndex]), sleepingPosition, 0.0);
+
+    // Once woken up, the particle is integrated again
+    store.setSleeping(sleepingIndex, false);
+    EXPECT_FALSE(store.isFrozen(sleepingIndex));
+    runSteps(store, &stencil, &ClothKernels::integrateRows);
+    EXPECT_GT((Vec3(store.m_position[sleepingIndex]) - sleepingPosition).norm(), 1e-3);
+}
+
+
+TEST(ClothKernelsTest, SwappingTheStateBuffersMatchesCopyingThem)
+{
+    ClothSpringStencil stencil;
+    stencil.init(11, 13, 0.1, 0.1, 1000.0, 0.5);
+
+    ClothParticleStore reference;
+    buildStore(reference, 11, 13);
+    runSteps(reference, &stencil, &ClothKernels::integrateRows);
+
+    // The integration writes the whole current state, so the previous one never needs to be copied
+    ClothParticleStore store;
+    buildStore(store, 11, 13);
+    ClothIntegrationParams params;
+    params.m_dt = static_cast<Real>(0.002);
+    params.m_pStencil = &stencil;
+    for (int step = 0; step < 20; ++step)
+    {
+        ClothKernels::integrateRows(store, params, 0, store.getResX());
+        store.swapCurrentAndPrevious();
+    }
+
+    for (size_t k = 0; k < store.size(); ++k)
+    {
+        assertVec3Near(Vec3(store.m_previousPosition[k]), Vec3(reference.m_position[k]), 0.0);
+        assertVec3Near(Vec3(store.m_previousVelocity[k]), Vec3(reference.m_velocity[k]), 0.0);
+    }
+}
+
+
+// Apply the contacts of the rows [rowFrom, rowTo[ of a store, like Cloth::applyContacts()
+static void applyContacts(ClothParticleStore& store, const std::vector<ContactBuffer>& buffers, const int rowFrom, const int rowTo)
+{
+    ContactBuffer::forEachParticle(buffers, 0, store.getIndex(rowFrom, 0), store.getIndex(rowTo, 0),
+        [&store](const size_t index, const Vec3R& displacement, const Vec3R& velocityChange) {
+            store.applyContact(index, displacement, velocityChange);
+        });
+}
+
+
+TEST(ClothKernelsTest, ContactsAreAppliedByRows)
+{
+    ClothParticleStore store;
+    buildStore(store, 11, 13);
+    const size_t index = store.getIndex(4, 2);
+    const Vec3 position(store.m_position[index]);
+    const Vec3 velocity(store.m_velocity[index]);
+
+    std::vector<ContactBuffer> buffers(2);
+    buffers[0].add(0, index, 1, 7, Vec3R(0.0, 0.01, 0.0), Vec3R(0.0, 1.0, 0.0));
+    buffers[1].add(0, index, 1, 3, Vec3R(0.0, 0.02, 0.0), Vec3R(0.0, 0.5, 0.0));
+    buffers[1].add(1, index, 0, index, Vec3R(1.0, 0.0, 0.0), Vec3R(1.0, 0.0, 0.0));
+    for (ContactBuffer& buffer : buffers)
+    {
+        buffer.sort();
+    }
+
+    // Rows outside of the range are not touched
+    applyContacts(store, buffers, 0, 4);
+    assertVec3Near(Vec3(store.m_position[index]), position, 0.0);
+
+    // The contacts of the other cloth are ignored
+    applyContacts(store, buffers, 4, 5);
+    assertVec3Near(Vec3(store.m_position[index]), position + Vec3(0.0, 0.03, 0.0), 1e-6);
+    assertVec3Near(Vec3(store.m_velocity[index]), velocity + Vec3(0.0, 1.5, 0.0), 1e-6);
+}
+
+
+TEST(ClothKernelsTest, ContactsAreSummedInAFixedOrder)
+{
+    // Contacts whose sum depends on the order of the additions
+    std::vector<ParticleContact> contacts;
+    for (size_t k = 0; k < 200; ++k)
+    {
+        ParticleContact contact;
+        contact.m_index = (k * 7) % 5;
+        contact.m_otherClothUid = 1;
+        contact.m_otherIndex = k;
+        const Real value = static_cast<Real>(1.0 / static_cast<double>(k + 3)) * ((k % 2 == 0) ? static_cast<Real>(1e4) : static_cast<Real>(1));
+        contact.m_displacement = Vec3R(value, -value, value * static_cast<Real>(0.5));
+        contact.m_velocityChange = Vec3R(-value, value, value);
+        contacts.push_back(contact);
+    }
+
+    // The same contacts, found by 1 task or by 4 tasks in another order
+    std::vector<ContactBuffer> oneTask(1);
+    std::vector<ContactBuffer> fourTasks(4);
+    for (size_t k = 0; k < contacts.size(); ++k)
+    {
+        const ParticleContact& contact = contacts[k];
+        oneTask[0].add(contact.m_clothUid, contact.m_index, contact.m_otherClothUid, contact.m_otherIndex, contact.m_displacement, contact.m_velocityChange);
+        const ParticleContact& shuffled = contacts[(k * 37) % contacts.size()];
+        fourTasks[(k * 13) % 4].add(shuffled.m_clothUid, shuffled.m_index, shuffled.m_otherClothUid, shuffled.m_otherIndex, shuffled.m_displacement, shuffled.m_velocityChange);
+    }
+    for (ContactBuffer& buffer : oneTask)
+    {
+        buffer.sort();
+    }
+    for (ContactBuffer& buffer : fourTasks)
+    {
+        buffer.sort();
+    }
+
+    ClothParticleStore store1;
+    ClothParticleStore store4;
+    buildStore(store1, 11, 13);
+    buildStore(store4, 11, 13);
+    applyContacts(store1, oneTask, 0, store1.getResX());
+    applyContacts(store4, fourTasks, 0, 1);
+    applyContacts(store4, fourTasks, 1, store4.getResX());
+
+    // Bit exact
+    for (size_t k = 0; k < store1.size(); ++k)
+    {
+        assertVec3Near(Vec3(store4.m_position[k]), Vec3(store1.m_position[k]), 0.0);
+        assertVec3Near(Vec3(store4.m_velocity[k]), Vec3(store1.m_velocity[k]), 0.0);
+    }
+}
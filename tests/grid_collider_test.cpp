@@ -0,0 +1,302 @@
+#include <gtest/gtest.h>
+
+#include "../src/physics/gridCollider.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+
+static std::tuple<size_t, int, int> toTuple(const GridParticle& particle)
+{
+    return std::make_tuple(static_cast<size_t>(particle.m_clothUid), particle.m_i, particle.m_j);
+}
+
+
+static void buildSortedGrid(SortedGridCollider& grid)
+{
+    // Split the chunks in two like two threads would, phase after phase
+    const size_t cellChunks = grid.getCellChunkCount();
+    grid.countCells(0, cellChunks / 2);
+    grid.countCells(cellChunks / 2, cellChunks);
+    grid.scanCells();
+    grid.writeCellStarts(cellChunks / 2, cellChunks);
+    grid.writeCellStarts(0, cellChunks / 2);
+    const size_t particleChunks = grid.getParticleChunkCount();
+    grid.scatterParticles(particleChunks / 2, particleChunks);
+    grid.scatterParticles(0, particleChunks / 2);
+}
+
+
+TEST(SortedGridColliderTest, CellsMatchTheLockedGrid)
+{
+    const double step = 0.1;
+    const size_t width = 40;
+    const size_t height = 40;
+    StaticGridCollider lockedGrid(step, width, height, Vec3(0.0, 0.0, 0.0));
+    SortedGridCollider sortedGrid(step, width, height);
+
+    // Two cloths, some of their particles out of the grid
+    const int resX = 30;
+    const int resY = 50;
+    sortedGrid.registerCloth(0, resX, resY);
+    sortedGrid.registerCloth(2, resX, resY);
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> coordinate(-0.2, 4.2);
+    for (const size_t clothUid : { size_t(0), size_t(2) })
+    {
+        for (int i = 0; i < resX; ++i)
+        {
+            for (int j = 0; j < resY; ++j)
+            {
+                const Vec3R position(coordinate(generator), coordinate(generator), coordinate(generator));
+                lockedGrid.addParticleToCell(position, std::make_tuple(clothUid, i, j));
+                sortedGrid.addParticleToCell(position, std::make_tuple(clothUid, i, j));
+            }
+        }
+    }
+    buildSortedGrid(sortedGrid);
+    // The cells of the locked grid are read after its swap
+    lockedGrid.swap();
+
+    ASSERT_EQ(sortedGrid.getNonEmptyCellCount(), lockedGrid.m_listOfPointerToNonEmptyCellsRead.size());
+    size_t particleCount = 0;
+    size_t previousCell = 0;
+    for (size_t k = 0; k < sortedGrid.getNonEmptyCellCount(); ++k)
+    {
+        // The non-empty cells are listed in the order of the grid
+        const size_t cell = sortedGrid.getNonEmptyCell(k);
+        if (k > 0)
+        {
+            EXPECT_LT(previousCell, cell);
+        }
+        previousCell = cell;
+
+        int x;
+        int y;
+        int z;
+        sortedGrid.getCellCoordsFromIndex(cell, x, y, z);
+        EXPECT_EQ(sortedGrid.getCellIndex(x, y, z), cell);
+
+        size_t count = 0;
+        const uint32_t* pParticles = sortedGrid.getCellParticles(cell, count);
+        ASSERT_NE(pParticles, nullptr);
+        std::vector<std::tuple<size_t, int, int>> sortedParticles;
+        for (size_t p = 0; p < count; ++p)
+        {
+            sortedParticles.push_back(toTuple(sortedGrid.getParticle(pParticles[p])));
+        }
+
+        std::vector<std::tuple<size_t, int, int>> lockedParticles = lockedGrid.getCell(x, y, z)->m_particlesId;
+        std::sort(sortedParticles.begin(), sortedParticles.end());
+        std::sort(lockedParticles.begin(), lockedParticles.end());
+        EXPECT_EQ(sortedParticles, lockedParticles);
+        particleCount += count;
+    }
+    EXPECT_EQ(particleCount, sortedGrid.getParticleCount());
+    EXPECT_LT(particleCount, static_cast<size_t>(2 * resX * resY));
+}
+
+
+TEST(SortedGridColliderTest, ClearedGridIsBuiltAgain)
+{
+    SortedGridCollider grid(1.0, 8, 8);
+    grid.registerCloth(0, 2, 2);
+
+    grid.addParticleToCell(Vec3R(1.0, 1.0, 1.0), std::make_tuple(size_t(0), 0, 0));
+    grid.addParticleToCell(Vec3R(1.0, 1.0, 1.0), std::make_tuple(size_t(0), 0, 1));
+    grid.addParticleToCell(Vec3R(3.0, 1.0, 1.0), std::make_tuple(size_t(0), 1, 0));
+    // Not registered, ignored
+    grid.addParticleToCell(Vec3R(3.0, 1.0, 1.0), std::make_tuple(size_t(1), 0, 0));
+    buildSortedGrid(grid);
+
+    ASSERT_EQ(grid.getNonEmptyCellCount(), 2u);
+    EXPECT_EQ(grid.getParticleCount(), 3u);
+    size_t count = 0;
+    EXPECT_NE(grid.getCellParticles(grid.getCellIndex(1, 1, 1), count), nullptr);
+    EXPECT_EQ(count, 2u);
+
+    grid.clearGridParallelized(0, grid.getNonEmptyCellCount());
+    grid.swap();
+    EXPECT_EQ(grid.getNonEmptyCellCount(), 0u);
+    EXPECT_EQ(grid.getCellParticles(grid.getCellIndex(1, 1, 1), count), nullptr);
+
+    // The particles not added again are not in the next grid
+    grid.addParticleToCell(Vec3R(5.0, 5.0, 5.0), std::make_tuple(size_t(0), 1, 1));
+    buildSortedGrid(grid);
+    ASSERT_EQ(grid.getNonEmptyCellCount(), 1u);
+    EXPECT_EQ(grid.getNonEmptyCell(0), grid.getCellIndex(5, 5, 5));
+    const uint32_t* pParticles = grid.getCellParticles(grid.getCellIndex(5, 5, 5), count);
+    ASSERT_EQ(count, 1u);
+    EXPECT_EQ(pParticles[0], grid.getParticleHandle(0, 1, 1));
+    EXPECT_EQ(grid.getParticle(pParticles[0]).m_i, 1);
+    EXPECT_EQ(grid.getParticle(pParticles[0]).m_j, 1);
+}
+
+
+TEST(SortedGridColliderTest, UnboundedGridKeepsEveryParticle)
+{
+    const double step = 0.5;
+    SortedGridCollider grid(step);
+    EXPECT_TRUE(grid.isHashed());
+
+    // Enough particles to grow the table, spread far from the origin on both sides
+    const int resX = 40;
+    const int resY = 40;
+    grid.registerCloth(1, resX, resY);
+
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> coordinate(-1000.0, 1000.0);
+    std::map<std::tuple<int, int, int>, std::vector<std::tuple<size_t, int, int>>> expectedCells;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        expectedCells.clear();
+        for (int i = 0; i < resX; ++i)
+        {
+            for (int j = 0; j < resY; ++j)
+            {
+                // Half of the particles close to the Z axis, some of them share their cells
+                const double scale = (j % 2 == 0) ? 1.0 : 0.01;
+                const Vec3R position(coordinate(generator) * scale, coordinate(generator) * scale, coordinate(generator));
+                grid.addParticleToCell(position, std::make_tuple(size_t(1), i, j));
+                const std::tuple<int, int, int> coords(
+                    static_cast<int>(round(position.x / step)), static_cast<int>(round(position.y / step)), static_cast<int>(round(position.z / step)));
+                expectedCells[coords].push_back(std::make_tuple(size_t(1), i, j));
+            }
+        }
+        buildSortedGrid(grid);
+
+        ASSERT_EQ(grid.getNonEmptyCellCount(), expectedCells.size());
+        EXPECT_EQ(grid.getParticleCount(), static_cast<size_t>(resX * resY));
+        for (auto& [coords, expectedParticles] : expectedCells)
+        {
+            const auto& [x, y, z] = coords;
+            const size_t cell = grid.findCell(x, y, z);
+            ASSERT_NE(cell, SortedGridCollider::s_invalidCell);
+
+            int cellX;
+            int cellY;
+            int cellZ;
+            grid.getCellCoordsFromIndex(cell, cellX, cellY, cellZ);
+            EXPECT_EQ(std::make_tuple(cellX, cellY, cellZ), coords);
+
+            size_t count = 0;
+            const uint32_t* pParticles = grid.getCellParticles(cell, count);
+            std::vector<std::tuple<size_t, int, int>> particles;
+            for (size_t p = 0; p < count; ++p)
+            {
+                particles.push_back(toTuple(grid.getParticle(pParticles[p])));
+            }
+            std::sort(particles.begin(), particles.end());
+            std::sort(expectedParticles.begin(), expectedParticles.end());
+            EXPECT_EQ(particles, expectedParticles);
+        }
+        EXPECT_EQ(grid.findCell(5000, 0, 0), SortedGridCollider::s_invalidCell);
+
+        // The table is empty again for the next pass
+        grid.clearGridParallelized(0, grid.getNonEmptyCellCount());
+        grid.swap();
+        EXPECT_EQ(grid.findCell(std::get<0>(expectedCells.begin()->first), std::get<1>(expectedCells.begin()->first),
+            std::get<2>(expectedCells.begin()->first)), SortedGridCollider::s_invalidCell);
+    }
+}
+
+
+TEST(SortedGridColliderTest, DivergedParticlesAreOutOfTheGrid)
+{
+    SortedGridCollider grid(0.5);
+    grid.registerCloth(1, 2, 2);
+
+    // A position that blew up, or became NaN, has no cell: it must not overflow the cell coordinates
+    grid.addParticleToCell(Vec3R(1.0, 2.0, 3.0), std::make_tuple(size_t(1), 0, 0));
+    grid.addParticleToCell(Vec3R(std::numeric_limits<Real>::quiet_NaN(), 0.0, 0.0), std::make_tuple(size_t(1), 0, 1));
+    grid.addParticleToCell(Vec3R(0.0, static_cast<Real>(-1e30), 0.0), std::make_tuple(size_t(1), 1, 0));
+    grid.addParticleToCell(Vec3R(0.0, 0.0, std::numeric_limits<Real>::infinity()), std::make_tuple(size_t(1), 1, 1));
+    buildSortedGrid(grid);
+
+    EXPECT_EQ(grid.getNonEmptyCellCount(), 1u);
+    EXPECT_NE(grid.findCell(2, 4, 6), SortedGridCollider::s_invalidCell);
+    EXPECT_EQ(grid.findCell(std::numeric_limits<int>::min(), 0, 0), SortedGridCollider::s_invalidCell);
+    EXPECT_EQ(grid.findCell(0, std::numeric_limits<int>::max(), 0), SortedGridCollider::s_invalidCell);
+}
+
+
+TEST(SortedGridColliderTest, CellsOfABlockAreInZOrder)
+{
+    // Not a multiple of the blocks
+    SortedGridCollider grid(1.0, 10, 6);
+
+    // 3 x 3 x 2 blocks of 64 cells
+    std::vector<bool> isUsed(3 * 3 * 2 * 64, false);
+    for (int z = 0; z < 6; ++z)
+    {
+        for (int y = 0; y < 10; ++y)
+        {
+            for (int x = 0; x < 10; ++x)
+            {
+                const size_t cell = grid.getCellIndex(x, y, z);
+                ASSERT_LT(cell, isUsed.size());
+                EXPECT_FALSE(isUsed[cell]);
+                isUsed[cell] = true;
+
+                int cellX;
+                int cellY;
+                int cellZ;
+                grid.getCellCoordsFromIndex(cell, cellX, cellY, cellZ);
+                EXPECT_EQ(std::make_tuple(cellX, cellY, cellZ), std::make_tuple(x, y, z));
+            }
+        }
+    }
+
+    // The 8 cells of a 2x2x2 corner of a block follow each other
+    const size_t corner = grid.getCellIndex(4, 0, 0);
+    for (int k = 0; k < 8; ++k)
+    {
+        EXPECT_EQ(grid.getCellIndex(4 + (k & 1), (k >> 1) & 1, (k >> 2) & 1), corner + static_cast<size_t>(k));
+    }
+}
+
+
+TEST(SortedGridColliderTest, PositionsAreCopiedInTheOrderOfTheCells)
+{
+    for (const bool isHashed : { false, true })
+    {
+        std::unique_ptr<SortedGridCollider> pGrid = isHashed ? std::make_unique<SortedGridCollider>(0.5) : std::make_unique<SortedGridCollider>(0.5, 16, 16);
+        pGrid->registerCloth(0, 8, 8);
+
+        std::vector<Vec3R> positions;
+        for (int i = 0; i < 8; ++i)
+        {
+            for (int j = 0; j < 8; ++j)
+            {
+                positions.push_back(Vec3R(1.0 + 0.3 * i, 2.0, 1.0 + 0.3 * j));
+                pGrid->addParticleToCell(positions.back(), std::make_tuple(size_t(0), i, j));
+            }
+        }
+        buildSortedGrid(*pGrid);
+
+        size_t particleCount = 0;
+        for (size_t k = 0; k < pGrid->getNonEmptyCellCount(); ++k)
+        {
+            const size_t cell = pGrid->getNonEmptyCell(k);
+            size_t count = 0;
+            const uint32_t* pParticles = pGrid->getCellParticles(cell, count);
+            const Vec3R* pPositions = pGrid->getCellPositions(cell);
+            for (size_t p = 0; p < count; ++p)
+            {
+                const GridParticle& particle = pGrid->getParticle(pParticles[p]);
+                const Vec3R& expected = positions[static_cast<size_t>(particle.m_i * 8 + particle.m_j)];
+                EXPECT_EQ(pPositions[p].x, expected.x);
+                EXPECT_EQ(pPositions[p].y, expected.y);
+                EXPECT_EQ(pPositions[p].z, expected.z);
+            }
+            particleCount += count;
+        }
+        EXPECT_EQ(particleCount, positions.size());
+    }
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <algorithm>
+
+#include "../src/math/Vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+#include "../src/physics/implicitSolver.hpp"
+#include "utils.hpp"
+
+
+static const double s_spacing = 0.1;
+
+
+// Flat resX x resY grid (in the XZ plane) at rest, hanging from two corners
+static void buildStore(ClothParticleStore& store, const int resX, const int resY)
+{
+    buildFlatStore(store, resX, resY, s_spacing);
+    std::fill(store.m_inverseMass.begin(), store.m_inverseMass.end(), static_cast<Real>(4.0));
+    store.setFixed(store.getIndex(0, 0), true);
+    store.setFixed(store.getIndex(0, resY - 1), true);
+}
+
+
+// One implicit step over batches of rows, with the same phases as the orchestrator
+static void step(ImplicitSolver& solver, ClothParticleStore& store, const double dt, const int batchSize)
+{
+    auto forEachBatch = [&store, batchSize](auto function) { forEachRowBatch(store.getResX(), batchSize, function); };
+
+    forEachBatch([&](int from, int to) { solver.beginStep(store, dt, from, to); });
+    bool isActive = solver.startIterations();
+    while (isActive)
+    {
+        forEachBatch([&](int from, int to) { solver.computeProduct(store, dt, from, to); });
+        solver.computeStepLength();
+        forEachBatch([&](int from, int to) { solver.updateResidual(from, to); });
+        isActive = solver.finishIteration();
+        if (isActive)
+        {
+            forEachBatch([&](int from, int to) { solver.updateDirection(from, to); });
+        }
+    }
+    forEachBatch([&](int from, int to) { solver.endStep(store, dt, from, to); });
+    store.copyCurrentToPrevious(0, store.size());
+}
+
+
+TEST(ImplicitSolverTest, StiffClothIsStableWithLargeTimeSteps)
+{
+    const int resX = 15;
+    const int resY = 15;
+    ClothParticleStore store;
+    buildStore(store, resX, resY);
+
+    // Far too stiff for the explicit integration at this time step
+    ClothSpringStencil stencil;
+    stencil.init(resX, resY, s_spacing, s_spacing, 100000.0, 0.0);
+
+    ImplicitSolver solver;
+    solver.init(resX, resY, &stencil);
+    solver.m_maxIterations = 200;
+    solver.m_tolerance = 1e-4;
+
+    // 2 seconds at 60 Hz
+    for (int frame = 0; frame < 120; ++frame)
+    {
+        step(solver, store, 1.0 / 60.0, 5);
+        ASSERT_TRUE(solver.getStats().m_converged);
+        EXPECT_LE(solver.getStats().m_relativeResidual, 1e-4);
+    }
+
+    for (size_t index = 0; index < store.size(); ++index)
+    {
+        const Vec3 position(store.m_position[index]);
+        ASSERT_TRUE(std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z));
+        EXPECT_LE(position.y, 2.0 + 1e-6);
+        EXPECT_GT(position.y, 2.0 - 2.0 * s_spacing * resX);
+    }
+
+    // The fixed corners did not move
+    assertVec3Near(Vec3(store.m_position[store.getIndex(0, 0)]), Vec3(0.0, 2.0, 0.0), 1e-12);
+}
+
+
+TEST(ImplicitSolverTest, BatchesDoNotChangeTheResult)
+{
+    const int resX = 11;
+    const int resY = 7;
+
+    ClothSpringStencil stencil;
+    stencil.init(resX, resY, s_spacing, s_spacing, 5000.0, 0.0);
+
+    ClothParticleStore reference;
+    buildStore(reference, resX, resY);
+    ImplicitSolver referenceSolver;
+    referenceSolver.init(resX, resY, &stencil);
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        step(referenceSolver, reference, 1.0 / 60.0, resX);
+    }
+
+    // The dot products are summed per row, so the result does not depend on the batches
+    for (int batchSize : { 1, 2, 5 })
+    {
+        ClothParticleStore store;
+        buildStore(store, resX, resY);
+        ImplicitSolver solver;
+        solver.init(resX, resY, &stencil);
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            step(solver, store, 1.0 / 60.0, batchSize);
+        }
+
+        EXPECT_EQ(solver.getStats().m_iterations, referenceSolver.getStats().m_iterations);
+        for (size_t k = 0; k < store.size(); ++k)
+        {
+            assertVec3Near(Vec3(store.m_position[k]), Vec3(reference.m_position[k]), 0.0);
+        }
+    }
+}
+
+
+TEST(ImplicitSolverTest, IterationLimitIsReported)
+{
+    const int resX = 10;
+    const int resY = 10;
+    ClothParticleStore store;
+    buildStore(store, resX, resY);
+
+    ClothSpringStencil stencil;
+    stencil.init(resX, resY, s_spacing, s_spacing, 100000.0, 0.0);
+
+    ImplicitSolver solver;
+    solver.init(resX, resY, &stencil);
+    solver.m_maxIterations = 2;
+    solver.m_tolerance = 1e-12;
+
+    // Let the cloth fall a bit so the springs are stretched
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        step(solver, store, 1.0 / 60.0, 3);
+    }
+
+    EXPECT_EQ(solver.getStats().m_iterations, 2);
+    EXPECT_FALSE(solver.getStats().m_converged);
+    EXPECT_GT(solver.getStats().m_relativeResidual, 1e-12);
+}
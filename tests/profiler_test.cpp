@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include "../src/threading/profiler.hpp"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+TEST(ProfilerTest, RingBufferDropsWhenFull)
+{
+    ProfileRingBuffer buffer(3);
+    EXPECT_EQ(buffer.getCapacity(), 4u);
+
+    ProfileSample sample;
+    for (int i = 0; i < 6; ++i)
+    {
+        sample.m_durationNanoseconds = i;
+        EXPECT_EQ(buffer.push(sample), i < 4);
+    }
+    EXPECT_EQ(buffer.getDroppedCount(), 2u);
+
+    std::vector<ProfileSample> samples;
+    EXPECT_EQ(buffer.drain(samples), 4u);
+    ASSERT_EQ(samples.size(), 4u);
+    EXPECT_EQ(samples.front().m_durationNanoseconds, 0);
+    EXPECT_EQ(samples.back().m_durationNanoseconds, 3);
+
+    // Room again once drained
+    EXPECT_TRUE(buffer.push(sample));
+    EXPECT_EQ(buffer.drain(samples), 1u);
+}
+
+
+TEST(ProfilerTest, StatisticsOfTheWindow)
+{
+    Profiler profiler;
+    const uint32_t stepId = profiler.registerScope("step");
+    const uint32_t taskId = profiler.registerScope("task");
+    EXPECT_EQ(profiler.registerScope("step"), stepId);
+
+    // 1 to 100 us
+    for (int i = 1; i <= 100; ++i)
+    {
+        profiler.addSample(stepId, 0, i * 1000);
+    }
+
+    const std::vector<ProfileScopeStats> stats = profiler.getStats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[stepId].m_name, "step");
+    EXPECT_EQ(stats[stepId].m_count, 100u);
+    EXPECT_NEAR(stats[stepId].m_min, 1e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_max, 100e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_mean, 50.5e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_p50, 50e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_p95, 95e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_p99, 99e-6, 1e-12);
+    EXPECT_NEAR(stats[stepId].m_totalTime, 5050e-6, 1e-12);
+    EXPECT_EQ(stats[taskId].m_count, 0u);
+}
+
+
+TEST(ProfilerTest, RollingWindowKeepsTheLastSamples)
+{
+    Profiler profiler(64, 10);
+    const uint32_t id = profiler.registerScope("step");
+
+    for (int i = 1; i <= 25; ++i)
+    {
+        profiler.addSample(id, 0, i);
+        profiler.collect();
+    }
+
+    const ProfileScopeStats stats = profiler.getStats()[id];
+    EXPECT_EQ(stats.m_count, 25u);
+    EXPECT_EQ(stats.m_windowCount, 10u);
+    EXPECT_NEAR(stats.m_min, 16e-9, 1e-15);
+    EXPECT_NEAR(stats.m_max, 25e-9, 1e-15);
+
+    profiler.reset();
+    EXPECT_EQ(profiler.getStats()[id].m_count, 0u);
+}
+
+
+TEST(ProfilerTest, CollectsTheSamplesOfAllTheThreads)
+{
+    Profiler profiler;
+    const uint32_t id = profiler.registerScope("task");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&profiler, id]() {
+            for (int i = 0; i < 1000; ++i)
+            {
+                ProfileScope scope(profiler, id);
+            }
+        });
+    }
+
+    // Collected while the threads measure
+    for (int i = 0; i < 100; ++i)
+    {
+        profiler.collect();
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(profiler.getStats()[id].m_count + profiler.getDroppedSampleCount(), 4000u);
+    EXPECT_EQ(profiler.getDroppedSampleCount(), 0u);
+
+    // Nothing is measured once disabled
+    profiler.setEnabled(false);
+    {
+        ProfileScope scope(profiler, id);
+    }
+    EXPECT_EQ(profiler.getStats()[id].m_count, 4000u);
+}
+
+
+TEST(ProfilerTest, ExportsJsonAndCsv)
+{
+    Profiler profiler;
+    const uint32_t id = profiler.registerScope("step.run_graph");
+    profiler.addSample(id, 0, 2000);
+
+    std::ostringstream json;
+    profiler.exportJson(json);
+    EXPECT_NE(json.str().find("\"name\": \"step.run_graph\""), std::string::npos);
+    EXPECT_NE(json.str().find("\"count\": 1"), std::string::npos);
+    EXPECT_NE(json.str().find("\"p99Us\": 2"), std::string::npos);
+
+    std::ostringstream csv;
+    profiler.exportCsv(csv);
+    EXPECT_EQ(csv.str(),
+        "name,count,total_ms,window_count,min_us,mean_us,p50_us,p95_us,p99_us,max_us\n"
+        "step.run_graph,1,0.002,1,2,2,2,2,2,2\n");
+}
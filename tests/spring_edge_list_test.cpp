@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+#include "../src/math/Vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/springEdgeList.hpp"
+#include "../src/physics/gridSpringStencil.hpp"
+#include "utils.hpp"
+
+
+// Forces are summed in a different order, so they match up to the rounding of the simulation precision
+static const double s_tolerance = std::is_same_v<Real, float> ? 1e-3 : 1e-9;
+
+// Build a slightly deformed resX x resY grid linked with a 5x5 stencil of springs
+static void buildGrid(ClothParticleStore& store, SpringEdgeList& edges, const int resX, const int resY)
+{
+    store.resize(resX, resY);
+    edges.reset(resX, resY);
+
+    for (int i = 0; i < resX; ++i)
+    {
+        for (int j = 0; j < resY; ++j)
+        {
+            const size_t index = store.getIndex(i, j);
+            store.m_previousPosition[index] = Vec3R(0.1 * i + 0.01 * std::sin(7.0 * j), 0.02 * std::cos(3.0 * i + j), 0.1 * j);
+            store.m_previousVelocity[index] = Vec3R(0.05 * std::sin(1.0 * index), 0.0, 0.05 * std::cos(2.0 * index));
+        }
+    }
+
+    for (int i = 0; i < resX; ++i)
+    {
+        for (int j = 0; j < resY; ++j)
+        {
+            for (int ii = std::max(0, i - 2); ii <= std::min(resX - 1, i + 2); ++ii)
+            {
+                for (int jj = std::max(0, j - 2); jj <= std::min(resY - 1, j + 2); ++jj)
+                {
+                    if (store.getIndex(ii, jj) <= store.getIndex(i, j))
+                    {
+                        continue;
+                    }
+                    const int dist = std::max(std::abs(ii - i), std::abs(jj - j));
+                    const double restLength = 0.1 * std::sqrt(static_cast<double>((ii - i) * (ii - i) + (jj - j) * (jj - j)));
+                    edges.addEdge(store.getIndex(i, j), store.getIndex(ii, jj), restLength, 1000.0 / (dist * 2.0), 0.5);
+                }
+            }
+        }
+    }
+    edges.finalize();
+}
+
+
+TEST(SpringEdgeListTest, EachSpringIsStoredOnce)
+{
+    ClothParticleStore store;
+    SpringEdgeList edges;
+    buildGrid(store, edges, 6, 7);
+
+    // 6x7 grid: horizontal/vertical/diagonal pairs within a distance of 2, counted once
+    size_t expected = 0;
+    for (int di = 0; di <= 2; ++di)
+    {
+        for (int dj = -2; dj <= 2; ++dj)
+        {
+            if (di == 0 && dj <= 0)
+            {
+                continue;
+            }
+            expected += static_cast<size_t>(6 - di) * static_cast<size_t>(7 - std::abs(dj));
+        }
+    }
+
+    EXPECT_EQ(edges.size(), expected);
+    EXPECT_EQ(edges.getHaloRows(), 2);
+}
+
+
+TEST(SpringEdgeListTest, ForcesAreEqualAndOpposite)
+{
+    ClothParticleStore store;
+    SpringEdgeList edges;
+    buildGrid(store, edges, 6, 7);
+
+    edges.accumulateForces(store, 0, 6);
+
+    Vec3 sum;
+    for (const Vec3R& force : store.m_externalForces)
+    {
+        sum += Vec3(force);
+    }
+
+    assertVec3Near(sum, Vec3(0.0, 0.0, 0.0), s_tolerance);
+}
+
+
+TEST(SpringEdgeListTest, BatchedScatterMatchesSingleBatch)
+{
+    ClothParticleStore reference;
+    SpringEdgeList referenceEdges;
+    buildGrid(reference, referenceEdges, 11, 5);
+    referenceEdges.accumulateForces(reference, 0, 11);
+
+    for (int batchSize : { 1, 2, 3, 5 })
+    {
+        ClothParticleStore store;
+        SpringEdgeList edges;
+        buildGrid(store, edges, 11, 5);
+
+        // Same sequence as the orchestrator: scatter all the batches, then gather before the integration
+        for (int i = 0; i < 11; i += batchSize)
+        {
+            edges.accumulateForces(store, i, std::min(i + batchSize, 11));
+        }
+        for (int i = 0; i < 11; i += batchSize)
+        {
+            edges.gatherHaloForces(store, i, std::min(i + batchSize, 11));
+        }
+
+        for (size_t k = 0; k < store.size(); ++k)
+        {
+            assertVec3Near(Vec3(store.m_externalForces[k]), Vec3(reference.m_externalForces[k]), s_tolerance);
+        }
+
+        // The halo buffers must be left empty for the next step
+        std::fill(store.m_externalForces.begin(), store.m_externalForces.end(), Vec3R(0.0, 0.0, 0.0));
+        for (int i = 0; i < 11; i += batchSize)
+        {
+            edges.gatherHaloForces(store, i, std::min(i + batchSize, 11));
+        }
+        for (const Vec3R& force : store.m_externalForces)
+        {
+            assertVec3Near(Vec3(force), Vec3(0.0, 0.0, 0.0), 1e-12);
+        }
+    }
+}
+
+
+TEST(SpringEdgeListTest, StencilMatchesEdgeList)
+{
+    ClothParticleStore reference;
+    SpringEdgeList edges;
+    buildGrid(reference, edges, 9, 6);
+    edges.accumulateForces(reference, 0, 9);
+
+    ClothParticleStore store;
+    SpringEdgeList unused;
+    buildGrid(store, unused, 9, 6);
+
+    // Same springs as buildGrid(), without storing them
+    GridSpringStencil<2, InverseDistanceFalloff<2>> stencil;
+    stencil.init(9, 6, 0.1, 0.1, 1000.0, 0.5);
+    stencil.accumulateForces(store, 0, 4);
+    stencil.accumulateForces(store, 4, 9);
+
+    for (size_t k = 0; k < store.size(); ++k)
+    {
+        assertVec3Near(Vec3(store.m_externalForces[k]), Vec3(reference.m_externalForces[k]), s_tolerance);
+    }
+}
@@ -0,0 +1,563 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+
+#include "../src/threading/chaseLevDeque.hpp"
+#include "../src/threading/mpmcRing.hpp"
+#include "../src/threading/taskQueue.hpp"
+#include "../src/threading/taskGroup.hpp"
+#include "../src/threading/taskGraph.hpp"
+
+
+// Worker threads running the same loop as the orchestrator's workers
+class TaskQueueWorkers
+{
+public:
+    TaskQueueWorkers(TaskQueue& queue, const size_t count) : m_queue(queue), m_count(count)
+    {
+        m_queue.setWorkerCount(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            m_threads.emplace_back([this, i]() {
+                while (m_isRunning)
+                {
+                    TaskQueue::TaskSlot task;
+                    m_queue.getTask(task, i);
+                    if (task)
+                    {
+                        task();
+                        m_queue.markTaskAsDone();
+                    }
+                }
+            });
+        }
+    }
+
+    ~TaskQueueWorkers()
+    {
+        m_isRunning = false;
+        m_queue.releaseAll(m_count);
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_queue.clearTaskQueue();
+    }
+
+private:
+    TaskQueue& m_queue;
+    size_t m_count;
+    std::atomic<bool> m_isRunning = true;
+    std::vector<std::thread> m_threads;
+};
+
+
+TEST(ChaseLevDequeTest, OwnerPopsInLifoOrderAndThievesStealInFifoOrder)
+{
+    ChaseLevDeque<int> deque(2);
+    for (int k = 0; k < 10; ++k)
+    {
+        deque.push(k);
+    }
+    EXPECT_EQ(deque.size(), 10);
+
+    int value = -1;
+    ASSERT_TRUE(deque.pop(value));
+    EXPECT_EQ(value, 9);
+    ASSERT_TRUE(deque.steal(value));
+    EXPECT_EQ(value, 0);
+
+    int count = 2;
+    while (deque.pop(value))
+    {
+        ++count;
+    }
+    EXPECT_EQ(count, 10);
+    EXPECT_FALSE(deque.steal(value));
+}
+
+
+TEST(ChaseLevDequeTest, EachValueIsTakenOnce)
+{
+    const int valueCount = 200000;
+    ChaseLevDeque<int> deque(16);
+    std::vector<std::atomic<int>> takenCount(valueCount);
+    std::atomic<bool> isPushing = true;
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t)
+    {
+        thieves.emplace_back([&]() {
+            int value = 0;
+            while (isPushing || !deque.empty())
+            {
+                if (deque.steal(value))
+                {
+                    takenCount[value]++;
+                }
+            }
+        });
+    }
+
+    // The owner pushes and pops at the same time, the deque grows while being stolen from
+    int value = 0;
+    for (int k = 0; k < valueCount; ++k)
+    {
+        deque.push(k);
+        if (k % 3 == 0 && deque.pop(value))
+        {
+            takenCount[value]++;
+        }
+    }
+    while (deque.pop(value))
+    {
+        takenCount[value]++;
+    }
+    isPushing = false;
+    for (std::thread& thief : thieves)
+    {
+        thief.join();
+    }
+
+    for (int k = 0; k < valueCount; ++k)
+    {
+        ASSERT_EQ(takenCount[k].load(), 1) << "value " << k;
+    }
+}
+
+
+TEST(MpmcRingTest, ValuesComeOutInOrderAndPushFailsWhenFull)
+{
+    MpmcRing<int> ring(3);
+    EXPECT_EQ(ring.capacity(), 4u);
+
+    for (int k = 0; k < 4; ++k)
+    {
+        int value = k;
+        ASSERT_TRUE(ring.tryPush(value));
+    }
+    int value = 4;
+    EXPECT_FALSE(ring.tryPush(value));
+    EXPECT_EQ(ring.size(), 4u);
+
+    // The slots are reused on the next lap
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            ASSERT_TRUE(ring.tryPop(value));
+            EXPECT_EQ(value, lap * 4 + k);
+            int nextValue = (lap + 1) * 4 + k;
+            ASSERT_TRUE(ring.tryPush(nextValue));
+        }
+    }
+    for (int k = 0; k < 4; ++k)
+    {
+        ASSERT_TRUE(ring.tryPop(value));
+    }
+    EXPECT_FALSE(ring.tryPop(value));
+    EXPECT_TRUE(ring.empty());
+}
+
+
+TEST(MpmcRingTest, EachValueIsTakenOnce)
+{
+    const int producerCount = 3;
+    const int valuesPerProducer = 100000;
+    MpmcRing<int> ring(64);
+    std::vector<std::atomic<int>> takenCount(producerCount * valuesPerProducer);
+    std::atomic<int> producingCount = producerCount;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producerCount; ++p)
+    {
+        threads.emplace_back([&, p]() {
+            for (int k = 0; k < valuesPerProducer; ++k)
+            {
+                int value = p * valuesPerProducer + k;
+                while (!ring.tryPush(value))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            producingCount--;
+        });
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        threads.emplace_back([&]() {
+            int value = 0;
+            while (producingCount > 0 || !ring.empty())
+            {
+                if (ring.tryPop(value))
+                {
+                    takenCount[value]++;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (size_t k = 0; k < takenCount.size(); ++k)
+    {
+        ASSERT_EQ(takenCount[k].load(), 1) << "value " << k;
+    }
+}
+
+
+TEST(TaskQueueTest, AllTasksRunBeforeWaitReturns)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 4);
+
+    std::vector<int> results(5000, 0);
+    for (int phase = 0; phase < 20; ++phase)
+    {
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            queue.addTask([&results, k]() { results[k]++; });
+        }
+        queue.waitUntilEmpty();
+
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            ASSERT_EQ(results[k], phase + 1);
+        }
+    }
+}
+
+
+TEST(TaskQueueTest, TasksAddedByWorkersAreStolen)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 4);
+
+    // A single task spawns all the others on its worker's deque, the idle workers steal them
+    std::atomic<int> count = 0;
+    queue.addTask([&queue, &count]() {
+        for (int k = 0; k < 1000; ++k)
+        {
+            queue.addTask([&count]() { count++; });
+        }
+    });
+    queue.waitUntilEmpty();
+
+    EXPECT_EQ(count.load(), 1000);
+}
+
+
+TEST(TaskQueueTest, RingBackendRunsAllTasksWhenFull)
+{
+    // Far more tasks than slots, added by the main thread and by a worker
+    TaskQueue queue(TaskQueueBackend::BoundedRing, 16);
+    EXPECT_EQ(queue.getBackend(), TaskQueueBackend::BoundedRing);
+    TaskQueueWorkers workers(queue, 4);
+
+    std::vector<int> results(2000, 0);
+    for (int phase = 0; phase < 10; ++phase)
+    {
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            queue.addTask([&results, k]() { results[k]++; });
+        }
+        queue.waitUntilEmpty();
+
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            ASSERT_EQ(results[k], phase + 1);
+        }
+    }
+
+    std::atomic<int> count = 0;
+    queue.addTask([&queue, &count]() {
+        for (int k = 0; k < 1000; ++k)
+        {
+            queue.addTask([&count]() { count++; });
+        }
+    });
+    queue.waitUntilEmpty();
+    EXPECT_EQ(count.load(), 1000);
+}
+
+
+TEST(TaskQueueTest, PersistentTasksAreExecutedInPlace)
+{
+    // Counts the copies of the callback: a persistent task is only referenced, whatever the backend
+    struct CopyCounter
+    {
+        std::atomic<int>* m_pCopyCount;
+        CopyCounter(std::atomic<int>* pCopyCount) : m_pCopyCount(pCopyCount) {}
+        CopyCounter(const CopyCounter& other) : m_pCopyCount(other.m_pCopyCount) { (*m_pCopyCount)++; }
+    };
+
+    for (const TaskQueueBackend backend : { TaskQueueBackend::WorkStealing, TaskQueueBackend::BoundedRing })
+    {
+        TaskQueue queue(backend, 16);
+        TaskQueueWorkers workers(queue, 2);
+
+        std::atomic<int> copyCount = 0;
+        std::atomic<int> runCount = 0;
+        std::vector<TaskQueue::Task> tasks(8);
+        for (TaskQueue::Task& task : tasks)
+        {
+            task.m_callback = [counter = CopyCounter(&copyCount), &runCount]() { runCount++; };
+        }
+        const int copyCountBefore = copyCount.load();
+
+        for (int replay = 0; replay < 50; ++replay)
+        {
+            for (TaskQueue::Task& task : tasks)
+            {
+                queue.addTask(task);
+            }
+            queue.waitUntilEmpty();
+        }
+        EXPECT_EQ(runCount.load(), 50 * 8);
+        EXPECT_EQ(copyCount.load(), copyCountBefore);
+    }
+}
+
+
+TEST(TaskGroupTest, WaitingThreadRunsTheTasksWithoutWorkers)
+{
+    TaskQueue queue;
+    queue.setWorkerCount(0);
+
+    int count = 0;
+    TaskGroup group(queue);
+    for (int k = 0; k < 100; ++k)
+    {
+        group.run([&count]() { count++; });
+    }
+    group.wait();
+
+    EXPECT_EQ(count, 100);
+
+    // Nothing submitted
+    group.wait();
+    EXPECT_EQ(count, 100);
+}
+
+
+TEST(TaskGroupTest, ExceptionIsRethrownByWait)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 4);
+
+    std::atomic<int> count = 0;
+    TaskGroup group(queue);
+    for (int k = 0; k < 200; ++k)
+    {
+        group.run([&count, k]() {
+            count++;
+            if (k == 17)
+            {
+                throw std::runtime_error("task 17 failed");
+            }
+        });
+    }
+    EXPECT_THROW(group.wait(), std::runtime_error);
+    EXPECT_EQ(count.load(), 200);
+
+    // The group can be reused, the exception has been consumed
+    group.run([&count]() { count++; });
+    EXPECT_NO_THROW(group.wait());
+    EXPECT_EQ(count.load(), 201);
+}
+
+
+TEST(TaskGroupTest, NestedGroupsAndWaitPolicies)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 3);
+
+    TaskWaitPolicy parkRightAway;
+    parkRightAway.m_spinRounds = 0;
+    TaskWaitPolicy spinOnly;
+    spinOnly.m_canPark = false;
+
+    for (const TaskWaitPolicy& waitPolicy : { parkRightAway, spinOnly, TaskWaitPolicy() })
+    {
+        queue.setWaitPolicy(waitPolicy);
+
+        // Each task waits for its own group of sub tasks, the waiting workers help the others
+        std::atomic<int> count = 0;
+        TaskGroup group(queue);
+        for (int k = 0; k < 20; ++k)
+        {
+            group.run([&queue, &count]() {
+                TaskGroup subGroup(queue);
+                for (int s = 0; s < 50; ++s)
+                {
+                    subGroup.run([&count]() { count++; });
+                }
+                subGroup.wait();
+            });
+        }
+        group.wait();
+
+        EXPECT_EQ(count.load(), 1000);
+    }
+}
+
+
+TEST(TaskGraphTest, DependenciesAreRespectedWhenReplayed)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 4);
+
+    // Chains of different lengths joined at the end, like the batches of cloths of different sizes
+    TaskGraph graph;
+    std::atomic<int> clock = 0;
+    std::vector<int> stamps(64, -1);
+    std::vector<std::pair<TaskGraph::NodeId, TaskGraph::NodeId>> dependencies;
+
+    const TaskGraph::NodeId joinNode = graph.addNode([&]() { stamps[0] = clock++; });
+    TaskGraph::NodeId nextNode = 1;
+    for (int chain = 0; chain < 6; ++chain)
+    {
+        const int length = 2 + 3 * chain;
+        for (int k = 0; k < length; ++k)
+        {
+            const TaskGraph::NodeId nodeId = graph.addNode([&stamps, &clock, nextNode]() { stamps[nextNode] = clock++; });
+            ASSERT_EQ(nodeId, nextNode);
+            if (k > 0)
+            {
+                dependencies.emplace_back(nodeId - 1, nodeId);
+            }
+            if (k == length - 1)
+            {
+                dependencies.emplace_back(nodeId, joinNode);
+            }
+            nextNode++;
+        }
+    }
+    for (const auto& [predecessor, successor] : dependencies)
+    {
+        graph.addDependency(predecessor, successor);
+        // Duplicated dependencies are ignored
+        graph.addDependency(predecessor, successor);
+    }
+
+    for (int run = 0; run < 50; ++run)
+    {
+        std::fill(stamps.begin(), stamps.end(), -1);
+        clock = 0;
+        graph.run(queue);
+
+        EXPECT_EQ(clock.load(), static_cast<int>(graph.getNodeCount()));
+        for (const auto& [predecessor, successor] : dependencies)
+        {
+            ASSERT_GE(stamps[predecessor], 0);
+            ASSERT_LT(stamps[predecessor], stamps[successor]);
+        }
+    }
+}
+
+
+TEST(TaskGraphTest, RunningThreadExecutesTheNodesWithoutWorkers)
+{
+    TaskQueue queue;
+    queue.setWorkerCount(0);
+
+    // Diamond: 0 -> (1, 2) -> 3
+    TaskGraph graph;
+    std::vector<int> order;
+    for (int k = 0; k < 4; ++k)
+    {
+        graph.addNode([&order, k]() { order.push_back(k); });
+    }
+    graph.addDependency(0, 1);
+    graph.addDependency(0, 2);
+    graph.addDependency(1, 3);
+    graph.addDependency(2, 3);
+
+    graph.run(queue);
+    ASSERT_EQ(order.size(), 4u);
+    EXPECT_EQ(order.front(), 0);
+    EXPECT_EQ(order.back(), 3);
+
+    // Replayed
+    graph.run(queue);
+    EXPECT_EQ(order.size(), 8u);
+}
+
+
+TEST(TaskGraphTest, ReplayedOnTheRingBackend)
+{
+    // The nodes are persistent tasks, referenced by the slots of the ring
+    TaskQueue queue(TaskQueueBackend::BoundedRing, 8);
+    TaskQueueWorkers workers(queue, 3);
+
+    // A fan of 32 nodes between a first and a last node
+    TaskGraph graph;
+    std::atomic<int> count = 0;
+    std::atomic<int> countAtEnd = -1;
+    const TaskGraph::NodeId firstNode = graph.addNode([&count]() { count = 0; });
+    const TaskGraph::NodeId lastNode = graph.addNode([&count, &countAtEnd]() { countAtEnd = count.load(); });
+    for (int k = 0; k < 32; ++k)
+    {
+        const TaskGraph::NodeId nodeId = graph.addNode([&count]() { count++; });
+        graph.addDependency(firstNode, nodeId);
+        graph.addDependency(nodeId, lastNode);
+    }
+
+    for (int run = 0; run < 50; ++run)
+    {
+        countAtEnd = -1;
+        graph.run(queue);
+        ASSERT_EQ(countAtEnd.load(), 32);
+    }
+}
+
+
+TEST(TaskGraphTest, CycleAndInvalidDependenciesAreRejected)
+{
+    TaskGraph graph;
+    const TaskGraph::NodeId first = graph.addNode([]() {});
+    const TaskGraph::NodeId second = graph.addNode([]() {});
+    EXPECT_THROW(graph.addDependency(first, first), std::invalid_argument);
+    EXPECT_THROW(graph.addDependency(first, 7), std::invalid_argument);
+
+    graph.addDependency(first, second);
+    graph.addDependency(second, first);
+    EXPECT_THROW(graph.build(), std::logic_error);
+    EXPECT_FALSE(graph.isBuilt());
+}
+
+
+TEST(TaskGraphTest, ExceptionSkipsTheRemainingNodesAndIsRethrown)
+{
+    TaskQueue queue;
+    TaskQueueWorkers workers(queue, 2);
+
+    TaskGraph graph;
+    bool shouldThrow = true;
+    std::atomic<int> count = 0;
+    const TaskGraph::NodeId failingNode = graph.addNode([&shouldThrow]() {
+        if (shouldThrow)
+        {
+            throw std::runtime_error("node failed");
+        }
+    });
+    const TaskGraph::NodeId successor = graph.addNode([&count]() { count++; });
+    graph.addDependency(failingNode, successor);
+
+    EXPECT_THROW(graph.run(queue), std::runtime_error);
+    EXPECT_EQ(count.load(), 0);
+
+    // The exception has been consumed, the graph can run again
+    shouldThrow = false;
+    EXPECT_NO_THROW(graph.run(queue));
+    EXPECT_EQ(count.load(), 1);
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "../src/threading/threadPoolConfig.hpp"
+
+
+TEST(ThreadPoolConfigTest, ParsesTheCgroupCpuQuota)
+{
+    // cgroup v2: "<quota> <period>"
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV2CpuMax("250000 100000"), 2.5);
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV2CpuMax("max 100000"), 0.0);
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV2CpuMax(""), 0.0);
+
+    // cgroup v1: a negative quota means no limit
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV1CpuQuota("400000", "100000"), 4.0);
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV1CpuQuota("-1", "100000"), 0.0);
+    EXPECT_DOUBLE_EQ(ThreadPoolConfig::parseCgroupV1CpuQuota("abc", "100000"), 0.0);
+}
+
+
+TEST(ThreadPoolConfigTest, FindsTheCgroupOfTheProcess)
+{
+    // cgroup v2: a single "0::<path>" line
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath("0::/user.slice/session-2.scope\n", ""), "/user.slice/session-2.scope");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath("0::/\n", ""), "/");
+
+    // cgroup v1: one line per hierarchy, the cpu controller can share its hierarchy with others
+    const std::string v1Content = "12:memory:/docker/abc\n4:cpu,cpuacct:/docker/abc\n3:cpuset:/docker/abc\n1:name=systemd:/docker/abc\n";
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath(v1Content, "cpu"), "/docker/abc");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath(v1Content, "cpuacct"), "/docker/abc");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath(v1Content, ""), "");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath("3:cpuset:/a\n", "cpu"), "");
+
+    // Hybrid: the v2 hierarchy next to the v1 ones
+    const std::string hybridContent = "4:cpu,cpuacct:/v1\n0::/v2\n";
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath(hybridContent, "cpu"), "/v1");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath(hybridContent, ""), "/v2");
+
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath("", ""), "");
+    EXPECT_EQ(ThreadPoolConfig::parseProcCgroupPath("invalid\n", "cpu"), "");
+}
+
+
+TEST(ThreadPoolConfigTest, WorkerCountLeavesCoresToTheOtherThreads)
+{
+    // The orchestrator thread, and the GUI thread if a core is reserved for it
+    EXPECT_EQ(ThreadPoolConfig::computeWorkerCount(8, true), 6u);
+    EXPECT_EQ(ThreadPoolConfig::computeWorkerCount(8, false), 7u);
+    EXPECT_EQ(ThreadPoolConfig::computeWorkerCount(64, true), 62u);
+
+    // Always at least one worker
+    EXPECT_EQ(ThreadPoolConfig::computeWorkerCount(1, true), 1u);
+    EXPECT_EQ(ThreadPoolConfig::computeWorkerCount(2, true), 1u);
+}
+
+
+TEST(ThreadPoolConfigTest, ResolvedSettingsHaveWorkers)
+{
+    EXPECT_FALSE(ThreadPoolConfig::getAvailableCpus().empty());
+    EXPECT_GE(ThreadPoolConfig::getCpuBudget(), 1u);
+    EXPECT_LE(ThreadPoolConfig::getCpuBudget(), ThreadPoolConfig::getAvailableCpus().size());
+
+    ThreadPoolSettings settings;
+    settings.m_workerCount = 0;
+    EXPECT_GE(ThreadPoolConfig::resolve(settings).m_workerCount, 1u);
+}
+
+
+TEST(ThreadPoolConfigTest, PinsAThreadToAnAvailableCpu)
+{
+    const std::vector<int> cpus = ThreadPoolConfig::getAvailableCpus();
+
+    bool isPinned = false;
+    std::thread thread([&]() { isPinned = ThreadPoolConfig::pinCurrentThread({ cpus.back() }); });
+    thread.join();
+
+#if defined(_WIN32) || defined(__linux__)
+    EXPECT_TRUE(isPinned);
+#else
+    EXPECT_FALSE(isPinned);
+#endif
+    EXPECT_FALSE(ThreadPoolConfig::pinCurrentThread({}));
+}
+
+
+TEST(ThreadPoolConfigTest, RestartedPoolKeepsItsCpus)
+{
+    const std::vector<int> processCpus = ThreadPoolConfig::getAvailableCpus();
+
+    ThreadPoolSettings settings;
+    settings.m_workerCount = 0;
+    settings.m_pinThreads = true;
+    settings.m_reserveMainThreadCore = true;
+
+    // start(), stop(), start() from the same thread, as when the simulation is reset
+    std::vector<size_t> workerCounts;
+    std::vector<std::vector<int>> poolCpus;
+    std::thread mainThread([&]() {
+        const std::vector<int> threadCpus = ThreadPoolConfig::getCurrentThreadCpus();
+        std::vector<int> mainThreadCpus;
+        for (int start = 0; start < 2; ++start)
+        {
+            const ThreadPoolSettings resolved = ThreadPoolConfig::resolve(settings);
+            workerCounts.push_back(resolved.m_workerCount);
+            poolCpus.push_back(ThreadPoolConfig::reservePoolCpus(resolved, mainThreadCpus));
+            // The core of the main thread is still a CPU of the process
+            EXPECT_EQ(ThreadPoolConfig::getAvailableCpus(), processCpus);
+
+            ThreadPoolConfig::releaseMainThreadCore(mainThreadCpus);
+            EXPECT_TRUE(mainThreadCpus.empty());
+        }
+        EXPECT_EQ(ThreadPoolConfig::getCurrentThreadCpus(), threadCpus);
+    });
+    mainThread.join();
+
+    ASSERT_EQ(workerCounts.size(), 2u);
+    EXPECT_EQ(workerCounts[0], workerCounts[1]);
+    EXPECT_EQ(poolCpus[0], poolCpus[1]);
+#if defined(_WIN32) || defined(__linux__)
+    // The first CPU is the core of the main thread, if there is another one for the pool
+    if (processCpus.size() > 1)
+    {
+        EXPECT_EQ(poolCpus[0], std::vector<int>(processCpus.begin() + 1, processCpus.end()));
+    }
+#endif
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include "../src/threading/traceRecorder.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+
+static TraceEvent makeEvent(const char* pName, const int64_t startNanoseconds, const int64_t durationNanoseconds)
+{
+    TraceEvent event;
+    event.m_pName = pName;
+    event.m_startNanoseconds = startNanoseconds;
+    event.m_durationNanoseconds = durationNanoseconds;
+    return event;
+}
+
+
+TEST(TraceRecorderTest, RecordsNothingWhenDisabled)
+{
+    TraceRecorder recorder;
+    recorder.record(makeEvent("task.update", 0, 10));
+    EXPECT_EQ(recorder.getEventCount(), 0u);
+
+    recorder.start(16);
+    recorder.record(makeEvent("task.update", 0, 10));
+    recorder.stop();
+    recorder.record(makeEvent("task.update", 20, 10));
+    EXPECT_EQ(recorder.getEventCount(), 1u);
+
+    // A new trace discards the previous one
+    recorder.start(16);
+    EXPECT_EQ(recorder.getEventCount(), 0u);
+}
+
+
+TEST(TraceRecorderTest, BufferIsBounded)
+{
+    TraceRecorder recorder;
+    recorder.start(4);
+
+    std::thread thread([&recorder]() {
+        for (int i = 0; i < 10; ++i)
+        {
+            recorder.record(makeEvent("task.update", i, 1));
+        }
+    });
+    thread.join();
+    for (int i = 0; i < 3; ++i)
+    {
+        recorder.record(makeEvent("step", i, 1));
+    }
+
+    EXPECT_EQ(recorder.getEventCount(), 7u);
+    EXPECT_EQ(recorder.getDroppedEventCount(), 6u);
+}
+
+
+TEST(TraceRecorderTest, WritesChromeTraceEvents)
+{
+    TraceRecorder recorder;
+    recorder.start(16);
+    recorder.setThreadName("orchestrator");
+
+    TraceEvent event = makeEvent("task.update", 1500, 2000);
+    event.m_clothUid = 3;
+    event.m_pRangeName = "rows";
+    event.m_rangeBegin = 10;
+    event.m_rangeEnd = 15;
+    recorder.record(event);
+    recorder.record(makeEvent("step.run_graph", 1000, 5000));
+    recorder.stop();
+
+    std::ostringstream stream;
+    recorder.writeChromeTrace(stream);
+    const std::string trace = stream.str();
+
+    EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(trace.find("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"orchestrator\"}}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"task.update\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":1.500,\"dur\":2.000,\"args\":{\"cloth\":3,\"rows\":[10,15]}}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"step.run_graph\",\"cat\":\"step\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":1.000,\"dur\":5.000}"), std::string::npos);
+    EXPECT_NE(trace.find("\"droppedEvents\":0"), std::string::npos);
+}
+
+
+TEST(TraceRecorderTest, EscapesTheNamesOfTheThreads)
+{
+    TraceRecorder recorder;
+    recorder.start(16);
+    std::thread thread([&recorder]() { recorder.setThreadName("worker \"1\"\n\t\\"); });
+    thread.join();
+    recorder.stop();
+
+    std::ostringstream stream;
+    recorder.writeChromeTrace(stream);
+    EXPECT_NE(stream.str().find("\"args\":{\"name\":\"worker \\\"1\\\"\\u000a\\u0009\\\\\"}}"), std::string::npos);
+}
+
+
+TEST(TraceRecorderTest, RecordersDoNotShareTheirBuffers)
+{
+    // A recorder created where a destroyed one was must not get its buffer back from the cache of the thread
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        auto pRecorder = std::make_unique<TraceRecorder>();
+        pRecorder->start(4);
+        pRecorder->record(makeEvent("task.update", 0, 1));
+        EXPECT_EQ(pRecorder->getEventCount(), 1u);
+    }
+}
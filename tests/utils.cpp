@@ -13,4 +13,17 @@ void assertVec3Near(const Vec3& v1, const Vec3& v2, double epsilon)
     EXPECT_NEAR(v1.x, v2.x, epsilon);
     EXPECT_NEAR(v1.y, v2.y, epsilon);
     EXPECT_NEAR(v1.z, v2.z, epsilon);
-}
\ No newline at end of file
+}
+
+void buildFlatStore(ClothParticleStore& store, const int resX, const int resY, const double spacing, const double height)
+{
+    store.resize(resX, resY);
+    for (int i = 0; i < resX; ++i)
+    {
+        for (int j = 0; j < resY; ++j)
+        {
+            store.m_position[store.getIndex(i, j)] = Vec3R(spacing * i, height, spacing * j);
+        }
+    }
+    store.copyCurrentToPrevious(0, store.size());
+}
@@ -1,7 +1,27 @@
 #pragma once
 #include "../src/math/Vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+
+#include <algorithm>
 
 
 bool approximatelyEqual(double a, double b, double epsilon = 1e-5);
 
-void assertVec3Near(const Vec3& v1, const Vec3& v2, double epsilon = 1e-5);
\ No newline at end of file
+void assertVec3Near(const Vec3& v1, const Vec3& v2, double epsilon = 1e-5);
+
+// Flat resX x resY grid of particles at rest (in the XZ plane, at the given height), the previous state is the current one
+void buildFlatStore(ClothParticleStore& store, const int resX, const int resY, const double spacing, const double height = 2.0);
+
+
+// Call function(from, to) for each batch of batchSize rows, as the orchestrator splits a cloth
+// With a parity of 0 or 1, only for the even or odd batches (the batches processed at the same time by the solvers)
+template <typename Function>
+void forEachRowBatch(const int resX, const int batchSize, Function&& function, const int parity = -1)
+{
+    const int firstRow = (parity < 0) ? 0 : parity * batchSize;
+    const int rowStep = (parity < 0) ? batchSize : 2 * batchSize;
+    for (int i = firstRow; i < resX; i += rowStep)
+    {
+        function(i, std::min(i + batchSize, resX));
+    }
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <algorithm>
+
+#include "../src/math/Vec3.hpp"
+#include "../src/physics/clothParticleStore.hpp"
+#include "../src/physics/xpbdSolver.hpp"
+#include "utils.hpp"
+
+
+static const double s_spacing = 0.1;
+
+
+// Flat resX x resY grid (in the XZ plane) at rest, with a unit mass per particle
+static void buildStore(ClothParticleStore& store, const int resX, const int resY)
+{
+    buildFlatStore(store, resX, resY, s_spacing);
+    store.m_airFriction = 0.0;
+}
+
+
+// Largest relative stretch of the links between direct neighbors
+static double getMaxStretch(const ClothParticleStore& store)
+{
+    double maxStretch = 0.0;
+    for (int i = 0; i < store.getResX(); ++i)
+    {
+        for (int j = 0; j < store.getResY(); ++j)
+        {
+            const Vec3 position(store.m_position[store.getIndex(i, j)]);
+            if (i + 1 < store.getResX())
+            {
+                const double length = (Vec3(store.m_position[store.getIndex(i + 1, j)]) - position).norm();
+                maxStretch = std::max(maxStretch, std::abs(length / s_spacing - 1.0));
+            }
+            if (j + 1 < store.getResY())
+            {
+                const double length = (Vec3(store.m_position[store.getIndex(i, j + 1)]) - position).norm();
+                maxStretch = std::max(maxStretch, std::abs(length / s_spacing - 1.0));
+            }
+        }
+    }
+    return maxStretch;
+}
+
+
+// One XPBD step, with the even then odd batches of rows, as the orchestrator does
+static void step(XpbdSolver& solver, ClothParticleStore& store, const double dt, const int batchSize)
+{
+    const int resX = store.getResX();
+    solver.predict(store, dt, 0, resX);
+    for (int iteration = 0; iteration < solver.m_iterations; ++iteration)
+    {
+        for (int parity = 0; parity < 2; ++parity)
+        {
+            forEachRowBatch(resX, batchSize, [&](int from, int to) { solver.solve(store, dt, from, to, iteration); }, parity);
+        }
+    }
+    solver.updateVelocities(store, dt, 0, resX);
+    store.copyCurrentToPrevious(0, store.size());
+}
+
+
+TEST(XpbdSolverTest, ProjectionRestoresRestLengths)
+{
+    ClothParticleStore store;
+    buildStore(store, 8, 6);
+
+    // Stretch the grid by 20% along X
+    for (Vec3R& position : store.m_position)
+    {
+        position.x *= static_cast<Real>(1.2);
+    }
+    store.setFixed(store.getIndex(0, 0), true);
+
+    XpbdSolver solver;
+    solver.init(8, 6, s_spacing, s_spacing);
+    solver.setCompliances(0.0, 0.0, 0.0);
+
+    const Vec3 fixedPosition(store.m_position[store.getIndex(0, 0)]);
+    const double initialStretch = getMaxStretch(store);
+    for (int iteration = 0; iteration < 50; ++iteration)
+    {
+        solver.solve(store, 1.0 / 60.0, 0, 8, iteration);
+    }
+
+    EXPECT_LT(getMaxStretch(store), initialStretch * 0.25);
+    assertVec3Near(Vec3(store.m_position[store.getIndex(0, 0)]), fixedPosition, 1e-12);
+}
+
+
+TEST(XpbdSolverTest, HangingClothIsStableWithFrameTimeSteps)
+{
+    const int resX = 20;
+    const int resY = 20;
+    ClothParticleStore store;
+    buildStore(store, resX, resY);
+    for (size_t index = 0; index < store.size(); ++index)
+    {
+        store.m_inverseMass[index] = static_cast<Real>(4.0);
+    }
+    store.m_airFriction = 2.0;
+    store.setFixed(store.getIndex(0, 0), true);
+    store.setFixed(store.getIndex(0, resY - 1), true);
+
+    XpbdSolver solver;
+    solver.init(resX, resY, s_spacing, s_spacing);
+    solver.setCompliances(1e-6, 1e-6, 1e-4);
+
+    // 10 seconds at 30 Hz
+    for (int frame = 0; frame < 300; ++frame)
+    {
+        step(solver, store, 1.0 / 30.0, 5);
+    }
+
+    for (size_t index = 0; index < store.size(); ++index)
+    {
+        const Vec3 position(store.m_position[index]);
+        ASSERT_TRUE(std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z));
+
+        // The cloth hangs below its fixed corners and does not fly away
+        EXPECT_LE(position.y, 2.0 + 1e-6);
+        EXPECT_GT(position.y, 2.0 - 2.0 * s_spacing * resX);
+        EXPECT_LT(Vec3(store.m_velocity[index]).norm(), 1.0);
+    }
+    EXPECT_LT(getMaxStretch(store), 1.0);
+}